@@ -0,0 +1,44 @@
+#ifndef H_API_EXCHANGE_H
+#define H_API_EXCHANGE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <ArduinoJson.h>
+
+/**
+ * @file ApiExchange.hpp
+ * @brief What a REST API handler sees of its request, and how it answers it.
+ *
+ * The WebServer handlers take an ApiExchange instead of an AsyncWebServerRequest: the route
+ * parameters and the JSON body are parsed before the handler runs, so all a handler needs is
+ * a way to answer. The device implementation (AsyncApiExchange, in WebServer.hpp) forwards to
+ * ESPAsyncWebServer. This header depends on ArduinoJson only, so that a host-side harness can
+ * run the handlers against a recording implementation and measure them.
+ */
+
+/** @brief Outcome of an API command, shared by the REST and WebSocket transports. */
+struct ApiResult {
+    int status;       ///< HTTP status code
+    const char* body; ///< JSON body
+};
+
+class ApiExchange {
+  public:
+    virtual ~ApiExchange() {}
+
+    /** @brief Answers with @p body, which is copied. */
+    virtual void send(int status, const char* contentType, const char* body) = 0;
+
+    /**
+     * @brief Answers with @p doc serialized.
+     * @param compressible Lets the implementation compress the body, for the responses that may be large.
+     */
+    virtual void sendJson(int status, const JsonDocument& doc, bool compressible = false) = 0;
+
+    /** @brief Answers with a file of the data partition, as an attachment if @p download. */
+    virtual void sendFile(const char* path, const char* contentType, bool download) = 0;
+
+    void sendJson(int status, const char* body) { send(status, "application/json", body); }
+};
+
+#endif // H_API_EXCHANGE_H
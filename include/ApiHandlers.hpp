@@ -0,0 +1,83 @@
+#ifndef APIHANDLERS_HPP
+#define APIHANDLERS_HPP
+
+#include "DeviceState.hpp"
+#include "ConfigManager.hpp"
+#include "RecipeProcessor.hpp"
+#include "TankManager.hpp"
+#include "ApiExchange.hpp"
+#include <ArduinoJson.h>
+
+/**
+ * @file ApiHandlers.hpp
+ * @brief REST handlers over the device state, the settings, the tanks, the recipes, the meal schedule,
+ *        the feeding and scale commands and the sensor and servo diagnostics.
+ *
+ * WebServer routes to them. They answer through an ApiExchange and use nothing of the web server,
+ * the network or the board, so the host benchmark (test_api_bench) runs them unchanged. The handlers
+ * that need the network, the data partition files or the system (network info, jitter report, scale
+ * trace, logs, system info, reboot, time) stay in WebServer.
+ */
+class ApiHandlers {
+  public:
+    ApiHandlers(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager, RecipeProcessor& recipeProcessor,
+      TankManager& tankManager);
+
+    // Status
+    void getStatus(ApiExchange& exchange);
+
+    // Settings
+    void getSettings(ApiExchange& exchange);
+    void updateSettings(ApiExchange& exchange, JsonDocument& doc);
+    void exportSettings(ApiExchange& exchange);
+
+    // Tanks
+    void getTanks(ApiExchange& exchange);
+    void updateTank(ApiExchange& exchange, uint64_t tankUid, JsonDocument& doc);
+    void getTankHistory(ApiExchange& exchange, uint64_t tankUid);
+    void calibrateDensity(ApiExchange& exchange, uint64_t tankUid);
+
+    // Scale
+    void getScale(ApiExchange& exchange);
+    void tareScale(ApiExchange& exchange);
+    void calibrateScale(ApiExchange& exchange, JsonDocument& doc);
+
+    // Feeding
+    void feedImmediate(ApiExchange& exchange, uint64_t tankUid, JsonDocument& doc);
+    void feedRecipe(ApiExchange& exchange, uint32_t recipeUid, JsonDocument& doc);
+    void stopFeeding(ApiExchange& exchange);
+    void getFeedingHistory(ApiExchange& exchange);
+    void getMealSchedule(ApiExchange& exchange);
+    void setMealSchedule(ApiExchange& exchange, JsonDocument& doc);
+    void cancelMealSchedule(ApiExchange& exchange);
+
+    // Recipes
+    void getRecipes(ApiExchange& exchange);
+    void addRecipe(ApiExchange& exchange, JsonDocument& doc);
+    void updateRecipe(ApiExchange& exchange, uint32_t recipeUid, JsonDocument& doc);
+    void deleteRecipe(ApiExchange& exchange, uint32_t recipeUid);
+
+    // Servos
+    void jogServo(ApiExchange& exchange, JsonDocument& doc);
+
+    // Diagnostics
+    void getSensorDiagnostics(ApiExchange& exchange);
+    void getServoDiagnostics(ApiExchange& exchange);
+
+    // Commands shared by the REST handlers and the WebSocket, which only differ in how they carry arguments and results
+    ApiResult commandFeedImmediate(uint64_t tankUid, JsonVariantConst amount);
+    ApiResult commandFeedRecipe(uint32_t recipeUid, int servings);
+    ApiResult commandStopFeeding();
+    ApiResult commandTareScale();
+    ApiResult commandCalibrateDensity(uint64_t tankUid);
+    ApiResult commandJogServo(JsonVariantConst servo, JsonVariantConst pwm);
+
+  private:
+    DeviceState& _deviceState;
+    SemaphoreHandle_t& _mutex;
+    ConfigManager& _configManager;
+    RecipeProcessor& _recipeProcessor;
+    TankManager& _tankManager;
+};
+
+#endif // APIHANDLERS_HPP
@@ -0,0 +1,77 @@
+#ifndef H_API_ROUTER_H
+#define H_API_ROUTER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @file ApiRouter.hpp
+ * @brief Path template matcher for the REST API.
+ *
+ * Templates are compiled at startup into a prefix trie with one node per path segment. A
+ * segment is either a literal or a typed parameter:
+ * - `{hex}`: 1 to 16 hexadecimal digits, such as a tank UID, captured as a 64-bit value.
+ * - `{uint}`: 1 to 10 decimal digits up to 4294967295, such as a recipe UID.
+ *
+ * A request path is matched in one pass over its segments, literals first, without any
+ * allocation. This header does not depend on Arduino nor on ESP-IDF, so that a host-side
+ * harness can exercise it.
+ */
+
+#define ROUTER_MAX_PARAMS (2) // Parameter segments in a template
+
+enum class RouteMethod : uint8_t { GET, POST, PUT, DELETE, PATCH, COUNT };
+
+struct RouteParams {
+    uint8_t count;
+    uint64_t values[ROUTER_MAX_PARAMS];
+
+    uint64_t operator[](uint8_t index) const { return index < count ? values[index] : 0; }
+};
+
+class ApiRouter {
+  public:
+    static constexpr int NO_ROUTE           = -1; ///< No template matches the path
+    static constexpr int METHOD_NOT_ALLOWED = -2; ///< A template matches the path, but not for this method
+
+    ApiRouter();
+
+    /**
+     * @brief Compiles @p pathTemplate for @p method.
+     * @return The id of the route, numbered from 0 in registration order, or NO_ROUTE if the template is
+     *         malformed or already registered for this method.
+     */
+    int add(const char* pathTemplate, RouteMethod method);
+
+    /**
+     * @brief Finds the route of @p path (without its query string).
+     * @return A route id with @p params filled in, NO_ROUTE or METHOD_NOT_ALLOWED.
+     */
+    int match(const char* path, size_t len, RouteMethod method, RouteParams& params) const;
+
+    size_t getRouteCount() const { return _routeCount; }
+    size_t getNodeCount() const { return _nodes.size(); }
+
+  private:
+    enum class SegmentType : uint8_t { LITERAL, HEX_PARAM, UINT_PARAM }; // not HEX: an Arduino macro
+
+    struct Node {
+        std::string literal;
+        SegmentType type;
+        int16_t firstChild;  // -1 for none
+        int16_t nextSibling; // -1 for none
+        int16_t routes[(uint8_t)RouteMethod::COUNT];
+    };
+
+    std::vector<Node> _nodes; // _nodes[0] is the root, "/"
+    int16_t _routeCount;
+
+    int16_t _findOrAddChild(int16_t parent, const char* segment, size_t len);
+    /** @brief Matches the rest of the path below @p node, backtracking from literals to parameters. */
+    int16_t _matchFrom(int16_t node, const char* path, const char* end, RouteParams& params) const;
+    static bool _parseParam(SegmentType type, const char* segment, size_t len, uint64_t& value);
+};
+
+#endif // H_API_ROUTER_H
@@ -20,6 +20,14 @@
 #define BATTERY_H_
 
 #include <Arduino.h>
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+
+// Continuous (DMA) sampling of the sense pin, which must be on ADC1
+#define BATTERY_ADC_SAMPLE_HZ   (SOC_ADC_SAMPLE_FREQ_THRES_LOW) // Lowest rate of the continuous mode, 20 kHz on the ESP32
+#define BATTERY_ADC_FRAME_BYTES (1024) // Conversions per DMA interrupt, 2 bytes each: ~40 interrupts per second
+#define BATTERY_ADC_POOL_BYTES  (2048) // Driver pool, newer frames are dropped while it is full
+#define BATTERY_ADC_DEFAULT_VREF (1100) // mV, used by the calibration when the eFuses hold none
 
 typedef uint8_t (*mapFn_t)(uint16_t, uint16_t, uint16_t);
 
@@ -49,7 +57,8 @@ class Battery {
 
     /**
 		 * Initializes the library by optionally setting additional parameters.
-		 * To obtain the best results use a calibrated reference using the VoltageReference library or equivalent.
+		 * On an ADC1 pin, starts the continuous sampling, converted with the eFuse calibration of the chip;
+		 * @p refVoltage then only serves the fallback to analogRead().
 		 * * @param refVoltage is the board reference voltage, expressed in millivolts
 		 * @param dividerRatio is the multiplier used to obtain the real battery voltage
 		 * @param mapFunction is a pointer to the function used to map the battery voltage to the remaining capacity percentage (defaults to linear mapping)
@@ -80,7 +89,9 @@ class Battery {
     uint8_t level(uint16_t voltage = 0);
     
     /**
-     * Updates the rolling average by taking a new sample using voltageFast(100).
+     * Updates the rolling average with a new sample: the mean of the conversions the DMA gathered since
+     * the previous call, or of 100 analogRead() calls if the continuous sampling could not start.
+     * Does not wait for the ADC.
      */
     void refreshAverage();
 
@@ -100,6 +111,11 @@ class Battery {
      */
     uint16_t voltageFast(uint16_t samples);
 
+    /** @brief Sets up and starts the continuous sampling, returns false if the sense pin or the driver do not allow it. */
+    bool _startContinuous();
+    /** @brief Averages the conversions waiting in the driver pool, returns 0 if there are none. */
+    uint16_t _drainContinuous();
+
     uint16_t _minVoltage;
     uint16_t _maxVoltage;
     uint8_t _sensePin;
@@ -109,6 +125,13 @@ class Battery {
     mapFn_t _mapFunc;
     uint8_t _activationPin;
     uint8_t _activationMode;
+
+    // Continuous sampling
+    bool _continuous;
+    uint8_t _adcChannel;
+    esp_adc_cal_characteristics_t _adcChars;
+    uint16_t _lastSample; // Kept while the pool is empty
+    uint8_t _frame[BATTERY_ADC_FRAME_BYTES];
     
     // Rolling average variables
     uint16_t _averaging_samples;
@@ -2,17 +2,21 @@
 #define CONFIGMANAGER_HPP
 
 #include <Arduino.h>
-#include <SPIFFS.h>
 #include <vector>
 #include <string>
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "JsonFields.hpp"
+
+#define RECIPE_NAME_MAX_LEN (64) // Longest recipe name accepted by the API
 
 // Struct for a single ingredient in a recipe
 struct RecipeIngredient {
     uint64_t tankUid;
     // Changed to store the ingredient's mix ratio as a percentage.
     float percentage;
+
+    static const JsonFieldList FIELDS;
 };
 
 // Struct for a complete recipe
@@ -28,6 +32,8 @@ struct Recipe {
     bool isEnabled;
 
     static const Recipe EMPTY;
+    /** @brief JSON mapping, shared by the API and the recipe files. Its order is part of the files' CRC. */
+    static const JsonFieldList FIELDS;
 };
 
 class ConfigManager {
@@ -39,8 +45,9 @@ public:
     bool saveTimezone(const std::string& tz);
     std::string loadTimezone();
     
-    bool saveScaleCalibration(float factor, long offset);
-    bool loadScaleCalibration(float& factor, long& offset);
+    // Scale calibration, per HX711 channel (0 = channel A/hopper, 1 = channel B/bowl)
+    bool saveScaleCalibration(float factor, long offset, uint8_t channel = 0);
+    bool loadScaleCalibration(float& factor, long& offset, uint8_t channel = 0);
 
     bool saveWiFiCredentials(const std::string& ssid, const std::string& password);
     bool loadWiFiCredentials(std::string& ssid, std::string& password);
@@ -49,6 +56,10 @@ public:
     bool saveHopperCalibration(uint16_t closed_pwm, uint16_t open_pwm);
     bool loadHopperCalibration(uint16_t& closed_pwm, uint16_t& open_pwm);
 
+    // SwiMux link rate negotiated at boot (0 = never negotiated)
+    bool saveSwiMuxBaudRate(uint32_t bauds);
+    uint32_t loadSwiMuxBaudRate();
+
     // Recipe Management
     bool saveRecipes(const std::vector<Recipe>& recipes);
     std::vector<Recipe> loadRecipes();
@@ -64,12 +75,12 @@ private:
     bool _openNVS();
     void _closeNVS();
 
-    // Recipe file paths (SPIFFS) - triple redundancy
+    // Recipe file paths (data partition) - triple redundancy
     static constexpr const char* RECIPE_FILE_PRIMARY = "/recipes.json";
     static constexpr const char* RECIPE_FILE_BACKUP1 = "/recipes.bak1.json";
     static constexpr const char* RECIPE_FILE_BACKUP2 = "/recipes.bak2.json";
 
-    // Helper methods for SPIFFS recipe storage
+    // Helper methods for recipe file storage
     bool _saveRecipeFile(const char* path, const std::string& jsonContent);
     bool _loadRecipeFile(const char* path, std::vector<Recipe>& recipes);
     uint32_t _computeRecipeCRC(const std::string& jsonStr);
@@ -10,6 +10,9 @@
 #include "TankManager.hpp" // For TankInfo struct definition
 #include "ConfigManager.hpp" // For Recipe struct definition
 
+#define FEEDING_HISTORY_MAX     (50) // Entries kept in RAM, the oldest is dropped beyond that
+#define FEEDING_DESCRIPTION_LEN (32) // Recipe name of a history entry, with its terminator
+
 /**
  * @file DeviceState.hpp
  * @brief Defines the central, thread-safe data structure for the device's state.
@@ -22,7 +25,8 @@ enum class FeedCommandType
     IMMEDIATE,
     RECIPE,
     EMERGENCY_STOP,
-    TARE_SCALE
+    TARE_SCALE,
+    CALIBRATE_DENSITY
 };
 
 // Struct to hold feeding command details from the API
@@ -38,16 +42,19 @@ struct FeedCommand {
 // Expanded to match the API schema for feeding history
 struct FeedingHistoryEntry {
     time_t timestamp;
-    std::string type; // "recipe" or "immediate"
+    const char* type; // "recipe", "immediate" or "calibration", a string literal
     uint32_t recipeUid;
     bool success;
     float amount;
-    std::string description; // e.g., Recipe Name or "Immediate Feed"
+    char description[FEEDING_DESCRIPTION_LEN]; // e.g., Recipe Name or "Immediate Feed", truncated
 
     // Constructor to allow for direct initialization.
-    FeedingHistoryEntry(time_t ts, const std::string& t, uint32_t rUid, bool s, float a, const std::string& d)
-        : timestamp(ts), type(t), recipeUid(rUid), success(s), amount(a), description(d)
-    {}
+    FeedingHistoryEntry(time_t ts, const char* t, uint32_t rUid, bool s, float a, const char* d)
+        : timestamp(ts), type(t), recipeUid(rUid), success(s), amount(a)
+    {
+        strncpy(description, d, sizeof(description) - 1);
+        description[sizeof(description) - 1] = '\0';
+    }
 };
 
 enum DeviceOperationState_e : uint8_t
@@ -74,6 +81,7 @@ enum DeviceEvent_e : uint8_t
     DEVEVENT_MOTOR_STALL,             ///< SAFETY: Motor stall detected
     DEVEVENT_BOWL_OVERFILL,           ///< SAFETY: Bowl overfill detected
     DEVEVENT_TANK_EMPTY,              ///< Tank is empty
+    DEVEVENT_DENSITY_CALIBRATION_FAILED, ///< Density calibration gave no plausible density
 };
 
 // The central volatile state structure for the entire application.
@@ -97,12 +105,18 @@ struct DeviceState {
     time_t currentTime     = 0;
     char formattedTime[20] = "TIME_NOT_SET";
 
-    // Scale
+    // Scale (HX711 channel A, hopper load cell)
     float currentWeight    = 0.0;
     long currentRawValue   = 0;
     bool isWeightStable    = false;
     bool isScaleResponding = false;
 
+    // Bowl scale (HX711 channel B)
+    float bowlWeight           = 0.0;
+    long bowlRawValue          = 0;
+    bool isBowlWeightStable    = false;
+    bool isBowlScaleResponding = false;
+
     // Tanks
     std::vector<TankInfo> connectedTanks;
 
@@ -127,7 +141,7 @@ struct DeviceState {
         float getDispensingWeightChangeThreshold() const;
         uint32_t getDispensingNoWeightChangeTimeout_ms() const;
 
-        // Setters (These automatically save changes to SPIFFS)
+        // Setters (These automatically save changes to flash)
         void setDispensingWeightChangeThreshold(float newValue);
         void setDispensingNoWeightChangeTimeout_ms(uint32_t value);
 
@@ -5,11 +5,16 @@
 #include <SSD1680Driver.h>
 #include <SPI.h>
 
+#define DISPLAY_TASK_STACK_SIZE (4096)
+
 
 /**
  * @file EPaperDisplay.hpp
  * @brief Manages the 2.6" E-Paper display using the Adafruit_EPD library
  * and updated to use the global DeviceState in portrait orientation.
+ *
+ * Drawing a screen returns as soon as the frame is written to the panel: the refresh, which
+ * takes seconds, runs on the panel while the next frame can already be drawn. See Ssd1680_Driver.
  */
 
 class EPaperDisplay {
@@ -26,11 +31,15 @@ class EPaperDisplay {
     void showError(const char* title, const char* message);
 
     void forceUpdate();
+    /** @brief Blocks until the panel shows the last screen drawn, e.g. before a restart. */
+    void waitForRefresh() { _display->waitForRefresh(); }
 
   private:
     DeviceState& _deviceState;
     SemaphoreHandle_t& _mutex;
     TaskHandle_t _displayTaskHandle;
+    StackType_t _displayTaskStack[DISPLAY_TASK_STACK_SIZE];
+    StaticTask_t _displayTaskBuffer;
 
 
     Ssd1680_Driver* _display;
@@ -0,0 +1,171 @@
+#ifndef EVENTBUS_HPP
+#define EVENTBUS_HPP
+
+#include <Arduino.h>
+#include <functional>
+#include <type_traits>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#define EVENT_BUS_MAX_SUBSCRIBERS (8) // Consuming tasks, one wake-up bit each
+
+/**
+ * @file EventBus.hpp
+ * @brief Typed publish/subscribe between the tasks, with delivery on the subscriber's task.
+ *
+ * A producer owns an EventChannel and publishes into its ring of the last Depth events. Publishing
+ * copies the event once and sets the wake-up bits of the channel's subscribers in a single call,
+ * whatever their number, and never blocks. Each consuming task owns one EventSubscriber, attaches
+ * typed subscriptions to it, and runs their handlers from its own loop with dispatch().
+ *
+ * Every subscription reads the ring through its own cursor, so it behaves as a private queue of
+ * Depth events. A subscription that falls more than Depth events behind loses the oldest ones,
+ * which are counted as dropped. With EventPolicy::LATEST, only the newest pending event is
+ * delivered, the older ones being coalesced into it.
+ */
+
+enum class EventPolicy : uint8_t {
+    QUEUE,  // Every event in order, the oldest dropped on overrun
+    LATEST, // Only the newest pending event
+};
+
+class EventSubscriber;
+
+/** @brief A subscription as listed by its subscriber. See EventChannel::Subscription. */
+class EventSubscription {
+  public:
+    /** @brief Events not delivered: lost on overrun, or coalesced under EventPolicy::LATEST. */
+    uint32_t dropped() const { return _dropped; }
+
+  protected:
+    explicit EventSubscription(EventPolicy policy) : _policy(policy), _dropped(0), _cursor(0), _next(nullptr) {}
+    /** @brief Runs the handler on each pending event, returns how many were delivered. */
+    virtual size_t _drain() = 0;
+
+    EventPolicy _policy;
+    volatile uint32_t _dropped;
+    uint32_t _cursor; // Count of the channel's events already seen
+    EventSubscription* _next;
+
+    friend class EventSubscriber;
+    template <typename T, size_t Depth> friend class EventChannel;
+};
+
+/** @brief The consuming side of a task: its wake-up bit and its subscriptions. */
+class EventSubscriber {
+  public:
+    /** @brief Takes one of the EVENT_BUS_MAX_SUBSCRIBERS wake-up bits. @p name must be static. */
+    explicit EventSubscriber(const char* name);
+
+    /**
+     * @brief Waits up to @p timeout for events, then runs the handlers of those pending.
+     * To be called by the subscribing task only.
+     * @returns How many events were delivered.
+     */
+    size_t dispatch(TickType_t timeout);
+
+    EventBits_t bit() const { return _bit; }
+    const char* name() const { return _name; }
+
+    /** @brief Sets the wake-up bits of @p subscribers. */
+    static void wake(EventBits_t subscribers);
+
+  private:
+    const char* _name;
+    EventBits_t _bit; // 0 if none was left
+    EventSubscription* _subscriptions;
+
+    static EventGroupHandle_t _group;
+    static StaticEventGroup_t _groupBuffer;
+    static uint8_t _bitCount;
+
+    void _add(EventSubscription& subscription);
+
+    template <typename T, size_t Depth> friend class EventChannel;
+};
+
+/**
+ * @brief A stream of events of type @p T, keeping the last @p Depth of them.
+ * @p T is copied under a spinlock: keep it small and trivially copyable.
+ */
+template <typename T, size_t Depth> class EventChannel {
+    static_assert(std::is_trivially_copyable<T>::value, "Events are copied in and out of the ring");
+    static_assert(Depth > 0 && (Depth & (Depth - 1)) == 0, "Depth must be a power of two");
+
+  public:
+    /** @brief A subscription to this channel, delivered on the task of its subscriber. */
+    class Subscription : public EventSubscription {
+      public:
+        Subscription(EventPolicy policy, std::function<void(const T&)> handler)
+            : EventSubscription(policy), _channel(nullptr), _handler(handler)
+        {}
+
+      protected:
+        size_t _drain() override
+        {
+            size_t delivered = 0;
+            T event;
+            while (_channel != nullptr && _channel->_take(*this, event)) {
+                _handler(event);
+                delivered++;
+            }
+            return delivered;
+        }
+
+      private:
+        EventChannel* _channel;
+        std::function<void(const T&)> _handler;
+
+        friend class EventChannel;
+    };
+
+    EventChannel() : _published(0), _subscribers(0) { _lock = portMUX_INITIALIZER_UNLOCKED; }
+
+    /** @brief Attaches @p subscription to @p subscriber. It receives the events published from now on. */
+    void subscribe(EventSubscriber& subscriber, Subscription& subscription)
+    {
+        portENTER_CRITICAL(&_lock);
+        subscription._cursor = _published;
+        portEXIT_CRITICAL(&_lock);
+        subscription._channel = this;
+        subscriber._add(subscription);
+        _subscribers |= subscriber.bit();
+    }
+
+    /** @brief Stores @p event and wakes the subscribers. Constant time, never blocks. */
+    void publish(const T& event)
+    {
+        portENTER_CRITICAL(&_lock);
+        _ring[_published & (Depth - 1)] = event;
+        _published++;
+        portEXIT_CRITICAL(&_lock);
+        EventSubscriber::wake(_subscribers);
+    }
+
+  private:
+    T _ring[Depth];
+    uint32_t _published; // Wraps: only differences with the cursors matter
+    volatile EventBits_t _subscribers;
+    portMUX_TYPE _lock;
+
+    bool _take(Subscription& sub, T& event)
+    {
+        portENTER_CRITICAL(&_lock);
+        uint32_t pending = _published - sub._cursor;
+        if (pending == 0) {
+            portEXIT_CRITICAL(&_lock);
+            return false;
+        }
+        uint32_t keep = sub._policy == EventPolicy::LATEST ? 1 : Depth;
+        if (pending > keep) {
+            sub._dropped += pending - keep;
+            sub._cursor = _published - keep;
+        }
+        event = _ring[sub._cursor & (Depth - 1)];
+        sub._cursor++;
+        portEXIT_CRITICAL(&_lock);
+        return true;
+    }
+};
+
+#endif // EVENTBUS_HPP
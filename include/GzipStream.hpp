@@ -0,0 +1,83 @@
+#ifndef H_GZIP_STREAM_H
+#define H_GZIP_STREAM_H
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @file GzipStream.hpp
+ * @brief Incremental gzip encoder for API responses, with a small fixed window.
+ *
+ * The whole input is in memory (the responses are serialized first), the output is produced
+ * in chunks of any size as the TCP stack asks for them. The encoder emits a single deflate
+ * block with the fixed Huffman codes of RFC 1951, which needs no code tables and no lookahead:
+ * JSON, made of short repeated keys, mostly compresses through the LZ77 matches anyway.
+ *
+ * This header does not depend on Arduino nor on ESP-IDF, so that a host-side harness can
+ * check its output against zlib.
+ */
+
+#define GZIP_WINDOW_SIZE (2048) // Match distance limit, power of two
+#define GZIP_HASH_BITS   (9)
+#define GZIP_MAX_CHAIN   (8)    // Candidates probed per position at full effort
+
+// When AsyncApiExchange compresses a response
+#define GZIP_MIN_RESPONSE_SIZE (1024) // Smaller responses fit in a TCP segment or two, not worth the CPU
+#define GZIP_CHUNK_BUDGET_US   (4000) // CPU time per compressed chunk before the encoder lowers its effort
+
+class GzipStream {
+  public:
+    /** @param data Input, which must outlive the encoder. */
+    GzipStream(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Produces up to @p maxLen bytes of the gzip stream.
+     * @return The number of bytes written, 0 once the stream is complete.
+     */
+    size_t read(uint8_t* out, size_t maxLen);
+
+    /**
+     * @brief Sets how many match candidates are probed per position, 0 emitting literals only.
+     * @details Lets the caller trade ratio for CPU time while the stream is being produced.
+     */
+    void setMaxChain(uint8_t maxChain) { _maxChain = maxChain > GZIP_MAX_CHAIN ? GZIP_MAX_CHAIN : maxChain; }
+    uint8_t getMaxChain() const { return _maxChain; }
+
+    bool isDone() const { return _stage == Stage::DONE && _bitCount == 0; }
+    size_t getInputPosition() const { return _pos; }
+
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+  private:
+    enum class Stage : uint8_t { HEADER, BLOCK_START, BODY, TRAILER, DONE };
+
+    const uint8_t* _data;
+    size_t _len;
+    size_t _pos;       // next byte to encode
+    size_t _hashedPos; // next position to enter the hash chains
+    Stage _stage;
+    uint8_t _stageIndex; // byte index within the header or trailer
+    uint8_t _maxChain;
+    uint32_t _crc;
+    uint64_t _bitBuf;
+    uint8_t _bitCount;
+
+    uint32_t _head[1 << GZIP_HASH_BITS]; // last position + 1 per hash, 0 for none
+    uint16_t _prev[GZIP_WINDOW_SIZE];    // distance to the previous position with the same hash, 0 for none
+
+    void _putBits(uint32_t value, uint8_t count)
+    {
+        _bitBuf   |= (uint64_t)value << _bitCount;
+        _bitCount += count;
+    }
+    /** @brief Huffman codes go most significant bit first, unlike everything else in deflate. */
+    void _putCode(uint32_t code, uint8_t count);
+    void _putLiteral(uint8_t value);
+    void _putMatch(uint16_t length, uint16_t distance);
+    void _encodeNext();
+    void _insertHash(size_t upTo);
+    uint16_t _findMatch(uint16_t& distance);
+    uint32_t _hashAt(size_t pos) const;
+};
+
+#endif // H_GZIP_STREAM_H
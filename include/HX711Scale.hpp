@@ -5,33 +5,126 @@
 #include "HX711.h"
 #include "DeviceState.hpp"
 #include "ConfigManager.hpp"
+#include "ScaleTrace.hpp"
+#include "ScaleSampler.hpp"
+#include "EventBus.hpp"
 
 // The HX711 can be set to 80Hz mode, but accounting for timing drifts, 
 // we'll use a slightly more conservative value for timeout calculations.
 #define FAST_MODE_SAMPLING_PERIOD_MS ((uint32_t)(1000/75)) 
 
+#define SCALE_TASK_STACK_SIZE (4096)
+#define SCALE_EVENT_DEPTH     (8) // Averaging windows kept for each subscriber, both channels mixed
+
 /**
  * @file HX711Scale.hpp
  * @brief Manages the load cell and HX711 amplifier in a thread-safe manner.
+ *
+ * Both HX711 inputs are used: channel A (gain 128) carries the hopper load cell,
+ * channel B (gain 32) carries the bowl load cell. The sampling task alternates
+ * averaging windows between the two channels and publishes each stream separately.
  */
 
+/**
+ * @enum ScaleDutyLevel
+ * @brief Sampling duty cycle chosen by the scale task from the current activity.
+ */
+enum class ScaleDutyLevel : uint8_t {
+    CONTINUOUS, ///< HX711 kept powered, every 80Hz conversion is used (feeding, motion, explicit wake-up)
+    NORMAL,     ///< ~250ms windows separated by ~250ms power-downs (recent activity or live subscribers)
+    SPARSE,     ///< One window every couple of seconds (quiet device)
+};
+
+/** @brief An averaging window of one channel, as published by the scale task. */
+struct WeightEvent {
+    ScaleChannel channel;
+    float weight;
+    long raw;
+    uint32_t timestampDs; ///< esp_timer time of the publication, in tenths of a second
+};
+typedef EventChannel<WeightEvent, SCALE_EVENT_DEPTH> WeightEventChannel;
+
 class HX711Scale {
 public:
+    static constexpr uint8_t CHANNEL_COUNT = 2;
+
     HX711Scale(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager);
     bool begin(uint8_t dataPin, uint8_t clockPin);
-    void tare();
-    float getWeight();
-    long getRawReading();
+    void tare(ScaleChannel channel = ScaleChannel::HOPPER);
+    float getWeight(ScaleChannel channel = ScaleChannel::HOPPER);
+    long getRawReading(ScaleChannel channel = ScaleChannel::HOPPER);
     void startTask();
     
     // New method for calibration based on the API schema
-    float calibrateWithKnownWeight(float knownWeight);
+    float calibrateWithKnownWeight(float knownWeight, ScaleChannel channel = ScaleChannel::HOPPER);
 
-    void setCalibrationFactor(float factor);
-    float getCalibrationFactor();
-    long getZeroOffset();
+    void setCalibrationFactor(float factor, ScaleChannel channel = ScaleChannel::HOPPER);
+    float getCalibrationFactor(ScaleChannel channel = ScaleChannel::HOPPER);
+    long getZeroOffset(ScaleChannel channel = ScaleChannel::HOPPER);
     void saveCalibration();
-    void setOnWeightChangedCallback(std::function<void(float, long)> cb);
+    /** @brief Channel of the averaging windows of both load cells, for the tasks that follow the weight. */
+    WeightEventChannel& weightEvents() { return _weightEvents; }
+
+    /**
+     * @brief Switches the sampling to continuous mode for at least @p holdMs, waking the task if it is powered down.
+     * @param holdMs Minimum duration of the continuous sampling, in milliseconds.
+     */
+    void requestActivity(uint32_t holdMs = ACTIVE_HOLD_MS);
+    /** @brief Pins the continuous mode for the whole duration of a feeding operation. */
+    void setFeedingActive(bool active);
+    /** @brief Declares whether live weight subscribers exist; they prevent the step-down to sparse sampling. */
+    void setSubscribed(bool subscribed);
+    ScaleDutyLevel getDutyLevel() const { return _dutyLevel; }
+
+    // --- Actuation blanking ---
+    /**
+     * @brief Declares a mechanical disturbance: conversions within the next @p blankingMs are excluded
+     *        from the averaging windows, and blocking reads wait for its end.
+     */
+    void notifyActuation(uint32_t blankingMs);
+    /** @brief Whether the blanking window of the last actuation is over. */
+    bool isSettledSinceActuation() const;
+    /**
+     * @brief Blocks until the blanking window of the last actuation is over.
+     * @param timeoutMs Upper bound of the wait.
+     * @return true if settled, false if @p timeoutMs elapsed first.
+     */
+    bool waitUntilSettled(uint32_t timeoutMs);
+    static const char* getDutyLevelName(ScaleDutyLevel level);
+
+    // --- Non-blocking sample requests ---
+    /**
+     * @brief Asks the scale task for a fresh average of @p channel, taken after this call.
+     * @details The running window is cut short, and the next one averages CALIBRATION_SAMPLES clean
+     *          conversions of @p channel, leaving the blanked ones out. The result is fetched with
+     *          takeRequestedSample(). A new request replaces a pending one for the same channel,
+     *          and is answered by a window started after it.
+     */
+    void requestSample(ScaleChannel channel);
+    /**
+     * @brief Fetches, once, the answer to the last requestSample() of @p channel.
+     * @param grams Set to the average, or to NAN if the HX711 did not answer.
+     * @return false if the requested window is not complete yet.
+     */
+    bool takeRequestedSample(ScaleChannel channel, float& grams);
+
+    static const char* getChannelName(ScaleChannel channel);
+
+    // --- Raw trace capture & replay ---
+    /** @brief Attaches the recorder that receives every raw conversion while a capture runs. */
+    void setTrace(ScaleTrace* trace) { _trace = trace; }
+    ScaleTrace* getTrace() { return _trace; }
+    /**
+     * @brief Substitutes the raw samples of a recorded trace for the HX711 conversions.
+     * @details Samples are served at their recorded pace, each one to the channel it was recorded
+     *          on, and feed the same averaging and publishing as live ones. The recorded servo
+     *          commands raise the actuation blanking as the live ones do. The HX711 is used again
+     *          once the trace is over or stopReplay() is called.
+     * @return false if the trace cannot be loaded or is invalid.
+     */
+    bool startReplay(fs::FS& fs, const char* path);
+    void stopReplay();
+    bool isReplaying() const { return _replayBuffer != nullptr; }
 
 private:
     HX711 _scale;
@@ -42,32 +135,83 @@ private:
     // A dedicated mutex to protect access to the _scale object and HX711 hardware
     SemaphoreHandle_t _scaleMutex;
 
-    float _calibrationFactor;
-    long _zeroOffset;
-    std::function<void(float, long)> _onWeightChangedCallback;
+    float _calibrationFactor[CHANNEL_COUNT];
+    long _zeroOffset[CHANNEL_COUNT];
+    WeightEventChannel _weightEvents;
+    TaskHandle_t _taskHandle;
+    StackType_t _taskStack[SCALE_TASK_STACK_SIZE];
+    StaticTask_t _taskBuffer;
+
+    // Activity tracking, written by other tasks
+    volatile TickType_t _activeUntilTick;  // continuous sampling requested until this tick
+    volatile TickType_t _lastActivityTick; // last feed, motion or wake-up request
+    volatile bool _feedingHold;
+    volatile bool _subscribed;
+    ScaleDutyLevel _dutyLevel;
+    float _lastPublished[CHANNEL_COUNT];   // previous window of each channel, for motion detection
+    volatile TickType_t _blankUntilTick;   // conversions before this tick are disturbed by an actuation
+
+    // Sample requests (one bit per channel, guarded by _requestLock)
+    portMUX_TYPE _requestLock;
+    uint8_t _requestPending;
+    uint8_t _requestReady;
+    float _requestResult[CHANNEL_COUNT];
+    uint8_t _requestGeneration[CHANNEL_COUNT]; // bumped by every requestSample()
+    uint8_t _servedGeneration; // generation of the request the current window answers
+    bool _servingRequest;      // the current window answers a request
+
+    // Trace capture & replay (replay state guarded by _scaleMutex)
+    ScaleTrace* _trace;
+    uint8_t* _replayBuffer;
+    ScaleTracePlayer _replay;
+    TickType_t _replayStartTick;
 
     // State machine for non-blocking operation
     enum class ScaleState { SAMPLING, SETTLING, IDLE };
     ScaleState _state;
 
-    // Accumulators (reset each averaging window)
-    long _rawSum;
-    uint8_t _sampleCount;
-    uint8_t _failureCount;
+    // Channel bookkeeping and accumulators of the current averaging window
+    ScaleSampler _sampler;
+    bool _poweredDown; // the HX711 falls back to channel A whenever it wakes up
 
-    // Timebase counters
-    uint8_t _tickCounter;       // counts ticks within sampling window
-    uint8_t _idleTickCounter;   // counts ticks during idle/power-down
-    uint8_t _settlingCounter;   // counts ticks during settling after power-up
-    uint8_t _reportCounter;     // counts averaging windows for 5s report
+    // Timebase
+    TickType_t _phaseStartTick; // start of the current SAMPLING/IDLE/SETTLING phase
+    TickType_t _lastReportTick; // last 5s status report
 
     // Timing constants
-    static constexpr uint32_t TICK_MS = 13;              // ~77Hz task tick
-    static constexpr uint8_t TICKS_PER_AVERAGE = 19;     // ~247ms sampling window
-    static constexpr uint8_t IDLE_TICKS = 15;            // ~195ms idle (250-55ms for settling margin)
-    static constexpr uint8_t SETTLING_TICKS = 4;         // ~52ms settling after power-up
-    static constexpr uint8_t REPORTS_PERIOD = 20;        // 20×250ms = 5s
-    static constexpr uint8_t CALIBRATION_SAMPLES = 10;   // Fixed sample count for calibration/tare API
+    static constexpr uint32_t SAMPLE_POLL_MS = 4;             // DOUT polling while sampling, well under the 12.5ms conversion period
+    static constexpr uint32_t AVERAGE_WINDOW_MS = 247;        // sampling window
+    static constexpr uint32_t NORMAL_IDLE_MS = 195;           // power-down between windows (250-55ms for settling margin)
+    static constexpr uint32_t SPARSE_IDLE_MS = 2000;          // power-down between windows once the device is quiet
+    static constexpr uint32_t SETTLING_MS = 52;               // settling after power-up
+    static constexpr uint32_t REPORT_PERIOD_MS = 5000;        // status report period
+    static constexpr uint8_t CALIBRATION_SAMPLES = 10;        // Fixed sample count for calibration/tare API
+    static constexpr uint32_t MAX_BLANKING_WAIT_MS = 500;     // bound of the implicit settle wait of blocking reads
+    static constexpr uint32_t REQUEST_WINDOW_MAX_MS = 500;    // bound of a requested window, blanking included
+
+    // Duty cycle policy
+    static constexpr uint32_t ACTIVE_HOLD_MS = 10000;         // continuous sampling kept after the last activity
+    static constexpr uint32_t SPARSE_AFTER_QUIET_MS = 60000;  // quiet time before stepping down to sparse sampling
+    static constexpr float MOTION_THRESHOLD_GRAMS = 1.0f;     // window-to-window change deemed to be motion
+
+    static uint8_t _gainOf(ScaleChannel channel) { return channel == ScaleChannel::BOWL ? 32 : 128; }
+    bool _powerUp();
+    void _powerDown();
+    bool _selectChannel(ScaleChannel channel);
+    bool _isSampleReady();
+    long _readSample();
+    long _readAverage(uint8_t times, uint8_t& failuresOut);
+    void _releaseReplay();
+    uint32_t _replayElapsedMs() const;
+    /** @brief Applies the due servo records of the replay, and ends it once the trace is over. Caller must hold _scaleMutex. */
+    void _serviceReplay();
+    void _publishWindow(long avgRaw);
+    /** @brief Starts a requested window if a request is pending and none is being served. */
+    void _beginRequestedWindow(TickType_t now);
+    /** @brief Hands the result of the requested window over to takeRequestedSample(). */
+    void _completeRequest(long avgRaw);
+    ScaleDutyLevel _evaluateDutyLevel(TickType_t now);
+    uint32_t _idleDurationMs() const;
 
     static void _scaleTask(void *pvParameters);
 };
@@ -0,0 +1,70 @@
+#ifndef HEAPGUARD_HPP
+#define HEAPGUARD_HPP
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define HEAP_GUARD_MAX_TASKS (4)
+
+/**
+ * @file HeapGuard.hpp
+ * @brief Checks that the real-time tasks stop allocating once the device has booted.
+ *
+ * The board has no PSRAM, and weeks of allocations on the feed, scale and tank paths would
+ * fragment its heap. Those tasks call watchCurrentTask() when they start; setup() calls arm()
+ * once everything is up. From then on, a heap allocation made by a watched task is a violation:
+ * it is counted with its caller, or aborts the firmware when built with HEAP_STEADY_STATE_ABORT.
+ * An event that is not part of the steady state (a tank plugged in, a web client listening)
+ * may allocate within a HeapGuard::Allow scope.
+ *
+ * The check needs the build flags HEAP_STEADY_STATE_CHECK and -Wl,--wrap=malloc,--wrap=calloc,
+ * --wrap=realloc (see platformio.ini). Without them, this class does nothing.
+ */
+class HeapGuard {
+  public:
+    /** @brief Lets the calling task allocate while in scope, if @p allow. */
+    class Allow {
+      public:
+#ifdef HEAP_STEADY_STATE_CHECK
+        explicit Allow(bool allow = true);
+        ~Allow();
+
+      private:
+        int8_t _slot; // -1 if not watched or not allowed
+#else
+        explicit Allow(bool allow = true) {}
+#endif
+    };
+
+#ifdef HEAP_STEADY_STATE_CHECK
+    /** @brief Puts the calling task under watch, up to HEAP_GUARD_MAX_TASKS. */
+    static void watchCurrentTask();
+    /** @brief Marks the end of boot: watched tasks must not allocate from now on. */
+    static void arm();
+    /** @brief Adds the state of the check to @p obj. */
+    static void report(JsonObject obj);
+
+    /** @brief Called by the allocation wrappers. */
+    static void onAllocation(const void* caller);
+#else
+    static void watchCurrentTask() {}
+    static void arm() {}
+    static void report(JsonObject obj) {}
+#endif
+
+  private:
+#ifdef HEAP_STEADY_STATE_CHECK
+    struct WatchedTask {
+        TaskHandle_t handle;
+        volatile uint8_t allowDepth;
+        volatile uint32_t violations;
+        const void* volatile lastCaller;
+    };
+    static WatchedTask _tasks[HEAP_GUARD_MAX_TASKS];
+    static volatile bool _armed;
+
+    static int8_t _slotOfCurrentTask();
+#endif
+};
+
+#endif // HEAPGUARD_HPP
@@ -0,0 +1,156 @@
+#ifndef I2CMANAGER_HPP
+#define I2CMANAGER_HPP
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <type_traits>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define I2C_MAX_WRITE_LEN      (32)  // Register payload of a queued write, coalesced bursts included
+#define I2C_QUEUE_DEPTH        (32)  // Pending transactions, all priorities but EMERGENCY together, and ring size of each priority
+#define I2C_MAX_COMPLETIONS    (2)   // Completion callbacks a write can carry once others were merged into it
+#define I2C_TASK_PRIORITY      (12)  // Above the tank detection and feeding tasks
+#define I2C_TASK_STACK_SIZE    (3 * 1024UL)
+
+/**
+ * @file I2CManager.hpp
+ * @brief Owns the I2C bus: transactions are queued by the callers and run by a dedicated task.
+ *
+ * Register writes are queued and return at once, their outcome being reported to an optional
+ * completion callback (called from the I2C task, keep it short). Reads and multi-step sequences
+ * go through execute(), which runs them on the I2C task and waits for their result.
+ * The queues are fixed rings and callbacks are plain function pointers: queuing never allocates.
+ */
+
+/** @brief Outcome of a transaction; the first values are those of TwoWire::endTransmission(). */
+enum I2CResult_e : uint8_t
+{
+    I2CREZ_OK            = 0,
+    I2CREZ_DATA_TOO_LONG = 1,
+    I2CREZ_NACK_ADDRESS  = 2,
+    I2CREZ_NACK_DATA     = 3,
+    I2CREZ_OTHER         = 4,
+    I2CREZ_TIMEOUT       = 5,
+    I2CREZ_CANCELLED     = 6, ///< Superseded by an EMERGENCY transaction to the same device
+    I2CREZ_QUEUE_FULL    = 7, ///< Not queued
+};
+
+/** @brief Queues are served strictly in this order. */
+enum class I2CPriority : uint8_t {
+    EMERGENCY  = 0, ///< Emergency stops: jump the queue and cancel pending writes to the same device
+    CONTROL    = 1, ///< Commands of the control loops
+    BACKGROUND = 2, ///< Anything that can wait
+};
+#define I2C_PRIORITY_COUNT (3)
+
+/** @brief Completion callback of a queued write, @p context being the pointer given along with it. */
+typedef void (*I2CCompletion)(I2CResult_e result, void* context);
+
+class I2CManager {
+  public:
+    I2CManager(TwoWire& wire);
+
+    /** @brief Starts the bus and the task that owns it. */
+    bool begin();
+
+    TwoWire& getWire() { return _wire; }
+
+    /**
+     * @brief Queues a write of @p len bytes starting at register @p reg of device @p address.
+     * @details A write that directly follows a pending write to the same device at the same priority is merged
+     *          into it: it replaces the bytes of registers the pending write already covers, or extends it when it
+     *          starts right after it and the device auto-increments its register pointer. The merged write keeps
+     *          up to I2C_MAX_COMPLETIONS callbacks; past that, writes with a callback are queued on their own.
+     * @return I2CREZ_OK once queued, I2CREZ_QUEUE_FULL or I2CREZ_DATA_TOO_LONG otherwise (@p onComplete is then not called).
+     *         Before begin(), the write is made at once and its outcome is returned, as well as given to @p onComplete.
+     */
+    I2CResult_e write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t len, I2CPriority priority = I2CPriority::CONTROL,
+      I2CCompletion onComplete = nullptr, void* context = nullptr);
+
+    /**
+     * @brief Runs @p operation, any callable taking a TwoWire& and returning an I2CResult_e, on the I2C task and
+     *        waits for its result.
+     * @details The callable is used in place, from the stack of the caller: nothing is copied nor allocated.
+     * @note Runs inline when called before begin() or from the I2C task itself (completion callbacks).
+     */
+    template <typename Operation>
+    I2CResult_e execute(Operation&& operation, I2CPriority priority = I2CPriority::CONTROL)
+    {
+        typedef typename std::remove_reference<Operation>::type Callable;
+        return _execute(&I2CManager::_invoke<Callable>, (void*)&operation, priority);
+    }
+
+    /** @brief Declares whether @p address auto-increments its register pointer, allowing contiguous writes to be merged. */
+    void setAutoIncrement(uint8_t address, bool enabled);
+
+    /** @brief Writes merged into an already pending one since boot. */
+    uint32_t getCoalescedCount() const { return _coalescedCount; }
+    /** @brief Pending writes cancelled by emergency transactions since boot. */
+    uint32_t getCancelledCount() const { return _cancelledCount; }
+    /** @brief Largest backlog seen since boot. */
+    size_t getMaxDepth() const { return _maxDepth; }
+
+  private:
+    typedef I2CResult_e (*OperationFn)(TwoWire& wire, void* context);
+
+    struct Completion {
+        I2CCompletion callback;
+        void* context;
+    };
+
+    struct Transaction {
+        uint8_t address;
+        uint8_t reg;
+        uint8_t len;
+        uint8_t completionCount;
+        bool cancelled; // superseded by an emergency write, reported without touching the bus
+        uint8_t data[I2C_MAX_WRITE_LEN];
+        OperationFn operation; // set for execute() transactions, which are never merged
+        void* operationContext;
+        Completion completions[I2C_MAX_COMPLETIONS];
+    };
+
+    /** @brief Pending transactions of one priority, oldest at head. */
+    struct Ring {
+        Transaction slots[I2C_QUEUE_DEPTH];
+        uint8_t head;
+        uint8_t count;
+
+        Transaction& at(uint8_t i) { return slots[(head + i) % I2C_QUEUE_DEPTH]; }
+        Transaction& back() { return at(count - 1); }
+    };
+
+    TwoWire& _wire;
+    TaskHandle_t _taskHandle;
+    StackType_t _taskStack[I2C_TASK_STACK_SIZE];
+    StaticTask_t _taskBuffer;
+    SemaphoreHandle_t _queueMutex;
+    Ring _queues[I2C_PRIORITY_COUNT];
+    size_t _depth;
+    uint32_t _autoIncrement[4]; // one bit per 7-bit address
+    volatile uint32_t _coalescedCount;
+    volatile uint32_t _cancelledCount;
+    size_t _maxDepth;
+
+    template <typename Callable>
+    static I2CResult_e _invoke(TwoWire& wire, void* context)
+    {
+        return (*(Callable*)context)(wire);
+    }
+    I2CResult_e _execute(OperationFn operation, void* context, I2CPriority priority);
+    static void _signalDone(I2CResult_e result, void* context);
+
+    /** @brief Queues @p transaction, caller must not hold _queueMutex. */
+    I2CResult_e _enqueue(const Transaction& transaction, I2CPriority priority);
+    /** @brief Merges a write into the last pending one if possible, caller must hold _queueMutex. */
+    bool _coalesce(Ring& queue, const Transaction& transaction);
+    bool _dequeue(Transaction& out);
+    I2CResult_e _run(Transaction& transaction);
+    static void _complete(const Transaction& transaction, I2CResult_e result);
+    bool _isAutoIncrement(uint8_t address) const { return (_autoIncrement[(address >> 5) & 3] >> (address & 31)) & 1; }
+
+    static void _task(void* pvParam);
+};
+
+#endif // I2CMANAGER_HPP
@@ -0,0 +1,141 @@
+#ifndef JSONFIELDS_HPP
+#define JSONFIELDS_HPP
+
+#include <ArduinoJson.h>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @file JsonFields.hpp
+ * @brief Field-descriptor tables mapping structs to JSON, and the one codec that walks them.
+ *
+ * Each struct exposed in JSON (a recipe, a tank, the settings) describes its fields once, in a
+ * JsonField table next to its definition: key, member offset, type, unit scale and bounds. The
+ * same table then serializes the struct, validates a JSON body against it, and reads it back,
+ * for the API as for the files in storage.
+ *
+ * Fields are written in table order. For the recipes, that order is part of the stored format,
+ * since the CRC of the recipe files is computed over their serialized text.
+ */
+
+#define JSON_FIELD_REQUIRED  (0x01) // An API body must hold the key
+#define JSON_FIELD_READ_ONLY (0x02) // Written, but ignored when read from an API body
+#define JSON_FIELD_HEX       (0x04) // 64-bit UID, a hex string in the API and a number in storage
+
+/** @brief C++ type of the member a field maps to. */
+enum class JsonFieldType : uint8_t {
+    Bool,
+    Int8,
+    Int32,
+    Int64,
+    UInt8,
+    UInt16,
+    UInt32,
+    UInt64,
+    Float,
+    Double,
+    String, // std::string, bounds apply to its length
+    Object, // Nested JSON object, made of the fields of JsonField::nested (a JsonFieldList)
+    Array,  // std::vector of structs, described by JsonField::nested (a JsonFieldVector)
+};
+
+/** @brief Representation of the fields: the web API, or the files in storage. */
+enum class JsonFieldFormat : uint8_t {
+    Api,     // UIDs as hex strings, bodies validated and read-only fields skipped
+    Storage, // UIDs as numbers, data trusted: a missing or mistyped value keeps its default
+};
+
+struct JsonField {
+    const char* key;
+    JsonFieldType type;
+    uint8_t flags;      // JSON_FIELD_xxx
+    size_t offset;      // Of the member in its struct
+    double scale;       // JSON value = member value * scale
+    double min;         // Lowest accepted JSON value, or NAN
+    double max;         // Highest accepted JSON value, or NAN
+    double fallback;    // Value set by JsonFields::reset()
+    const void* nested; // Object and Array fields only
+};
+
+struct JsonFieldList {
+    const JsonField* fields;
+    size_t count;
+};
+
+/** @brief Element table and accessors of an Array field. */
+struct JsonFieldVector {
+    const JsonFieldList* element;
+    size_t (*size)(const void* vec);
+    const void* (*at)(const void* vec, size_t index);
+    void* (*append)(void* vec); // Adds a value-initialized element and returns it
+    void (*clear)(void* vec);
+};
+
+template <typename T> struct JsonFieldVectorOps {
+    static size_t size(const void* vec) { return static_cast<const std::vector<T>*>(vec)->size(); }
+    static const void* at(const void* vec, size_t index) { return &(*static_cast<const std::vector<T>*>(vec))[index]; }
+    static void* append(void* vec)
+    {
+        auto* v = static_cast<std::vector<T>*>(vec);
+        v->emplace_back();
+        return &v->back();
+    }
+    static void clear(void* vec) { static_cast<std::vector<T>*>(vec)->clear(); }
+};
+
+/** @brief A field of @p Struct. Scale 1, unbounded: use JSON_FIELD_RANGED otherwise. */
+#define JSON_FIELD(Struct, member, key, type, flags) \
+    { key, JsonFieldType::type, flags, offsetof(Struct, member), 1.0, NAN, NAN, 0.0, nullptr }
+/** @brief A field of @p Struct whose JSON value is the member times @p scale, within [@p min, @p max]. */
+#define JSON_FIELD_RANGED(Struct, member, key, type, flags, scale, min, max, fallback) \
+    { key, JsonFieldType::type, flags, offsetof(Struct, member), scale, min, max, fallback, nullptr }
+/** @brief A JSON object grouping the fields of @p list, which are members of the same struct. */
+#define JSON_FIELD_GROUP(key, list) { key, JsonFieldType::Object, 0, 0, 1.0, NAN, NAN, 0.0, &list }
+/** @brief A std::vector member of @p Struct, whose elements are described by @p vectorDesc. */
+#define JSON_FIELD_ARRAY(Struct, member, key, flags, vectorDesc) \
+    { key, JsonFieldType::Array, flags, offsetof(Struct, member), 1.0, NAN, NAN, 0.0, &vectorDesc }
+/** @brief Describes a std::vector<T> whose elements follow @p elementList. */
+#define JSON_FIELD_VECTOR_OF(T, elementList)                                                                \
+    { &elementList, &JsonFieldVectorOps<T>::size, &JsonFieldVectorOps<T>::at, &JsonFieldVectorOps<T>::append, \
+        &JsonFieldVectorOps<T>::clear }
+#define JSON_FIELD_LIST(array) { array, sizeof(array) / sizeof(array[0]) }
+
+/** @brief Why a JSON body was rejected. */
+struct JsonFieldError {
+    enum Reason : uint8_t { NONE, MISSING, WRONG_TYPE, OUT_OF_RANGE };
+
+    const JsonField* field = nullptr;
+    Reason reason          = NONE;
+
+    explicit operator bool() const { return reason != NONE; }
+    /** @brief Formats the error as an API error body, e.g. {"error":"servings must be at least 1"}. */
+    void toJson(char* buf, size_t len) const;
+};
+
+class JsonFields {
+  public:
+    /** @brief Sets every field of @p list in @p target to its fallback, and empties its strings and arrays. */
+    static void reset(void* target, const JsonFieldList& list);
+
+    /** @brief Adds the fields of @p source to @p dst, in table order. */
+    static void write(JsonObject dst, const void* source, const JsonFieldList& list, JsonFieldFormat format);
+
+    /** @brief Checks @p src against @p list without reading it. Storage data always passes. */
+    static JsonFieldError validate(JsonObjectConst src, const JsonFieldList& list, JsonFieldFormat format);
+
+    /**
+     * @brief Validates @p src, then copies the fields it holds into @p target.
+     * Fields missing from @p src keep their value in @p target, so a partial body updates only what
+     * it names. Nothing is copied if validation fails.
+     */
+    static JsonFieldError read(JsonObjectConst src, void* target, const JsonFieldList& list, JsonFieldFormat format);
+
+  private:
+    static JsonFieldError _check(JsonObjectConst src, const JsonFieldList& list, JsonFieldFormat format);
+    static void _apply(JsonObjectConst src, void* target, const JsonFieldList& list, JsonFieldFormat format);
+    static bool _skipped(const JsonField& field, JsonFieldFormat format);
+};
+
+#endif // JSONFIELDS_HPP
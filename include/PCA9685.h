@@ -1,6 +1,7 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "I2CManager.hpp"
 
 
 // MODE1 bits
@@ -41,6 +42,8 @@ class PCA9685 {
         I2C_NackOnData    = 3,
         I2C_Unknown       = 4,
         I2C_Timeout       = 5,
+        I2C_Cancelled     = 6, /**< Queued write cancelled by an emergency one (see I2CManager) */
+        I2C_QueueFull     = 7, /**< Write could not be queued (see I2CManager) */
     };
 
     enum PCA9685_REGS_t : uint8_t
@@ -67,6 +70,10 @@ class PCA9685 {
     PCA9685();
     PCA9685(const uint8_t addr);
     PCA9685(const uint8_t addr, TwoWire& i2c);
+    /*!
+     *  @brief  Routes all the transactions through @p bus, which owns the I2C interface.
+     */
+    PCA9685(const uint8_t addr, I2CManager& bus);
     void begin(uint8_t prescale = 0);
     void reset();
     void sleep();
@@ -77,6 +84,12 @@ class PCA9685 {
     uint8_t getPWM(uint8_t num);
     I2C_Result_e setPWM(int8_t num, uint16_t on, uint16_t off);
     /*!
+     *  @brief  Queues a PWM update without waiting for the bus (blocking setPWM() when no I2CManager is attached).
+     *  @return I2C_Ok once queued; the outcome of the transaction goes to @p onComplete.
+     */
+    I2C_Result_e queuePWM(int8_t num, uint16_t on, uint16_t off, I2CPriority priority = I2CPriority::CONTROL, I2CCompletion onComplete = nullptr,
+      void* context = nullptr);
+    /*!
  *  @brief  Sets the PWM output of one or all of the PCA9685 pins
  *  @param  num One of the PWM[0:15] output pins, or -1 to set all channels in one go.
  *  @param  fullOn Sets the output(s) to 100% duty <true>, or 0% duty <false>.
@@ -94,6 +107,7 @@ class PCA9685 {
   protected:
     uint8_t _i2caddr;
     TwoWire* _i2c;
+    I2CManager* _bus;
 
     uint32_t _oscillator_freq;
     uint8_t read8(uint8_t addr);
@@ -6,13 +6,16 @@
 #include "TankManager.hpp"
 #include "HX711Scale.hpp"
 
-#define DISPENSING_LOOP_PERIOD_MS (250)
+#define DISPENSING_TICK_MS           (10)     // tick() period of the feeding task while an operation runs
+#define DISPENSING_SAMPLE_TIMEOUT_MS (1500)   // A requested weight sample not received by then reads as NaN
 
 // ============================================================================
 // Hopper Constants
 // ============================================================================
 #define MAX_HOPPER_VOLUME_LITERS     (0.01f)
-#define HOPPER_PURGE_DELAY_MS        (2000)
+#define HOPPER_PURGE_DELAY_MS        (2000)   // Upper bound of the purge settle
+#define HOPPER_PURGE_MIN_SETTLE_MS   (300)    // Lower bound before the hopper channel is trusted
+#define HOPPER_EMPTY_TOLERANCE_GRAMS (1.0f)   // Hopper reading deemed back to its empty baseline
 
 // ============================================================================
 // Wiggle Constants
@@ -25,7 +28,7 @@
 // Close Detection Constants
 // ============================================================================
 #define CLOSE_STEP_PWM               (25)
-#define CLOSE_STEP_DELAY_MS          (100)
+#define CLOSE_STEP_DELAY_MS          (100)    // Upper bound of the post-step settle, see HX711Scale::waitUntilSettled()
 #define CLOSE_WEIGHT_SPIKE_GRAMS     (3.0f)
 #define CLOSE_BACKOFF_PWM            (50)
 #define CLOSE_MAX_ATTEMPTS           (60)
@@ -34,8 +37,11 @@
 // Settling/Timing Constants
 // ============================================================================
 #define DISPENSE_SETTLE_MS           (500)
-#define TARE_SETTLE_MS               (300)
+#define CLOSE_SETTLE_MS              (300)    // Upper bound, the actual wait ends with the actuation blanking
 #define POST_BATCH_DELAY_MS          (200)
+#define SERVO_POWER_SETTLE_MS        (200)    // Servo supply stabilization
+#define SERVO_MOVE_MS                (100)    // Hopper servo travel after an open or back-off command
+#define STOP_CLOSE_MS                (300)    // Hopper closing before the servo power is cut
 
 // ============================================================================
 // Auger Constants
@@ -44,11 +50,26 @@
 #define AUGER_FULL_SPEED             (1.0f)
 #define AUGER_SLOW_SPEED             (0.2f)
 
+// ============================================================================
+// Density Constants (see startDensityCalibration())
+// ============================================================================
+#define DENSITY_CALIBRATION_MIN_FILL_MS (2000)  // Shorter fills are too coarse to time the auger flow
+#define DENSITY_REFINE_MIN_RUN_MS       (1500)  // Full-speed auger time a feed needs to refine the density of a tank
+
 // ============================================================================
 // Default Servings
 // ============================================================================
 #define DEFAULT_SERVINGS             (3)
 #define MAX_INGREDIENTS              (6)
+#define RECIPE_NAME_RESERVE          (32)   // Capacity of the name of the running recipe, grows once if exceeded
+
+// ============================================================================
+// Staging Constants
+// ============================================================================
+#define STAGING_DEFAULT_LEAD_S       (120)    // Staging starts this long before a scheduled meal
+#define STAGING_MAX_LEAD_S           (1800)   // Longest accepted lead time
+#define STAGING_MAX_HOLD_S           (2700)   // A batch held longer than this is stale
+#define STAGING_MIN_VALID_TIME       (1704067200) // 2024-01-01: the clock is not set before that
 
 /**
  * @file RecipeProcessor.hpp
@@ -56,8 +77,19 @@
  *
  * The dispensing routine follows a three-phase cycle:
  * 1. PURGE - Open hopper, wiggle to dislodge stuck kibbles, wait for settling
- * 2. CLOSE & TARE - Close hopper with weight spike detection, tare scale
+ * 2. CLOSE & ZERO - Close hopper with weight spike detection, capture the empty-hopper baseline
  * 3. DISPENSE - Fill hopper in batches, mixing ingredients proportionally
+ *
+ * The cycle is a state machine that never blocks: an operation is started, then advanced by
+ * tick() calls, each of which only compares deadlines and consumes inputs. Its inputs are the
+ * hopper weight samples it asks the scale for, fed back through onWeightSample(), and the stop
+ * request. The feeding task pumps both between ticks; a stop takes effect on the next tick.
+ *
+ * The hopper and the bowl sit on separate HX711 channels, so the hopper is measured
+ * while the bowl is still settling and the scale no longer needs a per-cycle tare.
+ *
+ * A scheduled meal is staged: its first batch is measured into the closed hopper a lead
+ * time before the meal, so that at meal time the first kibble only waits for the trapdoor.
  */
 
 /**
@@ -66,15 +98,19 @@
  */
 enum class DispensingPhase : uint8_t {
     PHASE_IDLE,              ///< No dispensing operation in progress
+    PHASE_POWER_UP,          ///< Waiting for the servo supply to stabilize
     PHASE_PURGE_OPEN,        ///< Opening the hopper trapdoor
     PHASE_PURGE_WIGGLE,      ///< Wiggling to dislodge stuck kibbles
     PHASE_PURGE_SETTLE,      ///< Waiting for kibbles to fall through
     PHASE_CLOSE_MOVING,      ///< Gradually closing hopper
     PHASE_CLOSE_DETECT_SPIKE,///< Monitoring scale for weight spike
     PHASE_CLOSE_BACKOFF,     ///< Backing off after spike detection
-    PHASE_TARE,              ///< Taring the scale
+    PHASE_CLOSE_SETTLE,      ///< Waiting for the close motion to stop disturbing the load cells
+    PHASE_ZERO,              ///< Capturing the empty-hopper baseline
     PHASE_DISPENSE_AUGER,    ///< Running auger to dispense kibble
     PHASE_DISPENSE_SETTLE,   ///< Waiting for dispensed kibbles to settle
+    PHASE_POST_BATCH,        ///< Pause before the next cycle
+    PHASE_STOPPING,          ///< Closing the hopper before cutting the servo power
     PHASE_COMPLETE,          ///< Dispensing cycle completed successfully
     PHASE_ERROR              ///< Error occurred during dispensing
 };
@@ -93,13 +129,29 @@ enum class DispensingError : uint8_t {
     ERR_DISPENSE_TIMEOUT         ///< Dispense operation timed out (no weight change)
 };
 
+/**
+ * @enum DispensingOperation
+ * @brief What the running state machine was started for
+ */
+enum class DispensingOperation : uint8_t {
+    OP_NONE,      ///< Idle
+    OP_IMMEDIATE, ///< Single-tank feed
+    OP_RECIPE,    ///< Recipe feed
+    OP_STAGE,     ///< First batch of a scheduled meal, kept in the closed hopper
+    OP_CALIBRATE_DENSITY ///< Hopper filled from one tank to measure its kibble density
+};
+
 /**
  * @struct DispensingContext
  * @brief Holds all state for a dispensing operation
  */
 struct DispensingContext {
     // Recipe/feed identification
+    DispensingOperation operation;               ///< Operation in progress
     uint32_t recipeUid;                          ///< Recipe UID (0 for immediate feed)
+    std::string recipeName;                      ///< Recipe name, for the history
+    uint32_t stagingGeneration;                  ///< Generation of the meal being staged (OP_STAGE)
+    bool fromStagedBatch;                        ///< The feed started from a batch staged for it
     std::vector<RecipeIngredient> ingredients;   ///< List of ingredients to dispense
     float totalTargetGrams;                      ///< Total target weight for entire operation
     float dispensedGrams;                        ///< Total weight dispensed so far
@@ -122,14 +174,55 @@ struct DispensingContext {
 
     // Phase-specific counters
     uint8_t wiggleCount;                         ///< Number of wiggle cycles completed
+    uint8_t wiggleStep;                          ///< Wiggle half-periods completed
+    bool finalPurge;                             ///< The running purge releases the last batch
     uint8_t closeAttempts;                       ///< Number of close detection steps taken
+    uint16_t closePwm;                           ///< PWM of the last close step
     float preCloseWeight;                        ///< Weight reading before starting close
+    float prevWeight;                            ///< Previous hopper sample of the phase (NAN if none)
+
+    // Auger of the current ingredient
+    int8_t augerServo;                           ///< Servo of the running auger, -1 before it starts
+    float ingredientTargetGrams;                 ///< Target of the current ingredient in this batch
+    float ingredientDispensedGrams;              ///< Weight dispensed by the current auger run
+    float augerStartGrams;                       ///< Hopper reading when the auger started
+    TickType_t augerStartTick;                   ///< Tick at which the auger started
+    bool augerSlow;                              ///< Auger slowed down for the approach
+    TickType_t lastWeightChangeTick;             ///< Tick of the last significant weight change (stall detection)
+
+    // Auger flow at full speed, per ingredient, to refine the tank densities
+    float ingredientFlowGrams[MAX_INGREDIENTS];  ///< Grams moved at full speed
+    TickType_t ingredientFlowTicks[MAX_INGREDIENTS]; ///< Time spent at full speed
+
+    // Density calibration
+    TickType_t fillTicks;                        ///< Auger time until the hopper was full (0 if it never filled)
+    uint16_t measuredDensity;                    ///< Density measured by the fill in g/L (0 if none or implausible)
+    uint16_t measuredAugerFlow;                  ///< Auger flow of the fill in mL/min
+
+    // Weight sample input
+    bool awaitingSample;                         ///< A hopper sample has been requested
+    bool sampleReady;                            ///< sample holds an unconsumed answer
+    float sample;                                ///< Last hopper sample received (NAN if the scale failed)
+    TickType_t sampleRequestTick;                ///< Tick of the pending request
+
+    // Scale baselines
+    float hopperBaselineGrams;                   ///< Hopper channel reading with the hopper closed and empty
+    bool hopperBaselineValid;                    ///< Whether hopperBaselineGrams has been captured
+    float bowlStartGrams;                        ///< Bowl channel reading when the operation started (NAN if unknown)
+
+    // Latency
+    TickType_t startTick;                        ///< Tick count when the operation started
+    uint32_t firstKibbleMs;                      ///< Start to first opening of a loaded hopper (0 until then)
 
     /**
      * @brief Reset context to initial state
      */
     void reset() {
+        operation = DispensingOperation::OP_NONE;
         recipeUid = 0;
+        recipeName.clear();
+        stagingGeneration = 0;
+        fromStagedBatch = false;
         ingredients.clear();
         totalTargetGrams = 0.0f;
         dispensedGrams = 0.0f;
@@ -140,7 +233,12 @@ struct DispensingContext {
         currentIngredientIndex = 0;
         for (int i = 0; i < MAX_INGREDIENTS; i++) {
             ingredientRemainingGrams[i] = 0.0f;
+            ingredientFlowGrams[i] = 0.0f;
+            ingredientFlowTicks[i] = 0;
         }
+        fillTicks = 0;
+        measuredDensity = 0;
+        measuredAugerFlow = 0;
 
         learnedClosePwm = 0;
         closeCalibrated = false;
@@ -150,11 +248,63 @@ struct DispensingContext {
         phaseStartTick = 0;
 
         wiggleCount = 0;
+        wiggleStep = 0;
+        finalPurge = false;
         closeAttempts = 0;
+        closePwm = 0;
         preCloseWeight = 0.0f;
+        prevWeight = NAN;
+
+        augerServo = -1;
+        ingredientTargetGrams = 0.0f;
+        ingredientDispensedGrams = 0.0f;
+        augerStartGrams = 0.0f;
+        augerStartTick = 0;
+        augerSlow = false;
+        lastWeightChangeTick = 0;
+
+        awaitingSample = false;
+        sampleReady = false;
+        sample = NAN;
+        sampleRequestTick = 0;
+
+        hopperBaselineGrams = 0.0f;
+        hopperBaselineValid = false;
+        bowlStartGrams = NAN;
+
+        startTick = 0;
+        firstKibbleMs = 0;
     }
 };
 
+/**
+ * @enum StagingState
+ * @brief What the hopper holds ahead of a scheduled meal
+ */
+enum class StagingState : uint8_t {
+    STAGING_NONE,     ///< No meal scheduled, hopper empty
+    STAGING_PENDING,  ///< Meal scheduled, lead time not reached yet
+    STAGING_HELD,     ///< First batch of the scheduled meal held in the closed hopper
+    STAGING_RESIDUAL  ///< Staging aborted, the batch is credited to the next feed
+};
+
+/**
+ * @struct StagingStatus
+ * @brief Snapshot of the scheduled meal and of the staged batch, for the API
+ */
+struct StagingStatus {
+    StagingState state;
+    bool scheduled;             ///< Whether a meal is scheduled
+    uint32_t recipeUid;         ///< Recipe of the scheduled meal
+    int servings;               ///< Servings of the scheduled meal
+    time_t mealTime;            ///< When the scheduled meal is served
+    uint32_t leadTimeS;         ///< How long before mealTime the first batch is staged
+    float stagedGrams;          ///< Grams held in the hopper (0 if none)
+    time_t stagedAt;            ///< When the held batch was measured (0 if none)
+    uint32_t lastFirstKibbleMs; ///< Time to first kibble of the last feed (0 if none yet)
+    bool lastFeedWasStaged;     ///< Whether the last feed started from a staged batch
+};
+
 class RecipeProcessor {
   public:
     RecipeProcessor(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager, TankManager& tankManager,
@@ -163,11 +313,63 @@ class RecipeProcessor {
     void begin();
 
     // These methods are called by the central feeding task
-    bool executeImmediateFeed(const uint64_t tankUid, float targetWeight);
-    // Updated to accept the number of servings to dispense, defaulting to 1.
-    bool executeRecipeFeed(uint32_t recipeUid, int servings = 1);
+    /**
+     * @brief Starts an immediate feed, advanced by tick()
+     * @return false if the feed was rejected (and logged), nothing then runs
+     */
+    bool startImmediateFeed(const uint64_t tankUid, float targetWeight);
+    /**
+     * @brief Starts a recipe feed, advanced by tick()
+     * @return false if the recipe does not exist, nothing then runs
+     */
+    bool startRecipeFeed(uint32_t recipeUid, int servings = 1);
+    /**
+     * @brief Measures the kibble density of a tank, advanced by tick()
+     * @details After the usual purge, close and zero, the auger of the tank runs until the hopper is full, which shows
+     *          as the weight no longer rising within the no-weight-change timeout. The weight held by the
+     *          MAX_HOPPER_VOLUME_LITERS of the hopper gives the density, and the fill time the volume moved by the auger,
+     *          which later feeds use to refine the density. Both are stored in the tank EEPROM, and the kibble is
+     *          released into the bowl. A density outside [DENSITY_MIN_GPL, DENSITY_MAX_GPL] (a tank running empty, a jam)
+     *          is discarded and the operation reported as failed.
+     * @return false if the tank is not connected, or if the hopper holds a staged batch
+     */
+    bool startDensityCalibration(uint64_t tankUid);
+
+    /**
+     * @brief Advances the running operation, without blocking
+     * @param now Current tick count
+     */
+    void tick(TickType_t now);
+    /** @brief Weight sample input: answers the last request of the state machine for @p channel. */
+    void onWeightSample(ScaleChannel channel, float grams);
+    /** @brief Stop input: the running operation closes the hopper and stops the servos on the next tick. */
+    void requestStop() { _stopRequested = true; }
+
+    bool isBusy() const { return _ctx.operation != DispensingOperation::OP_NONE; }
+    bool lastOperationSucceeded() const { return _lastSuccess; }
+    DispensingPhase getPhase() const { return _ctx.phase; }
+
+    /** @brief Closes the hopper and stops all servos right away, for use while idle. */
     void stopAllFeeding();
 
+    /**
+     * @brief Schedules a one-shot meal, replacing the previous one
+     * @details A batch already staged for the previous meal is not released: it is credited
+     *          to whichever feed comes next.
+     * @param mealTime Epoch time at which the meal is served
+     * @param leadTimeS How long before @p mealTime the first batch is staged, 0 for no staging
+     * @return false if the recipe does not exist
+     */
+    bool scheduleMeal(uint32_t recipeUid, int servings, time_t mealTime, uint32_t leadTimeS);
+    void cancelScheduledMeal();
+    StagingStatus getStagingStatus();
+
+    /**
+     * @brief Stages, aborts or serves the scheduled meal, called by the feeding task while idle
+     * @details Serving posts a regular recipe command, which then starts from the staged batch.
+     */
+    void serviceStaging(time_t now);
+
     // Recipe management methods (called by WebServer)
     bool addRecipe(const Recipe& recipe);
     bool updateRecipe(const Recipe& recipe);
@@ -187,74 +389,139 @@ class RecipeProcessor {
 
     std::vector<Recipe> _recipes;
     DispensingContext _ctx;
+    volatile bool _stopRequested;
+    bool _lastSuccess;
+
+    // Scheduled meal, written by the API (guarded by _mutex)
+    struct ScheduledMeal {
+        bool active;
+        uint32_t recipeUid;
+        int servings;
+        time_t mealTime;
+        uint32_t leadTimeS;
+        uint32_t generation; ///< Bumped on every change, so that a staged batch knows it is outdated
+    };
+    // Batch measured ahead of a meal, owned by the feeding task (written under _mutex)
+    struct StagedBatch {
+        bool held;
+        bool residual; ///< Staging was aborted, credit the batch to the next feed whatever it is
+        uint32_t recipeUid;
+        int servings;
+        uint32_t generation;
+        time_t stagedAt;
+        float grams;
+        float ingredientGrams[MAX_INGREDIENTS];
+        float hopperBaselineGrams;
+    };
+    ScheduledMeal _meal;
+    StagedBatch _batch;
+    uint32_t _failedGeneration;  ///< Generation whose staging failed, not retried
+    uint32_t _lastFirstKibbleMs;
+    bool _lastFeedWasStaged;
 
     // Recipe persistence
     void _loadRecipesFromNVS();
     void _saveRecipesToNVS();
 
     // ========================================================================
-    // Three-Phase Dispensing Cycle Methods
+    // Dispensing State Machine
     // ========================================================================
 
-    /**
-     * @brief Execute the complete purge-close-dispense cycle
-     * @return true if cycle completed successfully
-     */
-    bool _executeCycle();
-
     /**
      * @brief Prepare the dispensing context for a recipe or immediate feed
      * @param recipeUid Recipe UID (0 for immediate feed)
      * @param ingredients List of ingredients to dispense
+     * @param count Number of ingredients, only the first MAX_INGREDIENTS are kept
      * @param totalGrams Total weight to dispense
      * @param servings Number of servings
      */
     void _prepareDispensingContext(uint32_t recipeUid,
-                                    const std::vector<RecipeIngredient>& ingredients,
+                                    const RecipeIngredient* ingredients,
+                                    size_t count,
                                     float totalGrams,
                                     int servings);
 
+    /**
+     * @brief Power the servos and start the state machine for @p operation
+     */
+    void _beginOperation(DispensingOperation operation);
+
+    /**
+     * @brief Record the outcome of the operation (history, staged batch, latency) and go idle
+     */
+    void _finishOperation(bool success);
+
+    void _enterPhase(DispensingPhase phase, TickType_t now);
+
+    /**
+     * @brief Ask the scale for a fresh hopper sample, answered through onWeightSample()
+     */
+    void _requestSample(TickType_t now);
+
+    /**
+     * @brief Consume the answer to the last sample request
+     * @return false if it has not arrived yet
+     */
+    bool _takeSample(float& grams);
+
     /**
      * @brief Check if there's more kibble to dispense
      * @return true if dispensedGrams < totalTargetGrams
      */
     bool _hasMoreToDispense() const;
 
+    /**
+     * @brief Log how much the bowl channel gained over the operation, next to the hopper-measured total
+     */
+    void _logBowlDelivery();
+
+    /**
+     * @brief Read the last published bowl weight, without blocking
+     * @return NAN if the bowl channel does not respond
+     */
+    float _getBowlWeight();
+
+    /**
+     * @brief Total grams of @p servings servings of @p recipe
+     */
+    float _recipeTargetGrams(const Recipe& recipe, int servings);
+
     // --- Phase 1: Purge ---
 
     /**
-     * @brief Execute full purge sequence: open, wiggle, settle
-     * @return true if purge completed successfully
+     * @brief Open the hopper, then wiggle and settle
+     * @param final Whether this purge releases the last batch and ends the operation
      */
-    bool _purgeHopper();
+    void _enterPurge(bool final, TickType_t now);
+    void _tickPurgeWiggle(TickType_t now);
 
     /**
-     * @brief Execute wiggle oscillations around open position
-     * @return true if wiggle completed
+     * @brief Wait for the hopper channel to return to its empty baseline after opening
+     * @details Bounded by HOPPER_PURGE_MIN_SETTLE_MS and HOPPER_PURGE_DELAY_MS. The bowl
+     *          channel is not waited upon.
      */
-    bool _executeWiggle();
+    void _tickPurgeSettle(TickType_t now);
+    void _afterPurge(TickType_t now);
 
-    // --- Phase 2: Close & Tare ---
+    // --- Phase 2: Close & Zero ---
 
     /**
-     * @brief Gradually close hopper with spike detection, then tare
-     * @return true if close and tare completed successfully
+     * @brief Read the pre-close weight, then close the hopper step by step with spike detection
      */
-    bool _closeAndTareHopper();
+    void _enterClose(TickType_t now);
 
     /**
-     * @brief Step PWM and monitor scale for weight spike
-     * @return true if spike detected, false if max attempts reached
+     * @brief Step the PWM towards the closed position and request the sample to check for a spike
      */
-    bool _detectCloseSpike();
+    void _stepClose(TickType_t now);
+    void _tickCloseDetect(TickType_t now);
 
     // --- Phase 3: Dispense ---
 
     /**
-     * @brief Dispense one batch (up to MAX_HOPPER_VOLUME_LITERS)
-     * @return true if batch completed successfully
+     * @brief Start one batch (up to MAX_HOPPER_VOLUME_LITERS)
      */
-    bool _dispenseBatch();
+    void _enterDispense(TickType_t now);
 
     /**
      * @brief Calculate target weight for current batch
@@ -263,27 +530,66 @@ class RecipeProcessor {
     float _calculateBatchTarget();
 
     /**
-     * @brief Run auger to dispense specified weight from a tank
-     * @param tankUid Tank to dispense from
-     * @param targetGrams Weight to dispense
-     * @param dispensedOut Output: actual weight dispensed
-     * @return true if dispense completed successfully
+     * @brief Start the auger of the next ingredient with something left for this batch, or settle
      */
-    bool _runAugerForIngredient(uint64_t tankUid, float targetGrams, float& dispensedOut);
+    void _nextIngredient(TickType_t now);
 
-    // --- Error Handling & Utilities ---
+    /**
+     * @brief Run the auger of the current ingredient until its batch target, slowing down for the approach
+     */
+    void _tickAuger(TickType_t now);
+    void _finishIngredient(bool complete, TickType_t now);
+    /**
+     * @brief Add the full-speed part of the running auger run to the flow of its ingredient
+     */
+    void _recordAugerFlow(TickType_t now);
+    void _afterBatch(TickType_t now);
+
+    // --- Density ---
+
+    /**
+     * @brief Derive the density and auger flow from the hopper fill, or leave them at 0 if implausible
+     */
+    void _evaluateDensityCalibration();
 
     /**
-     * @brief Check if emergency stop has been commanded
-     * @return true if emergency stop is active
+     * @brief Refine the density of each tank from the full-speed flow of its auger over the operation
      */
-    bool _checkEmergencyStop();
+    void _refineTankDensities();
+
+    // --- Staging ---
+
+    /**
+     * @brief Start measuring the first batch of @p meal into the hopper, keeping the hopper closed
+     */
+    void _stageMeal(const ScheduledMeal& meal);
+
+    /**
+     * @brief Keep the held batch in the hopper, credited to the next feed instead of the staged meal
+     */
+    void _abortStaging(const char* reason);
+
+    /**
+     * @brief Credit the held batch, if any, to the operation just prepared
+     * @details The batch counts as already dispensed and the first purge releases it. It is
+     *          split per ingredient as measured if it was staged for this recipe and servings,
+     *          pro rata of the percentages otherwise.
+     * @return true if the batch was staged for this very feed
+     */
+    bool _applyStagedBatch(uint32_t recipeUid, int servings);
+
+    /**
+     * @brief Cancel (deleted) or invalidate the staging of the scheduled meal if it uses @p recipeUid
+     */
+    void _onRecipeChanged(uint32_t recipeUid, bool deleted);
+
+    // --- Error Handling & Utilities ---
 
     /**
-     * @brief Handle dispensing error: log, set event, stop feeding
+     * @brief Handle dispensing error: log, set event, then close the hopper and stop the servos
      * @param error The error that occurred
      */
-    void _handleError(DispensingError error);
+    void _handleError(DispensingError error, TickType_t now);
 
     /**
      * @brief Get density for a tank (kg/L -> g/L)
@@ -5,21 +5,43 @@
 #include <Adafruit_EPD.h>
 #include <Adafruit_GFX.h>
 
-
-
+#define SSD1680_BUSY_TIMEOUT_MS (5000) // Longest panel refresh, well beyond the ~3s of the custom LUT
+
+/**
+ * @brief SSD1680 panel driver whose refresh does not hold the caller.
+ *
+ * update() starts the refresh and returns: the panel refreshes from its own RAM, so the
+ * framebuffer can be drawn into again at once. The next access to the panel waits for the
+ * refresh to end, blocked on a semaphore given by the falling edge of BUSY rather than polling it.
+ */
 class Ssd1680_Driver : public Adafruit_SSD1680 {
   public:
     Ssd1680_Driver(int width, int height, int16_t SID, int16_t SCLK, int16_t DC,
                    int16_t RST, int16_t CS, int16_t SRCS, int16_t MISO,
                    int16_t BUSY = -1)
-        : Adafruit_SSD1680(width, height, SID, SCLK, DC, RST, CS, SRCS, MISO, BUSY)
+        : Adafruit_SSD1680(width, height, SID, SCLK, DC, RST, CS, SRCS, MISO, BUSY), _busySemaphore(nullptr), _refreshStartMs(0)
     {}
 
     Ssd1680_Driver(int width, int height, int16_t DC, int16_t RST, int16_t CS, int16_t SRCS, int16_t BUSY = -1, SPIClass* spi = &SPI)
-        : Adafruit_SSD1680(width, height, DC, RST, CS, SRCS, BUSY, spi)
+        : Adafruit_SSD1680(width, height, DC, RST, CS, SRCS, BUSY, spi), _busySemaphore(nullptr), _refreshStartMs(0)
     {}
 
-    void powerUp(), update();
+    void begin(bool reset = true) override;
+    void powerUp() override;
+    /** @brief Starts the refresh of the panel from its RAM, without waiting for it to end. */
+    void update() override;
+    /** @brief Blocks until the refresh started by the last update() has ended. */
+    void waitForRefresh();
+
+  protected:
+    /** @brief Blocks until BUSY is low, on the BUSY interrupt when there is one. */
+    void busy_wait() override;
+
+  private:
+    SemaphoreHandle_t _busySemaphore; // given on each falling edge of BUSY
+    uint32_t _refreshStartMs;         // 0 unless a refresh was started and not waited for yet
+
+    static void IRAM_ATTR _onBusyFalling(void* arg);
 };
 
 #endif // !H_SSD1680_DRIVER_H
@@ -4,6 +4,8 @@
 #include "DeviceState.hpp"
 #include "TankManager.hpp"
 
+#define SAFETY_TASK_STACK_SIZE (4096)
+
 /**
  * @file SafetySystem.hpp
  * @brief Monitors system state for unsafe conditions and takes action.
@@ -18,6 +20,8 @@ private:
     DeviceState& _deviceState;
     SemaphoreHandle_t& _mutex;
     TankManager& _tankManager;
+    StackType_t _taskStack[SAFETY_TASK_STACK_SIZE];
+    StaticTask_t _taskBuffer;
 
     static void _safetyTask(void *pvParameters);
 };
@@ -0,0 +1,85 @@
+#ifndef SCALESAMPLER_HPP
+#define SCALESAMPLER_HPP
+
+#include <cstdint>
+
+/**
+ * @file ScaleSampler.hpp
+ * @brief Channel and averaging window bookkeeping of the HX711 sampling task.
+ *
+ * The HX711 converts one input at a time, and the gain pulses that end a read select the input
+ * of the *next* conversion. The sampler tracks which input the chip converts, drops the
+ * conversions that straddle an input switch, and accumulates the clean conversions of the channel
+ * being averaged. HX711Scale drives it from its task. This header does not depend on Arduino nor
+ * on ESP-IDF, so that host tests can drive it with injected conversions.
+ */
+
+/**
+ * @enum ScaleChannel
+ * @brief Load cells wired to the HX711 inputs.
+ */
+enum class ScaleChannel : uint8_t {
+    HOPPER = 0, ///< Channel A, gain 128
+    BOWL   = 1, ///< Channel B, gain 32
+};
+
+/** @brief What became of a conversion handed to ScaleSampler::onConversion(). */
+enum class ScaleConversion : uint8_t {
+    STALE_INPUT, ///< Belongs to the previously selected input; the switch discard starts
+    FAILED,      ///< The HX711 did not answer
+    DISCARDED,   ///< Output still settling after an input switch
+    BLANKED,     ///< Disturbed by a servo actuation, kept out of the average
+    ACCEPTED,    ///< Added to the average of the window
+};
+
+class ScaleSampler {
+  public:
+    static constexpr uint8_t CHANNEL_SWITCH_DISCARD = 4; // 50ms output settling at 80Hz after an input/gain change (datasheet)
+
+    ScaleSampler();
+
+    /** @brief Channel averaged by the current window, whose gain is to be sent with the next read. */
+    ScaleChannel getActiveChannel() const { return _activeChannel; }
+    /** @brief Input the HX711 is converting, i.e. the one the next read returns. */
+    ScaleChannel getChipChannel() const { return _chipChannel; }
+    /** @brief The HX711 left a power-down: it converts channel A at gain 128 again. */
+    void onPowerUp() { _chipChannel = ScaleChannel::HOPPER; }
+    /** @brief Records an input switch made by a blocking read, outside of the windows. */
+    void setChipChannel(ScaleChannel channel) { _chipChannel = channel; }
+
+    /**
+     * @brief Accounts for a conversion clocked out with the gain of the active channel.
+     * @param raw Raw reading, 0 if the HX711 did not answer.
+     * @param settled Whether the blanking window of the last actuation is over.
+     */
+    ScaleConversion onConversion(long raw, bool settled);
+
+    /** @brief Clears the accumulators and starts a window on @p channel. */
+    void startWindow(ScaleChannel channel);
+    /** @brief Starts the next window, on the other channel. */
+    void nextWindow() { startWindow(otherChannel(_activeChannel)); }
+
+    /** @brief Average of the accepted conversions of the window, 0 if none. */
+    long getAverage() const { return _sampleCount > 0 ? _rawSum / _sampleCount : 0; }
+    uint8_t getSampleCount() const { return _sampleCount; }
+    uint8_t getFailureCount() const { return _failureCount; }
+    uint8_t getBlankedCount() const { return _blankedCount; }
+
+    static ScaleChannel otherChannel(ScaleChannel channel)
+    {
+        return channel == ScaleChannel::HOPPER ? ScaleChannel::BOWL : ScaleChannel::HOPPER;
+    }
+
+  private:
+    ScaleChannel _activeChannel; // channel averaged by the current window
+    ScaleChannel _chipChannel;   // channel the HX711 is currently converting
+    uint8_t _discardCount;       // conversions still to be dropped after an input switch
+
+    // Accumulators (reset each window)
+    long _rawSum;
+    uint8_t _sampleCount;
+    uint8_t _failureCount;
+    uint8_t _blankedCount;
+};
+
+#endif // SCALESAMPLER_HPP
@@ -0,0 +1,66 @@
+#ifndef SCALETRACE_HPP
+#define SCALETRACE_HPP
+
+#include <Arduino.h>
+#include <FS.h>
+#include "ScaleTraceFormat.hpp"
+
+#define SCALE_TRACE_PATH         "/scale_trace.bin"
+#define SCALE_TRACE_MAX_BYTES    (64 * 1024UL) // ~4 minutes of continuous 80Hz sampling
+#define SCALE_TRACE_BUFFER_SIZE  (1024)
+
+/**
+ * @file ScaleTrace.hpp
+ * @brief Records the raw HX711 stream and the servo commands of a feed to flash.
+ *
+ * Capture is one-shot: arm() it, and the next feed is recorded from its start to its end
+ * into SCALE_TRACE_PATH, replacing the previous trace. Records are buffered in RAM and
+ * appended to the file whenever the buffer fills up. See ScaleTraceFormat.hpp for the layout.
+ */
+class ScaleTrace {
+  public:
+    ScaleTrace(fs::FS& fs, const char* path = SCALE_TRACE_PATH);
+
+    bool begin();
+
+    /** @brief Arms (or disarms) the capture of the next feed. */
+    void arm(bool armed) { _armed = armed; }
+    bool isArmed() const { return _armed; }
+    bool isRecording() const { return _recording; }
+    const char* getPath() const { return _path; }
+
+    /**
+     * @brief Starts recording if the capture is armed, consuming the arming.
+     * @return true if a recording was started.
+     */
+    bool start();
+    /** @brief Ends the current recording, if any, and flushes it to flash. */
+    void stop();
+
+    void recordSample(uint8_t channel, long raw);
+    void recordServo(uint8_t servoNum, uint16_t pwm);
+
+  private:
+    fs::FS& _fs;
+    const char* _path;
+    SemaphoreHandle_t _traceMutex;
+    File _file;
+
+    volatile bool _armed;
+    volatile bool _recording;
+    uint32_t _lastRecordMs;
+    int32_t _lastRaw[2];
+    size_t _bytesWritten;
+
+    uint8_t _buffer[SCALE_TRACE_BUFFER_SIZE];
+    size_t _bufferLen;
+
+    // Caller must hold _traceMutex
+    size_t _putTag(uint8_t* out, ScaleTraceRecordType type);
+    bool _hasRoomFor(size_t len) const;
+    void _append(const uint8_t* record, size_t len);
+    void _flush();
+    void _writeMark(ScaleTraceMark mark);
+};
+
+#endif // SCALETRACE_HPP
@@ -0,0 +1,298 @@
+#ifndef H_SCALE_TRACE_FORMAT_H
+#define H_SCALE_TRACE_FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring> // For memcmp
+
+/**
+ * @file ScaleTraceFormat.hpp
+ * @brief On-flash layout of the raw scale traces, with a dependency-free decoder.
+ *
+ * This header does not depend on Arduino nor on ESP-IDF, so that a host-side harness can
+ * include it to replay a downloaded trace through the scale filters and dispensing logic.
+ *
+ * Layout:
+ * - 16-byte header: "KTRC", version, 3 reserved bytes, start millis() (LE32), start UNIX time (LE32).
+ * - Records, each one starting with varint(dt << 2 | type), dt being the milliseconds elapsed
+ *   since the previous record:
+ *   - SAMPLE_HOPPER / SAMPLE_BOWL: zigzag varint of the raw value minus the previous raw value of that channel.
+ *   - SERVO: one byte servo index, then varint of the commanded pulse width in microseconds.
+ *   - MARK: one byte marker id (see ScaleTraceMark).
+ */
+
+#define SCALE_TRACE_MAGIC        "KTRC"
+#define SCALE_TRACE_VERSION      (1)
+#define SCALE_TRACE_HEADER_SIZE  (16)
+#define SCALE_TRACE_MAX_RECORD   (12) // tag varint (5) + servo index (1) + payload varint (5), rounded up
+#define SCALE_TRACE_SERVO_COUNT  (16) // PCA9685 outputs, the range of the SERVO record index
+
+enum class ScaleTraceRecordType : uint8_t {
+    SAMPLE_HOPPER = 0, ///< Raw HX711 conversion of channel A
+    SAMPLE_BOWL   = 1, ///< Raw HX711 conversion of channel B
+    SERVO         = 2, ///< PWM command sent to a servo
+    MARK          = 3, ///< Operation boundary
+};
+
+enum class ScaleTraceMark : uint8_t {
+    CAPTURE_START = 0,
+    CAPTURE_END   = 1,
+};
+
+struct ScaleTraceRecord {
+    uint32_t timeMs;           ///< Milliseconds since the start of the capture
+    ScaleTraceRecordType type;
+    uint8_t index;             ///< Servo index for SERVO records, marker id for MARK records
+    int32_t value;             ///< Raw reading for samples, pulse width for SERVO records
+};
+
+namespace ScaleTraceCodec {
+
+inline size_t putVarint(uint8_t* out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+inline uint32_t zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+inline int32_t unzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+inline void putLe32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out[i] = (uint8_t)(value >> (8 * i));
+}
+
+inline uint32_t getLe32(const uint8_t* in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+} // namespace ScaleTraceCodec
+
+/**
+ * @class ScaleTraceReader
+ * @brief Decodes a trace held in memory, one record at a time.
+ */
+class ScaleTraceReader {
+  public:
+    ScaleTraceReader() : _data(nullptr), _len(0) { rewind(); }
+    ScaleTraceReader(const uint8_t* data, size_t len) : _data(data), _len(len) { rewind(); }
+
+    /** @brief Whether the buffer starts with a supported trace header. */
+    bool isValid() const
+    {
+        return _data != nullptr && _len >= SCALE_TRACE_HEADER_SIZE && memcmp(_data, SCALE_TRACE_MAGIC, 4) == 0
+            && _data[4] == SCALE_TRACE_VERSION;
+    }
+
+    uint32_t getStartMillis() const { return isValid() ? ScaleTraceCodec::getLe32(_data + 8) : 0; }
+    uint32_t getStartUnixTime() const { return isValid() ? ScaleTraceCodec::getLe32(_data + 12) : 0; }
+
+    void rewind()
+    {
+        _pos       = SCALE_TRACE_HEADER_SIZE;
+        _timeMs    = 0;
+        _lastRaw[0] = _lastRaw[1] = 0;
+    }
+
+    /**
+     * @brief Decodes the next record.
+     * @return false at the end of the trace, or if the trace is truncated or invalid.
+     */
+    bool next(ScaleTraceRecord& out)
+    {
+        if (!isValid())
+            return false;
+        uint32_t tag;
+        if (!_getVarint(tag))
+            return false;
+        _timeMs += tag >> 2;
+        out.timeMs = _timeMs;
+        out.type   = (ScaleTraceRecordType)(tag & 0x03);
+        out.index  = 0;
+
+        uint32_t payload;
+        switch (out.type) {
+            case ScaleTraceRecordType::SAMPLE_HOPPER:
+            case ScaleTraceRecordType::SAMPLE_BOWL: {
+                if (!_getVarint(payload))
+                    return false;
+                int32_t& last = _lastRaw[(uint8_t)out.type];
+                last += ScaleTraceCodec::unzigzag(payload);
+                out.value = last;
+                return true;
+            }
+            case ScaleTraceRecordType::SERVO:
+                if (_pos >= _len)
+                    return false;
+                out.index = _data[_pos++];
+                if (!_getVarint(payload))
+                    return false;
+                out.value = (int32_t)payload;
+                return true;
+            default:
+                if (_pos >= _len)
+                    return false;
+                out.index = _data[_pos++];
+                out.value = 0;
+                return true;
+        }
+    }
+
+  private:
+    const uint8_t* _data;
+    size_t _len;
+    size_t _pos;
+    uint32_t _timeMs;
+    int32_t _lastRaw[2];
+
+    bool _getVarint(uint32_t& value)
+    {
+        value = 0;
+        for (uint8_t shift = 0; shift < 35; shift += 7) {
+            if (_pos >= _len)
+                return false;
+            uint8_t b = _data[_pos++];
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * @class ScaleTracePlayer
+ * @brief Serves the records of a trace at their recorded pace, for a replay in place of the HX711.
+ *
+ * Each channel has its own cursor, so a conversion only ever reaches the channel it was recorded
+ * on, whatever interleaving the replaying side follows. Like the HX711, which only holds its last
+ * conversion, a channel that is not read for a while skips to its latest due sample. Times are
+ * milliseconds since the start of the replay, on the clock of the caller.
+ */
+class ScaleTracePlayer {
+  public:
+    ScaleTracePlayer() { reset(ScaleTraceReader()); }
+    explicit ScaleTracePlayer(const ScaleTraceReader& reader) { reset(reader); }
+
+    void reset(const ScaleTraceReader& reader)
+    {
+        for (uint8_t i = 0; i < CURSOR_COUNT; i++) {
+            _cursors[i].reader = reader;
+            _cursors[i].reader.rewind();
+            _cursors[i].primed = false;
+            _cursors[i].ended  = false;
+        }
+        for (uint8_t i = 0; i < SCALE_TRACE_SERVO_COUNT; i++)
+            _lastServoPwm[i] = 0;
+    }
+
+    bool isValid() const { return _cursors[EVENTS].reader.isValid(); }
+
+    /** @brief Whether a conversion of @p channel recorded at or before @p elapsedMs is still to be served. */
+    bool isSampleDue(uint8_t channel, uint32_t elapsedMs)
+    {
+        const ScaleTraceRecord* record = _peek(channel);
+        return record != nullptr && record->timeMs <= elapsedMs;
+    }
+
+    /**
+     * @brief Recorded time of the next conversion of @p channel.
+     * @return false if the trace holds no more conversions of @p channel.
+     */
+    bool nextSampleTime(uint8_t channel, uint32_t& timeMs)
+    {
+        const ScaleTraceRecord* record = _peek(channel);
+        if (record == nullptr)
+            return false;
+        timeMs = record->timeMs;
+        return true;
+    }
+
+    /**
+     * @brief Serves the latest due conversion of @p channel, dropping the older due ones.
+     * @return false if no conversion of @p channel is due.
+     */
+    bool takeSample(uint8_t channel, uint32_t elapsedMs, int32_t& raw)
+    {
+        if (!isSampleDue(channel, elapsedMs))
+            return false;
+        do {
+            raw = _cursors[channel].record.value;
+            _cursors[channel].primed = false;
+        } while (isSampleDue(channel, elapsedMs));
+        return true;
+    }
+
+    /**
+     * @brief Serves the next due servo command, in recorded order.
+     * @param travelUs Set to the pulse width change since the previous command of that servo.
+     * @return false if no servo command is due.
+     */
+    bool takeServo(uint32_t elapsedMs, uint8_t& servo, uint16_t& pwm, uint16_t& travelUs)
+    {
+        const ScaleTraceRecord* record;
+        while ((record = _peek(EVENTS)) != nullptr && record->timeMs <= elapsedMs) {
+            _cursors[EVENTS].primed = false;
+            if (record->type != ScaleTraceRecordType::SERVO)
+                continue;
+            servo = record->index;
+            pwm   = (uint16_t)record->value;
+            if (servo < SCALE_TRACE_SERVO_COUNT) {
+                travelUs             = (uint16_t)(pwm > _lastServoPwm[servo] ? pwm - _lastServoPwm[servo] : _lastServoPwm[servo] - pwm);
+                _lastServoPwm[servo] = pwm;
+            } else {
+                travelUs = pwm;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /** @brief Whether the trace is over at @p elapsedMs: no record lies after it, and all the servo commands were served. */
+    bool isFinished(uint32_t elapsedMs)
+    {
+        const ScaleTraceRecord* record;
+        // Past records other than servo commands need no serving
+        while ((record = _peek(EVENTS)) != nullptr && record->timeMs <= elapsedMs && record->type != ScaleTraceRecordType::SERVO)
+            _cursors[EVENTS].primed = false;
+        return record == nullptr;
+    }
+
+  private:
+    // One cursor per sample channel, indexed as ScaleTraceRecordType, and one for all the records
+    enum : uint8_t { EVENTS = 2, CURSOR_COUNT = 3 };
+
+    struct Cursor {
+        ScaleTraceReader reader;
+        ScaleTraceRecord record;
+        bool primed; ///< record holds the next record of the cursor
+        bool ended;  ///< the reader is exhausted, or stopped on a truncated record
+    };
+    Cursor _cursors[CURSOR_COUNT];
+    uint16_t _lastServoPwm[SCALE_TRACE_SERVO_COUNT];
+
+    /** @brief Next record of cursor @p index, sample cursors skipping the other types; nullptr at the end. */
+    const ScaleTraceRecord* _peek(uint8_t index)
+    {
+        if (index >= CURSOR_COUNT)
+            return nullptr;
+        Cursor& cursor = _cursors[index];
+        while (!cursor.primed) {
+            if (cursor.ended || !cursor.reader.next(cursor.record)) {
+                cursor.ended = true;
+                return nullptr;
+            }
+            cursor.primed = index == EVENTS || (uint8_t)cursor.record.type == index;
+        }
+        return &cursor.record;
+    }
+};
+
+#endif // H_SCALE_TRACE_FORMAT_H
@@ -0,0 +1,116 @@
+#ifndef STORAGE_HPP
+#define STORAGE_HPP
+
+#include <Arduino.h>
+#include <FS.h>
+#include "esp_partition.h"
+
+#define STORAGE_PARTITION_LABEL   "spiffs"    // Data partition, whatever the filesystem on it
+#define STORAGE_LITTLEFS_PATH     "/littlefs"
+#define STORAGE_SPIFFS_PATH       "/spiffs"
+#define STORAGE_MAX_OPEN_FILES    (10)
+#define STORAGE_ARCHIVE_MAGIC     (0x4749524BUL) // "KRIG", little-endian
+#define STORAGE_ARCHIVE_VERSION   (1)
+#define STORAGE_COPY_CHUNK        (1024)
+#define STORAGE_SECTOR_SIZE       (4096)        // Flash erase unit
+#define STORAGE_TMP_SUFFIX        ".tmp"
+
+enum class StorageBackend : uint8_t
+{
+    NONE,     ///< Nothing mounted
+    LITTLEFS, ///< Normal operation
+    SPIFFS,   ///< Legacy partition kept after a failed migration
+};
+
+enum class StorageMigration : uint8_t
+{
+    NOT_NEEDED,  ///< The partition already held LittleFS, or was blank
+    MIGRATED,    ///< SPIFFS content copied to a fresh LittleFS this boot
+    RESUMED,     ///< An interrupted migration was completed from its archive
+    KEPT_SPIFFS, ///< The SPIFFS content could not be archived (no scratch slot, too large), SPIFFS kept
+    ROLLED_BACK, ///< LittleFS could not be populated, SPIFFS restored
+    FAILED,      ///< Neither filesystem could be restored
+};
+
+/**
+ * @file Storage.hpp
+ * @brief Owns the data partition and presents it as a single fs::FS.
+ *
+ * Everything stored on flash (web assets, settings, recipes, the rolling log, the scale trace)
+ * goes through the `storage` object rather than a concrete filesystem. It mounts LittleFS on
+ * the data partition and forwards to it, or to SPIFFS if the partition could not be migrated.
+ *
+ * Devices shipped with SPIFFS are migrated once at boot. The partition table cannot change
+ * over the air, so the content is first packed into the inactive OTA slot: one record per
+ * file with its CRC-32, read back and checked, then committed by writing the archive header
+ * last. The partition is then formatted as LittleFS and the files unpacked and checked again.
+ * If that fails, the partition is formatted back to SPIFFS and refilled from the archive. A
+ * committed archive found at boot means a migration was interrupted, and it is resumed once its
+ * records match their CRC; a damaged archive is discarded without formatting anything. The
+ * archive is erased once the partition holds its content again.
+ */
+class Storage : public fs::FS {
+  public:
+    Storage();
+
+    /** @brief Mounts the data partition, migrating it from SPIFFS if needed. */
+    bool begin();
+
+    StorageBackend getBackend() const { return _backend; }
+    StorageMigration getMigration() const { return _migration; }
+    static const char* getBackendName(StorageBackend backend);
+    static const char* getMigrationName(StorageMigration migration);
+    size_t totalBytes();
+    size_t usedBytes();
+    /** @brief Average time to open an existing file, measured at boot (0 if nothing to open). */
+    uint32_t getOpenLatencyUs() const { return _openLatencyUs; }
+
+    /**
+     * @brief Replaces @p path with @p tmpPath, a complete file written beside it.
+     * @details Atomic on LittleFS: after a power loss, @p path is either the old or the new file.
+     *          SPIFFS cannot rename over a file, so the old one is removed first.
+     */
+    bool commit(const char* tmpPath, const char* path);
+
+  private:
+    struct ArchiveHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t fileCount;
+        uint32_t dataLength; // bytes of records after the header
+        uint32_t dataCrc;
+        uint32_t headerCrc; // of the fields above
+    };
+
+    struct ArchiveRecord {
+        uint16_t pathLength; // path follows the record, then the content
+        uint16_t reserved;
+        uint32_t size;
+        uint32_t crc;
+    };
+
+    static constexpr size_t ARCHIVE_DATA_OFFSET = STORAGE_SECTOR_SIZE; // header alone in the first sector
+
+    StorageBackend _backend;
+    StorageMigration _migration;
+    uint32_t _openLatencyUs;
+
+    bool _mountLittleFS(bool format);
+    bool _mountSPIFFS(bool format);
+    void _use(StorageBackend backend);
+    void _measureOpenLatency();
+
+    StorageMigration _migrate(const esp_partition_t* scratch);
+    StorageMigration _resume(const esp_partition_t* scratch, const ArchiveHeader& header);
+    bool _readArchiveHeader(const esp_partition_t* scratch, ArchiveHeader& header);
+    /** @brief Checks the records against the CRC of the header, before anything is formatted. */
+    bool _verifyArchive(const esp_partition_t* scratch, const ArchiveHeader& header);
+    bool _packArchive(const esp_partition_t* scratch);
+    bool _unpackArchive(const esp_partition_t* scratch, const ArchiveHeader& header, fs::FS& dest);
+    void _eraseArchive(const esp_partition_t* scratch);
+};
+
+extern Storage storage;
+
+#endif // STORAGE_HPP
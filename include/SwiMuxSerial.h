@@ -62,6 +62,88 @@ enum SwiMuxSerialResult_e : uint8_t /* Includes proprietary values as well as va
 
 
 
+/**
+ * @brief Link speed negotiation opcode, an extension of the base SwiMuxOpcodes_e set.
+ * @details Request: { opcode, ~opcode, bauds (LE32) }, sent at the current rate. The SwiMux acknowledges
+ *          at the current rate, then switches. If no valid frame reaches it at the new rate within
+ *          SWIMUX_BAUD_COMMIT_MS, it reverts to DEFAULT_SERIAL_BAUDS on its own. SwiMux firmwares that
+ *          predate it NACK the opcode, which keeps the link at DEFAULT_SERIAL_BAUDS.
+ */
+#define SMCMD_SetBaudRate     ((uint8_t)0x20)
+#define SWIMUX_BAUD_COMMIT_MS (500)
+
+struct __attribute__((packed)) SwiMuxCmdSetBaud_t {
+    uint8_t Opcode;
+    uint8_t NegOpcode;
+    uint8_t bauds[4]; // little endian
+};
+
+/** @brief Operations whose round-trip time is tracked separately. */
+enum SwiMuxRttSlot_e : uint8_t {
+    SMRTT_GETUID = 0,
+    SMRTT_ROLLCALL,
+    SMRTT_READ,
+    SMRTT_WRITE,
+    SMRTT_COUNT
+};
+
+/**
+ * @brief Round-trip time estimator of one SwiMux operation, after the TCP retransmission timer (RFC 6298).
+ * @details The timeout is SRTT + 4 * RTTVAR, doubled after each consecutive timeout, and bounded by the
+ *          static timeout of the operation, which is also used until a first round trip has been measured.
+ */
+struct SwiMuxRttEstimator_t {
+    float srttMs;
+    float rttvarMs;
+    uint8_t backoff; // doublings applied after consecutive timeouts
+    bool valid;
+    uint32_t samples;
+    uint32_t timeouts;
+
+    SwiMuxRttEstimator_t() : srttMs(0), rttvarMs(0), backoff(0), valid(false), samples(0), timeouts(0) {}
+
+    void addSample(uint32_t rttMs)
+    {
+        if (!valid) {
+            srttMs   = rttMs;
+            rttvarMs = rttMs / 2.0f;
+            valid    = true;
+        } else {
+            float err = srttMs - (float)rttMs;
+            rttvarMs  = 0.75f * rttvarMs + 0.25f * (err < 0 ? -err : err);
+            srttMs    = 0.875f * srttMs + 0.125f * rttMs;
+        }
+        backoff = 0;
+        samples++;
+    }
+
+    void reset() { *this = SwiMuxRttEstimator_t(); }
+
+    void onTimeout()
+    {
+        if (backoff < MAX_BACKOFF)
+            backoff++;
+        timeouts++;
+    }
+
+    uint32_t timeoutMs(uint32_t ceilingMs) const
+    {
+        if (!valid)
+            return ceilingMs;
+        float var    = 4.0f * rttvarMs;
+        if (var < GRANULARITY_MS)
+            var = GRANULARITY_MS;
+        uint32_t rto = (uint32_t)(srttMs + var + 0.5f) << backoff;
+        if (rto < MIN_TIMEOUT_MS)
+            rto = MIN_TIMEOUT_MS;
+        return rto < ceilingMs ? rto : ceilingMs;
+    }
+
+    static constexpr uint8_t MAX_BACKOFF       = 4;
+    static constexpr float GRANULARITY_MS      = 2.0f; // millis() resolution plus one scheduler tick
+    static constexpr uint32_t MIN_TIMEOUT_MS   = 10;
+};
+
 struct SwiMuxPresenceReport_t {
     uint16_t presences; // Bit flags, each representing presence '1' or absence `0` of an EEPROM on each bus of the respective bus index/bit index.
     uint8_t busesCount; // The actual count of connected EEPROMS.
@@ -88,7 +170,8 @@ struct SwiMuxPresenceReport_t {
 class SwiMuxSerial_t {
   public:
     SwiMuxSerial_t(HardwareSerial& serial, uint8_t txPin, uint8_t rxPin)
-        : _lastResult(SwiMuxSerialResult_e::SMREZ_OK), _codec(), _sPort(serial), _isAwake(false), _beginCalled(false), _txPin(txPin), _rxPin(rxPin)
+        : _lastResult(SwiMuxSerialResult_e::SMREZ_OK), _codec(), _sPort(serial), _isAwake(false), _beginCalled(false), _txPin(txPin), _rxPin(rxPin),
+          _bauds(DEFAULT_SERIAL_BAUDS), _requestSentAt(0)
     {}
 
     void begin();
@@ -112,7 +195,7 @@ class SwiMuxSerial_t {
      * @param uids The result of the roll call. Any missing/dead EEPROM is reported as UINT64_MAX (all 64 bits set).
      * @return SwiMuxSerialResult_e::SMREZ_OK is the roll call succeeded.
      */
-    SwiMuxSerialResult_e rollCall(RollCallArray_t& uids, uint32_t timeout_ms = ROLLCALL_TIMEOUT_MS);
+    SwiMuxSerialResult_e rollCall(RollCallArray_t& uids, uint32_t timeout_ms = ADAPTIVE_TIMEOUT);
     /**
      * @brief Read a span of bytes from the EEPROM on a specified bus.
      * @param busIndex Bus from which to read.
@@ -122,7 +205,7 @@ class SwiMuxSerial_t {
      * @param timeout_ms Maximum amount of millisecond to wait for the result.
      * @return SwiMuxSerialResult_e::SMREZ_OK if the read succeeded.
      */
-    SwiMuxSerialResult_e read(uint8_t busIndex, uint8_t* bufferOut, uint8_t offset, uint8_t len, uint32_t timeout_ms = READ_TIMEOUT_MS);
+    SwiMuxSerialResult_e read(uint8_t busIndex, uint8_t* bufferOut, uint8_t offset, uint8_t len, uint32_t timeout_ms = ADAPTIVE_TIMEOUT);
     /**
      * @brief Writes a span of bytes to the EEPROM on the specified bus.
     *  @param busIndex Bus to write to which.
@@ -131,13 +214,24 @@ class SwiMuxSerial_t {
      * @param len Number of bytes to write. Must be <= to the size of @p bufferOut
      * @return SwiMuxSerialResult_e::SMREZ_OK if the write succeeded.
      */
-    SwiMuxSerialResult_e write(uint8_t busIndex, const uint8_t* bufferIn, uint8_t offset, uint8_t len, uint32_t timeout_ms = WRITE_TIMEOUT_MS);
+    SwiMuxSerialResult_e write(uint8_t busIndex, const uint8_t* bufferIn, uint8_t offset, uint8_t len, uint32_t timeout_ms = ADAPTIVE_TIMEOUT);
     /** @brief Gets the UID of the device present (or not) on the specified bus.
      * @param busIndex Index of the bus to interrogate.
      * @param &result Reference to the variable that will store the result. It will be UINT64_MAX if nothing's on @p busIndex.
      * @result SwiMuxSerialResult_e::SMREZ_OK if the SwiMux interrogated the bus, EEPROM present or not.
      */
-    SwiMuxSerialResult_e getUid(uint8_t busIndex, uint64_t& result, uint32_t timeout_ms = GETUID_TIMEOUT_MS);
+    SwiMuxSerialResult_e getUid(uint8_t busIndex, uint64_t& result, uint32_t timeout_ms = ADAPTIVE_TIMEOUT);
+    /**
+     * @brief Switches the link to the fastest rate that passes a link test.
+     * @param preferredBauds Rate that passed last time (0 if unknown); tried first, then the other
+     *        SUPPORTED_BAUDS from the fastest down.
+     * @return SMREZ_OK if the link runs above DEFAULT_SERIAL_BAUDS, otherwise the reason it stayed there.
+     */
+    SwiMuxSerialResult_e negotiateBaudRate(uint32_t preferredBauds = 0);
+    /** @brief Current rate of the link. */
+    uint32_t getBaudRate() const { return _bauds; }
+    /** @brief Round-trip statistics of an operation. */
+    const SwiMuxRttEstimator_t& getRttEstimator(SwiMuxRttSlot_e slot) const { return _rtt[slot]; }
 
 
 #ifdef DEBUG_MENU_ENABLED
@@ -149,6 +243,9 @@ class SwiMuxSerial_t {
     static const char* getSwiMuxErrorString(const SwiMuxSerialResult_e value);
     static constexpr uint32_t DEFAULT_SERIAL_CONFIG = SERIAL_8N1;
     static constexpr uint32_t DEFAULT_SERIAL_BAUDS  = 57600;
+    static constexpr uint32_t SUPPORTED_BAUDS[]     = { 921600, 460800, 230400, 115200 };
+    /** @brief Passed as timeout_ms, lets the measured round-trip times set the timeout. */
+    static constexpr uint32_t ADAPTIVE_TIMEOUT = 0;
 
   private:
 #define UART_DURATION_MS_ROUND(CHAR_COUNT, BAUDS) ((((uint64_t)(CHAR_COUNT * 2) * 10000ULL + ((uint64_t)(BAUDS) / 2ULL)) / (uint64_t)(BAUDS)))
@@ -158,21 +255,39 @@ class SwiMuxSerial_t {
     //static constexpr uint32_t WRITE_CMD_DELAY_MS    = 8;
     //static constexpr uint32_t ROLLCALL_CMD_DELAY_MS = 20;
     static constexpr size_t AWAKE_RETRIES_DEFAULT = 3;
+    static constexpr uint8_t LINK_TEST_ROUNDS     = 3; // roll calls carry the largest responses
+    static constexpr uint32_t BAUD_SWITCH_GUARD_MS = 10;
     static constexpr uint32_t PRESENCE_TIMEOUT_MS = 1 + 2 * UART_DURATION_MS_ROUND(sizeof(SwiMuxPresenceReport_t), DEFAULT_SERIAL_BAUDS);
+    // Static timeouts: used until round trips have been measured, then as ceilings of the adaptive ones.
     static constexpr uint32_t GETUID_TIMEOUT_MS   = 100; //(uint32_t)(10 + 5.0 * UART_DURATION_MS_ROUND(10, DEFAULT_SERIAL_BAUDS));
     static constexpr uint32_t READ_TIMEOUT_MS     = 600; //(uint32_t)(10 + 5.0 * UART_DURATION_MS_ROUND(140, DEFAULT_SERIAL_BAUDS));
-    static constexpr uint32_t WRITE_TIMEOUT_MS    = 600; //(uint32_t)(10 + 5.0 * UART_DURATION_MS_ROUND(140, DEFAULT_SERIAL_BAUDS));
+    static constexpr uint32_t WRITE_TIMEOUT_MS    = 3000; // ACK only comes after the 1-Wire copy: 13ms per character + 70ms per block of 8 bytes + 70ms
     static constexpr uint32_t ROLLCALL_TIMEOUT_MS
       = 333; //(uint32_t)(10 + 5.0 * UART_DURATION_MS_ROUND(sizeof(SwiMuxRespUID_t), DEFAULT_SERIAL_BAUDS));
+    static constexpr uint8_t IDEMPOTENT_RETRIES   = 2; // extra attempts of reads, UID queries and roll calls
 
     bool assertAwake(size_t retries = AWAKE_RETRIES_DEFAULT);
     SwiMuxPresenceReport_t _pollPresencePacket(uint32_t timeout_ms = PRESENCE_TIMEOUT_MS);
     bool pollAck(SwiMuxOpcodes_e opcode, uint32_t timeout_ms = 15);
+    SwiMuxSerialResult_e _getUidOnce(uint8_t busIndex, uint64_t& result, uint32_t timeout_ms);
+    SwiMuxSerialResult_e _rollCallOnce(RollCallArray_t& uids, uint32_t timeout_ms);
+    SwiMuxSerialResult_e _readOnce(uint8_t busIndex, uint8_t* bufferOut, uint8_t offset, uint8_t len, uint32_t timeout_ms);
+    uint32_t _timeoutFor(SwiMuxRttSlot_e slot, uint32_t requested, uint32_t ceiling) const;
+    void _recordRoundTrip(SwiMuxRttSlot_e slot, SwiMuxSerialResult_e result);
+    bool _shouldRetry(SwiMuxSerialResult_e result, uint8_t attempt);
+    void _resetRoundTripStats();
+    bool _requestBaudRate(uint32_t bauds);
+    bool _linkTest();
+    void _fallbackToDefaultBaudRate();
     SwiMuxSerialResult_e _lastResult;
     SwiMuxComms_t _codec;
     HardwareSerial _sPort;
     volatile bool _isAwake, _beginCalled;
     uint8_t _rxPin, _txPin;
+    uint32_t _bauds;
+    SwiMuxRttEstimator_t _rtt[SMRTT_COUNT];
+    uint32_t _requestSentAt;
+    alignas(SwiMuxCmdWrite_t) uint8_t _writeCmdBuffer[sizeof(SwiMuxCmdWrite_t) + UINT8_MAX]; // header and payload of write()
     uint16_t lastPresence();
 };
 
@@ -8,6 +8,8 @@
 #include "freertos/semphr.h"
 #include "board_pinout.h"
 #include "SwiMuxSerial.h"
+#include "JsonFields.hpp"
+#include "EventBus.hpp"
 
 
 // Forward-declare DeviceState to break circular dependency.
@@ -17,6 +19,8 @@ struct DeviceState;
 #define SERVO_CONTINUOUS_STOP_PWM 1500
 #define SERVO_CONTINUOUS_FWD_PWM  2000
 #define SERVO_CONTINUOUS_REV_PWM  1000
+#define SERVO_JOG_MIN_PWM         500  // Accepted range of manual jog commands (0 releases the servo)
+#define SERVO_JOG_MAX_PWM         2500
 
 // Default values for the hopper servo if no calibration is found
 #define DEFAULT_HOPPER_CLOSED_PWM 1000
@@ -26,7 +30,80 @@ struct DeviceState;
 #define HOPPER_SERVO_INDEX (NUMBER_OF_BUSES)
 #define TOTAL_SERVO_COUNT  (NUMBER_OF_BUSES + 1)
 
+// Servo pulses are staggered across the PCA9685 frame so that their inrush currents do not stack.
+// With 7 channels the slots are 585 ticks (~2.86 ms) apart, wider than the longest 2.5 ms pulse.
+#define SERVO_PWM_FRAME_TICKS  (4096)
+#define SERVO_PHASE_STEP_TICKS (SERVO_PWM_FRAME_TICKS / TOTAL_SERVO_COUNT)
+
+// Load cell blanking after a servo command, growing with the commanded travel
+#define SERVO_BLANKING_BASE_MS      (30)
+#define SERVO_BLANKING_MS_PER_100US (20)
+#define SERVO_BLANKING_MAX_MS       (250)
+
+// Background EEPROM scrubbing (see TankManager::scrubTank())
+#define TANK_SCRUB_INTERVAL_MS (6UL * 60UL * 60UL * 1000UL) // Each tank is reread every 6 hours
+#define TANK_SCRUB_POLL_MS     (10000)                      // How often the scrubber looks for an idle window
+#define TANK_SCRUB_IDLE_MS     (60000)                      // Quiet time required after the last servo move
+#define TANK_EEPROM_ROW_SIZE   (8)                          // DS28E07/DS2431 scratchpad row, the unit of the write-backs
+#define TANK_TASK_STACK_SIZE   (5 * 1024UL)
+#define TANK_SCRUB_STACK_SIZE  (3 * 1024UL)
+#define TANK_EVENT_DEPTH       (4)                          // Population changes kept for each subscriber
+
+// Kibble density (see TankManager::refineDensity())
+#define DENSITY_MIN_GPL              (150)    // Lowest plausible kibble density, in g/L
+#define DENSITY_MAX_GPL              (1000)   // Highest plausible kibble density, in g/L
+#define DENSITY_REFINE_WEIGHT        (0.125f) // Share of a feed's estimate in the refined density
+#define DENSITY_REFINE_MAX_DEVIATION (0.5f)   // Estimates further than this (relative) from the density are discarded
+#define TANK_EEPROM_LEGACY_NAME_SIZE (80)     // Name field of the records written before the density calibration
+
+/** @brief A change of the tank population, as published by the tank detection task. */
+struct TanksChangedEvent {
+    uint8_t changedBuses; ///< Bit map of the buses whose tank was plugged, unplugged or swapped
+};
+typedef EventChannel<TanksChangedEvent, TANK_EVENT_DEPTH> TanksEventChannel;
+
+/** @brief A servo command, as published to the scale pipeline and the trace capture. */
+struct ServoActuation {
+    uint8_t servoNum;
+    uint16_t pwm;        ///< Commanded pulse width, in microseconds
+    TickType_t tick;     ///< When the command was issued
+    uint32_t blankingMs; ///< How long the load cells should be deemed disturbed (0 if the servo was already there)
+};
+
+/** @brief Load cell blanking of a servo command that moves the pulse width by @p travelUs (0 if it does not move). */
+inline uint32_t servoBlankingMs(uint16_t travelUs)
+{
+    if (travelUs == 0)
+        return 0;
+    uint32_t blankingMs = SERVO_BLANKING_BASE_MS + ((uint32_t)travelUs * SERVO_BLANKING_MS_PER_100US) / 100;
+    return blankingMs < SERVO_BLANKING_MAX_MS ? blankingMs : SERVO_BLANKING_MAX_MS;
+}
+
+
+
+/** @brief Where a servo pulse sits in the 20 ms PCA9685 frame. */
+struct ServoPhaseSlot {
+    uint8_t servoNum;
+    uint16_t onTick;  ///< Pulse start, in 1/4096 of the frame
+    uint16_t offTick; ///< Pulse end, lower than onTick if the pulse wraps around the frame end
+    uint16_t pulseUs; ///< Last commanded pulse width (0 if never commanded)
+};
+
+/** @brief Error counters of the EEPROM of the tank on a bus, as gathered by the scrubber. */
+struct TankScrubStats {
+    uint64_t uid;              ///< Tank the counters belong to (0 if none scrubbed yet)
+    uint32_t scrubs;           ///< Completed passes
+    uint32_t correctedBytes;   ///< Bytes fixed by Reed-Solomon, all passes included
+    uint32_t rowsRewritten;    ///< Rows written back with their corrected contents
+    uint32_t uncorrectable;    ///< Passes that found more errors than the ECC can fix
+    uint32_t readFailures;     ///< Passes aborted by a SwiMux error
+    TickType_t lastScrubTick;
 
+    TankScrubStats() : uid(0), scrubs(0), correctedBytes(0), rowsRewritten(0), uncorrectable(0), readFailures(0), lastScrubTick(0) {}
+
+    /** @brief Average number of corrected bytes per pass. */
+    float errorRate() const { return scrubs ? (float)correctedBytes / scrubs : 0.0f; }
+};
 
 /** @brief Internal record structure for Tank EEPROM */
 struct __attribute__((packed)) TankHistory_t {
@@ -34,6 +111,13 @@ struct __attribute__((packed)) TankHistory_t {
     uint8_t lastBusIndex;
 };
 
+/** @brief How the density of a tank was obtained, from the least to the most trusted. */
+enum class DensitySource : uint8_t {
+    NONE     = 0, ///< Unknown, batches are sized from a default
+    USER     = 1, ///< Entered through the API
+    MEASURED = 2, ///< Measured by a hopper-fill calibration, refined by the feeds that followed
+};
+
 /** @brief Main data section of the Tank EEPROM */
 struct __attribute__((packed)) TankEEpromRecordData_t {
     TankHistory_t history;
@@ -42,7 +126,10 @@ struct __attribute__((packed)) TankEEpromRecordData_t {
     uint16_t density; // Kibble density in grams per liter (g/L)
     uint16_t servoIdlePwm;
     uint16_t remainingGrams;
-    char name[80];
+    char name[76];
+    uint16_t augerFlow;     // Kibble volume moved by the auger at full speed, in mL per minute (0 if unknown)
+    uint8_t densitySource;  // DensitySource of .density
+    uint8_t densitySamples; // Feeds blended into .density since it was measured (saturates at 255)
 };
 
 /** @brief Complete data structure including ECC */
@@ -80,6 +167,7 @@ struct __attribute__((packed)) TankEEpromData_t {
     static constexpr size_t ECC_SIZE        = sizeof(ecc);
     static constexpr size_t NAME_FIELD_SIZE = sizeof(data.name);
 };
+static_assert(sizeof(TankEEpromData_t) == 128, "The record fills the DS28E07/DS2431 exactly");
 
 /**
  * @struct TankInfo
@@ -104,6 +192,11 @@ struct TankInfo {
     // Servo calibration data
     uint16_t servoIdlePwm;
 
+    // Density calibration
+    uint16_t augerFlow;           // mL per minute at full speed, 0 if never measured
+    DensitySource densitySource;  // How kibbleDensity was obtained
+    uint8_t densitySamples;       // Feeds blended into kibbleDensity since its measurement
+
     TankInfo()
         : uid(0ULL),
           lastBaseMAC48 { 0, 0, 0, 0, 0, 0 },
@@ -113,9 +206,15 @@ struct TankInfo {
           capacityLiters(0),
           kibbleDensity(0),
           remaining_weight_grams(0),
-          servoIdlePwm(1500)
+          servoIdlePwm(1500),
+          augerFlow(0),
+          densitySource(DensitySource::NONE),
+          densitySamples(0)
     {}
 
+    /** @brief JSON mapping of the API, in its units: capacity in L, density in g/L. Bounded by the EEPROM fields. */
+    static const JsonFieldList FIELDS;
+
   protected:
     friend class TankManager;
 
@@ -123,7 +222,7 @@ struct TankInfo {
     {
         TID_NONE              = 0, // Nothing changed.
         TID_NAME_CHANGED      = 1, // The .name and/or .nameLength fields have changed.
-        TID_SPECS_CHANGED     = 2, // One or more fields of the specs (.capacity, .density, .calibration) have changed.
+        TID_SPECS_CHANGED     = 2, // One or more fields of the specs (.capacity, .density and its calibration, .servoIdlePwm) have changed.
         TID_MAC_CHANGED       = 4, // the base MAC addres have changed.
         TID_BUSINDEX_CHANGED  = 8, // the bus index has changed.
         TID_REMAINING_CHANGED = 16, // .remainingGrams and .notDSR have changed.
@@ -142,23 +241,59 @@ class TankManager {
 
   public:
     // Constructor now takes ServoController directly.
-    TankManager(DeviceState& deviceState, SemaphoreHandle_t& mutex)
+    TankManager(DeviceState& deviceState, SemaphoreHandle_t& mutex, I2CManager& i2c)
         : _deviceState(deviceState),
           _deviceStateMutex(mutex),
-          _pwm(PCA9685()),
+          _pwm(PCA9685(PCA9685_I2C_ADDRESS, i2c)),
           _isServoMode(false),
           _swiMux(SWIMUX_SERIAL_DEVICE, SWIMUX_TX_PIN, SWIMUX_RX_PIN),
-          _lastKnownUids {}
-    {}
+          _lastKnownUids {},
+          _lastCommandedPwm {},
+          _lastActuationTick(0),
+          _feedingActive(false),
+          _nextScrubBus(0),
+          _densityDirtyBuses(0)
+    {
+        _densityLock = portMUX_INITIALIZER_UNLOCKED;
+    }
 
-    /** @brief Initialize the multiplexed OneWire setup but does not start the task. */
-    void begin(uint16_t hopper_closed_pwm, uint16_t hopper_open_pwm);
+    /** @brief Initialize the multiplexed OneWire setup but does not start the task.
+     * @param swimuxBauds Persisted SwiMux link rate: 0 to negotiate the fastest one, SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS to skip the negotiation.
+     */
+    void begin(uint16_t hopper_closed_pwm, uint16_t hopper_open_pwm, uint32_t swimuxBauds = 0);
+    /** @brief Current SwiMux link rate, to be persisted once begin() negotiated it. */
+    uint32_t getSwiMuxBaudRate() const { return _swiMux.getBaudRate(); }
     /** @brief Refreshes the local data about connected tanks, by interrogating them. Uses lazy update.
      * @param refreshMap <optional> bit map of the tanks to refresh.
      */
     void refresh(uint16_t refreshMap = 0xFFFFU);
 
-    void startTask() { xTaskCreate(TankManager::_tankDetectionTask, "TankManager", 5 * 1024UL, this, 11, &TankManager::_runningTask); }
+    void startTask()
+    {
+        _runningTask = xTaskCreateStatic(
+          TankManager::_tankDetectionTask, "TankManager", TANK_TASK_STACK_SIZE, this, 11, _taskStack, &_taskBuffer);
+        xTaskCreateStatic(TankManager::_scrubTask, "TankScrubber", TANK_SCRUB_STACK_SIZE, this, 1, _scrubStack, &_scrubBuffer);
+    }
+
+    /** @brief Holds the background scrubber and manual jogging off while a feed is in progress. */
+    void setFeedingActive(bool active) { _feedingActive = active; }
+    bool isFeedingActive() const { return _feedingActive; }
+    /**
+     * @brief Moves a servo by hand (calibration), powering the servos first if needed.
+     * @details Switching to servo mode cuts the EEPROM power, so it waits for the SwiMux to be released.
+     */
+    PCA9685::I2C_Result_e jogServo(uint8_t servoNum, uint16_t pwm);
+    /**
+     * @brief Rereads the EEPROM of the tank on @p busIndex and writes back the rows that Reed-Solomon had to correct.
+     * @details Uncorrectable contents are only counted: reformatting is left to refresh(). The background task
+     *          calls this for each tank every TANK_SCRUB_INTERVAL_MS, when the SwiMux and the servos are idle.
+     *          A feed starting during the write-back stops it between two runs of rows.
+     * @return SMREZ_OK if the EEPROM was read (whether or not anything had to be repaired),
+     *         SMREZ_CommandDisabled if a feed cut the write-back short.
+     */
+    SwiMuxSerialResult_e scrubTank(uint8_t busIndex);
+    /** @brief Error counters of the tank currently on @p busIndex. */
+    TankScrubStats getScrubStats(uint8_t busIndex) const;
     /**
      * @brief Update both local memory and eeprom so that the amount of remaining kibble is set to a new value.
      * @param uid Uid of the tank to update.
@@ -208,10 +343,32 @@ class TankManager {
     inline bool disableSwiMux() { return _swiMux.sleep(); }
 
     /**
-     * @brief Sets a callback to be invoked when the tank population changes.
-     * @param cb The callback function to invoke on tank population change.
+     * @brief Replaces the density of @p uid with one measured by a hopper-fill calibration.
+     * @param gramsPerLiter Measured density.
+     * @param augerFlow Volume moved by the auger at full speed during the measurement, in mL per minute.
+     * @details The cached tank is updated at once. The EEPROM is written when the servos are next idle, see refineDensity().
+     * @return <false> if the tank is unknown.
+     */
+    bool setMeasuredDensity(uint64_t uid, uint16_t gramsPerLiter, uint16_t augerFlow);
+    /**
+     * @brief Blends the density estimated from the full-speed flow of a feed into the measured density of @p uid.
+     * @param gramsPerMinute Weight moved by the auger of the tank at full speed.
+     * @details Only tanks whose density was measured have a known auger flow, and thus a volume to divide by. Estimates
+     *          outside the plausible range, or too far from the current density (a jam, a nearly empty tank), are discarded.
+     *          The EEPROM is written by the scrubbing task once the servos have been idle for TANK_SCRUB_IDLE_MS,
+     *          powering them down if needed: the EEPROMs are powered through the same PCA9685 outputs.
+     * @return <true> if the estimate was blended in.
+     */
+    bool refineDensity(uint64_t uid, float gramsPerMinute);
+
+    /** @brief Channel of the tank population changes, published once the new tanks have been read. */
+    TanksEventChannel& tankEvents() { return _tankEvents; }
+
+    /**
+     * @brief Sets a callback to be invoked with every servo PWM command (scale blanking, trace capture).
+     * @param cb The callback function, receiving the command and its blanking window.
      */
-    void setOnTanksChangedCallback(std::function<void()> cb);
+    void setOnServoCommandCallback(std::function<void(const ServoActuation&)> cb);
 
     /**
      * @brief Prints formatted information about all connected tanks to a Stream.
@@ -220,12 +377,19 @@ class TankManager {
     void printConnectedTanks(Stream& stream);
 
     // --- Servo Control Methods ---
+    /** @brief Switches the PCA9685 between servo and EEPROM power, under the SwiMux mutex. */
     void setServoPower(bool on);
     PCA9685::I2C_Result_e setContinuousServo(uint8_t servoNum, float speed); // speed from -1.0 to 1.0
     PCA9685::I2C_Result_e stopAllServos();
     PCA9685::I2C_Result_e setServoPWM(uint8_t servoNum, uint16_t pwm);
     PCA9685::I2C_Result_e openHopper() { return setServoPWM(HOPPER_SERVO_INDEX, _hopperOpenPwm); }
     PCA9685::I2C_Result_e closeHopper() { return setServoPWM(HOPPER_SERVO_INDEX, _hopperClosedPwm); }
+    /** @brief Tick of the last command that actually moved a servo. */
+    TickType_t getLastActuationTick() const { return _lastActuationTick; }
+    /** @brief Start of the pulse of @p servoNum within the frame, in PCA9685 ticks. */
+    static uint16_t getServoPhaseOffset(uint8_t servoNum) { return (uint16_t)(servoNum * SERVO_PHASE_STEP_TICKS); }
+    /** @brief Pulse slots of all the servo channels, hopper included, as currently programmed. */
+    std::vector<ServoPhaseSlot> getServoSchedule() const;
 
     // --- Hopper PWM Getters ---
     uint16_t getHopperOpenPwm() const { return _hopperOpenPwm; }
@@ -263,14 +427,28 @@ class TankManager {
     bool _isServoMode;
 
     static TaskHandle_t _runningTask;
+    StackType_t _taskStack[TANK_TASK_STACK_SIZE];
+    StaticTask_t _taskBuffer;
+    StackType_t _scrubStack[TANK_SCRUB_STACK_SIZE];
+    StaticTask_t _scrubBuffer;
 
     // A physical interface to address Dallas 1-Wire EEPROMs (DS28E07/DS2431+, 128 bytes) on 6 separate buses via 57600B8N1 UART.
     SwiMuxSerial_t _swiMux;
     RollCallArray_t _lastKnownUids;
     // A dedicated mutex to protect 1-Wire bus transactions.
     SemaphoreHandle_t _swimuxMutex;
-    // Callback invoked when tank population changes (for SSE notifications).
-    std::function<void()> _onTanksChangedCallback;
+    TanksEventChannel _tankEvents;
+    // Callback invoked on each servo PWM command (scale blanking, trace capture).
+    std::function<void(const ServoActuation&)> _onServoCommandCallback;
+    uint16_t _lastCommandedPwm[TOTAL_SERVO_COUNT];
+    volatile TickType_t _lastActuationTick;
+    // Background scrubbing
+    volatile bool _feedingActive;
+    uint8_t _nextScrubBus;
+    // Buses whose cached density has yet to be written to EEPROM
+    uint8_t _densityDirtyBuses;
+    portMUX_TYPE _densityLock;
+    TankScrubStats _scrubStats[NUMBER_OF_BUSES];
 
 
     // Internal list of tanks, which holds the comprehensive state.
@@ -280,10 +458,22 @@ class TankManager {
     // --- PCA9685 Mode Switching Helpers ---
     void _switchToSwiMode();
     void _switchToServoMode();
+    /** @brief Queues a pulse of @p pwm microseconds in the phase slot of @p servoNum. */
+    PCA9685::I2C_Result_e _writeServoPulse(uint8_t servoNum, uint16_t pwm, I2CPriority priority = I2CPriority::CONTROL);
+    PCA9685::I2C_Result_e _setServoPWM(uint8_t servoNum, uint16_t pwm, I2CPriority priority);
 
 
     inline void fullRefresh() { refresh(0xFFFF); }
     static void _tankDetectionTask(void* pvParam);
+    static void _scrubTask(void* pvParam);
+    /** @brief Scrubs one tank, caller must hold _swimuxMutex. */
+    SwiMuxSerialResult_e _scrubTank(uint8_t busIndex);
+    /** @brief Whether no feed is running and no servo has moved for TANK_SCRUB_IDLE_MS. */
+    bool _areServosIdle() const;
+    /** @brief Writes the density of one tank whose cached value changed, caller must hold _swimuxMutex with the servos unpowered. */
+    void _flushDensity();
+    /** @brief Marks the tank on @p busIndex for _flushDensity(), and mirrors its cached entry into the device state. */
+    void _densityChanged(const TankInfo& tank);
 
     /** @brief Selectively updates an eeprom through the _swiMux adapter. 
      * @param data Reference to the TankEEpromData_t to use as source.
@@ -0,0 +1,64 @@
+#ifndef TASKJITTER_HPP
+#define TASKJITTER_HPP
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define JITTER_MAX_PROBES   (6)
+#define JITTER_BUCKETS      (12)  // Lateness histogram buckets, the last one is open-ended
+#define JITTER_FIRST_EDGE_US (250) // Upper edge of the first bucket, each next edge doubles it
+
+/**
+ * @file TaskJitter.hpp
+ * @brief Scheduling-lateness histograms of the periodic tasks, for the jitter benchmark build.
+ *
+ * A periodic task brackets its delay with sleeping() and woke(). The probe measures how much
+ * later than asked the task got the CPU back, and how long the loop ran before sleeping again.
+ * Lateness goes into a histogram of fixed power-of-two edges, so that reports taken before and
+ * after a change are comparable bucket by bucket.
+ *
+ * The probes only record when built with JITTER_BENCHMARK defined. Otherwise their methods are
+ * empty and the report endpoint is not registered.
+ */
+class JitterProbe {
+  public:
+    /** @brief Registers the probe for the report, up to JITTER_MAX_PROBES. @p name must be static. */
+    explicit JitterProbe(const char* name);
+
+#ifdef JITTER_BENCHMARK
+    /** @brief Call right before the task delays itself for @p ticks. */
+    void sleeping(uint32_t ticks);
+    /** @brief Call right after the delay returns. */
+    void woke();
+#else
+    void sleeping(uint32_t ticks) {}
+    void woke() {}
+#endif
+
+    /** @brief Appends the histograms of every probe to @p doc, with the bucket edges. */
+    static void report(JsonDocument& doc);
+    /** @brief Clears every histogram, to start a measurement window. */
+    static void resetAll();
+
+  private:
+    const char* _name;
+    int64_t _sleepStartUs; // 0 while the task runs
+    int64_t _wakeUs;       // 0 before the first wake-up
+    uint32_t _expectedUs;
+    uint32_t _periodMs; // last requested delay, for the report
+    uint32_t _samples;
+    uint32_t _maxLateUs;
+    uint32_t _maxBusyUs;
+    uint64_t _sumLateUs;
+    uint32_t _buckets[JITTER_BUCKETS];
+
+    static JitterProbe* _probes[JITTER_MAX_PROBES];
+    static size_t _probeCount;
+    static int64_t _windowStartUs;
+    static portMUX_TYPE _lock;
+
+    static uint32_t _bucketUpperUs(size_t bucket);
+    uint32_t _percentileUs(uint32_t permille) const;
+};
+
+#endif // TASKJITTER_HPP
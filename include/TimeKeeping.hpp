@@ -5,6 +5,8 @@
 #include "ConfigManager.hpp"
 #include <time.h>
 
+#define TIMEKEEPING_TASK_STACK_SIZE (4096)
+
 /**
  * @file TimeKeeping.hpp
  * @brief Manages NTP time synchronization and updates the global device state.
@@ -20,6 +22,8 @@ private:
     DeviceState& _deviceState;
     SemaphoreHandle_t& _mutex;
     ConfigManager& _configManager;
+    StackType_t _taskStack[TIMEKEEPING_TASK_STACK_SIZE];
+    StaticTask_t _taskBuffer;
     
     static void _timekeepingTask(void *pvParameters);
 };
@@ -10,13 +10,65 @@
 #include "TankManager.hpp"
 #include "HX711Scale.hpp"
 #include "EPaperDisplay.hpp"
+#include "ApiRouter.hpp"
+#include "ApiExchange.hpp"
+#include "ApiHandlers.hpp"
 #include <ArduinoJson.h>
 
+#define WS_MAX_CLIENTS     (4)   // Concurrent WebSocket clients, older ones are dropped beyond that
+#define WS_MAX_MESSAGE_LEN (256) // Largest accepted WebSocket request, which must fit in one frame
+
+// HTTP admission control: keeps web clients from starving the feeding and scale tasks of the state mutex.
+#define HTTP_TRACKED_CLIENTS       (8)  // Token buckets, the least recently seen client's is recycled
+#define HTTP_BUCKET_CAPACITY       (10) // Burst of API requests a client can make
+#define HTTP_BUCKET_REFILL_PER_SEC (4)  // Sustained API request rate per client
+#define HTTP_EXPENSIVE_COST        (3)  // Tokens taken by an expensive request, 1 for the others
+#define HTTP_MAX_EXPENSIVE         (2)  // Expensive requests being served at once
+#define HTTP_RETRY_BUSY_S          (1)  // Retry-After of a request refused for the concurrency cap
+#define HTTP_RETRY_FEEDING_S       (5)  // Retry-After of an expensive request refused while feeding
+
+// Request bodies are buffered in fixed slots rather than on the heap, one per body being received.
+#define HTTP_BODY_SLOTS       (3)
+#define HTTP_BODY_SLOT_SIZE   (2048)  // Largest accepted JSON body, 413 beyond
+#define HTTP_BODY_STALE_MS    (10000) // A slot untouched for this long belonged to a dropped connection
+
+// Device status published in the TXT records of the _kittyble._tcp mDNS service
+#define MDNS_STATUS_POLL_MS         (1000)
+#define MDNS_STATUS_MIN_INTERVAL_MS (5000) // Between two TXT updates, each of which multicasts an announcement
+#define MDNS_STATUS_STACK_SIZE      (3072)
+#define MDNS_BATTERY_STEP_PERCENT   (5)    // Battery change worth an update
+
+// Task pushing the scale and tank events to the SSE and WebSocket clients
+#define WEB_EVENTS_STACK_SIZE (3072)
+#define WEB_EVENTS_PRIORITY   (2)
+
 /**
  * @file WebServer.hpp
- * @brief Manages WiFi connection (STA/AP mode) and the REST API.
+ * @brief Manages WiFi connection (STA/AP mode), the REST API and its WebSocket counterpart.
  */
 
+/** @brief Telemetry streams a WebSocket client can subscribe to. */
+enum WsStream_e : uint8_t
+{
+    WSSTREAM_WEIGHT        = 1 << 0,
+    WSSTREAM_BOWL_WEIGHT   = 1 << 1,
+    WSSTREAM_TANKS_CHANGED = 1 << 2,
+};
+
+/** @brief ApiExchange answering an ESPAsyncWebServer request; compressible JSON is gzip'd when large and accepted. */
+class AsyncApiExchange : public ApiExchange {
+  public:
+    explicit AsyncApiExchange(AsyncWebServerRequest* request) : _request(request) {}
+
+    using ApiExchange::sendJson;
+    void send(int status, const char* contentType, const char* body) override;
+    void sendJson(int status, const JsonDocument& doc, bool compressible = false) override;
+    void sendFile(const char* path, const char* contentType, bool download) override;
+
+  private:
+    AsyncWebServerRequest* _request;
+};
+
 class WebServer {
   public:
     WebServer(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager, RecipeProcessor& recipeProcessor,
@@ -28,6 +80,7 @@ class WebServer {
   private:
     AsyncWebServer _server;
     AsyncEventSource _events;
+    AsyncWebSocket _ws;
     DNSServer _dnsServer;
     DeviceState& _deviceState;
     SemaphoreHandle_t& _mutex;
@@ -36,12 +89,44 @@ class WebServer {
     TankManager& _tankManager;
     HX711Scale& _scale;
     EPaperDisplay& _display;
+    ApiHandlers _api; // The handlers over the state, settings, tanks and recipes
 
     // To store the list of scanned networks
     std::vector<String> _scanned_ssids;
     // Buffer to hold the pre-rendered captive portal page
     char* _captive_portal_buffer;
 
+    // --- mDNS Status ---
+    /** @brief Fields of the TXT records, compared to decide whether an update is worth a multicast. */
+    struct MdnsStatus {
+        uint8_t state;
+        uint8_t battery;
+        long long lastFeedTime;
+        uint8_t tankCount;
+        bool operator==(const MdnsStatus& other) const;
+    };
+    bool _mdnsStarted;
+    MdnsStatus _mdnsPublished;
+    TaskHandle_t _mdnsTaskHandle;
+    StackType_t _mdnsTaskStack[MDNS_STATUS_STACK_SIZE];
+    StaticTask_t _mdnsTaskBuffer;
+
+    bool _readMdnsStatus(MdnsStatus& status);
+    void _publishMdnsStatus(const MdnsStatus& status);
+    static void _mdnsStatusTask(void* pvParam);
+
+    // --- Event Push ---
+    EventSubscriber _eventSubscriber;
+    WeightEventChannel::Subscription _weightSubscription;
+    TanksEventChannel::Subscription _tanksSubscription;
+    TaskHandle_t _eventsTaskHandle;
+    StackType_t _eventsTaskStack[WEB_EVENTS_STACK_SIZE];
+    StaticTask_t _eventsTaskBuffer;
+
+    void _pushWeight(const WeightEvent& event);
+    void _pushTanksChanged(const TanksChangedEvent& event);
+    static void _eventsTask(void* pvParam);
+
     // --- WiFi Management ---
     void _scanWifiNetworks();
     void _startAPMode();
@@ -49,52 +134,98 @@ class WebServer {
     void _handleWifiSave(AsyncWebServerRequest* request);
 
     // --- API Routes ---
+    typedef std::function<void(ApiExchange&, const RouteParams&)> ApiRequestHandler;
+    typedef std::function<void(ApiExchange&, const RouteParams&, JsonDocument&)> ApiBodyHandler;
+    struct ApiRoute {
+        ApiRequestHandler onRequest; // set for the routes without a body
+        ApiBodyHandler onBody;       // set for the routes taking a JSON body
+    };
+    ApiRouter _router;
+    std::vector<ApiRoute> _routes; // indexed by the ids given by _router
+
     void _setupAPIRoutes();
+    void _route(const char* pathTemplate, RouteMethod method, ApiRequestHandler handler);
+    void _routeBody(const char* pathTemplate, RouteMethod method, ApiBodyHandler handler);
+    int _matchRoute(AsyncWebServerRequest* request, RouteParams& params);
+    /** @brief Catch-all handler of /api/: runs the matching route, or answers 404/405. */
+    void _dispatchRequest(AsyncWebServerRequest* request);
+    void _dispatchBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+
+    // --- Admission Control ---
+    struct ClientBucket {
+        uint32_t ip;          // 0 for a free bucket
+        uint32_t milliTokens; // 1000 per token
+        uint32_t lastRefillMs;
+    };
+    ClientBucket _buckets[HTTP_TRACKED_CLIENTS];
+    uint8_t _expensiveInFlight; // only touched from the AsyncTCP task
+    uint32_t _throttledCount;
+    uint32_t _deferredCount;
+
+    struct BodySlot {
+        const AsyncWebServerRequest* owner; // nullptr for a free slot
+        uint32_t touchedMs;
+        char data[HTTP_BODY_SLOT_SIZE];
+    };
+    BodySlot _bodySlots[HTTP_BODY_SLOTS]; // only touched from the AsyncTCP task
+    uint32_t _bodyRefusedCount;
+
+    /**
+     * @brief Decides whether an API request may run, answering it with 429 or 503 and Retry-After otherwise.
+     * @details Runs once per request: from the middleware for requests without a body, and from _handleBody()
+     *          before any of the body is buffered for the others (body handlers run before the middleware).
+     */
+    bool _admitRequest(AsyncWebServerRequest* request);
+    /** @brief Takes @p cost tokens from the client's bucket, or gives the seconds until they are available. */
+    bool _takeTokens(uint32_t ip, uint8_t cost, uint32_t& retryAfterS);
+    static bool _isExpensive(const String& url);
+    void _sendRetryLater(AsyncWebServerRequest* request, int code, const char* body, uint32_t retryAfterS);
+    /**
+     * @brief Slot for the body of @p request, taken when its first chunk arrives.
+     * @details The request does not own the slot as it would a _tempObject, so a dropped connection cannot
+     *          free it: a slot left untouched for HTTP_BODY_STALE_MS is taken back instead.
+     */
+    BodySlot* _claimBodySlot(const AsyncWebServerRequest* request);
+    BodySlot* _findBodySlot(const AsyncWebServerRequest* request);
+
+    // --- WebSocket ---
+    struct WsSubscriber {
+        volatile uint32_t clientId; // 0 for a free slot
+        volatile uint8_t streams;   // WsStream_e flags
+    };
+    WsSubscriber _wsSubscribers[WS_MAX_CLIENTS];
+    portMUX_TYPE _wsSubscribersLock;
+
+    void _onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void _handleWsMessage(AsyncWebSocketClient* client, const uint8_t* data, size_t len);
+    /** @brief Adds (or removes, when @p subscribe is false) the named streams to the client's subscriptions. */
+    void _setWsSubscription(uint32_t clientId, JsonVariantConst streams, bool subscribe);
+    void _removeWsSubscriber(uint32_t clientId);
+    bool _hasWsSubscribers(uint8_t stream);
+    /** @brief Sends a telemetry message to the clients subscribed to @p stream. */
+    void _publishWs(uint8_t stream, const char* name, const char* payload);
    
 
-    // --- API Handlers ---
-    // Status
-    void _handleGetStatus(AsyncWebServerRequest* request);
-
+    // --- API Handlers (the others are in _api) ---
     // System
-    void _handleGetSystemInfo(AsyncWebServerRequest* request);
-    void _handleRestart(AsyncWebServerRequest* request);
-    void _handleFactoryReset(AsyncWebServerRequest* request);
-    void _handleSetTime(AsyncWebServerRequest* request, JsonDocument &doc);
-
-    // Settings
-    void _handleGetSettings(AsyncWebServerRequest* request);
-    void _handleUpdateSettings(AsyncWebServerRequest* request, JsonDocument& doc);
-    void _handleExportSettings(AsyncWebServerRequest* request);
-
-    // Tanks
-    void _handleGetTanks(AsyncWebServerRequest* request);
-    void _handleUpdateTank(AsyncWebServerRequest* request, JsonDocument& doc);
-    void _handleGetTankHistory(AsyncWebServerRequest* request);
-
-    // Scale
-    void _handleGetScale(AsyncWebServerRequest* request);
-    void _handleTareScale(AsyncWebServerRequest* request);
-    void _handleCalibrateScale(AsyncWebServerRequest* request, JsonDocument& doc);
-
-    // Feeding
-    void _handleFeedImmediate(AsyncWebServerRequest* request, JsonDocument& doc);
-    void _handleFeedRecipe(AsyncWebServerRequest* request, JsonDocument& doc);
-    void _handleGetFeedingHistory(AsyncWebServerRequest* request);
-    void _handleStopFeeding(AsyncWebServerRequest* request);
-
-    // Recipes
-    void _handleGetRecipes(AsyncWebServerRequest* request);
-    void _handleAddRecipe(AsyncWebServerRequest* request, JsonDocument& doc);
-    void _handleUpdateRecipe(AsyncWebServerRequest* request, JsonDocument& doc);
-    void _handleDeleteRecipe(AsyncWebServerRequest* request);
+    void _handleGetSystemInfo(ApiExchange& exchange);
+    void _handleRestart(ApiExchange& exchange);
+    void _handleFactoryReset(ApiExchange& exchange);
+    void _handleSetTime(ApiExchange& exchange, JsonDocument &doc);
+
+    // Scale trace
+    void _handleGetScaleTrace(ApiExchange& exchange);
+    void _handleArmScaleTrace(ApiExchange& exchange, JsonDocument& doc);
+    void _handleReplayScaleTrace(ApiExchange& exchange);
 
     // Diagnostics & Logs
-    void _handleGetSensorDiagnostics(AsyncWebServerRequest* request);
-    void _handleGetServoDiagnostics(AsyncWebServerRequest* request);
-    void _handleGetNetworkInfo(AsyncWebServerRequest* request);
-    void _handleGetSystemLogs(AsyncWebServerRequest* request);
-    void _handleGetFeedingLogs(AsyncWebServerRequest* request);
+    void _handleGetNetworkInfo(ApiExchange& exchange);
+#ifdef JITTER_BENCHMARK
+    void _handleGetJitterReport(ApiExchange& exchange);
+    void _handleResetJitter(ApiExchange& exchange);
+#endif
+    void _handleGetSystemLogs(ApiExchange& exchange);
+    void _handleGetFeedingLogs(ApiExchange& exchange);
 
     // OTA Update Handler
     void _onUpdate(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final);
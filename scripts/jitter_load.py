@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""Web load generator for the jitter benchmark build (-D JITTER_BENCHMARK).
+
+Measures how web load delays the real-time tasks of a device on the network:
+
+  1. DELETE /api/diagnostics/jitter, leave the device idle, then GET the report: the baseline.
+  2. DELETE again, apply the load, then GET the report under load.
+  3. Print both side by side, task by task, with the responses the load got.
+
+The load is made of clients polling /api/status, SSE subscribers on /api/events, and clients
+fetching large responses (feeding history, recipes, tanks) with gzip accepted. All of it comes
+from this host, so it shares one admission token bucket on the device: expect 429 and 503
+answers, which are counted and printed rather than retried.
+
+Python 3 standard library only:  python3 scripts/jitter_load.py 192.168.1.42 --duration 60
+"""
+
+import argparse
+import http.client
+import json
+import sys
+import threading
+import time
+from collections import Counter
+
+JITTER_PATH = "/api/diagnostics/jitter"
+DEFAULT_LARGE_PATHS = "/api/feeding/history,/api/recipes,/api/tanks"
+TIMEOUT_S = 10
+
+
+class LoadStats:
+    """Responses seen by one kind of load, shared by its threads."""
+
+    def __init__(self, name):
+        self.name = name
+        self.statuses = Counter()
+        self.bytes = 0
+        self.events = 0
+        self._lock = threading.Lock()
+
+    def record(self, status, size=0, events=0):
+        with self._lock:
+            self.statuses[status] += 1
+            self.bytes += size
+            self.events += events
+
+    def summary(self):
+        statuses = ", ".join("%s: %d" % (k, v) for k, v in sorted(self.statuses.items(), key=lambda kv: str(kv[0])))
+        line = "%-8s %s" % (self.name, statuses or "no response")
+        if self.bytes:
+            line += ", %.1f kB received" % (self.bytes / 1024.0)
+        if self.events:
+            line += ", %d events" % self.events
+        return line
+
+
+def request(host, port, method, path, headers=None):
+    """One request on its own connection: (status, body bytes, headers)."""
+    conn = http.client.HTTPConnection(host, port, timeout=TIMEOUT_S)
+    try:
+        conn.request(method, path, headers=headers or {})
+        response = conn.getresponse()
+        return response.status, response.read(), response
+    finally:
+        conn.close()
+
+
+def jitter_call(host, port, method, attempts=10):
+    """Jitter endpoint call, waiting out the admission control (it is an expensive request)."""
+    for _ in range(attempts):
+        status, body, response = request(host, port, method, JITTER_PATH)
+        if status == 200:
+            return json.loads(body) if method == "GET" else None
+        if status == 404:
+            sys.exit("%s not found: the firmware was not built with -D JITTER_BENCHMARK." % JITTER_PATH)
+        if status not in (429, 503):
+            sys.exit("%s %s answered %d: %s" % (method, JITTER_PATH, status, body[:200]))
+        time.sleep(float(response.getheader("Retry-After", "1")))
+    sys.exit("%s %s still refused after %d attempts." % (method, JITTER_PATH, attempts))
+
+
+def poll_status(host, port, interval, stop, stats):
+    while not stop.is_set():
+        try:
+            status, body, _ = request(host, port, "GET", "/api/status")
+            stats.record(status, len(body))
+        except (OSError, http.client.HTTPException) as e:
+            stats.record(type(e).__name__)
+        stop.wait(interval)
+
+
+def fetch_large(host, port, paths, stop, stats):
+    i = 0
+    while not stop.is_set():
+        path = paths[i % len(paths)]
+        i += 1
+        try:
+            status, body, response = request(host, port, "GET", path, {"Accept-Encoding": "gzip"})
+            stats.record(status, len(body))
+            if status in (429, 503):
+                stop.wait(float(response.getheader("Retry-After", "1")))
+        except (OSError, http.client.HTTPException) as e:
+            stats.record(type(e).__name__)
+            stop.wait(1)
+
+
+def subscribe_events(host, port, stop, stats):
+    while not stop.is_set():
+        conn = http.client.HTTPConnection(host, port, timeout=1)
+        try:
+            conn.request("GET", "/api/events", headers={"Accept": "text/event-stream"})
+            response = conn.getresponse()
+            stats.record(response.status)
+            if response.status != 200:
+                stop.wait(1)
+                continue
+            while not stop.is_set():
+                try:
+                    line = response.fp.readline()
+                except OSError:
+                    continue  # read timeout: no event this second
+                if not line:
+                    break  # closed by the device
+                stats.record("event", len(line), 1 if line.startswith(b"event:") else 0)
+                stats.statuses["event"] -= 1  # events are counted apart from the responses
+        except (OSError, http.client.HTTPException) as e:
+            stats.record(type(e).__name__)
+            stop.wait(1)
+        finally:
+            conn.close()
+
+
+def run_load(args):
+    stop = threading.Event()
+    stats = [LoadStats("status"), LoadStats("sse"), LoadStats("large")]
+    threads = []
+    for _ in range(args.pollers):
+        threads.append(threading.Thread(target=poll_status, args=(args.host, args.port, args.poll_interval, stop, stats[0])))
+    for _ in range(args.sse):
+        threads.append(threading.Thread(target=subscribe_events, args=(args.host, args.port, stop, stats[1])))
+    paths = [p for p in args.large_paths.split(",") if p]
+    for _ in range(args.large):
+        threads.append(threading.Thread(target=fetch_large, args=(args.host, args.port, paths, stop, stats[2])))
+    for thread in threads:
+        thread.daemon = True
+        thread.start()
+    try:
+        time.sleep(args.duration)
+    finally:
+        stop.set()
+        for thread in threads:
+            thread.join(TIMEOUT_S + 2)
+    for s in stats:
+        s.statuses.pop("event", None)
+    return stats
+
+
+def print_comparison(idle, loaded):
+    print()
+    print("Window: idle %.1f s, load %.1f s" % (idle.get("windowMs", 0) / 1000.0, loaded.get("windowMs", 0) / 1000.0))
+    load = loaded.get("load", {})
+    print("Server saw: %s SSE, %s WebSocket clients; throttled %s, deferred %s since boot"
+          % (load.get("sseClients", "?"), load.get("wsClients", "?"), load.get("throttled", "?"), load.get("deferred", "?")))
+    print()
+    columns = ("samples", "meanUs", "p50Us", "p99Us", "maxUs", "maxBusyUs")
+    print("%-16s %-6s" % ("task", "") + "".join("%12s" % c for c in columns))
+    idle_tasks = {t["name"]: t for t in idle.get("tasks", [])}
+    for task in loaded.get("tasks", []):
+        before = idle_tasks.get(task["name"], {})
+        print("%-16s %-6s" % (task["name"], "idle") + "".join("%12s" % before.get(c, "-") for c in columns))
+        print("%-16s %-6s" % ("", "load") + "".join("%12s" % task.get(c, "-") for c in columns))
+        deltas = []
+        for c in columns[1:]:
+            if isinstance(before.get(c), int) and isinstance(task.get(c), int):
+                deltas.append("%+12d" % (task[c] - before[c]))
+            else:
+                deltas.append("%12s" % "-")
+        print("%-16s %-6s" % ("", "delta") + "%12s" % "" + "".join(deltas))
+
+    edges = loaded.get("bucketUpperUs", [])
+    if edges:
+        print()
+        print("Histograms (lateness bucket upper edge in us, last bucket open-ended):")
+        labels = ["<%d" % e for e in edges] + [">=%d" % edges[-1]]
+        print("%-16s %-6s" % ("", "") + "".join("%9s" % l for l in labels))
+        for task in loaded.get("tasks", []):
+            before = idle_tasks.get(task["name"], {})
+            print("%-16s %-6s" % (task["name"], "idle") + "".join("%9d" % n for n in before.get("histogram", [])))
+            print("%-16s %-6s" % ("", "load") + "".join("%9d" % n for n in task.get("histogram", [])))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="device IP address or host name")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--duration", type=float, default=60, help="seconds of load (default 60)")
+    parser.add_argument("--idle", type=float, default=None, help="seconds of the idle baseline (default: --duration)")
+    parser.add_argument("--pollers", type=int, default=4, help="/api/status pollers (default 4)")
+    parser.add_argument("--poll-interval", type=float, default=0.25, help="seconds between two polls of a poller")
+    parser.add_argument("--sse", type=int, default=2, help="SSE subscribers on /api/events (default 2)")
+    parser.add_argument("--large", type=int, default=2, help="clients fetching large responses (default 2)")
+    parser.add_argument("--large-paths", default=DEFAULT_LARGE_PATHS, help="comma-separated paths the large clients cycle through")
+    args = parser.parse_args()
+
+    idle_s = args.duration if args.idle is None else args.idle
+    print("Idle baseline: %.0f s..." % idle_s)
+    jitter_call(args.host, args.port, "DELETE")
+    time.sleep(idle_s)
+    idle = jitter_call(args.host, args.port, "GET")
+
+    print("Load: %d status pollers, %d SSE subscribers, %d large-GET clients for %.0f s..."
+          % (args.pollers, args.sse, args.large, args.duration))
+    jitter_call(args.host, args.port, "DELETE")
+    stats = run_load(args)
+    # The report itself is admitted like any request: let this host's token bucket refill first
+    time.sleep(3)
+    loaded = jitter_call(args.host, args.port, "GET")
+
+    print()
+    print("Responses under load:")
+    for s in stats:
+        print("  " + s.summary())
+    print_comparison(idle, loaded)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,699 @@
+#include "ApiHandlers.hpp"
+#include "JsonFields.hpp"
+#include "Storage.hpp"
+#include "esp_log.h"
+#include <cmath>
+#include <string>
+#include <time.h>
+
+static const char* TAG = "ApiHandlers";
+
+/** @brief The user settings, as exchanged by the settings endpoints. */
+struct DeviceSettings {
+    std::string deviceName;
+    std::string timezone; // POSIX TZ string
+};
+
+static const JsonField SETTINGS_FIELD_ARRAY[] = {
+    JSON_FIELD_RANGED(DeviceSettings, deviceName, "deviceName", String, 0, 1.0, 1, 32, 0.0),
+    JSON_FIELD_RANGED(DeviceSettings, timezone, "timezone", String, 0, 1.0, 1, 63, 0.0),
+};
+static const JsonFieldList SETTINGS_FIELDS = JSON_FIELD_LIST(SETTINGS_FIELD_ARRAY);
+
+static void sendFieldError(ApiExchange& exchange, const JsonFieldError& error)
+{
+    char body[96];
+    error.toJson(body, sizeof(body));
+    ESP_LOGI(TAG, "Rejected request body: %s", body);
+    exchange.sendJson(400, body);
+}
+
+/** @brief Fills @p recipe from an API body, or answers 400 and returns false. */
+static bool readRecipeBody(ApiExchange& exchange, JsonDocument& doc, Recipe& recipe)
+{
+    JsonFields::reset(&recipe, Recipe::FIELDS);
+    JsonFieldError error = JsonFields::read(doc.as<JsonObjectConst>(), &recipe, Recipe::FIELDS, JsonFieldFormat::Api);
+    if (error) {
+        sendFieldError(exchange, error);
+        return false;
+    }
+
+    float totalPercent = 0;
+    for (const auto& ing : recipe.ingredients) {
+        totalPercent += ing.percentage;
+    }
+    if (fabs(totalPercent - 100.0) > 0.1) {
+        ESP_LOGI(TAG, "Recipe '%s': percentages must sum to 100 (got %.2f)", recipe.name.c_str(), totalPercent);
+        exchange.sendJson(400, "{\"error\":\"Percentages must sum to 100\"}");
+        return false;
+    }
+    return true;
+}
+
+ApiHandlers::ApiHandlers(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager, RecipeProcessor& recipeProcessor,
+  TankManager& tankManager)
+    : _deviceState(deviceState), _mutex(mutex), _configManager(configManager), _recipeProcessor(recipeProcessor), _tankManager(tankManager)
+{}
+
+// --- Status ---
+void ApiHandlers::getStatus(ApiExchange& exchange)
+{
+    JsonDocument doc;
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(200)) == pdTRUE) {
+        doc["battery"] = _deviceState.batteryLevel; // Integer (0-100). Current battery percentage.
+        doc["state"]
+          = static_cast<uint8_t>(_deviceState.operationState); // Integer. DeviceOperationState_e: 0=IDLE, 1=FEEDING, 2=ERROR, 3=CALIBRATING.
+        doc["lastFeedTime"] = _deviceState.lastFeedTime; // Integer. Unix timestamp of the last successful feed.
+        doc["lastRecipe"]   = _deviceState.lastRecipe.name; // String. Name of the recipe last used.
+        doc["event"]        = static_cast<uint8_t>(_deviceState.lastEvent); // Integer. DeviceEvent_e: 0=NONE, 1-9 for various events.
+        xSemaphoreGive(_mutex);
+    } else {
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
+        return;
+    }
+    exchange.sendJson(200, doc);
+}
+
+// --- Settings ---
+void ApiHandlers::getSettings(ApiExchange& exchange)
+{
+    JsonDocument doc;
+    DeviceSettings settings;
+    settings.timezone = _configManager.loadTimezone();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        settings.deviceName = _deviceState.deviceName;
+        JsonFields::write(doc.to<JsonObject>(), &settings, SETTINGS_FIELDS, JsonFieldFormat::Api);
+        doc["wifiStrength"] = _deviceState.wifiStrength;
+        doc["safetyMode"]   = _deviceState.safetyModeEngaged;
+        // These are placeholders as they are not yet in DeviceState
+        doc["autoRefillAlerts"]                = true;
+        JsonObject feedingSettings             = doc["feedingSettings"].to<JsonObject>();
+        feedingSettings["timeOfFirstServing"]  = "08:30";
+        feedingSettings["minTimeBetweenFeeds"] = 300;
+        xSemaphoreGive(_mutex);
+    } else {
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
+        return;
+    }
+    exchange.sendJson(200, doc);
+}
+
+void ApiHandlers::updateSettings(ApiExchange& exchange, JsonDocument& doc)
+{
+    DeviceSettings settings;
+    JsonFieldError error = JsonFields::read(doc.as<JsonObjectConst>(), &settings, SETTINGS_FIELDS, JsonFieldFormat::Api);
+    if (error) {
+        sendFieldError(exchange, error);
+        return;
+    }
+
+    if (!doc["deviceName"].isNull()) {
+        if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+            _deviceState.deviceName = settings.deviceName;
+            xSemaphoreGive(_mutex);
+        }
+    }
+    if (!doc["timezone"].isNull()) {
+        _configManager.saveTimezone(settings.timezone);
+    }
+
+    // Add logic for other settings as they are implemented
+
+    exchange.sendJson(200, "{\"success\":true}");
+}
+
+void ApiHandlers::exportSettings(ApiExchange& exchange)
+{
+    JsonDocument doc;
+
+    // Settings
+    DeviceSettings settings;
+    settings.timezone = _configManager.loadTimezone();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        settings.deviceName = _deviceState.deviceName;
+        xSemaphoreGive(_mutex);
+    }
+    JsonFields::write(doc["settings"].to<JsonObject>(), &settings, SETTINGS_FIELDS, JsonFieldFormat::Api);
+
+    // Tanks
+    JsonArray tanks = doc["tanks"].to<JsonArray>();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        for (const auto& tank : _deviceState.connectedTanks) {
+            JsonFields::write(tanks.add<JsonObject>(), &tank, TankInfo::FIELDS, JsonFieldFormat::Api);
+        }
+        xSemaphoreGive(_mutex);
+    }
+
+    // Recipes
+    JsonArray recipes = doc["recipes"].to<JsonArray>();
+    for (const auto& recipe : _recipeProcessor.getRecipes()) {
+        JsonFields::write(recipes.add<JsonObject>(), &recipe, Recipe::FIELDS, JsonFieldFormat::Api);
+    }
+
+    exchange.sendJson(200, doc, true);
+}
+
+// --- Tanks ---
+void ApiHandlers::getTanks(ApiExchange& exchange)
+{
+    JsonDocument doc;
+    JsonArray tanksArray = doc.to<JsonArray>();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        ESP_LOGI(TAG, "getTanks: _deviceState.connectedTanks.size==%d", _deviceState.connectedTanks.size());
+        for (const auto& tank : _deviceState.connectedTanks) {
+            JsonObject tankObj = tanksArray.add<JsonObject>();
+            JsonFields::write(tankObj, &tank, TankInfo::FIELDS, JsonFieldFormat::Api);
+            tankObj["lastDispensed"]  = 0;
+            tankObj["totalDispensed"] = 0;
+        }
+        xSemaphoreGive(_mutex);
+    } else {
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
+        return;
+    }
+    exchange.sendJson(200, doc);
+}
+
+void ApiHandlers::updateTank(ApiExchange& exchange, uint64_t uid, JsonDocument& doc)
+{
+    // 1. The router has already validated the UID of the path.
+    ESP_LOGI(TAG, "updateTank invoked for %llX", (unsigned long long)uid);
+
+    // 2. Create a TankInfo object to hold the new data.
+    // We must first read the existing data to have a complete object to modify.
+    TankInfo tankToUpdate;
+    tankToUpdate.uid = uid;
+
+    if (!_tankManager.refreshTankInfo(tankToUpdate)) {
+        exchange.sendJson(404, "{\"error\":\"Tank not found\"}");
+        return;
+    }
+
+    // 3. Populate the TankInfo object from the JSON document.
+    // The JSON might only contain a subset of fields: the others keep the values just read.
+    if (doc["density"].isNull() && !doc["kibbleDensity"].isNull()) {
+        doc["density"] = doc["kibbleDensity"]; // Former name of the field
+    }
+    double previousDensity = tankToUpdate.kibbleDensity;
+    JsonFieldError error = JsonFields::read(doc.as<JsonObjectConst>(), &tankToUpdate, TankInfo::FIELDS, JsonFieldFormat::Api);
+    if (error) {
+        sendFieldError(exchange, error);
+        return;
+    }
+    if (tankToUpdate.kibbleDensity != previousDensity) {
+        // A density entered by hand replaces the measured one, the auger flow stays valid
+        tankToUpdate.densitySource  = tankToUpdate.kibbleDensity > 0 ? DensitySource::USER : DensitySource::NONE;
+        tankToUpdate.densitySamples = 0;
+    }
+
+    // 4. Commit the changes using the full-featured TankManager method.
+    if (_tankManager.commitTankInfo(tankToUpdate)) {
+        exchange.sendJson(200, "{\"success\":true}");
+        // Print updated tank info for debugging using ESP_LOGI
+        ESP_LOGI(TAG, "Tank %llX updated: name=%s, remainingWeightGrams=%.2fg, capacity=%.2f L, kibbleDensity=%.2f kg/L, servoIdlePwm=%d",
+          (unsigned long long)tankToUpdate.uid, tankToUpdate.name.c_str(), tankToUpdate.remaining_weight_grams, tankToUpdate.capacityLiters,
+          tankToUpdate.kibbleDensity, tankToUpdate.servoIdlePwm);
+    } else {
+        // This could fail if the tank was disconnected between the check and the commit.
+        exchange.sendJson(500, "{\"error\":\"Failed to write update to tank EEPROM\"}");
+    }
+}
+
+void ApiHandlers::getTankHistory(ApiExchange& exchange, uint64_t tankUid)
+{
+    JsonDocument doc;
+    JsonArray historyArray = doc.to<JsonArray>();
+
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        for (const auto& entry : _deviceState.feedingHistory) {
+            // This is a simplified implementation. A real implementation would need to check
+            // if the tank was part of the recipe or immediate feed.
+            JsonObject entryObj    = historyArray.add<JsonObject>();
+            entryObj["timestamp"]  = entry.timestamp;
+            entryObj["amount"]     = entry.amount;
+            entryObj["recipeUid"]  = entry.recipeUid;
+            entryObj["recipeName"] = entry.description;
+        }
+        xSemaphoreGive(_mutex);
+    } else {
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
+        return;
+    }
+
+    exchange.sendJson(200, doc, true);
+}
+
+void ApiHandlers::calibrateDensity(ApiExchange& exchange, uint64_t tankUid)
+{
+    ApiResult result = commandCalibrateDensity(tankUid);
+    exchange.sendJson(result.status, result.body);
+}
+
+// --- Scale ---
+void ApiHandlers::getScale(ApiExchange& exchange)
+{
+    JsonDocument doc;
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        doc["rawValue"]  = _deviceState.currentRawValue;
+        doc["weight"]    = _deviceState.currentWeight;
+        doc["stable"]    = _deviceState.isWeightStable;
+        doc["timestamp"] = _deviceState.currentTime;
+        JsonObject bowl  = doc["bowl"].to<JsonObject>();
+        bowl["rawValue"]   = _deviceState.bowlRawValue;
+        bowl["weight"]     = _deviceState.bowlWeight;
+        bowl["stable"]     = _deviceState.isBowlWeightStable;
+        bowl["responding"] = _deviceState.isBowlScaleResponding;
+        xSemaphoreGive(_mutex);
+    } else {
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
+        return;
+    }
+    exchange.sendJson(200, doc);
+}
+
+void ApiHandlers::tareScale(ApiExchange& exchange)
+{
+    ApiResult result = commandTareScale();
+    exchange.sendJson(result.status, result.body);
+}
+
+void ApiHandlers::calibrateScale(ApiExchange& exchange, JsonDocument& doc)
+{
+    if (doc["knownWeight"].isNull()) {
+        exchange.sendJson(400, "{\"error\":\"Missing knownWeight\"}");
+        return;
+    }
+    float knownWeight    = doc["knownWeight"];
+    ScaleChannel channel = ScaleChannel::HOPPER;
+    if (!doc["channel"].isNull()) {
+        std::string channelName = doc["channel"].as<std::string>();
+        if (channelName == "bowl") {
+            channel = ScaleChannel::BOWL;
+        } else if (channelName != "hopper") {
+            exchange.sendJson(400, "{\"error\":\"Invalid channel\"}");
+            return;
+        }
+    }
+    float newFactor = _recipeProcessor.getScale().calibrateWithKnownWeight(knownWeight, channel);
+
+    JsonDocument responseDoc;
+    responseDoc["success"]              = true;
+    responseDoc["newCalibrationFactor"] = newFactor;
+    responseDoc["message"]              = "Scale calibrated";
+
+    exchange.sendJson(200, responseDoc);
+}
+
+// --- Feeding ---
+void ApiHandlers::feedImmediate(ApiExchange& exchange, uint64_t tankUid, JsonDocument& doc)
+{
+    ApiResult result = commandFeedImmediate(tankUid, doc["amount"]);
+    exchange.sendJson(result.status, result.body);
+}
+
+void ApiHandlers::feedRecipe(ApiExchange& exchange, uint32_t recipeUid, JsonDocument& doc)
+{
+    ApiResult result = commandFeedRecipe(recipeUid, doc["servings"] | 1); // Default to 1 serving
+    exchange.sendJson(result.status, result.body);
+}
+
+void ApiHandlers::stopFeeding(ApiExchange& exchange)
+{
+    ApiResult result = commandStopFeeding();
+    exchange.sendJson(result.status, result.body);
+}
+
+void ApiHandlers::getFeedingHistory(ApiExchange& exchange)
+{
+    JsonDocument doc;
+    JsonArray historyArray = doc.to<JsonArray>();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        for (const auto& entry : _deviceState.feedingHistory) {
+            JsonObject entryObj   = historyArray.add<JsonObject>();
+            entryObj["timestamp"] = entry.timestamp;
+            entryObj["type"]      = entry.type;
+            if (entry.recipeUid != 0) {
+                entryObj["recipeUid"] = entry.recipeUid;
+            }
+            entryObj["success"] = entry.success;
+            entryObj["amount"]  = entry.amount;
+        }
+        xSemaphoreGive(_mutex);
+    } else {
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
+        return;
+    }
+    exchange.sendJson(200, doc, true);
+}
+
+void ApiHandlers::getMealSchedule(ApiExchange& exchange)
+{
+    static const char* const stateNames[] = { "none", "pending", "held", "residual" };
+    StagingStatus status = _recipeProcessor.getStagingStatus();
+
+    JsonDocument doc;
+    doc["state"] = stateNames[(uint8_t)status.state];
+    if (status.scheduled) {
+        JsonObject meal   = doc["meal"].to<JsonObject>();
+        meal["recipeUid"] = status.recipeUid;
+        meal["servings"]  = status.servings;
+        meal["time"]      = status.mealTime;
+        meal["leadTime"]  = status.leadTimeS;
+    }
+    if (status.stagedAt != 0) {
+        doc["stagedGrams"] = status.stagedGrams;
+        doc["stagedAt"]    = status.stagedAt;
+    }
+    JsonObject last       = doc["lastFeed"].to<JsonObject>();
+    last["firstKibbleMs"] = status.lastFirstKibbleMs;
+    last["staged"]        = status.lastFeedWasStaged;
+
+    exchange.sendJson(200, doc);
+}
+
+void ApiHandlers::setMealSchedule(ApiExchange& exchange, JsonDocument& doc)
+{
+    uint32_t recipeUid = doc["recipeUid"] | 0;
+    int servings       = doc["servings"] | 1;
+    long long mealTime = doc["time"] | 0LL;
+    uint32_t leadTime  = doc["leadTime"] | STAGING_DEFAULT_LEAD_S;
+    time_t now         = time(nullptr);
+
+    if (recipeUid == 0 || servings < 1) {
+        exchange.sendJson(400, "{\"error\":\"Invalid recipeUid or servings\"}");
+        return;
+    }
+    if (leadTime > STAGING_MAX_LEAD_S) {
+        exchange.sendJson(400, "{\"error\":\"leadTime too long\"}");
+        return;
+    }
+    if (now < STAGING_MIN_VALID_TIME) {
+        exchange.sendJson(409, "{\"error\":\"Clock not set\"}");
+        return;
+    }
+    if (mealTime <= now) {
+        exchange.sendJson(400, "{\"error\":\"time must be in the future\"}");
+        return;
+    }
+
+    if (_recipeProcessor.scheduleMeal(recipeUid, servings, (time_t)mealTime, leadTime)) {
+        exchange.sendJson(200, "{\"success\":true}");
+    } else {
+        exchange.sendJson(404, "{\"error\":\"Recipe not found\"}");
+    }
+}
+
+void ApiHandlers::cancelMealSchedule(ApiExchange& exchange)
+{
+    _recipeProcessor.cancelScheduledMeal();
+    exchange.sendJson(200, "{\"success\":true}");
+}
+
+// --- Recipes ---
+void ApiHandlers::getRecipes(ApiExchange& exchange)
+{
+    std::vector<Recipe> recipes = _recipeProcessor.getRecipes();
+    JsonDocument doc;
+    JsonArray recipesArray = doc.to<JsonArray>();
+    for (const auto& recipe : recipes) {
+        JsonFields::write(recipesArray.add<JsonObject>(), &recipe, Recipe::FIELDS, JsonFieldFormat::Api);
+    }
+    exchange.sendJson(200, doc);
+}
+
+void ApiHandlers::addRecipe(ApiExchange& exchange, JsonDocument& doc)
+{
+#if ESP_LOG_LEVEL >= ESP_LOG_INFO && !defined(LOG_TO_FILE_ENABLED)
+    {
+        std::string payload;
+        serializeJson(doc, payload);
+        ESP_LOGI(TAG, "addRecipe: payload=%s", payload.c_str());
+    }
+#endif
+
+    Recipe recipe;
+    if (!readRecipeBody(exchange, doc, recipe)) {
+        return;
+    }
+
+    if (_recipeProcessor.addRecipe(recipe)) {
+        exchange.sendJson(200, "{\"success\":true}");
+    } else {
+        ESP_LOGI(TAG, "addRecipe: Failed to save recipe '%s'", recipe.name.c_str());
+        exchange.sendJson(500, "{\"error\":\"Failed to save recipe\"}");
+    }
+}
+
+void ApiHandlers::updateRecipe(ApiExchange& exchange, uint32_t recipeUid, JsonDocument& doc)
+{
+#if ESP_LOG_LEVEL >= ESP_LOG_INFO && !defined(LOG_TO_FILE_ENABLED)
+    {
+        std::string payload;
+        serializeJson(doc, payload);
+        ESP_LOGI(TAG, "updateRecipe: payload=%s", payload.c_str());
+    }
+#endif
+
+    if (recipeUid == 0) {
+        ESP_LOGI(TAG, "updateRecipe: Invalid recipeUid %u", recipeUid);
+        exchange.sendJson(400, "{\"error\":\"Invalid recipeUid\"}");
+        return;
+    }
+
+    Recipe recipe;
+    if (!readRecipeBody(exchange, doc, recipe)) {
+        return;
+    }
+    recipe.uid = recipeUid;
+
+    if (_recipeProcessor.updateRecipe(recipe)) {
+        exchange.sendJson(200, "{\"success\":true}");
+    } else {
+        ESP_LOGI(TAG, "updateRecipe: Recipe not found for recipeUid %u", recipeUid);
+        exchange.sendJson(404, "{\"error\":\"Recipe not found\"}");
+    }
+}
+
+void ApiHandlers::deleteRecipe(ApiExchange& exchange, uint32_t recipeUid)
+{
+    if (recipeUid == 0) {
+        exchange.sendJson(400, "{\"error\":\"Invalid recipeUid\"}");
+        return;
+    }
+
+    if (_recipeProcessor.deleteRecipe(recipeUid)) {
+        exchange.sendJson(200, "{\"success\":true}");
+    } else {
+        exchange.sendJson(404, "{\"error\":\"Recipe not found\"}");
+    }
+}
+
+// --- Servos ---
+void ApiHandlers::jogServo(ApiExchange& exchange, JsonDocument& doc)
+{
+    ApiResult result = commandJogServo(doc["servo"], doc["pwm"]);
+    exchange.sendJson(result.status, result.body);
+}
+
+// --- Diagnostics ---
+void ApiHandlers::getSensorDiagnostics(ApiExchange& exchange)
+{
+    JsonDocument doc;
+
+    // Scale
+    JsonObject scale = doc["scale"].to<JsonObject>();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        scale["weight"]   = _deviceState.currentWeight;
+        scale["rawValue"] = _deviceState.currentRawValue;
+        scale["stable"]   = _deviceState.isWeightStable;
+        scale["duty"]     = HX711Scale::getDutyLevelName(_recipeProcessor.getScale().getDutyLevel());
+        JsonObject bowl   = doc["bowlScale"].to<JsonObject>();
+        bowl["weight"]     = _deviceState.bowlWeight;
+        bowl["rawValue"]   = _deviceState.bowlRawValue;
+        bowl["stable"]     = _deviceState.isBowlWeightStable;
+        bowl["responding"] = _deviceState.isBowlScaleResponding;
+        xSemaphoreGive(_mutex);
+    }
+
+    // Tank Levels
+    JsonArray tankLevels = doc["tankLevels"].to<JsonArray>();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        for (const auto& tank : _deviceState.connectedTanks) {
+            JsonObject tankLevel              = tankLevels.add<JsonObject>();
+            tankLevel["uid"]                  = tank.uid;
+            tankLevel["remainingWeightGrams"] = tank.remaining_weight_grams;
+            tankLevel["sensorType"]           = "estimation";
+            if (tank.busIndex >= 0) {
+                TankScrubStats stats = _tankManager.getScrubStats(tank.busIndex);
+                if (stats.uid != tank.uid)
+                    stats = TankScrubStats(); // not scrubbed yet
+                JsonObject eeprom        = tankLevel["eeprom"].to<JsonObject>();
+                eeprom["scrubs"]         = stats.scrubs;
+                eeprom["correctedBytes"] = stats.correctedBytes;
+                eeprom["rowsRewritten"]  = stats.rowsRewritten;
+                eeprom["uncorrectable"]  = stats.uncorrectable;
+                eeprom["readFailures"]   = stats.readFailures;
+                eeprom["errorRate"]      = stats.errorRate();
+            }
+        }
+        xSemaphoreGive(_mutex);
+    }
+
+    // Data partition
+    JsonObject storageDiag      = doc["storage"].to<JsonObject>();
+    storageDiag["backend"]      = Storage::getBackendName(storage.getBackend());
+    storageDiag["migration"]    = Storage::getMigrationName(storage.getMigration());
+    storageDiag["totalBytes"]   = storage.totalBytes();
+    storageDiag["usedBytes"]    = storage.usedBytes();
+    storageDiag["openLatencyUs"] = storage.getOpenLatencyUs();
+
+    // Placeholders for other sensors
+    doc["temperature"] = 23.5;
+    doc["humidity"]    = 45.2;
+
+    exchange.sendJson(200, doc);
+}
+
+void ApiHandlers::getServoDiagnostics(ApiExchange& exchange)
+{
+    // Positions are the last commanded pulse widths; the servos give no feedback.
+    std::vector<ServoPhaseSlot> schedule = _tankManager.getServoSchedule();
+    JsonDocument doc;
+    JsonArray tanks = doc["tanks"].to<JsonArray>();
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        for (const auto& tank : _deviceState.connectedTanks) {
+            JsonObject tankDiag   = tanks.add<JsonObject>();
+            tankDiag["uid"]       = tank.uid;
+            tankDiag["connected"] = tank.busIndex > -1;
+            if (tank.busIndex > -1 && tank.busIndex < TOTAL_SERVO_COUNT) {
+                tankDiag["currentPosition"] = schedule[tank.busIndex].pulseUs;
+                tankDiag["phaseOnTick"]     = schedule[tank.busIndex].onTick;
+            }
+        }
+        xSemaphoreGive(_mutex);
+    }
+
+    JsonObject hopper         = doc["hopper"].to<JsonObject>();
+    hopper["connected"]       = true;
+    hopper["currentPosition"] = schedule[HOPPER_SERVO_INDEX].pulseUs;
+    hopper["phaseOnTick"]     = schedule[HOPPER_SERVO_INDEX].onTick;
+
+    // Full pulse schedule of the PCA9685 frame
+    JsonArray slots = doc["schedule"].to<JsonArray>();
+    for (const auto& slot : schedule) {
+        JsonObject entry = slots.add<JsonObject>();
+        entry["channel"] = slot.servoNum;
+        entry["onTick"]  = slot.onTick;
+        entry["offTick"] = slot.offTick;
+        entry["pulseUs"] = slot.pulseUs;
+    }
+    doc["frameTicks"] = SERVO_PWM_FRAME_TICKS;
+
+    exchange.sendJson(200, doc);
+}
+
+// --- Commands ---
+// Shared by the REST handlers and the WebSocket, which only differ in how they carry arguments and results.
+
+ApiResult ApiHandlers::commandFeedImmediate(uint64_t tankUid, JsonVariantConst amount)
+{
+    if (amount.isNull() || !amount.is<float>() || amount.as<float>() <= 0)
+        return { 400, "{\"error\":\"Invalid or missing amount\"}" };
+
+    ApiResult result = { 503, "{\"error\":\"Could not acquire state lock\"}" };
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        if (_deviceState.feedCommand.processed) {
+            _deviceState.feedCommand.type        = FeedCommandType::IMMEDIATE;
+            _deviceState.feedCommand.tankUid     = tankUid;
+            _deviceState.feedCommand.amountGrams = amount.as<float>();
+            _deviceState.feedCommand.processed   = false;
+            result = { 202, "{\"success\":true, \"message\":\"Immediate feed command accepted\"}" };
+        } else {
+            result = { 429, "{\"error\":\"Device busy\"}" };
+        }
+        xSemaphoreGive(_mutex);
+    }
+    return result;
+}
+
+ApiResult ApiHandlers::commandFeedRecipe(uint32_t recipeUid, int servings)
+{
+    if (recipeUid == 0)
+        return { 400, "{\"error\":\"Invalid recipeUid\"}" };
+
+    ApiResult result = { 503, "{\"error\":\"Could not acquire state lock\"}" };
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        if (_deviceState.feedCommand.processed) {
+            _deviceState.feedCommand.type      = FeedCommandType::RECIPE;
+            _deviceState.feedCommand.recipeUid = recipeUid;
+            _deviceState.feedCommand.servings  = servings;
+            _deviceState.feedCommand.processed = false;
+            result = { 202, "{\"success\":true, \"message\":\"Recipe feed command accepted\"}" };
+        } else {
+            result = { 429, "{\"error\":\"Device busy\"}" };
+        }
+        xSemaphoreGive(_mutex);
+    }
+    return result;
+}
+
+ApiResult ApiHandlers::commandStopFeeding()
+{
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) != pdTRUE)
+        return { 503, "{\"error\":\"Could not acquire state lock\"}" };
+    _deviceState.feedCommand.type      = FeedCommandType::EMERGENCY_STOP;
+    _deviceState.feedCommand.processed = false;
+    xSemaphoreGive(_mutex);
+    return { 202, "{\"success\":true, \"message\":\"Stop command accepted\"}" };
+}
+
+ApiResult ApiHandlers::commandTareScale()
+{
+    ApiResult result = { 503, "{\"error\":\"Could not acquire state lock\"}" };
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        if (_deviceState.feedCommand.processed) {
+            _deviceState.feedCommand.type      = FeedCommandType::TARE_SCALE;
+            _deviceState.feedCommand.processed = false;
+            result = { 202, "{\"success\":true, \"message\":\"Tare command accepted\"}" };
+        } else {
+            result = { 429, "{\"error\":\"Device busy\"}" };
+        }
+        xSemaphoreGive(_mutex);
+    }
+    return result;
+}
+
+ApiResult ApiHandlers::commandCalibrateDensity(uint64_t tankUid)
+{
+    ApiResult result = { 503, "{\"error\":\"Could not acquire state lock\"}" };
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        if (_deviceState.feedCommand.processed) {
+            _deviceState.feedCommand.type      = FeedCommandType::CALIBRATE_DENSITY;
+            _deviceState.feedCommand.tankUid   = tankUid;
+            _deviceState.feedCommand.processed = false;
+            result = { 202, "{\"success\":true, \"message\":\"Density calibration command accepted\"}" };
+        } else {
+            result = { 429, "{\"error\":\"Device busy\"}" };
+        }
+        xSemaphoreGive(_mutex);
+    }
+    return result;
+}
+
+ApiResult ApiHandlers::commandJogServo(JsonVariantConst servo, JsonVariantConst pwm)
+{
+    if (!servo.is<int>() || servo.as<int>() < 0 || servo.as<int>() >= TOTAL_SERVO_COUNT)
+        return { 400, "{\"error\":\"Invalid or missing servo\"}" };
+    if (!pwm.is<int>() || (pwm.as<int>() != 0 && (pwm.as<int>() < SERVO_JOG_MIN_PWM || pwm.as<int>() > SERVO_JOG_MAX_PWM)))
+        return { 400, "{\"error\":\"Invalid or missing pwm\"}" };
+    // The feeding task owns the servos while it dispenses.
+    if (_tankManager.isFeedingActive())
+        return { 409, "{\"error\":\"Feeding in progress\"}" };
+
+    PCA9685::I2C_Result_e rez = _tankManager.jogServo((uint8_t)servo.as<int>(), (uint16_t)pwm.as<int>());
+    if (rez == PCA9685::I2C_Result_e::I2C_Timeout)
+        return { 503, "{\"error\":\"Servo bus busy\"}" };
+    if (rez != PCA9685::I2C_Result_e::I2C_Ok)
+        return { 500, "{\"error\":\"Servo command failed\"}" };
+    return { 200, "{\"success\":true}" };
+}
@@ -0,0 +1,166 @@
+#include "ApiRouter.hpp"
+#include <cstring>
+
+ApiRouter::ApiRouter() : _routeCount(0)
+{
+    Node root;
+    root.type        = SegmentType::LITERAL;
+    root.firstChild  = -1;
+    root.nextSibling = -1;
+    for (auto& route : root.routes)
+        route = NO_ROUTE;
+    _nodes.push_back(root);
+}
+
+int16_t ApiRouter::_findOrAddChild(int16_t parent, const char* segment, size_t len)
+{
+    SegmentType type = SegmentType::LITERAL;
+    if (len == 5 && memcmp(segment, "{hex}", 5) == 0)
+        type = SegmentType::HEX_PARAM;
+    else if (len == 6 && memcmp(segment, "{uint}", 6) == 0)
+        type = SegmentType::UINT_PARAM;
+    else if (memchr(segment, '{', len) != nullptr || memchr(segment, '}', len) != nullptr)
+        return -1; // unknown parameter type
+
+    int16_t last = -1;
+    for (int16_t child = _nodes[parent].firstChild; child != -1; child = _nodes[child].nextSibling) {
+        const Node& node = _nodes[child];
+        if (node.type == type && (type != SegmentType::LITERAL || (node.literal.size() == len && memcmp(node.literal.data(), segment, len) == 0)))
+            return child;
+        last = child;
+    }
+
+    Node node;
+    node.type        = type;
+    node.firstChild  = -1;
+    node.nextSibling = -1;
+    if (type == SegmentType::LITERAL)
+        node.literal.assign(segment, len);
+    for (auto& route : node.routes)
+        route = NO_ROUTE;
+    int16_t index = (int16_t)_nodes.size();
+    _nodes.push_back(node);
+    if (last == -1)
+        _nodes[parent].firstChild = index;
+    else
+        _nodes[last].nextSibling = index;
+    return index;
+}
+
+int ApiRouter::add(const char* pathTemplate, RouteMethod method)
+{
+    if (pathTemplate == nullptr || pathTemplate[0] != '/' || method >= RouteMethod::COUNT)
+        return NO_ROUTE;
+
+    int16_t node      = 0;
+    uint8_t params    = 0;
+    const char* start = pathTemplate;
+    while (*start) {
+        while (*start == '/')
+            start++;
+        if (*start == '\0')
+            break;
+        const char* end = start;
+        while (*end && *end != '/')
+            end++;
+        node = _findOrAddChild(node, start, end - start);
+        if (node < 0)
+            return NO_ROUTE;
+        if (_nodes[node].type != SegmentType::LITERAL && ++params > ROUTER_MAX_PARAMS)
+            return NO_ROUTE;
+        start = end;
+    }
+
+    int16_t& route = _nodes[node].routes[(uint8_t)method];
+    if (route != NO_ROUTE)
+        return NO_ROUTE;
+    route = _routeCount++;
+    return route;
+}
+
+bool ApiRouter::_parseParam(SegmentType type, const char* segment, size_t len, uint64_t& value)
+{
+    value = 0;
+    if (type == SegmentType::HEX_PARAM) {
+        if (len == 0 || len > 16)
+            return false;
+        for (size_t i = 0; i < len; i++) {
+            char c = segment[i];
+            uint8_t digit;
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if (c >= 'a' && c <= 'f')
+                digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                digit = c - 'A' + 10;
+            else
+                return false;
+            value = (value << 4) | digit;
+        }
+        return true;
+    }
+    if (type == SegmentType::UINT_PARAM) {
+        if (len == 0 || len > 10)
+            return false;
+        for (size_t i = 0; i < len; i++) {
+            if (segment[i] < '0' || segment[i] > '9')
+                return false;
+            value = value * 10 + (segment[i] - '0');
+        }
+        return value <= 0xFFFFFFFFULL;
+    }
+    return false;
+}
+
+int16_t ApiRouter::_matchFrom(int16_t node, const char* path, const char* end, RouteParams& params) const
+{
+    while (path < end && *path == '/')
+        path++;
+    if (path == end) {
+        // Path consumed: only a node some route ends on is a match.
+        for (int16_t route : _nodes[node].routes) {
+            if (route != NO_ROUTE)
+                return node;
+        }
+        return -1;
+    }
+
+    const char* segmentEnd = path;
+    while (segmentEnd < end && *segmentEnd != '/')
+        segmentEnd++;
+    size_t len = segmentEnd - path;
+
+    // Literals take precedence over parameters: "/api/scale/trace" never reaches a "{uint}" sibling.
+    for (int16_t child = _nodes[node].firstChild; child != -1; child = _nodes[child].nextSibling) {
+        const Node& candidate = _nodes[child];
+        if (candidate.type == SegmentType::LITERAL && candidate.literal.size() == len && memcmp(candidate.literal.data(), path, len) == 0) {
+            int16_t found = _matchFrom(child, segmentEnd, end, params);
+            if (found >= 0)
+                return found;
+        }
+    }
+    for (int16_t child = _nodes[node].firstChild; child != -1; child = _nodes[child].nextSibling) {
+        const Node& candidate = _nodes[child];
+        uint64_t value;
+        if (candidate.type == SegmentType::LITERAL || params.count >= ROUTER_MAX_PARAMS || !_parseParam(candidate.type, path, len, value))
+            continue;
+        params.values[params.count++] = value;
+        int16_t found = _matchFrom(child, segmentEnd, end, params);
+        if (found >= 0)
+            return found;
+        params.count--;
+    }
+    return -1;
+}
+
+int ApiRouter::match(const char* path, size_t len, RouteMethod method, RouteParams& params) const
+{
+    params.count = 0;
+    if (path == nullptr || method >= RouteMethod::COUNT)
+        return NO_ROUTE;
+    int16_t node = _matchFrom(0, path, path + len, params);
+    if (node < 0)
+        return NO_ROUTE;
+    int16_t route = _nodes[node].routes[(uint8_t)method];
+    return route != NO_ROUTE ? route : METHOD_NOT_ALLOWED;
+}
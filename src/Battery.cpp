@@ -17,8 +17,11 @@
  */
 
 #include "Battery.h"
+#include "esp_log.h"
 #include <math.h>
 
+static const char* TAG = "Battery";
+
 uint8_t linear(uint16_t voltage, uint16_t minVoltage, uint16_t maxVoltage)
 {
     if (voltage <= minVoltage) {
@@ -63,6 +66,10 @@ Battery::Battery(uint16_t minVoltage, uint16_t maxVoltage, uint8_t sensePin, uin
     _refVoltage    = 5000;
     _dividerRatio  = 1.0;
     _activationPin = 0;
+    _mapFunc       = 0;
+    _continuous    = false;
+    _adcChannel    = 0;
+    _lastSample    = 0;
 
     _averaging_samples = averaging_samples;
     if (_averaging_samples > 0) {
@@ -91,6 +98,85 @@ void Battery::begin(uint16_t refVoltage, float dividerRatio, mapFn_t mapFunc)
     _dividerRatio = dividerRatio;
     _mapFunc      = mapFunc;
     pinMode(_sensePin, INPUT);
+    _continuous = _startContinuous();
+}
+
+bool Battery::_startContinuous()
+{
+    int8_t channel = digitalPinToAnalogChannel(_sensePin);
+    if (channel < 0 || channel > 7) {
+        ESP_LOGW(TAG, "GPIO %d is not on ADC1, falling back to analogRead().", _sensePin);
+        return false;
+    }
+    _adcChannel = (uint8_t)channel;
+
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size     = BATTERY_ADC_POOL_BYTES;
+    initConfig.conv_num_each_intr     = BATTERY_ADC_FRAME_BYTES;
+    initConfig.adc1_chan_mask         = BIT(_adcChannel);
+    esp_err_t err                     = adc_digi_initialize(&initConfig);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Continuous ADC init failed (%s), falling back to analogRead().", esp_err_to_name(err));
+        return false;
+    }
+
+    adc_digi_pattern_config_t pattern = {};
+    pattern.atten                     = ADC_ATTEN_DB_11; // Full range, as analogRead()
+    pattern.channel                   = _adcChannel;
+    pattern.unit                      = 0; // ADC1
+    pattern.bit_width                 = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en            = true; // Required on the ESP32
+    config.conv_limit_num           = 250;
+    config.pattern_num              = 1;
+    config.adc_pattern              = &pattern;
+    config.sample_freq_hz           = BATTERY_ADC_SAMPLE_HZ;
+    config.conv_mode                = ADC_CONV_SINGLE_UNIT_1;
+    config.format                   = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    err                             = adc_digi_controller_configure(&config);
+    if (err == ESP_OK)
+        err = adc_digi_start();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Continuous ADC start failed (%s), falling back to analogRead().", esp_err_to_name(err));
+        adc_digi_deinitialize();
+        return false;
+    }
+
+    // Two-point or reference-voltage eFuses, depending on the chip's factory calibration
+    esp_adc_cal_value_t source =
+      esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, BATTERY_ADC_DEFAULT_VREF, &_adcChars);
+    ESP_LOGI(TAG, "Continuous sampling of ADC1 channel %u at %u Hz, calibrated from %s.", _adcChannel, BATTERY_ADC_SAMPLE_HZ,
+      source == ESP_ADC_CAL_VAL_EFUSE_TP     ? "eFuse two-point"
+        : source == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref"
+                                               : "default Vref");
+    return true;
+}
+
+uint16_t Battery::_drainContinuous()
+{
+    uint32_t sum   = 0;
+    uint32_t count = 0;
+    uint32_t length;
+    // The pool holds the first frames that came after the previous drain: older than the latest conversion,
+    // but only by the drain period, which a battery voltage does not care about.
+    for (;;) {
+        esp_err_t err = adc_digi_read_bytes(_frame, sizeof(_frame), &length, 0);
+        // The driver reports a pool that overflowed since, which is expected here, but still returns the data.
+        if ((err != ESP_OK && err != ESP_ERR_INVALID_STATE) || length == 0)
+            break;
+        for (uint32_t i = 0; i + sizeof(adc_digi_output_data_t) <= length; i += sizeof(adc_digi_output_data_t)) {
+            const adc_digi_output_data_t* conversion = (const adc_digi_output_data_t*)&_frame[i];
+            if (conversion->type1.channel != _adcChannel)
+                continue;
+            sum += conversion->type1.data;
+            count++;
+        }
+    }
+    if (count == 0)
+        return 0;
+    uint32_t milliVolts = esp_adc_cal_raw_to_voltage((sum + count / 2) / count, &_adcChars);
+    return (uint16_t)(milliVolts * _dividerRatio);
 }
 
 void Battery::onDemand(uint8_t activationPin, uint8_t activationMode)
@@ -102,6 +188,13 @@ void Battery::onDemand(uint8_t activationPin, uint8_t activationMode)
 
 uint16_t Battery::voltage()
 {
+    if (_continuous) {
+        // analogRead() cannot share ADC1 with the continuous mode.
+        uint16_t sample = _drainContinuous();
+        if (sample != 0)
+            _lastSample = sample;
+        return _lastSample;
+    }
     // Default single read behavior or small average (standard library does 1 read usually, or small set)
     if (_activationPin)
         digitalWrite(_activationPin, _activationMode);
@@ -160,8 +253,17 @@ void Battery::refreshAverage()
         return;
     }
 
-    // 1. Get single sample (which is itself an average of 100 fast reads)
-    uint16_t newSample = voltageFast(100);
+    // 1. Get single sample (which is itself an average of the pending conversions, or of 100 fast reads)
+    uint16_t newSample;
+    if (_continuous) {
+        newSample = _drainContinuous();
+        if (newSample == 0)
+            newSample = _lastSample; // No frame since the previous call
+        else
+            _lastSample = newSample;
+    } else {
+        newSample = voltageFast(100);
+    }
 
     // 2. Rolling Average Update
     _accumulator -= _window[_windowIndex]; // Remove oldest
@@ -2,7 +2,9 @@
 #include "ArduinoJson.h"
 #include "esp_log.h"
 #include "rom/crc.h"
+#include "Storage.hpp"
 #include "TankManager.hpp"
+#include <cstddef>
 #include <cstdint>
 
 static const char* TAG = "ConfigManager";
@@ -107,30 +109,31 @@ std::string ConfigManager::loadTimezone()
     return tz;
 }
 
-bool ConfigManager::saveScaleCalibration(float factor, long offset)
+bool ConfigManager::saveScaleCalibration(float factor, long offset, uint8_t channel)
 {
     if (!_openNVS())
         return false;
-    nvs_set_i32(_nvs_handle, "scale_cal_f", (int32_t)(factor * 1000));
-    nvs_set_i32(_nvs_handle, "scale_cal_o", offset);
+    nvs_set_i32(_nvs_handle, channel ? "scale_b_cal_f" : "scale_cal_f", (int32_t)(factor * 1000));
+    nvs_set_i32(_nvs_handle, channel ? "scale_b_cal_o" : "scale_cal_o", offset);
     esp_err_t err = nvs_commit(_nvs_handle);
     _closeNVS();
     return err == ESP_OK;
 }
 
-bool ConfigManager::loadScaleCalibration(float& factor, long& offset)
+bool ConfigManager::loadScaleCalibration(float& factor, long& offset, uint8_t channel)
 {
-    factor = 2280.0f; // Default value
+    // Default value; channel B runs at a quarter of channel A's gain (32 vs 128)
+    factor = channel ? 570.0f : 2280.0f;
     offset = 0; // Default value
     if (!_openNVS())
         return false;
     int32_t temp_factor;
-    if (nvs_get_i32(_nvs_handle, "scale_cal_f", &temp_factor) == ESP_OK) {
+    if (nvs_get_i32(_nvs_handle, channel ? "scale_b_cal_f" : "scale_cal_f", &temp_factor) == ESP_OK) {
         factor = (float)temp_factor / 1000.0f;
     }
 
     int32_t temp_offset;
-    if (nvs_get_i32(_nvs_handle, "scale_cal_o", &temp_offset) == ESP_OK) {
+    if (nvs_get_i32(_nvs_handle, channel ? "scale_b_cal_o" : "scale_cal_o", &temp_offset) == ESP_OK) {
         offset = temp_offset;
     }
 
@@ -164,8 +167,28 @@ bool ConfigManager::loadHopperCalibration(uint16_t& closed_pwm, uint16_t& open_p
     return true;
 }
 
+bool ConfigManager::saveSwiMuxBaudRate(uint32_t bauds)
+{
+    if (!_openNVS())
+        return false;
+    nvs_set_u32(_nvs_handle, "swimux_baud", bauds);
+    esp_err_t err = nvs_commit(_nvs_handle);
+    _closeNVS();
+    return err == ESP_OK;
+}
+
+uint32_t ConfigManager::loadSwiMuxBaudRate()
+{
+    uint32_t bauds = 0;
+    if (!_openNVS())
+        return bauds;
+    nvs_get_u32(_nvs_handle, "swimux_baud", &bauds);
+    _closeNVS();
+    return bauds;
+}
+
 // ============================================================================
-// SPIFFS Recipe Storage Helpers
+// Recipe File Storage Helpers
 // ============================================================================
 
 uint32_t ConfigManager::_computeRecipeCRC(const std::string& jsonStr)
@@ -175,9 +198,11 @@ uint32_t ConfigManager::_computeRecipeCRC(const std::string& jsonStr)
 
 bool ConfigManager::_saveRecipeFile(const char* path, const std::string& jsonContent)
 {
-    File file = SPIFFS.open(path, FILE_WRITE);
+    // Written beside the old copy and swapped in, so a power loss never truncates it
+    String tmpPath = String(path) + STORAGE_TMP_SUFFIX;
+    File file      = storage.open(tmpPath, FILE_WRITE);
     if (!file) {
-        ESP_LOGE(TAG, "Failed to open %s for writing", path);
+        ESP_LOGE(TAG, "Failed to open %s for writing", tmpPath.c_str());
         return false;
     }
 
@@ -186,7 +211,11 @@ bool ConfigManager::_saveRecipeFile(const char* path, const std::string& jsonCon
 
     if (written != jsonContent.length()) {
         ESP_LOGE(TAG, "Incomplete write to %s: wrote %d of %d bytes",
-                 path, written, jsonContent.length());
+                 tmpPath.c_str(), written, jsonContent.length());
+        storage.remove(tmpPath);
+        return false;
+    }
+    if (!storage.commit(tmpPath.c_str(), path)) {
         return false;
     }
 
@@ -196,14 +225,9 @@ bool ConfigManager::_saveRecipeFile(const char* path, const std::string& jsonCon
 
 bool ConfigManager::_loadRecipeFile(const char* path, std::vector<Recipe>& recipes)
 {
-    if (!SPIFFS.exists(path)) {
-        ESP_LOGW(TAG, "Recipe file %s does not exist", path);
-        return false;
-    }
-
-    File file = SPIFFS.open(path, FILE_READ);
+    File file = storage.open(path, FILE_READ);
     if (!file) {
-        ESP_LOGE(TAG, "Failed to open %s for reading", path);
+        ESP_LOGW(TAG, "Recipe file %s does not exist", path);
         return false;
     }
 
@@ -241,20 +265,8 @@ bool ConfigManager::_loadRecipeFile(const char* path, std::vector<Recipe>& recip
     recipes.clear();
     for (JsonObject recipeObj : recipesArray) {
         Recipe recipe;
-        recipe.uid         = recipeObj["uid"].as<uint32_t>();
-        recipe.name        = recipeObj["name"].as<std::string>();
-        recipe.dailyWeight = recipeObj["dailyWeight"] | 0.0;
-        recipe.servings    = recipeObj["servings"] | 1;
-        recipe.created     = recipeObj["created"] | 0LL;
-        recipe.lastUsed    = recipeObj["lastUsed"] | 0LL;
-        recipe.isEnabled   = recipeObj["isEnabled"] | true;
-
-        for (JsonObject ingObj : recipeObj["ingredients"].as<JsonArray>()) {
-            RecipeIngredient ing;
-            ing.tankUid    = ingObj["tankUid"].as<uint64_t>();
-            ing.percentage = ingObj["percentage"] | 0.0f;
-            recipe.ingredients.push_back(ing);
-        }
+        JsonFields::reset(&recipe, Recipe::FIELDS);
+        JsonFields::read(recipeObj, &recipe, Recipe::FIELDS, JsonFieldFormat::Storage);
         recipes.push_back(recipe);
     }
 
@@ -277,20 +289,9 @@ std::vector<Recipe> ConfigManager::_loadRecipesFromNVS_Legacy()
                 JsonArray array = doc.as<JsonArray>();
                 for (JsonObject recipeObj : array) {
                     Recipe recipe;
-                    recipe.uid         = recipeObj["id"].as<uint32_t>();  // Legacy: read "id" as uid
-                    recipe.name        = recipeObj["name"].as<std::string>();
-                    recipe.dailyWeight = recipeObj["dailyWeight"] | 0.0;
-                    recipe.servings    = recipeObj["servings"] | 1;
-                    recipe.created     = recipeObj["created"] | 0LL;
-                    recipe.lastUsed    = recipeObj["lastUsed"] | 0LL;
-                    recipe.isEnabled   = recipeObj["isEnabled"] | true;
-
-                    for (JsonObject ingObj : recipeObj["ingredients"].as<JsonArray>()) {
-                        RecipeIngredient ing;
-                        ing.tankUid    = ingObj["tankUid"].as<uint64_t>();
-                        ing.percentage = ingObj["percentage"] | 0.0f;
-                        recipe.ingredients.push_back(ing);
-                    }
+                    JsonFields::reset(&recipe, Recipe::FIELDS);
+                    JsonFields::read(recipeObj, &recipe, Recipe::FIELDS, JsonFieldFormat::Storage);
+                    recipe.uid = recipeObj["id"].as<uint32_t>(); // Legacy: read "id" as uid
                     recipes.push_back(recipe);
                 }
             }
@@ -313,7 +314,7 @@ void ConfigManager::_deleteNVSRecipes()
 }
 
 // ============================================================================
-// Public Recipe Methods (SPIFFS-based with triple redundancy)
+// Public Recipe Methods (file-based with triple redundancy)
 // ============================================================================
 
 bool ConfigManager::saveRecipes(const std::vector<Recipe>& recipes)
@@ -323,21 +324,7 @@ bool ConfigManager::saveRecipes(const std::vector<Recipe>& recipes)
     JsonArray array = recipesDoc.to<JsonArray>();
 
     for (const auto& recipe : recipes) {
-        JsonObject recipeObj     = array.add<JsonObject>();
-        recipeObj["uid"]         = recipe.uid;
-        recipeObj["name"]        = recipe.name;
-        recipeObj["dailyWeight"] = recipe.dailyWeight;
-        recipeObj["servings"]    = recipe.servings;
-        recipeObj["created"]     = recipe.created;
-        recipeObj["lastUsed"]    = recipe.lastUsed;
-        recipeObj["isEnabled"]   = recipe.isEnabled;
-
-        JsonArray ingredients = recipeObj["ingredients"].to<JsonArray>();
-        for (const auto& ing : recipe.ingredients) {
-            JsonObject ingObj    = ingredients.add<JsonObject>();
-            ingObj["tankUid"]    = ing.tankUid;
-            ingObj["percentage"] = ing.percentage;
-        }
+        JsonFields::write(array.add<JsonObject>(), &recipe, Recipe::FIELDS, JsonFieldFormat::Storage);
     }
 
     // Serialize recipes array for CRC computation
@@ -395,29 +382,29 @@ std::vector<Recipe> ConfigManager::loadRecipes()
         }
     }
 
-    // No valid SPIFFS file found - try legacy NVS migration
-    ESP_LOGW(TAG, "No valid SPIFFS recipe files found, attempting NVS migration");
+    // No valid recipe file found - try legacy NVS migration
+    ESP_LOGW(TAG, "No valid recipe files found, attempting NVS migration");
     recipes = _loadRecipesFromNVS_Legacy();
 
     if (!recipes.empty()) {
-        ESP_LOGI(TAG, "Migrating %d recipes from NVS to SPIFFS", recipes.size());
+        ESP_LOGI(TAG, "Migrating %d recipes from NVS to flash files", recipes.size());
         if (saveRecipes(recipes)) {
             _deleteNVSRecipes();  // Clean up legacy storage
         }
         return recipes;
     }
 
-    ESP_LOGI(TAG, "No recipes found in NVS or SPIFFS, returning empty list");
+    ESP_LOGI(TAG, "No recipes found in NVS or in files, returning empty list");
     return recipes;
 }
 
 bool ConfigManager::factoryReset()
 {
-    // Delete SPIFFS recipe files
+    // Delete recipe files
     const char* recipeFiles[] = { RECIPE_FILE_PRIMARY, RECIPE_FILE_BACKUP1, RECIPE_FILE_BACKUP2 };
     for (const char* path : recipeFiles) {
-        if (SPIFFS.exists(path)) {
-            SPIFFS.remove(path);
+        if (storage.exists(path)) {
+            storage.remove(path);
             ESP_LOGI(TAG, "Deleted recipe file: %s", path);
         }
     }
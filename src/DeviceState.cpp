@@ -1,16 +1,17 @@
 #include "DeviceState.hpp"
 #include "esp_log.h"
 #include "ArduinoJson.h"
-#include <SPIFFS.h>
+#include "Storage.hpp"
 
 static const char* TAG           = "DeviceSettings";
 static const char* SETTINGS_FILE = "/settings.json";
 
-// --- Private Methods for SPIFFS Interaction ---
+// --- Private Methods for File Interaction ---
 
 /**
- * @brief Saves the current settings from the in-memory struct to the SPIFFS file.
- * This is a private helper function called by the public setters.
+ * @brief Saves the current settings from the in-memory struct to the settings file.
+ * This is a private helper function called by the public setters. The file is written
+ * beside the old one and swapped in, so a power loss never leaves it truncated.
  */
 static void _saveSettingsToFile(const DeviceState::Settings_t& settings)
 {
@@ -18,33 +19,36 @@ static void _saveSettingsToFile(const DeviceState::Settings_t& settings)
     doc["dispenseWeightChangeThreshold"]      = settings.getDispensingWeightChangeThreshold();
     doc["dispensingNoWeightChangeTimeout_ms"] = settings.getDispensingNoWeightChangeTimeout_ms();
 
-    File file = SPIFFS.open(SETTINGS_FILE, FILE_WRITE);
+    String tmpPath = String(SETTINGS_FILE) + STORAGE_TMP_SUFFIX;
+    File file      = storage.open(tmpPath, FILE_WRITE);
     if (!file) {
         ESP_LOGE(TAG, "Failed to open settings file for writing");
         return;
     }
 
-    if (serializeJson(doc, file) == 0) {
+    size_t written = serializeJson(doc, file);
+    file.close();
+    if (written == 0) {
         ESP_LOGE(TAG, "Failed to write to settings file");
-    } else {
+        storage.remove(tmpPath);
+    } else if (storage.commit(tmpPath.c_str(), SETTINGS_FILE)) {
         ESP_LOGI(TAG, "Settings successfully saved to %s", SETTINGS_FILE);
     }
-    file.close();
 }
 
 /**
- * @brief Loads settings from the SPIFFS file into the in-memory struct.
+ * @brief Loads settings from the settings file into the in-memory struct.
  * Called once at startup. If the file doesn't exist, it initializes with defaults.
  */
 static bool _loadSettingsFromFile(DeviceState::Settings_t& settings)
 {
-    if (!SPIFFS.exists(SETTINGS_FILE)) {
+    if (!storage.exists(SETTINGS_FILE)) {
         ESP_LOGW(TAG, "Settings file not found. Initializing with defaults and creating file.");
         settings.resetToDefaults(); // This will also trigger the first save.
         return false;
     }
 
-    File file = SPIFFS.open(SETTINGS_FILE, FILE_READ);
+    File file = storage.open(SETTINGS_FILE, FILE_READ);
     if (!file) {
         ESP_LOGE(TAG, "Failed to open settings file for reading. Using defaults.");
         settings.resetToDefaults();
@@ -72,7 +76,7 @@ static bool _loadSettingsFromFile(DeviceState::Settings_t& settings)
 
 // --- Public Method Implementations ---
 
-// Constructor: Initializes settings to their default values and then tries to load from SPIFFS.
+// Constructor: Initializes settings to their default values and then tries to load from the settings file.
 bool DeviceState::Settings_t::begin()
 {
     resetToDefaults(false); // Initialize without saving
@@ -150,6 +154,10 @@ void DeviceState::printTo(DeviceState& state, Stream& stream)
     stream.printf("  Raw Scale Value:       %ld\r\n", state.currentRawValue);
     stream.printf("  Is Weight Stable:      %s\r\n", state.isWeightStable ? "true" : "false");
     stream.printf("  Is Scale Responding:   %s\r\n", state.isScaleResponding ? "true" : "false");
+    stream.printf("  Bowl Weight:           %.2f g\r\n", state.bowlWeight);
+    stream.printf("  Bowl Raw Value:        %ld\r\n", state.bowlRawValue);
+    stream.printf("  Is Bowl Stable:        %s\r\n", state.isBowlWeightStable ? "true" : "false");
+    stream.printf("  Is Bowl Responding:    %s\r\n", state.isBowlScaleResponding ? "true" : "false");
     stream.printf("  Servo Power:           %s\r\n", state.servoPower ? "true" : "false");
     stream.flush();
 
@@ -249,11 +257,11 @@ void DeviceState::printTo(DeviceState& state, Stream& stream)
             stream.printf("  [%d] ts=%lld type=%s recipe=%u success=%s amt=%.2fg desc=\"%s\"\r\n",
                           (int)i,
                           (long long)entry.timestamp,
-                          entry.type.c_str(),
+                          entry.type,
                           entry.recipeUid,
                           entry.success ? "Y" : "N",
                           entry.amount,
-                          entry.description.c_str());
+                          entry.description);
             if ((i + 1) % 5 == 0) {
                 stream.flush();
             }
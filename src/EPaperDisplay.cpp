@@ -1,6 +1,7 @@
 #include "EPaperDisplay.hpp"
 #include "board_pinout.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <qrcode.h>
 #include <Fonts/FreeSansBold9pt7b.h>
 #include <Fonts/FreeSans9pt7b.h>
@@ -38,7 +39,8 @@ bool EPaperDisplay::begin()
 
 void EPaperDisplay::startTask()
 {
-    xTaskCreate(_displayTask, "Display Task", 4096, this, 4, &_displayTaskHandle);
+    _displayTaskHandle =
+      xTaskCreateStatic(_displayTask, "Display Task", DISPLAY_TASK_STACK_SIZE, this, 4, _displayTaskStack, &_displayTaskBuffer);
 }
 
 
@@ -293,5 +295,8 @@ void EPaperDisplay::_updateDisplay()
     _display->setCursor(5, _display->height() - 8);
     _display->print(timeStr);
 
+    // Returns once the frame is in the panel RAM, the refresh itself goes on without this task.
+    int64_t start = esp_timer_get_time();
     _display->display();
+    ESP_LOGD(TAG, "Frame pushed in %u us.", (unsigned)(esp_timer_get_time() - start));
 }
\ No newline at end of file
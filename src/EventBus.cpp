@@ -0,0 +1,44 @@
+#include "EventBus.hpp"
+#include "esp_log.h"
+
+static const char* TAG = "EventBus";
+
+EventGroupHandle_t EventSubscriber::_group = NULL;
+StaticEventGroup_t EventSubscriber::_groupBuffer;
+uint8_t EventSubscriber::_bitCount = 0;
+
+EventSubscriber::EventSubscriber(const char* name) : _name(name), _bit(0), _subscriptions(nullptr)
+{
+    // Subscribers are constructed before the scheduler starts, one at a time.
+    if (_group == NULL)
+        _group = xEventGroupCreateStatic(&_groupBuffer);
+    if (_bitCount < EVENT_BUS_MAX_SUBSCRIBERS)
+        _bit = (EventBits_t)1 << _bitCount++;
+    else
+        ESP_LOGE(TAG, "No wake-up bit left for %s: all %d taken.", name, EVENT_BUS_MAX_SUBSCRIBERS);
+}
+
+void EventSubscriber::_add(EventSubscription& subscription)
+{
+    subscription._next = _subscriptions;
+    _subscriptions     = &subscription;
+}
+
+void EventSubscriber::wake(EventBits_t subscribers)
+{
+    if (subscribers != 0)
+        xEventGroupSetBits(_group, subscribers);
+}
+
+size_t EventSubscriber::dispatch(TickType_t timeout)
+{
+    if (_bit == 0) {
+        vTaskDelay(timeout);
+        return 0;
+    }
+    xEventGroupWaitBits(_group, _bit, pdTRUE, pdFALSE, timeout);
+    size_t delivered = 0;
+    for (EventSubscription* sub = _subscriptions; sub != nullptr; sub = sub->_next)
+        delivered += sub->_drain();
+    return delivered;
+}
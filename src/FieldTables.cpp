@@ -0,0 +1,62 @@
+/**
+ * @file FieldTables.cpp
+ * @brief JSON field tables of the recipes and the tanks (see JsonFields.hpp).
+ *
+ * Apart from ConfigManager and TankManager, so that the host builds link them without the hardware.
+ */
+#include "ConfigManager.hpp"
+#include "TankManager.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// --- Recipes ---
+static_assert(std::is_standard_layout<Recipe>::value && std::is_standard_layout<RecipeIngredient>::value,
+  "The field tables locate members with offsetof");
+static_assert(sizeof(int) == sizeof(int32_t) && sizeof(long long) == sizeof(int64_t), "Recipe member types");
+
+static const JsonField INGREDIENT_FIELDS[] = {
+    JSON_FIELD(RecipeIngredient, tankUid, "tankUid", UInt64, JSON_FIELD_REQUIRED | JSON_FIELD_HEX),
+    JSON_FIELD_RANGED(RecipeIngredient, percentage, "percentage", Float, JSON_FIELD_REQUIRED, 1.0, 0.0, 100.0, 0.0),
+};
+const JsonFieldList RecipeIngredient::FIELDS = JSON_FIELD_LIST(INGREDIENT_FIELDS);
+static const JsonFieldVector INGREDIENT_VECTOR = JSON_FIELD_VECTOR_OF(RecipeIngredient, RecipeIngredient::FIELDS);
+
+static const JsonField RECIPE_FIELDS[] = {
+    JSON_FIELD(Recipe, uid, "uid", UInt32, JSON_FIELD_READ_ONLY),
+    JSON_FIELD_RANGED(Recipe, name, "name", String, JSON_FIELD_REQUIRED, 1.0, 1, RECIPE_NAME_MAX_LEN, 0.0),
+    JSON_FIELD_RANGED(Recipe, dailyWeight, "dailyWeight", Double, 0, 1.0, 0.0, NAN, 0.0),
+    JSON_FIELD_RANGED(Recipe, servings, "servings", Int32, 0, 1.0, 1, NAN, 1),
+    JSON_FIELD(Recipe, created, "created", Int64, JSON_FIELD_READ_ONLY),
+    JSON_FIELD(Recipe, lastUsed, "lastUsed", Int64, JSON_FIELD_READ_ONLY),
+    JSON_FIELD_RANGED(Recipe, isEnabled, "isEnabled", Bool, JSON_FIELD_READ_ONLY, 1.0, NAN, NAN, true),
+    JSON_FIELD_ARRAY(Recipe, ingredients, "ingredients", JSON_FIELD_REQUIRED, INGREDIENT_VECTOR),
+};
+const JsonFieldList Recipe::FIELDS = JSON_FIELD_LIST(RECIPE_FIELDS);
+
+// --- Tanks ---
+static_assert(std::is_standard_layout<TankInfo>::value, "The field tables locate members with offsetof");
+
+static const JsonField TANK_CALIBRATION_FIELDS[] = {
+    JSON_FIELD(TankInfo, servoIdlePwm, "idlePwm", UInt16, 0),
+};
+static const JsonFieldList TANK_CALIBRATION = JSON_FIELD_LIST(TANK_CALIBRATION_FIELDS);
+
+static const JsonField TANK_DENSITY_CALIBRATION_FIELDS[] = {
+    JSON_FIELD(TankInfo, densitySource, "source", UInt8, JSON_FIELD_READ_ONLY), // DensitySource
+    JSON_FIELD(TankInfo, densitySamples, "samples", UInt8, JSON_FIELD_READ_ONLY),
+    JSON_FIELD(TankInfo, augerFlow, "augerFlow", UInt16, JSON_FIELD_READ_ONLY), // mL/min
+};
+static const JsonFieldList TANK_DENSITY_CALIBRATION = JSON_FIELD_LIST(TANK_DENSITY_CALIBRATION_FIELDS);
+
+static const JsonField TANK_FIELDS[] = {
+    JSON_FIELD(TankInfo, uid, "uid", UInt64, JSON_FIELD_READ_ONLY | JSON_FIELD_HEX),
+    JSON_FIELD_RANGED(TankInfo, name, "name", String, 0, 1.0, NAN, TankEEpromData_t::NAME_FIELD_SIZE - 1, 0.0),
+    JSON_FIELD(TankInfo, busIndex, "busIndex", Int8, JSON_FIELD_READ_ONLY),
+    JSON_FIELD_RANGED(TankInfo, remaining_weight_grams, "remainingWeightGrams", Double, 0, 1.0, 0.0, UINT16_MAX, 0.0),
+    JSON_FIELD_RANGED(TankInfo, capacityLiters, "capacity", Double, 0, 1.0, 0.0, UINT16_MAX / 1000.0, 0.0), // EEPROM: mL
+    JSON_FIELD_RANGED(TankInfo, kibbleDensity, "density", Double, 0, 1000.0, 0.0, UINT16_MAX, 0.0), // Internal kg/L, API g/L
+    JSON_FIELD_GROUP("calibration", TANK_CALIBRATION),
+    JSON_FIELD_GROUP("densityCalibration", TANK_DENSITY_CALIBRATION),
+};
+const JsonFieldList TankInfo::FIELDS = JSON_FIELD_LIST(TANK_FIELDS);
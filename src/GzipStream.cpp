@@ -0,0 +1,198 @@
+#include "GzipStream.hpp"
+#include <cstring>
+
+// RFC 1951, 3.2.5: base value and extra bits of the length (257..285) and distance codes.
+static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131,
+    163, 195, 227, 258 };
+static const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DIST_BASE[30]   = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049,
+      3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DIST_EXTRA[30]   = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// RFC 1952: magic, deflate, no flags, no mtime, no extra flags, unknown OS.
+static const uint8_t GZIP_HEADER[10] = { 0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF };
+
+static constexpr uint16_t MIN_MATCH = 3;
+static constexpr uint16_t MAX_MATCH = 258;
+
+GzipStream::GzipStream(const uint8_t* data, size_t len)
+    : _data(data), _len(len), _pos(0), _hashedPos(0), _stage(Stage::HEADER), _stageIndex(0), _maxChain(GZIP_MAX_CHAIN), _crc(0),
+      _bitBuf(0), _bitCount(0)
+{
+    memset(_head, 0, sizeof(_head));
+    memset(_prev, 0, sizeof(_prev));
+}
+
+uint32_t GzipStream::crc32(uint32_t crc, const uint8_t* data, size_t len)
+{
+    // Nibble table: 64 bytes instead of 1 KB, fast enough next to the matching.
+    static const uint32_t table[16] = { 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        crc  = (crc >> 4) ^ table[crc & 0x0F];
+        crc  = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+size_t GzipStream::read(uint8_t* out, size_t maxLen)
+{
+    size_t n = 0;
+    while (true) {
+        while (_bitCount >= 8 && n < maxLen) {
+            out[n++]   = (uint8_t)_bitBuf;
+            _bitBuf  >>= 8;
+            _bitCount -= 8;
+        }
+        // Each step below adds at most 31 bits, drained before the next one.
+        if (n >= maxLen || _stage == Stage::DONE)
+            break;
+
+        switch (_stage) {
+            case Stage::HEADER:
+                _putBits(GZIP_HEADER[_stageIndex++], 8);
+                if (_stageIndex == sizeof(GZIP_HEADER))
+                    _stage = Stage::BLOCK_START;
+                break;
+            case Stage::BLOCK_START:
+                _putBits(1, 1); // BFINAL: the whole stream is one block
+                _putBits(1, 2); // BTYPE: fixed Huffman codes
+                _stage = Stage::BODY;
+                break;
+            case Stage::BODY:
+                if (_pos < _len) {
+                    _encodeNext();
+                } else {
+                    _putCode(0, 7); // end of block (256)
+                    if (_bitCount & 7)
+                        _putBits(0, 8 - (_bitCount & 7));
+                    _stage      = Stage::TRAILER;
+                    _stageIndex = 0;
+                }
+                break;
+            case Stage::TRAILER: {
+                uint32_t word = _stageIndex < 4 ? _crc : (uint32_t)_len;
+                _putBits((word >> (8 * (_stageIndex & 3))) & 0xFF, 8);
+                if (++_stageIndex == 8)
+                    _stage = Stage::DONE;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return n;
+}
+
+void GzipStream::_putCode(uint32_t code, uint8_t count)
+{
+    uint32_t reversed = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code   >>= 1;
+    }
+    _putBits(reversed, count);
+}
+
+void GzipStream::_putLiteral(uint8_t value)
+{
+    if (value < 144)
+        _putCode(0x30 + value, 8);
+    else
+        _putCode(0x190 + (value - 144), 9);
+}
+
+void GzipStream::_putMatch(uint16_t length, uint16_t distance)
+{
+    uint8_t code = 28;
+    while (LENGTH_BASE[code] > length)
+        code--;
+    uint16_t symbol = 257 + code;
+    if (symbol < 280)
+        _putCode(symbol - 256, 7);
+    else
+        _putCode(0xC0 + (symbol - 280), 8);
+    _putBits(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+    code = 29;
+    while (DIST_BASE[code] > distance)
+        code--;
+    _putCode(code, 5);
+    _putBits(distance - DIST_BASE[code], DIST_EXTRA[code]);
+}
+
+uint32_t GzipStream::_hashAt(size_t pos) const
+{
+    uint32_t key = ((uint32_t)_data[pos] << 16) | ((uint32_t)_data[pos + 1] << 8) | _data[pos + 2];
+    return (uint32_t)(key * 2654435761U) >> (32 - GZIP_HASH_BITS);
+}
+
+void GzipStream::_insertHash(size_t upTo)
+{
+    for (; _hashedPos < upTo && _hashedPos + MIN_MATCH <= _len; _hashedPos++) {
+        uint32_t hash     = _hashAt(_hashedPos);
+        uint32_t previous = _head[hash];
+        size_t distance   = previous ? _hashedPos - (previous - 1) : 0;
+        _prev[_hashedPos & (GZIP_WINDOW_SIZE - 1)] = distance < GZIP_WINDOW_SIZE ? (uint16_t)distance : 0;
+        _head[hash]                                = (uint32_t)_hashedPos + 1;
+    }
+}
+
+uint16_t GzipStream::_findMatch(uint16_t& distance)
+{
+    if (_pos + MIN_MATCH > _len)
+        return 0;
+    size_t limit  = _len - _pos < MAX_MATCH ? _len - _pos : MAX_MATCH;
+    uint16_t best = 0;
+    uint32_t head = _head[_hashAt(_pos)];
+    if (head == 0)
+        return 0;
+
+    size_t candidate = head - 1;
+    for (uint8_t probes = 0; probes < _maxChain; probes++) {
+        size_t dist = _pos - candidate;
+        if (dist == 0 || dist >= GZIP_WINDOW_SIZE)
+            break;
+        const uint8_t* a = _data + candidate;
+        const uint8_t* b = _data + _pos;
+        if (a[best] == b[best]) { // cannot beat the best match otherwise
+            uint16_t length = 0;
+            while (length < limit && a[length] == b[length])
+                length++;
+            if (length > best) {
+                best     = length;
+                distance = (uint16_t)dist;
+                if (length == limit)
+                    break;
+            }
+        }
+        uint16_t step = _prev[candidate & (GZIP_WINDOW_SIZE - 1)];
+        if (step == 0 || step > candidate)
+            break;
+        candidate -= step;
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+void GzipStream::_encodeNext()
+{
+    uint16_t distance = 0;
+    uint16_t length   = 0;
+    if (_maxChain > 0) {
+        _insertHash(_pos);
+        length = _findMatch(distance);
+    } else {
+        _hashedPos = _pos; // literals only from now on, the chains are not maintained
+    }
+
+    if (length) {
+        _putMatch(length, distance);
+    } else {
+        _putLiteral(_data[_pos]);
+        length = 1;
+    }
+    _crc  = crc32(_crc, _data + _pos, length);
+    _pos += length;
+}
@@ -1,11 +1,22 @@
 #include "HX711Scale.hpp"
+#include "TaskJitter.hpp"
+#include "HeapGuard.hpp"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <algorithm>
 
 static const char* TAG = "HX711Scale";
+static JitterProbe scaleJitter("scale");
 
 HX711Scale::HX711Scale(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager)
-    : _deviceState(deviceState), _mutex(mutex), _configManager(configManager), _scaleMutex(NULL), _calibrationFactor(400.0f), _zeroOffset(0)
-{}
+    : _deviceState(deviceState), _mutex(mutex), _configManager(configManager), _scaleMutex(NULL), _calibrationFactor { 400.0f, 100.0f },
+      _zeroOffset { 0, 0 }, _taskHandle(NULL), _activeUntilTick(0), _lastActivityTick(0), _feedingHold(false), _subscribed(false),
+      _dutyLevel(ScaleDutyLevel::NORMAL), _lastPublished { NAN, NAN }, _blankUntilTick(0), _requestPending(0), _requestReady(0),
+      _requestResult { NAN, NAN }, _requestGeneration { 0, 0 }, _servedGeneration(0), _servingRequest(false), _trace(nullptr), _replayBuffer(nullptr),
+      _replayStartTick(0), _poweredDown(true)
+{
+    _requestLock = portMUX_INITIALIZER_UNLOCKED;
+}
 
 bool HX711Scale::begin(uint8_t dataPin, uint8_t clockPin)
 {
@@ -16,26 +27,127 @@ bool HX711Scale::begin(uint8_t dataPin, uint8_t clockPin)
     }
 
     _scale.begin(dataPin, clockPin);
-    _configManager.loadScaleCalibration(_calibrationFactor, _zeroOffset);
-    _scale.set_scale(_calibrationFactor);
-    _scale.set_offset(_zeroOffset);
-    ESP_LOGI(TAG, "Scale initialized with factor: %.2f, offset: %ld", _calibrationFactor, _zeroOffset);
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+        _configManager.loadScaleCalibration(_calibrationFactor[ch], _zeroOffset[ch], ch);
+        ESP_LOGI(TAG, "%s channel initialized with factor: %.2f, offset: %ld", getChannelName((ScaleChannel)ch), _calibrationFactor[ch],
+          _zeroOffset[ch]);
+    }
     return true;
 }
 
-void HX711Scale::tare()
+const char* HX711Scale::getChannelName(ScaleChannel channel)
+{
+    return channel == ScaleChannel::BOWL ? "Bowl" : "Hopper";
+}
+
+// ============================================================================
+// Channel Handling (caller must hold _scaleMutex)
+// ============================================================================
+
+bool HX711Scale::_powerUp()
+{
+    _scale.power_up();
+    if (_poweredDown) {
+        // After a power-down/reset the HX711 always converts channel A at gain 128.
+        _sampler.onPowerUp();
+        _poweredDown = false;
+        return true;
+    }
+    return false;
+}
+
+void HX711Scale::_powerDown()
+{
+    _scale.power_down();
+    _poweredDown = true;
+}
+
+bool HX711Scale::_selectChannel(ScaleChannel channel)
+{
+    _scale.set_gain(_gainOf(channel));
+    if (_sampler.getChipChannel() == channel)
+        return true;
+
+    // The pending conversion still belongs to the previous input; clocking it out selects the new one.
+    if (_readSample() == 0)
+        return false;
+    _sampler.setChipChannel(channel);
+    // Let the input settle, then drop the conversion that straddled the switch.
+    if (!isReplaying())
+        vTaskDelay(pdMS_TO_TICKS(ScaleSampler::CHANNEL_SWITCH_DISCARD * FAST_MODE_SAMPLING_PERIOD_MS));
+    return _readSample() != 0;
+}
+
+bool HX711Scale::_isSampleReady()
+{
+    if (isReplaying())
+        return _replay.isSampleDue((uint8_t)_sampler.getChipChannel(), _replayElapsedMs());
+    return _scale.is_ready();
+}
+
+long HX711Scale::_readSample()
+{
+    if (isReplaying()) {
+        // Like HX711::read(), wait for the next conversion of the input being converted
+        uint8_t ch = (uint8_t)_sampler.getChipChannel();
+        uint32_t dueMs;
+        int32_t raw;
+        while (_replay.nextSampleTime(ch, dueMs)) {
+            uint32_t elapsedMs = _replayElapsedMs();
+            if (_replay.takeSample(ch, elapsedMs, raw))
+                return raw;
+            vTaskDelay(pdMS_TO_TICKS(dueMs - elapsedMs) + 1);
+            _serviceReplay();
+        }
+        // The trace holds no more conversions of this input, read as an unresponsive HX711
+        return 0;
+    }
+
+    // The conversion clocked out belongs to the input selected by the previous read.
+    long raw = _scale.read();
+    if (_trace)
+        _trace->recordSample((uint8_t)_sampler.getChipChannel(), raw);
+    return raw;
+}
+
+long HX711Scale::_readAverage(uint8_t times, uint8_t& failuresOut)
+{
+    long sum    = 0;
+    failuresOut = 0;
+    for (uint8_t i = 0; i < times; i++) {
+        long value = _readSample();
+        if (value == 0)
+            failuresOut++;
+        sum += value;
+        delay(0);
+    }
+    return sum / times;
+}
+
+// ============================================================================
+// Blocking API
+// ============================================================================
+
+void HX711Scale::tare(ScaleChannel channel)
 {
     // Tare takes a fixed number of samples (20), so we can calculate a generous timeout.
-    TickType_t timeout = pdMS_TO_TICKS(20 * FAST_MODE_SAMPLING_PERIOD_MS + 150);
+    TickType_t timeout = pdMS_TO_TICKS((20 + ScaleSampler::CHANNEL_SWITCH_DISCARD) * FAST_MODE_SAMPLING_PERIOD_MS + 150);
+    uint8_t ch         = (uint8_t)channel;
 
     if (xSemaphoreTake(_scaleMutex, timeout) == pdTRUE) {
-        ESP_LOGI(TAG, "Taring scale...");
+        ESP_LOGI(TAG, "Taring %s channel...", getChannelName(channel));
         // Ensure HX711 is powered up for blocking read
-        _scale.power_up();
-        vTaskDelay(pdMS_TO_TICKS(55)); // Wait for settling
-        if (_scale.tare(20)) {
-            _zeroOffset = _scale.get_offset();
-            ESP_LOGI(TAG, "Tare complete. New offset: %ld", _zeroOffset);
+        if (_powerUp())
+            vTaskDelay(pdMS_TO_TICKS(55)); // Wait for settling
+        uint8_t failures = 0;
+        long average     = 0;
+        if (_selectChannel(channel))
+            average = _readAverage(20, failures);
+        else
+            failures = 1;
+        if (failures == 0) {
+            _zeroOffset[ch] = average;
+            ESP_LOGI(TAG, "Tare complete. New offset: %ld", _zeroOffset[ch]);
             saveCalibration();
         } else {
             ESP_LOGE(TAG, "Tare failed due to unresponsiveness of the HX711.");
@@ -46,35 +158,30 @@ void HX711Scale::tare()
     }
 }
 
-float HX711Scale::getWeight()
+float HX711Scale::getWeight(ScaleChannel channel)
 {
-    float weight       = 0.0f;
-    TickType_t timeout = pdMS_TO_TICKS(CALIBRATION_SAMPLES * FAST_MODE_SAMPLING_PERIOD_MS + 50);
-    uint8_t failures   = 0;
-    if (xSemaphoreTake(_scaleMutex, timeout) == pdTRUE) {
-        // Ensure HX711 is powered up for blocking read
-        _scale.power_up();
-        vTaskDelay(pdMS_TO_TICKS(55)); // Wait for settling
-        weight = _scale.get_units(CALIBRATION_SAMPLES, failures);
-        xSemaphoreGive(_scaleMutex);
-    } else {
-        ESP_LOGE(TAG, "Failed to acquire scale mutex for getWeight().");
-    }
-    if (failures)
+    long rawValue = getRawReading(channel);
+    if (rawValue == 0)
         return NAN;
-    return weight;
+    uint8_t ch = (uint8_t)channel;
+    return (float)(rawValue - _zeroOffset[ch]) / _calibrationFactor[ch];
 }
 
-long HX711Scale::getRawReading()
+long HX711Scale::getRawReading(ScaleChannel channel)
 {
     long rawValue      = 0;
-    TickType_t timeout = pdMS_TO_TICKS(CALIBRATION_SAMPLES * FAST_MODE_SAMPLING_PERIOD_MS + 50);
+    TickType_t timeout = pdMS_TO_TICKS((CALIBRATION_SAMPLES + ScaleSampler::CHANNEL_SWITCH_DISCARD) * FAST_MODE_SAMPLING_PERIOD_MS + 50);
     uint8_t failures   = 0;
+    // Conversions taken while a servo is still moving would carry its transient
+    waitUntilSettled(MAX_BLANKING_WAIT_MS);
     if (xSemaphoreTake(_scaleMutex, timeout) == pdTRUE) {
         // Ensure HX711 is powered up for blocking read
-        _scale.power_up();
-        vTaskDelay(pdMS_TO_TICKS(55)); // Wait for settling
-        rawValue = _scale.read_average(CALIBRATION_SAMPLES, failures);
+        if (_powerUp())
+            vTaskDelay(pdMS_TO_TICKS(55)); // Wait for settling
+        if (_selectChannel(channel))
+            rawValue = _readAverage(CALIBRATION_SAMPLES, failures);
+        else
+            failures = 1;
         xSemaphoreGive(_scaleMutex);
     } else {
         ESP_LOGE(TAG, "Failed to acquire scale mutex for getRawReading().");
@@ -84,183 +191,520 @@ long HX711Scale::getRawReading()
     return rawValue;
 }
 
-float HX711Scale::calibrateWithKnownWeight(float knownWeight)
+float HX711Scale::calibrateWithKnownWeight(float knownWeight, ScaleChannel channel)
 {
+    uint8_t ch = (uint8_t)channel;
     if (knownWeight <= 0) {
         ESP_LOGE(TAG, "Calibration failed: Known weight must be positive.");
-        return _calibrationFactor;
+        return _calibrationFactor[ch];
     }
     // getRawReading() is already thread-safe.
-    long reading = getRawReading();
+    long reading = getRawReading(channel);
 
     // setCalibrationFactor() is also thread-safe.
-    float new_factor = (float)(reading - _zeroOffset) / knownWeight;
-    setCalibrationFactor(new_factor);
+    float new_factor = (float)(reading - _zeroOffset[ch]) / knownWeight;
+    setCalibrationFactor(new_factor, channel);
 
     saveCalibration();
-    ESP_LOGI(TAG, "Scale calibrated with new factor: %.4f", new_factor);
+    ESP_LOGI(TAG, "%s channel calibrated with new factor: %.4f", getChannelName(channel), new_factor);
     return new_factor;
 }
 
-void HX711Scale::setCalibrationFactor(float factor)
+void HX711Scale::setCalibrationFactor(float factor, ScaleChannel channel)
 {
     // This requires a very short lock as it's a quick operation.
     if (xSemaphoreTake(_scaleMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        _calibrationFactor = factor;
-        _scale.set_scale(factor);
+        _calibrationFactor[(uint8_t)channel] = factor;
         xSemaphoreGive(_scaleMutex);
-        ESP_LOGI(TAG, "Calibration factor set to: %.2f", factor);
+        ESP_LOGI(TAG, "%s calibration factor set to: %.2f", getChannelName(channel), factor);
     } else {
         ESP_LOGE(TAG, "Failed to acquire scale mutex for setCalibrationFactor().");
     }
 }
 
-float HX711Scale::getCalibrationFactor()
+float HX711Scale::getCalibrationFactor(ScaleChannel channel)
 {
-    return _calibrationFactor;
+    return _calibrationFactor[(uint8_t)channel];
 }
 
-long HX711Scale::getZeroOffset()
+long HX711Scale::getZeroOffset(ScaleChannel channel)
 {
-    return _zeroOffset;
+    return _zeroOffset[(uint8_t)channel];
 }
 
 void HX711Scale::saveCalibration()
 {
-    _configManager.saveScaleCalibration(_calibrationFactor, _zeroOffset);
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+        _configManager.saveScaleCalibration(_calibrationFactor[ch], _zeroOffset[ch], ch);
     ESP_LOGI(TAG, "Scale calibration saved to NVS.");
 }
 
+// ============================================================================
+// Actuation Blanking
+// ============================================================================
+
+void HX711Scale::notifyActuation(uint32_t blankingMs)
+{
+    if (blankingMs == 0)
+        return;
+    TickType_t until = xTaskGetTickCount() + pdMS_TO_TICKS(blankingMs);
+    // Overlapping actuations extend the window, never shorten it
+    if ((int32_t)(until - _blankUntilTick) > 0)
+        _blankUntilTick = until;
+}
+
+bool HX711Scale::isSettledSinceActuation() const
+{
+    return (int32_t)(_blankUntilTick - xTaskGetTickCount()) <= 0;
+}
+
+bool HX711Scale::waitUntilSettled(uint32_t timeoutMs)
+{
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        int32_t remaining = (int32_t)(_blankUntilTick - xTaskGetTickCount());
+        if (remaining <= 0)
+            return true;
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= pdMS_TO_TICKS(timeoutMs))
+            return false;
+        // Sleep to the end of the window, re-checking in case another actuation extended it
+        vTaskDelay(std::min<TickType_t>((TickType_t)remaining, pdMS_TO_TICKS(timeoutMs) - elapsed));
+    }
+}
+
+// ============================================================================
+// Trace Replay
+// ============================================================================
+
+bool HX711Scale::startReplay(fs::FS& fs, const char* path)
+{
+    if (_trace && _trace->isRecording()) {
+        ESP_LOGW(TAG, "Cannot replay while a capture is running.");
+        return false;
+    }
+    File file = fs.open(path, FILE_READ);
+    if (!file) {
+        ESP_LOGE(TAG, "Trace %s not found.", path);
+        return false;
+    }
+    size_t len = file.size();
+    if (len < SCALE_TRACE_HEADER_SIZE || len > SCALE_TRACE_MAX_BYTES) {
+        ESP_LOGE(TAG, "Trace %s has an invalid size (%u).", path, (unsigned)len);
+        file.close();
+        return false;
+    }
+    uint8_t* buffer = (uint8_t*)malloc(len);
+    if (buffer == nullptr) {
+        ESP_LOGE(TAG, "Not enough memory to replay %s (%u bytes).", path, (unsigned)len);
+        file.close();
+        return false;
+    }
+    size_t readLen = file.read(buffer, len);
+    file.close();
+
+    ScaleTraceReader reader(buffer, readLen);
+    if (readLen != len || !reader.isValid()) {
+        ESP_LOGE(TAG, "Trace %s is corrupted.", path);
+        free(buffer);
+        return false;
+    }
+
+    if (xSemaphoreTake(_scaleMutex, pdMS_TO_TICKS(500)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire scale mutex for startReplay().");
+        free(buffer);
+        return false;
+    }
+    _releaseReplay();
+    _replayBuffer    = buffer;
+    _replay.reset(reader);
+    _replayStartTick = xTaskGetTickCount();
+    xSemaphoreGive(_scaleMutex);
+
+    ESP_LOGI(TAG, "Replaying %s (%u bytes).", path, (unsigned)len);
+    requestActivity();
+    return true;
+}
+
+void HX711Scale::stopReplay()
+{
+    if (xSemaphoreTake(_scaleMutex, pdMS_TO_TICKS(500)) == pdTRUE) {
+        _releaseReplay();
+        xSemaphoreGive(_scaleMutex);
+    } else {
+        ESP_LOGE(TAG, "Failed to acquire scale mutex for stopReplay().");
+    }
+}
+
+void HX711Scale::_releaseReplay()
+{
+    if (_replayBuffer) {
+        free(_replayBuffer);
+        _replayBuffer = nullptr;
+        _replay.reset(ScaleTraceReader());
+    }
+}
+
+uint32_t HX711Scale::_replayElapsedMs() const
+{
+    return (uint32_t)((xTaskGetTickCount() - _replayStartTick) * portTICK_PERIOD_MS);
+}
+
+void HX711Scale::_serviceReplay()
+{
+    if (!isReplaying())
+        return;
+    uint32_t elapsedMs = _replayElapsedMs();
+    uint8_t servo;
+    uint16_t pwm, travelUs;
+    // The recorded servo commands disturb the replayed stream as the live ones did
+    while (_replay.takeServo(elapsedMs, servo, pwm, travelUs))
+        notifyActuation(servoBlankingMs(travelUs));
+    if (_replay.isFinished(elapsedMs)) {
+        ESP_LOGI(TAG, "Trace replay complete, back to the HX711.");
+        _releaseReplay();
+    }
+}
+
+// ============================================================================
+// Sampling Task
+// ============================================================================
+
 void HX711Scale::startTask()
 {
-    xTaskCreate(_scaleTask, "Scale Task", 4096, this, 5, NULL);
+    _taskHandle = xTaskCreateStatic(_scaleTask, "Scale Task", SCALE_TASK_STACK_SIZE, this, 5, _taskStack, &_taskBuffer);
+}
+
+const char* HX711Scale::getDutyLevelName(ScaleDutyLevel level)
+{
+    switch (level) {
+        case ScaleDutyLevel::CONTINUOUS:
+            return "continuous";
+        case ScaleDutyLevel::NORMAL:
+            return "normal";
+        default:
+            return "sparse";
+    }
+}
+
+// ============================================================================
+// Non-blocking Sample Requests
+// ============================================================================
+
+void HX711Scale::requestSample(ScaleChannel channel)
+{
+    uint8_t bit = 1 << (uint8_t)channel;
+    portENTER_CRITICAL(&_requestLock);
+    _requestPending |= bit;
+    _requestReady   &= ~bit;
+    _requestGeneration[(uint8_t)channel]++;
+    portEXIT_CRITICAL(&_requestLock);
+    // Wakes the task up if it is powered down
+    requestActivity();
+}
+
+bool HX711Scale::takeRequestedSample(ScaleChannel channel, float& grams)
+{
+    uint8_t bit = 1 << (uint8_t)channel;
+    bool ready  = false;
+    portENTER_CRITICAL(&_requestLock);
+    if (_requestReady & bit) {
+        grams          = _requestResult[(uint8_t)channel];
+        _requestReady &= ~bit;
+        ready          = true;
+    }
+    portEXIT_CRITICAL(&_requestLock);
+    return ready;
+}
+
+void HX711Scale::_beginRequestedWindow(TickType_t now)
+{
+    if (_servingRequest)
+        return;
+    portENTER_CRITICAL(&_requestLock);
+    uint8_t pending = _requestPending;
+    portEXIT_CRITICAL(&_requestLock);
+    if (pending == 0)
+        return;
+
+    // Close the regular window with what it has: its first conversions predate the request
+    if (_sampler.getSampleCount() > 0)
+        _publishWindow(_sampler.getAverage());
+    // The channel being averaged goes first, it needs no input switch
+    ScaleChannel channel = _sampler.getActiveChannel();
+    if ((pending & (1 << (uint8_t)channel)) == 0)
+        channel = ScaleSampler::otherChannel(channel);
+    _sampler.startWindow(channel);
+    _phaseStartTick = now;
+    _servingRequest = true;
+    portENTER_CRITICAL(&_requestLock);
+    _servedGeneration = _requestGeneration[(uint8_t)channel];
+    portEXIT_CRITICAL(&_requestLock);
+}
+
+void HX711Scale::_completeRequest(long avgRaw)
+{
+    uint8_t ch    = (uint8_t)_sampler.getActiveChannel();
+    float grams   = _sampler.getSampleCount() > 0 ? (float)(avgRaw - _zeroOffset[ch]) / _calibrationFactor[ch] : NAN;
+    uint8_t bit   = 1 << ch;
+    portENTER_CRITICAL(&_requestLock);
+    // A request renewed while this window ran stays pending: its answer must postdate it
+    if (_requestGeneration[ch] == _servedGeneration) {
+        _requestResult[ch] = grams;
+        _requestReady     |= bit;
+        _requestPending   &= ~bit;
+    }
+    portEXIT_CRITICAL(&_requestLock);
+    _servingRequest = false;
+}
+
+void HX711Scale::requestActivity(uint32_t holdMs)
+{
+    TickType_t now   = xTaskGetTickCount();
+    TickType_t until = now + pdMS_TO_TICKS(holdMs);
+    // Never shorten a longer hold already granted
+    if ((int32_t)(until - _activeUntilTick) > 0)
+        _activeUntilTick = until;
+    _lastActivityTick = now;
+    if (_taskHandle)
+        xTaskNotifyGive(_taskHandle);
+}
+
+void HX711Scale::setFeedingActive(bool active)
+{
+    _feedingHold = active;
+    // Also restarts the continuous hold, so the bowl keeps being followed closely once the feed ends.
+    requestActivity();
+}
+
+void HX711Scale::setSubscribed(bool subscribed)
+{
+    bool wasSubscribed = _subscribed;
+    _subscribed        = subscribed;
+    if (subscribed && !wasSubscribed) {
+        // Fresh subscriber: leave the sparse level right away rather than after the current power-down.
+        _lastActivityTick = xTaskGetTickCount();
+        if (_taskHandle)
+            xTaskNotifyGive(_taskHandle);
+    }
+}
+
+ScaleDutyLevel HX711Scale::_evaluateDutyLevel(TickType_t now)
+{
+    // A replay follows the recorded stream, which no power-down should punch holes into
+    if (_feedingHold || isReplaying() || (int32_t)(_activeUntilTick - now) > 0)
+        return ScaleDutyLevel::CONTINUOUS;
+    if (_subscribed || (now - _lastActivityTick) < pdMS_TO_TICKS(SPARSE_AFTER_QUIET_MS))
+        return ScaleDutyLevel::NORMAL;
+    return ScaleDutyLevel::SPARSE;
+}
+
+uint32_t HX711Scale::_idleDurationMs() const
+{
+    switch (_dutyLevel) {
+        case ScaleDutyLevel::CONTINUOUS:
+            return 0;
+        case ScaleDutyLevel::NORMAL:
+            return NORMAL_IDLE_MS;
+        default:
+            return SPARSE_IDLE_MS;
+    }
+}
+
+// ============================================================================
+// Sampling Task
+// ============================================================================
+
+void HX711Scale::_publishWindow(long avgRaw)
+{
+    ScaleChannel channel = _sampler.getActiveChannel();
+    uint8_t ch           = (uint8_t)channel;
+    // A window entirely blanked by an actuation says nothing about the load cell; keep the last values.
+    if (_sampler.getSampleCount() == 0 && _sampler.getBlankedCount() > 0)
+        return;
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(50)) != pdTRUE)
+        return;
+
+    float avgWeight = NAN;
+    if (_sampler.getSampleCount() > 0) {
+        avgWeight = (float)(avgRaw - _zeroOffset[ch]) / _calibrationFactor[ch];
+        if (channel == ScaleChannel::BOWL) {
+            _deviceState.isBowlWeightStable    = (abs(avgWeight - _deviceState.bowlWeight) < 0.5f);
+            _deviceState.bowlWeight            = avgWeight;
+            _deviceState.bowlRawValue          = avgRaw;
+            _deviceState.isBowlScaleResponding = true;
+        } else {
+            _deviceState.isWeightStable    = (abs(avgWeight - _deviceState.currentWeight) < 0.5f);
+            _deviceState.currentWeight     = avgWeight;
+            _deviceState.currentRawValue   = avgRaw;
+            _deviceState.isScaleResponding = true;
+        }
+
+        // Delivered on the subscribers' tasks: no network or display work in this loop.
+        _weightEvents.publish({ channel, avgWeight, avgRaw, (uint32_t)(esp_timer_get_time() / 100000) });
+    } else if (channel == ScaleChannel::BOWL) {
+        // No valid samples collected
+        _deviceState.isBowlWeightStable    = false;
+        _deviceState.isBowlScaleResponding = false;
+    } else {
+        _deviceState.isWeightStable    = false;
+        _deviceState.isScaleResponding = false;
+    }
+    xSemaphoreGive(_mutex);
+
+    // Motion on either load cell (cat at the bowl, hopper being handled) switches to continuous sampling.
+    if (!std::isnan(avgWeight) && !std::isnan(_lastPublished[ch]) && fabsf(avgWeight - _lastPublished[ch]) >= MOTION_THRESHOLD_GRAMS) {
+        requestActivity();
+    }
+    _lastPublished[ch] = avgWeight;
 }
 
 void HX711Scale::_scaleTask(void* pvParameters)
 {
     HX711Scale* instance = (HX711Scale*)pvParameters;
     ESP_LOGI(TAG, "Scale Task Started. Tare initiated.");
-    instance->tare();
+    HeapGuard::watchCurrentTask();
+    instance->tare(ScaleChannel::HOPPER);
 
     // Initialize state machine
     instance->_state = ScaleState::SAMPLING;
-    instance->_rawSum = 0;
-    instance->_sampleCount = 0;
-    instance->_failureCount = 0;
-    instance->_tickCounter = 0;
-    instance->_idleTickCounter = 0;
-    instance->_settlingCounter = 0;
-    instance->_reportCounter = 0;
+    instance->_sampler.startWindow(ScaleChannel::HOPPER);
+    instance->_phaseStartTick = xTaskGetTickCount();
+    instance->_lastReportTick = instance->_phaseStartTick;
+    instance->_dutyLevel = instance->_evaluateDutyLevel(instance->_phaseStartTick);
 
     for (;;) {
+        TickType_t now   = xTaskGetTickCount();
+        TickType_t delay = pdMS_TO_TICKS(SAMPLE_POLL_MS);
+
+        if (instance->isReplaying() && xSemaphoreTake(instance->_scaleMutex, pdMS_TO_TICKS(5)) == pdTRUE) {
+            instance->_serviceReplay();
+            xSemaphoreGive(instance->_scaleMutex);
+        }
+
         switch (instance->_state) {
             case ScaleState::SAMPLING: {
-                // Timebase 1: collect samples at ~13ms intervals
+                instance->_beginRequestedWindow(now);
+
+                // Timebase 1: poll DOUT often enough to catch every 80Hz conversion
                 if (xSemaphoreTake(instance->_scaleMutex, pdMS_TO_TICKS(5)) == pdTRUE) {
-                    if (instance->_scale.is_ready()) {
-                        long sample = instance->_scale.read();
-                        if (sample != 0) {
-                            instance->_rawSum += sample;
-                            instance->_sampleCount++;
-                        } else {
-                            instance->_failureCount++;
-                        }
+                    if (instance->_isSampleReady()) {
+                        // The gain pulses trailing this read select the input of the *next* conversion.
+                        instance->_scale.set_gain(_gainOf(instance->_sampler.getActiveChannel()));
+                        long sample = instance->_readSample();
+                        // Conversions disturbed by a servo actuation are tagged, and kept out of the average
+                        instance->_sampler.onConversion(sample, instance->isSettledSinceActuation());
                     }
                     xSemaphoreGive(instance->_scaleMutex);
                 }
-                instance->_tickCounter++;
-
-                // Timebase 2: After ~250ms worth of ticks, compute and publish averages
-                if (instance->_tickCounter >= TICKS_PER_AVERAGE) {
-                    if (xSemaphoreTake(instance->_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-                        if (instance->_sampleCount > 0) {
-                            long avgRaw = instance->_rawSum / instance->_sampleCount;
-                            float avgWeight = (float)(avgRaw - instance->_zeroOffset) / instance->_calibrationFactor;
-
-                            instance->_deviceState.isWeightStable = (abs(avgWeight - instance->_deviceState.currentWeight) < 0.5f);
-                            instance->_deviceState.currentWeight = avgWeight;
-                            instance->_deviceState.currentRawValue = avgRaw;
-                            instance->_deviceState.isScaleResponding = true;
-
-                            if (instance->_onWeightChangedCallback) {
-                                instance->_onWeightChangedCallback(avgWeight, avgRaw);
-                            }
-                        } else {
-                            // No valid samples collected
-                            instance->_deviceState.isWeightStable = false;
-                            instance->_deviceState.isScaleResponding = false;
-                        }
-                        xSemaphoreGive(instance->_mutex);
-                    }
+
+                // Timebase 2: After ~250ms, or once a requested window has its samples, compute and publish averages
+                bool windowDone;
+                if (instance->_servingRequest) {
+                    windowDone = instance->_sampler.getSampleCount() >= CALIBRATION_SAMPLES
+                      || instance->_sampler.getFailureCount() >= CALIBRATION_SAMPLES
+                      || (now - instance->_phaseStartTick) >= pdMS_TO_TICKS(REQUEST_WINDOW_MAX_MS);
+                } else {
+                    windowDone = (now - instance->_phaseStartTick) >= pdMS_TO_TICKS(AVERAGE_WINDOW_MS);
+                }
+                if (windowDone) {
+                    long avgRaw = instance->_sampler.getAverage();
+                    instance->_publishWindow(avgRaw);
+                    if (instance->_servingRequest)
+                        instance->_completeRequest(avgRaw);
 
                     // Timebase 3: Report every 5s
-                    instance->_reportCounter++;
+                    if ((now - instance->_lastReportTick) >= pdMS_TO_TICKS(REPORT_PERIOD_MS)) {
+                        instance->_lastReportTick = now;
 #if defined(PRINT_SCALE_STATUS) && !defined(LOG_TO_SPIFFS)
-                    if (instance->_reportCounter >= REPORTS_PERIOD) {
                         if (instance->_deviceState.isScaleResponding) {
-                            ESP_LOGI(TAG, "Scale status: %s, %.2fg (%ld), samples=%u, failures=%u",
+                            ESP_LOGI(TAG, "Hopper status: %s, %.2fg (%ld)",
                                 (instance->_deviceState.isWeightStable ? "stable" : "unstable"),
                                 instance->_deviceState.currentWeight,
-                                instance->_deviceState.currentRawValue,
-                                instance->_sampleCount,
-                                instance->_failureCount);
+                                instance->_deviceState.currentRawValue);
                         } else {
-                            ESP_LOGW(TAG, "Scale status: UNRESPONSIVE!");
+                            ESP_LOGW(TAG, "Hopper status: UNRESPONSIVE!");
                         }
-                        instance->_reportCounter = 0;
-                    }
-#else
-                    if (instance->_reportCounter >= REPORTS_PERIOD) {
-                        instance->_reportCounter = 0;
-                    }
+                        if (instance->_deviceState.isBowlScaleResponding) {
+                            ESP_LOGI(TAG, "Bowl status: %s, %.2fg (%ld)",
+                                (instance->_deviceState.isBowlWeightStable ? "stable" : "unstable"),
+                                instance->_deviceState.bowlWeight,
+                                instance->_deviceState.bowlRawValue);
+                        } else {
+                            ESP_LOGW(TAG, "Bowl status: UNRESPONSIVE!");
+                        }
+                        ESP_LOGI(TAG, "Last window (%s): samples=%u, failures=%u, blanked=%u, duty=%s",
+                          getChannelName(instance->_sampler.getActiveChannel()), instance->_sampler.getSampleCount(),
+                          instance->_sampler.getFailureCount(), instance->_sampler.getBlankedCount(), getDutyLevelName(instance->_dutyLevel));
 #endif
+                    }
 
-                    // Reset accumulators for next window
-                    instance->_rawSum = 0;
-                    instance->_sampleCount = 0;
-                    instance->_failureCount = 0;
-                    instance->_tickCounter = 0;
+                    // Reset accumulators for next window, which averages the other channel
+                    instance->_sampler.nextWindow();
+                    instance->_phaseStartTick = now;
 
-                    // Power down and transition to IDLE
-                    if (xSemaphoreTake(instance->_scaleMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-                        instance->_scale.power_down();
-                        xSemaphoreGive(instance->_scaleMutex);
+                    ScaleDutyLevel level = instance->_evaluateDutyLevel(now);
+                    if (level != instance->_dutyLevel) {
+                        ESP_LOGD(TAG, "Duty level: %s -> %s", getDutyLevelName(instance->_dutyLevel), getDutyLevelName(level));
+                        instance->_dutyLevel = level;
+                    }
+
+                    // Continuous mode keeps the HX711 powered: the next window starts right away,
+                    // the channel switch being absorbed by the discard logic above.
+                    if (level != ScaleDutyLevel::CONTINUOUS) {
+                        if (xSemaphoreTake(instance->_scaleMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+                            instance->_powerDown();
+                            xSemaphoreGive(instance->_scaleMutex);
+                        }
+                        instance->_state = ScaleState::IDLE;
+                        // Drop wake-ups that arrived while sampling, they are already accounted for.
+                        ulTaskNotifyTake(pdTRUE, 0);
+                        delay = pdMS_TO_TICKS(instance->_idleDurationMs());
                     }
-                    instance->_state = ScaleState::IDLE;
-                    instance->_idleTickCounter = 0;
                 }
                 break;
             }
 
             case ScaleState::IDLE: {
-                instance->_idleTickCounter++;
-                // Stay idle for ~200ms, then wake up and allow settling
-                if (instance->_idleTickCounter >= IDLE_TICKS) {
+                // A wake-up request may have raised the duty level since the power-down
+                instance->_dutyLevel = instance->_evaluateDutyLevel(now);
+                uint32_t idleMs      = instance->_idleDurationMs();
+                TickType_t elapsed   = now - instance->_phaseStartTick;
+                if (elapsed >= pdMS_TO_TICKS(idleMs)) {
                     if (xSemaphoreTake(instance->_scaleMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-                        instance->_scale.power_up();
+                        instance->_powerUp();
                         xSemaphoreGive(instance->_scaleMutex);
                     }
-                    instance->_state = ScaleState::SETTLING;
-                    instance->_settlingCounter = 0;
+                    instance->_state          = ScaleState::SETTLING;
+                    instance->_phaseStartTick = now;
+                    delay                     = pdMS_TO_TICKS(SETTLING_MS);
+                } else {
+                    delay = pdMS_TO_TICKS(idleMs) - elapsed;
                 }
                 break;
             }
 
             case ScaleState::SETTLING: {
-                instance->_settlingCounter++;
                 // Wait for settling time (~52ms) before starting to sample
-                if (instance->_settlingCounter >= SETTLING_TICKS) {
-                    instance->_state = ScaleState::SAMPLING;
-                    instance->_tickCounter = 0;
+                if ((now - instance->_phaseStartTick) >= pdMS_TO_TICKS(SETTLING_MS)) {
+                    instance->_state          = ScaleState::SAMPLING;
+                    instance->_phaseStartTick = now;
+                } else {
+                    delay = pdMS_TO_TICKS(SETTLING_MS) - (now - instance->_phaseStartTick);
                 }
                 break;
             }
         }
 
-        vTaskDelay(pdMS_TO_TICKS(TICK_MS));
+        if (delay == 0)
+            delay = 1;
+        scaleJitter.sleeping(delay);
+        if (instance->_state == ScaleState::IDLE) {
+            // Sleep through the power-down, but let requestActivity() cut it short.
+            ulTaskNotifyTake(pdTRUE, delay);
+        } else {
+            vTaskDelay(delay);
+        }
+        scaleJitter.woke();
     }
 }
-
-void HX711Scale::setOnWeightChangedCallback(std::function<void(float, long)> cb) {
-    _onWeightChangedCallback = cb;
-}
@@ -0,0 +1,112 @@
+#include "HeapGuard.hpp"
+
+#ifdef HEAP_STEADY_STATE_CHECK
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+
+static const char* TAG = "HeapGuard";
+
+HeapGuard::WatchedTask HeapGuard::_tasks[HEAP_GUARD_MAX_TASKS] = {};
+volatile bool HeapGuard::_armed                             = false;
+
+void HeapGuard::watchCurrentTask()
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (auto& task : _tasks) {
+        if (task.handle == NULL) {
+            task.handle = self;
+            return;
+        }
+    }
+    ESP_LOGE(TAG, "Cannot watch %s: all %d slots taken.", pcTaskGetName(self), HEAP_GUARD_MAX_TASKS);
+}
+
+void HeapGuard::arm()
+{
+    _armed = true;
+    ESP_LOGI(TAG, "Boot complete, watched tasks must not allocate from now on.");
+}
+
+int8_t HeapGuard::_slotOfCurrentTask()
+{
+    if (xPortInIsrContext())
+        return -1;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int8_t i = 0; i < HEAP_GUARD_MAX_TASKS; i++) {
+        if (_tasks[i].handle == self)
+            return i;
+    }
+    return -1;
+}
+
+void HeapGuard::onAllocation(const void* caller)
+{
+    if (!_armed)
+        return;
+    int8_t slot = _slotOfCurrentTask();
+    if (slot < 0 || _tasks[slot].allowDepth > 0)
+        return;
+    _tasks[slot].violations++;
+    _tasks[slot].lastCaller = caller;
+#ifdef HEAP_STEADY_STATE_ABORT
+    // No logging here: it could allocate, and re-enter this check.
+    esp_rom_printf("HeapGuard: %s allocated from %p after boot.\n", pcTaskGetName(_tasks[slot].handle), caller);
+    abort();
+#endif
+}
+
+void HeapGuard::report(JsonObject obj)
+{
+    obj["armed"]     = (bool)_armed;
+    JsonArray tasks  = obj["tasks"].to<JsonArray>();
+    for (const auto& task : _tasks) {
+        if (task.handle == NULL)
+            continue;
+        JsonObject entry     = tasks.add<JsonObject>();
+        entry["name"]        = pcTaskGetName(task.handle);
+        entry["allocations"] = task.violations;
+        if (task.lastCaller != nullptr) {
+            char caller[12];
+            snprintf(caller, sizeof(caller), "%p", task.lastCaller);
+            entry["lastCaller"] = caller;
+        }
+    }
+}
+
+HeapGuard::Allow::Allow(bool allow) : _slot(allow ? _slotOfCurrentTask() : -1)
+{
+    if (_slot >= 0)
+        _tasks[_slot].allowDepth++;
+}
+
+HeapGuard::Allow::~Allow()
+{
+    if (_slot >= 0)
+        _tasks[_slot].allowDepth--;
+}
+
+// Linked in place of the C allocator entry points by -Wl,--wrap; operator new goes through malloc.
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    HeapGuard::onAllocation(__builtin_return_address(0));
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    HeapGuard::onAllocation(__builtin_return_address(0));
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    HeapGuard::onAllocation(__builtin_return_address(0));
+    return __real_realloc(ptr, size);
+}
+}
+#endif
@@ -0,0 +1,235 @@
+#include "I2CManager.hpp"
+#include "esp_log.h"
+#include <cstring>
+
+static const char* TAG = "I2CManager";
+
+I2CManager::I2CManager(TwoWire& wire)
+    : _wire(wire), _taskHandle(NULL), _queueMutex(NULL), _depth(0), _autoIncrement { 0, 0, 0, 0 }, _coalescedCount(0), _cancelledCount(0),
+      _maxDepth(0)
+{
+    for (auto& queue : _queues) {
+        queue.head  = 0;
+        queue.count = 0;
+    }
+}
+
+bool I2CManager::begin()
+{
+    if (_taskHandle != NULL)
+        return true;
+    _queueMutex = xSemaphoreCreateMutex();
+    if (_queueMutex == NULL) {
+        ESP_LOGE(TAG, "Could not create queue mutex.");
+        return false;
+    }
+    _wire.begin();
+    _taskHandle = xTaskCreateStatic(I2CManager::_task, "I2C", I2C_TASK_STACK_SIZE, this, I2C_TASK_PRIORITY, _taskStack, &_taskBuffer);
+    return true;
+}
+
+void I2CManager::setAutoIncrement(uint8_t address, bool enabled)
+{
+    uint32_t bit = 1UL << (address & 31);
+    if (enabled)
+        _autoIncrement[(address >> 5) & 3] |= bit;
+    else
+        _autoIncrement[(address >> 5) & 3] &= ~bit;
+}
+
+I2CResult_e I2CManager::write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t len, I2CPriority priority, I2CCompletion onComplete,
+  void* context)
+{
+    if (len > I2C_MAX_WRITE_LEN || (len > 0 && data == nullptr))
+        return I2CREZ_DATA_TOO_LONG;
+
+    Transaction transaction;
+    transaction.address          = address;
+    transaction.reg              = reg;
+    transaction.len              = len;
+    transaction.cancelled        = false;
+    transaction.operation        = nullptr;
+    transaction.operationContext = nullptr;
+    transaction.completionCount  = onComplete ? 1 : 0;
+    transaction.completions[0]   = { onComplete, context };
+    if (len)
+        memcpy(transaction.data, data, len);
+
+    if (_taskHandle == NULL) { // Not started yet: plain blocking write
+        I2CResult_e result = _run(transaction);
+        _complete(transaction, result);
+        return result;
+    }
+    return _enqueue(transaction, priority);
+}
+
+namespace {
+/** @brief What an execute() caller waits upon, on its own stack. */
+struct ExecuteWait {
+    SemaphoreHandle_t done;
+    I2CResult_e result;
+};
+} // namespace
+
+void I2CManager::_signalDone(I2CResult_e result, void* context)
+{
+    ExecuteWait* wait = (ExecuteWait*)context;
+    wait->result      = result;
+    xSemaphoreGive(wait->done);
+}
+
+I2CResult_e I2CManager::_execute(OperationFn operation, void* context, I2CPriority priority)
+{
+    if (_taskHandle == NULL || xTaskGetCurrentTaskHandle() == _taskHandle)
+        return operation(_wire, context);
+
+    StaticSemaphore_t doneBuffer;
+    ExecuteWait wait = { xSemaphoreCreateBinaryStatic(&doneBuffer), I2CREZ_OTHER };
+    Transaction transaction;
+    transaction.address          = 0;
+    transaction.reg              = 0;
+    transaction.len              = 0;
+    transaction.cancelled        = false;
+    transaction.operation        = operation;
+    transaction.operationContext = context;
+    transaction.completionCount  = 1;
+    transaction.completions[0]   = { &I2CManager::_signalDone, &wait };
+    I2CResult_e queued = _enqueue(transaction, priority);
+    if (queued != I2CREZ_OK) {
+        vSemaphoreDelete(wait.done);
+        return queued;
+    }
+    // No timeout: the operation, the semaphore and the result live on the stack until the I2C task is done with them.
+    xSemaphoreTake(wait.done, portMAX_DELAY);
+    vSemaphoreDelete(wait.done);
+    return wait.result;
+}
+
+I2CResult_e I2CManager::_enqueue(const Transaction& transaction, I2CPriority priority)
+{
+    if (xSemaphoreTake(_queueMutex, portMAX_DELAY) != pdTRUE)
+        return I2CREZ_OTHER;
+
+    if (priority == I2CPriority::EMERGENCY && !transaction.operation) {
+        // Pending writes to this device would undo the emergency command once it has run.
+        // They keep their slot, the I2C task reports them as cancelled without running them.
+        for (uint8_t p = (uint8_t)I2CPriority::CONTROL; p < I2C_PRIORITY_COUNT; p++) {
+            Ring& queue = _queues[p];
+            for (uint8_t i = 0; i < queue.count; i++) {
+                Transaction& pending = queue.at(i);
+                if (!pending.operation && !pending.cancelled && pending.address == transaction.address) {
+                    pending.cancelled = true;
+                    _cancelledCount++;
+                }
+            }
+        }
+    }
+
+    Ring& queue        = _queues[(uint8_t)priority];
+    I2CResult_e result = I2CREZ_OK;
+    if (!transaction.operation && _coalesce(queue, transaction)) {
+        _coalescedCount++;
+    } else if (queue.count >= I2C_QUEUE_DEPTH || (priority != I2CPriority::EMERGENCY && _depth >= I2C_QUEUE_DEPTH)) {
+        result = I2CREZ_QUEUE_FULL;
+    } else {
+        queue.at(queue.count) = transaction;
+        queue.count++;
+        _depth++;
+        if (_depth > _maxDepth)
+            _maxDepth = _depth;
+    }
+    xSemaphoreGive(_queueMutex);
+
+    if (result == I2CREZ_OK)
+        xTaskNotifyGive(_taskHandle);
+    else
+        ESP_LOGW(TAG, "Queue full, write to 0x%02X dropped.", transaction.address);
+    return result;
+}
+
+bool I2CManager::_coalesce(Ring& queue, const Transaction& transaction)
+{
+    if (queue.count == 0)
+        return false;
+    Transaction& last = queue.back();
+    if (last.operation || last.cancelled || last.address != transaction.address)
+        return false;
+    if (last.completionCount + transaction.completionCount > I2C_MAX_COMPLETIONS)
+        return false;
+
+    uint16_t lastEnd = (uint16_t)last.reg + last.len;
+    uint16_t newEnd  = (uint16_t)transaction.reg + transaction.len;
+    if (transaction.reg >= last.reg && newEnd <= lastEnd) {
+        // Same registers again: the newest values win.
+        memcpy(last.data + (transaction.reg - last.reg), transaction.data, transaction.len);
+    } else if (transaction.reg == lastEnd && _isAutoIncrement(transaction.address) && last.len + transaction.len <= I2C_MAX_WRITE_LEN) {
+        // Next registers: one burst instead of two transactions.
+        memcpy(last.data + last.len, transaction.data, transaction.len);
+        last.len += transaction.len;
+    } else {
+        return false;
+    }
+
+    // Both callers are told, in the order they queued
+    for (uint8_t i = 0; i < transaction.completionCount; i++)
+        last.completions[last.completionCount++] = transaction.completions[i];
+    return true;
+}
+
+bool I2CManager::_dequeue(Transaction& out)
+{
+    bool found = false;
+    if (xSemaphoreTake(_queueMutex, portMAX_DELAY) != pdTRUE)
+        return false;
+    for (auto& queue : _queues) {
+        if (queue.count > 0) {
+            out        = queue.at(0);
+            queue.head = (queue.head + 1) % I2C_QUEUE_DEPTH;
+            queue.count--;
+            _depth--;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(_queueMutex);
+    return found;
+}
+
+void I2CManager::_complete(const Transaction& transaction, I2CResult_e result)
+{
+    for (uint8_t i = 0; i < transaction.completionCount; i++)
+        transaction.completions[i].callback(result, transaction.completions[i].context);
+}
+
+I2CResult_e I2CManager::_run(Transaction& transaction)
+{
+    if (transaction.operation)
+        return transaction.operation(_wire, transaction.operationContext);
+    _wire.beginTransmission(transaction.address);
+    _wire.write(transaction.reg);
+    _wire.write(transaction.data, transaction.len);
+    return (I2CResult_e)_wire.endTransmission();
+}
+
+void I2CManager::_task(void* pvParam)
+{
+    if (pvParam == nullptr)
+        return;
+    I2CManager* pInst = (I2CManager*)pvParam;
+    Transaction transaction;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Re-checks the queues after each transaction, so an emergency write never waits for more than one.
+        while (pInst->_dequeue(transaction)) {
+            if (transaction.cancelled) {
+                _complete(transaction, I2CREZ_CANCELLED);
+                continue;
+            }
+            I2CResult_e result = pInst->_run(transaction);
+            if (result != I2CREZ_OK)
+                ESP_LOGW(TAG, "Transaction with 0x%02X failed (error #%d)", transaction.address, result);
+            _complete(transaction, result);
+        }
+    }
+}
@@ -0,0 +1,380 @@
+#include "JsonFields.hpp"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+static inline void* memberOf(void* base, const JsonField& field)
+{
+    return static_cast<uint8_t*>(base) + field.offset;
+}
+
+static inline const void* memberOf(const void* base, const JsonField& field)
+{
+    return static_cast<const uint8_t*>(base) + field.offset;
+}
+
+static bool isHexUid(const char* str)
+{
+    size_t len = strlen(str);
+    if (len == 0 || len > 16)
+        return false;
+    for (size_t i = 0; i < len; i++) {
+        if (!isxdigit((unsigned char)str[i]))
+            return false;
+    }
+    return true;
+}
+
+/** @brief Whether @p memberValue fits in the member type, for the types narrower than 64 bits. */
+static bool fitsMemberType(JsonFieldType type, double memberValue)
+{
+    switch (type) {
+        case JsonFieldType::Int8:
+            return memberValue >= INT8_MIN && memberValue <= INT8_MAX;
+        case JsonFieldType::Int32:
+            return memberValue >= INT32_MIN && memberValue <= INT32_MAX;
+        case JsonFieldType::UInt8:
+            return memberValue >= 0 && memberValue <= UINT8_MAX;
+        case JsonFieldType::UInt16:
+            return memberValue >= 0 && memberValue <= UINT16_MAX;
+        case JsonFieldType::UInt32:
+            return memberValue >= 0 && memberValue <= UINT32_MAX;
+        default:
+            return true;
+    }
+}
+
+template <typename T> static void storeNumber(void* member, JsonVariantConst value, double scale)
+{
+    if (scale == 1.0) {
+        *static_cast<T*>(member) = value.as<T>();
+    } else if (std::is_floating_point<T>::value) {
+        *static_cast<T*>(member) = (T)(value.as<double>() / scale);
+    } else {
+        *static_cast<T*>(member) = (T)llround(value.as<double>() / scale);
+    }
+}
+
+template <typename T> static void writeNumber(JsonObject dst, const char* key, const void* member, double scale)
+{
+    // Unscaled values keep their type, so that a float is printed with a float's precision.
+    if (scale == 1.0)
+        dst[key] = *static_cast<const T*>(member);
+    else
+        dst[key] = (double)*static_cast<const T*>(member) * scale;
+}
+
+template <typename T> static void resetNumber(void* member, double fallback)
+{
+    *static_cast<T*>(member) = (T)fallback;
+}
+
+bool JsonFields::_skipped(const JsonField& field, JsonFieldFormat format)
+{
+    return format == JsonFieldFormat::Api && (field.flags & JSON_FIELD_READ_ONLY);
+}
+
+/** @brief Whether @p value has the JSON type of @p field, without looking at its bounds. */
+static bool hasType(const JsonField& field, JsonVariantConst value)
+{
+    switch (field.type) {
+        case JsonFieldType::Bool:
+            return value.is<bool>();
+        case JsonFieldType::String:
+            return value.is<const char*>();
+        case JsonFieldType::Object:
+            return value.is<JsonObjectConst>();
+        case JsonFieldType::Array:
+            return value.is<JsonArrayConst>();
+        default:
+            if ((field.flags & JSON_FIELD_HEX) && value.is<const char*>())
+                return isHexUid(value.as<const char*>());
+            return value.is<double>();
+    }
+}
+
+void JsonFields::reset(void* target, const JsonFieldList& list)
+{
+    for (size_t i = 0; i < list.count; i++) {
+        const JsonField& field = list.fields[i];
+        void* member           = memberOf(target, field);
+        switch (field.type) {
+            case JsonFieldType::Bool:
+                *static_cast<bool*>(member) = field.fallback != 0.0;
+                break;
+            case JsonFieldType::Int8:
+                resetNumber<int8_t>(member, field.fallback);
+                break;
+            case JsonFieldType::Int32:
+                resetNumber<int32_t>(member, field.fallback);
+                break;
+            case JsonFieldType::Int64:
+                resetNumber<int64_t>(member, field.fallback);
+                break;
+            case JsonFieldType::UInt8:
+                resetNumber<uint8_t>(member, field.fallback);
+                break;
+            case JsonFieldType::UInt16:
+                resetNumber<uint16_t>(member, field.fallback);
+                break;
+            case JsonFieldType::UInt32:
+                resetNumber<uint32_t>(member, field.fallback);
+                break;
+            case JsonFieldType::UInt64:
+                resetNumber<uint64_t>(member, field.fallback);
+                break;
+            case JsonFieldType::Float:
+                resetNumber<float>(member, field.fallback);
+                break;
+            case JsonFieldType::Double:
+                resetNumber<double>(member, field.fallback);
+                break;
+            case JsonFieldType::String:
+                static_cast<std::string*>(member)->clear();
+                break;
+            case JsonFieldType::Object:
+                reset(member, *static_cast<const JsonFieldList*>(field.nested));
+                break;
+            case JsonFieldType::Array:
+                static_cast<const JsonFieldVector*>(field.nested)->clear(member);
+                break;
+        }
+    }
+}
+
+void JsonFields::write(JsonObject dst, const void* source, const JsonFieldList& list, JsonFieldFormat format)
+{
+    for (size_t i = 0; i < list.count; i++) {
+        const JsonField& field = list.fields[i];
+        const void* member     = memberOf(source, field);
+        switch (field.type) {
+            case JsonFieldType::Bool:
+                dst[field.key] = *static_cast<const bool*>(member);
+                break;
+            case JsonFieldType::Int8:
+                writeNumber<int8_t>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::Int32:
+                writeNumber<int32_t>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::Int64:
+                writeNumber<int64_t>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::UInt8:
+                writeNumber<uint8_t>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::UInt16:
+                writeNumber<uint16_t>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::UInt32:
+                writeNumber<uint32_t>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::UInt64:
+                if ((field.flags & JSON_FIELD_HEX) && format == JsonFieldFormat::Api) {
+                    char hex[17];
+                    snprintf(hex, sizeof(hex), "%llX", (unsigned long long)*static_cast<const uint64_t*>(member));
+                    dst[field.key] = hex;
+                } else {
+                    writeNumber<uint64_t>(dst, field.key, member, field.scale);
+                }
+                break;
+            case JsonFieldType::Float:
+                writeNumber<float>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::Double:
+                writeNumber<double>(dst, field.key, member, field.scale);
+                break;
+            case JsonFieldType::String:
+                dst[field.key] = *static_cast<const std::string*>(member);
+                break;
+            case JsonFieldType::Object:
+                write(dst[field.key].to<JsonObject>(), member, *static_cast<const JsonFieldList*>(field.nested), format);
+                break;
+            case JsonFieldType::Array: {
+                const JsonFieldVector* vec = static_cast<const JsonFieldVector*>(field.nested);
+                JsonArray array            = dst[field.key].to<JsonArray>();
+                size_t count               = vec->size(member);
+                for (size_t e = 0; e < count; e++)
+                    write(array.add<JsonObject>(), vec->at(member, e), *vec->element, format);
+                break;
+            }
+        }
+    }
+}
+
+/** @brief Checks one present value against its field, recursing into objects and arrays. */
+static JsonFieldError::Reason checkValue(const JsonField& field, JsonVariantConst value, JsonFieldFormat format,
+  JsonFieldError& nestedError)
+{
+    if (!hasType(field, value))
+        return JsonFieldError::WRONG_TYPE;
+
+    switch (field.type) {
+        case JsonFieldType::Bool:
+            return JsonFieldError::NONE;
+        case JsonFieldType::String: {
+            double len = (double)strlen(value.as<const char*>());
+            return (len < field.min || len > field.max) ? JsonFieldError::OUT_OF_RANGE : JsonFieldError::NONE;
+        }
+        case JsonFieldType::Object:
+            nestedError = JsonFields::validate(value.as<JsonObjectConst>(), *static_cast<const JsonFieldList*>(field.nested), format);
+            return nestedError.reason;
+        case JsonFieldType::Array: {
+            const JsonFieldList& element = *static_cast<const JsonFieldVector*>(field.nested)->element;
+            for (JsonVariantConst item : value.as<JsonArrayConst>()) {
+                if (!item.is<JsonObjectConst>())
+                    return JsonFieldError::WRONG_TYPE;
+                nestedError = JsonFields::validate(item.as<JsonObjectConst>(), element, format);
+                if (nestedError)
+                    return nestedError.reason;
+            }
+            return JsonFieldError::NONE;
+        }
+        default:
+            break;
+    }
+
+    if (value.is<const char*>())
+        return JsonFieldError::NONE; // A hex UID, already checked by hasType()
+    double number = value.as<double>();
+    if (number < field.min || number > field.max || !fitsMemberType(field.type, number / field.scale))
+        return JsonFieldError::OUT_OF_RANGE;
+    return JsonFieldError::NONE;
+}
+
+JsonFieldError JsonFields::validate(JsonObjectConst src, const JsonFieldList& list, JsonFieldFormat format)
+{
+    JsonFieldError error;
+    if (format == JsonFieldFormat::Storage)
+        return error;
+    for (size_t i = 0; i < list.count; i++) {
+        const JsonField& field = list.fields[i];
+        if (_skipped(field, format))
+            continue;
+        JsonVariantConst value = src[field.key];
+        if (value.isNull()) {
+            if (field.flags & JSON_FIELD_REQUIRED) {
+                error.field  = &field;
+                error.reason = JsonFieldError::MISSING;
+                return error;
+            }
+            continue;
+        }
+        JsonFieldError nested;
+        JsonFieldError::Reason reason = checkValue(field, value, format, nested);
+        if (nested)
+            return nested; // Reports the innermost offending field
+        if (reason != JsonFieldError::NONE) {
+            error.field  = &field;
+            error.reason = reason;
+            return error;
+        }
+    }
+    return error;
+}
+
+JsonFieldError JsonFields::read(JsonObjectConst src, void* target, const JsonFieldList& list, JsonFieldFormat format)
+{
+    JsonFieldError error = validate(src, list, format);
+    if (!error)
+        _apply(src, target, list, format);
+    return error;
+}
+
+void JsonFields::_apply(JsonObjectConst src, void* target, const JsonFieldList& list, JsonFieldFormat format)
+{
+    for (size_t i = 0; i < list.count; i++) {
+        const JsonField& field = list.fields[i];
+        JsonVariantConst value = src[field.key];
+        if (value.isNull() || _skipped(field, format))
+            continue;
+        void* member = memberOf(target, field);
+        // Storage data is not validated: a value of the wrong type leaves the member as it was.
+        if (format == JsonFieldFormat::Storage && !hasType(field, value))
+            continue;
+        switch (field.type) {
+            case JsonFieldType::Bool:
+                *static_cast<bool*>(member) = value.as<bool>();
+                break;
+            case JsonFieldType::Int8:
+                storeNumber<int8_t>(member, value, field.scale);
+                break;
+            case JsonFieldType::Int32:
+                storeNumber<int32_t>(member, value, field.scale);
+                break;
+            case JsonFieldType::Int64:
+                storeNumber<int64_t>(member, value, field.scale);
+                break;
+            case JsonFieldType::UInt8:
+                storeNumber<uint8_t>(member, value, field.scale);
+                break;
+            case JsonFieldType::UInt16:
+                storeNumber<uint16_t>(member, value, field.scale);
+                break;
+            case JsonFieldType::UInt32:
+                storeNumber<uint32_t>(member, value, field.scale);
+                break;
+            case JsonFieldType::UInt64:
+                if (value.is<const char*>())
+                    *static_cast<uint64_t*>(member) = strtoull(value.as<const char*>(), nullptr, 16);
+                else
+                    storeNumber<uint64_t>(member, value, field.scale);
+                break;
+            case JsonFieldType::Float:
+                storeNumber<float>(member, value, field.scale);
+                break;
+            case JsonFieldType::Double:
+                storeNumber<double>(member, value, field.scale);
+                break;
+            case JsonFieldType::String:
+                *static_cast<std::string*>(member) = value.as<const char*>();
+                break;
+            case JsonFieldType::Object:
+                _apply(value.as<JsonObjectConst>(), member, *static_cast<const JsonFieldList*>(field.nested), format);
+                break;
+            case JsonFieldType::Array: {
+                const JsonFieldVector* vec = static_cast<const JsonFieldVector*>(field.nested);
+                vec->clear(member);
+                for (JsonVariantConst item : value.as<JsonArrayConst>()) {
+                    if (!item.is<JsonObjectConst>())
+                        continue;
+                    void* element = vec->append(member);
+                    reset(element, *vec->element);
+                    _apply(item.as<JsonObjectConst>(), element, *vec->element, format);
+                }
+                break;
+            }
+        }
+    }
+}
+
+void JsonFieldError::toJson(char* buf, size_t len) const
+{
+    const char* key = field ? field->key : "body";
+    switch (reason) {
+        case MISSING:
+            snprintf(buf, len, "{\"error\":\"%s is required\"}", key);
+            break;
+        case WRONG_TYPE:
+            snprintf(buf, len, "{\"error\":\"%s has the wrong type\"}", key);
+            break;
+        case OUT_OF_RANGE: {
+            const char* unit = field->type == JsonFieldType::String ? " characters" : "";
+            if (!std::isnan(field->min) && !std::isnan(field->max))
+                snprintf(buf, len, "{\"error\":\"%s must be between %g and %g%s\"}", key, field->min, field->max, unit);
+            else if (!std::isnan(field->min))
+                snprintf(buf, len, "{\"error\":\"%s must be at least %g%s\"}", key, field->min, unit);
+            else if (!std::isnan(field->max))
+                snprintf(buf, len, "{\"error\":\"%s must be at most %g%s\"}", key, field->max, unit);
+            else
+                snprintf(buf, len, "{\"error\":\"%s is out of range\"}", key);
+            break;
+        }
+        default:
+            snprintf(buf, len, "{\"success\":true}");
+            break;
+    }
+}
@@ -36,14 +36,14 @@
  *  @brief  Instantiates a new PCA9685 PWM driver chip with the I2C address on a
  * TwoWire interface
  */
-PCA9685::PCA9685() : _i2caddr(PCA9685_I2C_ADDRESS), _i2c(&Wire) {}
+PCA9685::PCA9685() : _i2caddr(PCA9685_I2C_ADDRESS), _i2c(&Wire), _bus(nullptr) {}
 
 /*!
  *  @brief  Instantiates a new PCA9685 PWM driver chip with the I2C address on a
  * TwoWire interface
  *  @param  addr The 7-bit I2C address to locate this chip, default is 0x40
  */
-PCA9685::PCA9685(const uint8_t addr) : _i2caddr(addr), _i2c(&Wire) {}
+PCA9685::PCA9685(const uint8_t addr) : _i2caddr(addr), _i2c(&Wire), _bus(nullptr) {}
 
 /*!
  *  @brief  Instantiates a new PCA9685 PWM driver chip with the I2C address on a
@@ -52,7 +52,15 @@ PCA9685::PCA9685(const uint8_t addr) : _i2caddr(addr), _i2c(&Wire) {}
  *  @param  i2c  A reference to a 'TwoWire' object that we'll use to communicate
  *  with
  */
-PCA9685::PCA9685(const uint8_t addr, TwoWire& i2c) : _i2caddr(addr), _i2c(&i2c) {}
+PCA9685::PCA9685(const uint8_t addr, TwoWire& i2c) : _i2caddr(addr), _i2c(&i2c), _bus(nullptr) {}
+
+/*!
+ *  @brief  Instantiates a new PCA9685 PWM driver chip whose transactions are
+ * queued on an I2CManager
+ *  @param  addr The 7-bit I2C address to locate this chip, default is 0x40
+ *  @param  bus  The I2CManager owning the TwoWire interface
+ */
+PCA9685::PCA9685(const uint8_t addr, I2CManager& bus) : _i2caddr(addr), _i2c(&bus.getWire()), _bus(&bus) {}
 
 /*!
  *  @brief  Setups the I2C interface and hardware
@@ -61,7 +69,8 @@ PCA9685::PCA9685(const uint8_t addr, TwoWire& i2c) : _i2caddr(addr), _i2c(&i2c)
  */
 void PCA9685::begin(uint8_t prescale)
 {
-    _i2c->begin();
+    if (_bus == nullptr)
+        _i2c->begin(); // Otherwise started by I2CManager::begin()
     reset();
     if (prescale) {
         setExtClk(prescale);
@@ -168,6 +177,8 @@ void PCA9685::setPWMFreq(float freq)
     delay(5);
     // This sets the MODE1 register to turn on auto increment.
     write8(PCA9685_MODE1, oldmode | MODE1_RESTART | MODE1_AI);
+    if (_bus != nullptr)
+        _bus->setAutoIncrement(_i2caddr, true); // lets the manager merge writes to consecutive channels
 
 #ifdef PCA9685_DEBUG_ENABLED
     Serial.print("Mode now 0x");
@@ -216,8 +227,17 @@ uint8_t PCA9685::readPrescale(void)
  */
 uint8_t PCA9685::getPWM(uint8_t num)
 {
-    _i2c->requestFrom((int)_i2caddr, PCA9685_LED0_ON_L + 4 * num, (int)4);
-    return _i2c->read();
+    uint8_t value = 0;
+    auto op       = [this, num, &value](TwoWire& wire) -> I2CResult_e {
+        wire.requestFrom((int)_i2caddr, PCA9685_LED0_ON_L + 4 * num, (int)4);
+        value = wire.read();
+        return I2CREZ_OK;
+    };
+    if (_bus != nullptr)
+        _bus->execute(op);
+    else
+        op(*_i2c);
+    return value;
 }
 
 /*!
@@ -238,22 +258,44 @@ PCA9685::I2C_Result_e PCA9685::setPWM(int8_t num, uint16_t on, uint16_t off)
     Serial.println(off);
 #endif
 
+    uint8_t reg     = num > -1 ? (uint8_t)(PCA9685_LED0_ON_L + 4 * num) : (uint8_t)PCA9685_ALLLED_ON_L;
+    uint8_t data[4] = { (uint8_t)on, (uint8_t)(on >> 8), (uint8_t)off, (uint8_t)(off >> 8) };
+    if (_bus != nullptr) {
+        return (I2C_Result_e)_bus->execute([this, reg, &data](TwoWire& wire) -> I2CResult_e {
+            wire.beginTransmission(_i2caddr);
+            wire.write(reg);
+            wire.write(data, sizeof(data));
+            return (I2CResult_e)wire.endTransmission();
+        });
+    }
+
     _i2c->beginTransmission(_i2caddr);
+    _i2c->write(reg);
+    _i2c->write(data, sizeof(data));
+    return (I2C_Result_e)_i2c->endTransmission();
+}
 
-    if (num > -1) {
-        _i2c->write(PCA9685_LED0_ON_L + 4 * num);
-        _i2c->write(on);
-        _i2c->write(on >> 8);
-        _i2c->write(off);
-        _i2c->write(off >> 8);
-    } else {
-        _i2c->write(PCA9685_ALLLED_ON_L);
-        _i2c->write(on);
-        _i2c->write(on >> 8);
-        _i2c->write(off);
-        _i2c->write(off >> 8);
+/*!
+ *  @brief  Queues the PWM output of one or all of the PCA9685 pins
+ *  @param  num One of the PWM[0:15] output pins, or -1 so set all channels in one go.
+ *  @param  on At what point in the 4096-part cycle to turn the PWM output ON
+ *  @param  off At what point in the 4096-part cycle to turn the PWM output OFF
+ *  @param  priority Queue to use, I2CPriority::EMERGENCY cancelling the pending writes of this chip
+ *  @param  onComplete Called from the I2C task with the result of the transaction
+ *  @param  context Passed to @p onComplete
+ *  @return I2C_Ok once queued
+ */
+PCA9685::I2C_Result_e PCA9685::queuePWM(int8_t num, uint16_t on, uint16_t off, I2CPriority priority, I2CCompletion onComplete, void* context)
+{
+    if (_bus == nullptr) {
+        I2C_Result_e result = setPWM(num, on, off);
+        if (onComplete)
+            onComplete((I2CResult_e)result, context);
+        return result;
     }
-    return (I2C_Result_e)_i2c->endTransmission();
+    uint8_t reg     = num > -1 ? (uint8_t)(PCA9685_LED0_ON_L + 4 * num) : (uint8_t)PCA9685_ALLLED_ON_L;
+    uint8_t data[4] = { (uint8_t)on, (uint8_t)(on >> 8), (uint8_t)off, (uint8_t)(off >> 8) };
+    return (I2C_Result_e)_bus->write(_i2caddr, reg, data, sizeof(data), priority, onComplete, context);
 }
 
 
@@ -331,18 +373,33 @@ void PCA9685::setOscillatorFrequency(uint32_t freq)
 /******************* Low level I2C interface */
 uint8_t PCA9685::read8(uint8_t addr)
 {
-    _i2c->beginTransmission(_i2caddr);
-    _i2c->write(addr);
-    _i2c->endTransmission();
-
-    _i2c->requestFrom((uint8_t)_i2caddr, (uint8_t)1);
-    return _i2c->read();
+    uint8_t value = 0;
+    auto op       = [this, addr, &value](TwoWire& wire) -> I2CResult_e {
+        wire.beginTransmission(_i2caddr);
+        wire.write(addr);
+        I2CResult_e result = (I2CResult_e)wire.endTransmission();
+
+        wire.requestFrom((uint8_t)_i2caddr, (uint8_t)1);
+        value = wire.read();
+        return result;
+    };
+    if (_bus != nullptr)
+        _bus->execute(op);
+    else
+        op(*_i2c);
+    return value;
 }
 
 void PCA9685::write8(uint8_t addr, uint8_t d)
 {
-    _i2c->beginTransmission(_i2caddr);
-    _i2c->write(addr);
-    _i2c->write(d);
-    _i2c->endTransmission();
+    auto op = [this, addr, d](TwoWire& wire) -> I2CResult_e {
+        wire.beginTransmission(_i2caddr);
+        wire.write(addr);
+        wire.write(d);
+        return (I2CResult_e)wire.endTransmission();
+    };
+    if (_bus != nullptr)
+        _bus->execute(op);
+    else
+        op(*_i2c);
 }
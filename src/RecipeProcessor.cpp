@@ -1,4 +1,5 @@
 #include "RecipeProcessor.hpp"
+#include "HeapGuard.hpp"
 #include "esp_log.h"
 #include <algorithm>
 #include <cmath>
@@ -7,13 +8,22 @@ static const char* TAG = "RecipeProcessor";
 
 RecipeProcessor::RecipeProcessor(
   DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager, TankManager& tankManager, HX711Scale& scale)
-    : _deviceState(deviceState), _mutex(mutex), _configManager(configManager), _tankManager(tankManager), _scale(scale)
+    : _deviceState(deviceState), _mutex(mutex), _configManager(configManager), _tankManager(tankManager), _scale(scale),
+      _stopRequested(false), _lastSuccess(false), _meal {}, _batch {}, _failedGeneration(0), _lastFirstKibbleMs(0),
+      _lastFeedWasStaged(false)
 {
     _ctx.reset();
+    // Sized once, so that starting a feed copies into them without allocating.
+    _ctx.ingredients.reserve(MAX_INGREDIENTS);
+    _ctx.recipeName.reserve(RECIPE_NAME_RESERVE);
 }
 
 void RecipeProcessor::begin()
 {
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        _deviceState.feedingHistory.reserve(FEEDING_HISTORY_MAX);
+        xSemaphoreGive(_mutex);
+    }
     _loadRecipesFromNVS();
     ESP_LOGI(TAG, "Loaded %d recipes from NVS.", _recipes.size());
 }
@@ -27,7 +37,7 @@ HX711Scale& RecipeProcessor::getScale()
 // Public Feed Methods
 // ============================================================================
 
-bool RecipeProcessor::executeImmediateFeed(const uint64_t tankUid, float targetWeight)
+bool RecipeProcessor::startImmediateFeed(const uint64_t tankUid, float targetWeight)
 {
     if (tankUid == 0) {
         ESP_LOGE(TAG, "Immediate feed failed: No tank UID provided.");
@@ -51,52 +61,20 @@ bool RecipeProcessor::executeImmediateFeed(const uint64_t tankUid, float targetW
 
     ESP_LOGI(TAG, "Starting immediate feed of %.2fg from tank 0x%016llx", targetWeight, tankUid);
 
-    // Create a single-ingredient list for immediate feed
-    std::vector<RecipeIngredient> ingredients;
+    // A single ingredient for immediate feed
     RecipeIngredient ingredient;
     ingredient.tankUid = tankUid;
     ingredient.percentage = 100.0f;
-    ingredients.push_back(ingredient);
 
     // Prepare context (recipeUid = 0 for immediate feed, servings = 1)
-    _prepareDispensingContext(0, ingredients, targetWeight, 1);
-
-    // Execute dispensing cycles until complete
-    bool success = true;
-    while (_hasMoreToDispense() && success) {
-        if (_checkEmergencyStop()) {
-            _handleError(DispensingError::ERR_EMERGENCY_STOP);
-            success = false;
-            break;
-        }
-        success = _executeCycle();
-        if (success) {
-            vTaskDelay(pdMS_TO_TICKS(POST_BATCH_DELAY_MS));
-        }
-    }
-
-    // Final purge to release last batch, then close hopper
-    if (success) {
-        ESP_LOGI(TAG, "Final purge to release last batch.");
-        _purgeHopper();
-        ESP_LOGI(TAG, "Closing hopper to idle position.");
-        _tankManager.closeHopper();
-    }
-
-    // Log the immediate feeding event
-    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
-        FeedingHistoryEntry entry(time(nullptr), "immediate", 0, success, _ctx.dispensedGrams, "Immediate Feed");
-        _deviceState.feedingHistory.push_back(entry);
-        xSemaphoreGive(_mutex);
-    }
-
-    ESP_LOGI(TAG, "Immediate feed %s. Dispensed %.2fg of %.2fg target.",
-             success ? "completed" : "failed", _ctx.dispensedGrams, targetWeight);
-
-    return success;
+    _prepareDispensingContext(0, &ingredient, 1, targetWeight, 1);
+    _ctx.recipeName = "Immediate Feed";
+    _applyStagedBatch(0, 1);
+    _beginOperation(DispensingOperation::OP_IMMEDIATE);
+    return true;
 }
 
-bool RecipeProcessor::executeRecipeFeed(uint32_t recipeUid, int servings)
+bool RecipeProcessor::startRecipeFeed(uint32_t recipeUid, int servings)
 {
     auto it = std::find_if(_recipes.begin(), _recipes.end(), [recipeUid](const Recipe& r) { return r.uid == recipeUid; });
 
@@ -109,7 +87,7 @@ bool RecipeProcessor::executeRecipeFeed(uint32_t recipeUid, int servings)
         return false;
     }
 
-    Recipe& recipe = *it;
+    const Recipe& recipe = *it;
 
     // Validate servings: must be >= 1, default to 3 if invalid
     if (servings < 1) {
@@ -117,72 +95,243 @@ bool RecipeProcessor::executeRecipeFeed(uint32_t recipeUid, int servings)
         servings = DEFAULT_SERVINGS;
     }
 
-    // Validate recipe.servings for portion calculation
-    int recipeServings = recipe.servings;
-    if (recipeServings <= 0) {
-        ESP_LOGW(TAG, "Recipe '%s' has invalid servings %d, defaulting to %d.",
-                 recipe.name.c_str(), recipeServings, DEFAULT_SERVINGS);
-        recipeServings = DEFAULT_SERVINGS;
+    float totalTargetGrams = _recipeTargetGrams(recipe, servings);
+
+    ESP_LOGI(TAG, "Executing recipe '%s' for %d serving(s). Total target: %.2fg",
+             recipe.name.c_str(), servings, totalTargetGrams);
+
+    // Prepare dispensing context, starting from the staged batch if there is one
+    _prepareDispensingContext(recipeUid, recipe.ingredients.data(), recipe.ingredients.size(), totalTargetGrams, servings);
+    _ctx.recipeName      = recipe.name;
+    _ctx.fromStagedBatch = _applyStagedBatch(recipeUid, servings);
+    _beginOperation(DispensingOperation::OP_RECIPE);
+    return true;
+}
+
+bool RecipeProcessor::startDensityCalibration(uint64_t tankUid)
+{
+    if (_tankManager.getBusOfTank(tankUid) < 0) {
+        ESP_LOGE(TAG, "Density calibration failed: Tank 0x%016llx not found.", tankUid);
+        if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+            _deviceState.lastEvent = DeviceEvent_e::DEVEVENT_TANK_NOT_FOUND;
+            xSemaphoreGive(_mutex);
+        }
+        return false;
+    }
+    if (_batch.held) {
+        // The fill must start from an empty hopper, and the held batch belongs to the next feed
+        ESP_LOGE(TAG, "Density calibration refused: the hopper holds a staged batch.");
+        return false;
     }
 
-    // Calculate total target: (dailyWeight / recipe.servings) * requested servings
-    float singleServingWeight = recipe.dailyWeight / (float)recipeServings;
-    float totalTargetGrams = singleServingWeight * servings;
+    ESP_LOGI(TAG, "Starting density calibration of tank 0x%016llx", tankUid);
+
+    RecipeIngredient ingredient;
+    ingredient.tankUid    = tankUid;
+    ingredient.percentage = 100.0f;
 
-    ESP_LOGI(TAG, "Executing recipe '%s' for %d serving(s). Single serving: %.2fg, Total target: %.2fg",
-             recipe.name.c_str(), servings, singleServingWeight, totalTargetGrams);
+    // Never reached by a plausible density: the fill ends when the auger stalls
+    _prepareDispensingContext(0, &ingredient, 1, MAX_HOPPER_VOLUME_LITERS * DENSITY_MAX_GPL, 1);
+    _ctx.recipeName = "Density Calibration";
+    _beginOperation(DispensingOperation::OP_CALIBRATE_DENSITY);
+    return true;
+}
 
-    // Prepare dispensing context
-    _prepareDispensingContext(recipeUid, recipe.ingredients, totalTargetGrams, servings);
+void RecipeProcessor::stopAllFeeding()
+{
+    ESP_LOGW(TAG, "Stopping all feeding - closing hopper.");
+    _tankManager.closeHopper();
+    vTaskDelay(pdMS_TO_TICKS(STOP_CLOSE_MS)); // Allow hopper to physically close
+    _tankManager.stopAllServos();
+    _ctx.phase = DispensingPhase::PHASE_IDLE;
+}
 
-    // Execute dispensing cycles until complete
-    bool success = true;
-    while (_hasMoreToDispense() && success) {
-        if (_checkEmergencyStop()) {
-            _handleError(DispensingError::ERR_EMERGENCY_STOP);
-            success = false;
-            break;
-        }
-        success = _executeCycle();
-        if (success && _hasMoreToDispense()) {
-            vTaskDelay(pdMS_TO_TICKS(POST_BATCH_DELAY_MS));
+void RecipeProcessor::onWeightSample(ScaleChannel channel, float grams)
+{
+    if (channel != ScaleChannel::HOPPER || !_ctx.awaitingSample) {
+        return;
+    }
+    _ctx.awaitingSample = false;
+    _ctx.sampleReady    = true;
+    _ctx.sample         = grams;
+}
+
+// ============================================================================
+// Meal Staging
+// ============================================================================
+
+bool RecipeProcessor::scheduleMeal(uint32_t recipeUid, int servings, time_t mealTime, uint32_t leadTimeS)
+{
+    auto it = std::find_if(_recipes.begin(), _recipes.end(), [recipeUid](const Recipe& r) { return r.uid == recipeUid; });
+    if (it == _recipes.end()) {
+        ESP_LOGW(TAG, "Cannot schedule a meal of unknown recipe %u.", recipeUid);
+        return false;
+    }
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        _meal.active    = true;
+        _meal.recipeUid = recipeUid;
+        _meal.servings  = servings;
+        _meal.mealTime  = mealTime;
+        _meal.leadTimeS = leadTimeS;
+        _meal.generation++;
+        xSemaphoreGive(_mutex);
+    }
+    ESP_LOGI(TAG, "Meal of recipe %u (%d serving(s)) scheduled at %ld, staged %lus ahead.", recipeUid, servings, (long)mealTime,
+      (unsigned long)leadTimeS);
+    return true;
+}
+
+void RecipeProcessor::cancelScheduledMeal()
+{
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        if (_meal.active) {
+            _meal.active = false;
+            _meal.generation++;
+            ESP_LOGI(TAG, "Scheduled meal cancelled.");
         }
+        xSemaphoreGive(_mutex);
     }
+}
 
-    // Final purge to release last batch, then close hopper
-    if (success) {
-        ESP_LOGI(TAG, "Final purge to release last batch.");
-        _purgeHopper();
-        ESP_LOGI(TAG, "Closing hopper to idle position.");
-        _tankManager.closeHopper();
+StagingStatus RecipeProcessor::getStagingStatus()
+{
+    StagingStatus status = {};
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        status.scheduled         = _meal.active;
+        status.recipeUid         = _meal.recipeUid;
+        status.servings          = _meal.servings;
+        status.mealTime          = _meal.mealTime;
+        status.leadTimeS         = _meal.leadTimeS;
+        status.stagedGrams       = _batch.held ? _batch.grams : 0.0f;
+        status.stagedAt          = _batch.held ? _batch.stagedAt : 0;
+        status.lastFirstKibbleMs = _lastFirstKibbleMs;
+        status.lastFeedWasStaged = _lastFeedWasStaged;
+        if (_batch.held)
+            status.state = _batch.residual ? StagingState::STAGING_RESIDUAL : StagingState::STAGING_HELD;
+        else
+            status.state = _meal.active ? StagingState::STAGING_PENDING : StagingState::STAGING_NONE;
+        xSemaphoreGive(_mutex);
     }
+    return status;
+}
 
-    if (success) {
-        ESP_LOGI(TAG, "Recipe '%s' completed successfully.", recipe.name.c_str());
-        recipe.lastUsed = time(nullptr);
-        _saveRecipesToNVS();
+void RecipeProcessor::serviceStaging(time_t now)
+{
+    if (isBusy())
+        return;
+
+    ScheduledMeal meal;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE)
+        return;
+    meal = _meal;
+    xSemaphoreGive(_mutex);
+
+    // A held batch is only good for the meal it was measured for, and for a while
+    if (_batch.held && !_batch.residual) {
+        if (!meal.active || meal.generation != _batch.generation)
+            _abortStaging("schedule changed");
+        else if (now - _batch.stagedAt > STAGING_MAX_HOLD_S)
+            _abortStaging("batch is stale");
+    }
+
+    if (!meal.active || now < STAGING_MIN_VALID_TIME)
+        return;
+
+    if (now >= meal.mealTime) {
+        // Serve through the regular command path, which starts from the staged batch
+        if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+            if (_deviceState.feedCommand.processed && _meal.generation == meal.generation) {
+                _deviceState.feedCommand.type      = FeedCommandType::RECIPE;
+                _deviceState.feedCommand.recipeUid = meal.recipeUid;
+                _deviceState.feedCommand.servings  = meal.servings;
+                _deviceState.feedCommand.processed = false;
+                _meal.active                       = false;
+                _meal.generation++;
+                ESP_LOGI(TAG, "Serving the scheduled meal of recipe %u.", meal.recipeUid);
+            }
+            xSemaphoreGive(_mutex);
+        }
+        return;
+    }
+
+    if (!_batch.held && meal.leadTimeS > 0 && now + (time_t)meal.leadTimeS >= meal.mealTime && meal.generation != _failedGeneration)
+        _stageMeal(meal);
+}
+
+void RecipeProcessor::_stageMeal(const ScheduledMeal& meal)
+{
+    auto it = std::find_if(_recipes.begin(), _recipes.end(), [&meal](const Recipe& r) { return r.uid == meal.recipeUid; });
+    if (it == _recipes.end()) {
+        ESP_LOGW(TAG, "Scheduled recipe %u no longer exists, not staging.", meal.recipeUid);
+        _failedGeneration = meal.generation;
+        return;
     }
 
-    // Log the feeding event
+    float totalTargetGrams = _recipeTargetGrams(*it, meal.servings);
+    ESP_LOGI(TAG, "Staging the first batch of recipe '%s' (%.2fg in total).", it->name.c_str(), totalTargetGrams);
+
     if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
-        FeedingHistoryEntry entry(time(nullptr), "recipe", recipe.uid, success, _ctx.dispensedGrams, recipe.name);
-        _deviceState.feedingHistory.push_back(entry);
+        _deviceState.currentFeedingStatus = "Staging...";
         xSemaphoreGive(_mutex);
     }
 
-    ESP_LOGI(TAG, "Recipe feed %s. Dispensed %.2fg of %.2fg target.",
-             success ? "completed" : "failed", _ctx.dispensedGrams, totalTargetGrams);
+    // One regular cycle: purge, close and zero, then the first batch, which stays in the closed hopper
+    _prepareDispensingContext(meal.recipeUid, it->ingredients.data(), it->ingredients.size(), totalTargetGrams, meal.servings);
+    _ctx.recipeName        = it->name;
+    _ctx.stagingGeneration = meal.generation;
+    _beginOperation(DispensingOperation::OP_STAGE);
+}
 
-    return success;
+void RecipeProcessor::_abortStaging(const char* reason)
+{
+    ESP_LOGW(TAG, "Staging aborted (%s): %.2fg stay in the hopper for the next feed.", reason, _batch.grams);
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        _batch.residual = true;
+        xSemaphoreGive(_mutex);
+    }
 }
 
-void RecipeProcessor::stopAllFeeding()
+void RecipeProcessor::_onRecipeChanged(uint32_t recipeUid, bool deleted)
 {
-    ESP_LOGW(TAG, "Stopping all feeding - closing hopper.");
-    _tankManager.closeHopper();
-    vTaskDelay(pdMS_TO_TICKS(300)); // Allow hopper to physically close
-    _tankManager.stopAllServos();
-    _ctx.phase = DispensingPhase::PHASE_IDLE;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        if (_meal.active && _meal.recipeUid == recipeUid) {
+            // A batch staged with the old ingredients no longer matches the meal
+            _meal.active = !deleted;
+            _meal.generation++;
+            ESP_LOGI(TAG, "Scheduled recipe %u %s.", recipeUid, deleted ? "deleted, meal cancelled" : "changed");
+        }
+        xSemaphoreGive(_mutex);
+    }
+}
+
+bool RecipeProcessor::_applyStagedBatch(uint32_t recipeUid, int servings)
+{
+    if (!_batch.held)
+        return false;
+
+    bool matches = !_batch.residual && _batch.recipeUid == recipeUid && _batch.servings == servings;
+    float grams  = std::min(_batch.grams, _ctx.totalTargetGrams);
+
+    // The hopper is closed and zeroed already: the first purge releases the batch
+    _ctx.hopperBaselineGrams = _batch.hopperBaselineGrams;
+    _ctx.hopperBaselineValid = true;
+    _ctx.dispensedGrams      = grams;
+    size_t numIngredients    = std::min(_ctx.ingredients.size(), (size_t)MAX_INGREDIENTS);
+    for (size_t i = 0; i < numIngredients; i++) {
+        float credit = matches ? _batch.ingredientGrams[i] : grams * (_ctx.ingredients[i].percentage / 100.0f);
+        _ctx.ingredientRemainingGrams[i] = std::max(0.0f, _ctx.ingredientRemainingGrams[i] - credit);
+    }
+
+    if (matches)
+        ESP_LOGI(TAG, "Starting from the %.2fg staged in the hopper.", grams);
+    else
+        ESP_LOGW(TAG, "Crediting %.2fg left in the hopper by an aborted staging.", grams);
+
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        _batch.held = false;
+        xSemaphoreGive(_mutex);
+    }
+    return matches;
 }
 
 // ============================================================================
@@ -190,333 +339,551 @@ void RecipeProcessor::stopAllFeeding()
 // ============================================================================
 
 void RecipeProcessor::_prepareDispensingContext(uint32_t recipeUid,
-                                                 const std::vector<RecipeIngredient>& ingredients,
+                                                 const RecipeIngredient* ingredients,
+                                                 size_t count,
                                                  float totalGrams,
                                                  int servings)
 {
+    // Ingredients beyond MAX_INGREDIENTS are never dispensed
+    size_t numIngredients = std::min(count, (size_t)MAX_INGREDIENTS);
     _ctx.reset();
     _ctx.recipeUid = recipeUid;
-    _ctx.ingredients = ingredients;
+    _ctx.ingredients.assign(ingredients, ingredients + numIngredients);
     _ctx.totalTargetGrams = totalGrams;
     _ctx.servings = servings;
 
     // Initialize per-ingredient remaining grams based on percentage
-    size_t numIngredients = std::min(ingredients.size(), (size_t)MAX_INGREDIENTS);
     for (size_t i = 0; i < numIngredients; i++) {
         _ctx.ingredientRemainingGrams[i] = totalGrams * (ingredients[i].percentage / 100.0f);
         ESP_LOGD(TAG, "Ingredient %zu (tank 0x%016llx): %.2fg (%.1f%%)",
                  i, ingredients[i].tankUid, _ctx.ingredientRemainingGrams[i], ingredients[i].percentage);
     }
 
+    // Remember where the bowl started, to cross-check the delivered amount at the end
+    _ctx.bowlStartGrams = _getBowlWeight();
+}
+
+void RecipeProcessor::_beginOperation(DispensingOperation operation)
+{
+    TickType_t now     = xTaskGetTickCount();
+    _ctx.operation     = operation;
+    _ctx.startTick     = now;
+    _stopRequested     = false;
+
+    // Keep the HX711 sampling continuously for the whole operation, and the EEPROM scrubber off the SwiMux
+    _scale.setFeedingActive(true);
+    _tankManager.setFeedingActive(true);
+
     // Power on servos for the operation
     _tankManager.setServoPower(true);
-    vTaskDelay(pdMS_TO_TICKS(200)); // Wait for servo power stabilization
+    _enterPhase(DispensingPhase::PHASE_POWER_UP, now);
 }
 
-bool RecipeProcessor::_hasMoreToDispense() const
+void RecipeProcessor::_finishOperation(bool success)
 {
-    return _ctx.dispensedGrams < (_ctx.totalTargetGrams - 0.5f); // 0.5g tolerance
+    DispensingOperation operation = _ctx.operation;
+    _ctx.operation                = DispensingOperation::OP_NONE;
+    _ctx.phase                    = success ? DispensingPhase::PHASE_COMPLETE : DispensingPhase::PHASE_ERROR;
+    _ctx.awaitingSample           = false;
+    _stopRequested                = false;
+    _lastSuccess                  = success;
+
+    _scale.setFeedingActive(false);
+    _tankManager.setFeedingActive(false);
+    _refineTankDensities();
+
+    if (operation == DispensingOperation::OP_CALIBRATE_DENSITY) {
+        uint64_t tankUid = _ctx.ingredients[0].tankUid;
+        if (success && _ctx.measuredDensity != 0) {
+            _tankManager.setMeasuredDensity(tankUid, _ctx.measuredDensity, _ctx.measuredAugerFlow);
+        } else {
+            success      = false;
+            _lastSuccess = false;
+            ESP_LOGW(TAG, "Density calibration of tank 0x%016llx failed, density left unchanged.", tankUid);
+            if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+                if (_deviceState.lastEvent == DeviceEvent_e::DEVEVENT_NONE)
+                    _deviceState.lastEvent = DeviceEvent_e::DEVEVENT_DENSITY_CALIBRATION_FAILED;
+                xSemaphoreGive(_mutex);
+            }
+        }
+    }
+
+    if (operation == DispensingOperation::OP_STAGE) {
+        if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+            if (_ctx.dispensedGrams > 0.0f) {
+                _batch.held                = true;
+                _batch.residual            = !success;
+                _batch.recipeUid           = _ctx.recipeUid;
+                _batch.servings            = _ctx.servings;
+                _batch.generation          = _ctx.stagingGeneration;
+                _batch.stagedAt            = time(nullptr);
+                _batch.grams               = _ctx.dispensedGrams;
+                _batch.hopperBaselineGrams = _ctx.hopperBaselineGrams;
+                size_t numIngredients      = std::min(_ctx.ingredients.size(), (size_t)MAX_INGREDIENTS);
+                for (size_t i = 0; i < MAX_INGREDIENTS; i++) {
+                    _batch.ingredientGrams[i] = i < numIngredients
+                      ? _ctx.totalTargetGrams * (_ctx.ingredients[i].percentage / 100.0f) - _ctx.ingredientRemainingGrams[i]
+                      : 0.0f;
+                }
+            }
+            if (!success)
+                _failedGeneration = _ctx.stagingGeneration;
+            xSemaphoreGive(_mutex);
+        }
+        if (success)
+            ESP_LOGI(TAG, "Staged %.2fg in the hopper.", _ctx.dispensedGrams);
+        else
+            ESP_LOGW(TAG, "Staging failed with %.2fg in the hopper, the meal will be dispensed at its time.", _ctx.dispensedGrams);
+        return;
+    }
+
+    if (operation == DispensingOperation::OP_RECIPE && success) {
+        ESP_LOGI(TAG, "Recipe '%s' completed successfully.", _ctx.recipeName.c_str());
+        for (auto& recipe : _recipes) {
+            if (recipe.uid == _ctx.recipeUid) {
+                recipe.lastUsed = time(nullptr);
+                HeapGuard::Allow allowance; // Writing the recipe file allocates, as any flash write does
+                _saveRecipesToNVS();
+                break;
+            }
+        }
+    }
+
+    // Log the feeding event, the calibration fill having been released into the bowl as well
+    bool isRecipe    = (operation == DispensingOperation::OP_RECIPE);
+    const char* type = isRecipe ? "recipe" : operation == DispensingOperation::OP_CALIBRATE_DENSITY ? "calibration" : "immediate";
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        std::vector<FeedingHistoryEntry>& history = _deviceState.feedingHistory;
+        if (history.size() >= FEEDING_HISTORY_MAX)
+            history.erase(history.begin()); // plain data: shifting the entries does not allocate
+        history.emplace_back(
+          time(nullptr), type, _ctx.recipeUid, success, _ctx.dispensedGrams, _ctx.recipeName.c_str());
+        _lastFirstKibbleMs = _ctx.firstKibbleMs;
+        _lastFeedWasStaged = _ctx.fromStagedBatch;
+        xSemaphoreGive(_mutex);
+    }
+
+    ESP_LOGI(TAG, "%s feed %s. Dispensed %.2fg of %.2fg target, first kibble after %lums%s.", type,
+             success ? "completed" : "failed", _ctx.dispensedGrams, _ctx.totalTargetGrams, (unsigned long)_ctx.firstKibbleMs,
+             _ctx.fromStagedBatch ? " (staged)" : "");
 }
 
-// ============================================================================
-// Main Cycle Execution
-// ============================================================================
+void RecipeProcessor::_enterPhase(DispensingPhase phase, TickType_t now)
+{
+    _ctx.phase = phase;
+    _ctx.phaseStartTick = now;
+}
 
-bool RecipeProcessor::_executeCycle()
+void RecipeProcessor::_requestSample(TickType_t now)
 {
-    ESP_LOGI(TAG, "Starting dispense cycle. Dispensed so far: %.2fg / %.2fg",
-             _ctx.dispensedGrams, _ctx.totalTargetGrams);
+    _ctx.awaitingSample    = true;
+    _ctx.sampleReady       = false;
+    _ctx.sampleRequestTick = now;
+    _scale.requestSample(ScaleChannel::HOPPER);
+}
 
-    // Phase 1: Purge
-    if (!_purgeHopper()) {
+bool RecipeProcessor::_takeSample(float& grams)
+{
+    if (!_ctx.sampleReady) {
         return false;
     }
+    _ctx.sampleReady = false;
+    grams = _ctx.sample;
+    return true;
+}
+
+float RecipeProcessor::_getBowlWeight()
+{
+    float grams = NAN;
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        if (_deviceState.isBowlScaleResponding) {
+            grams = _deviceState.bowlWeight;
+        }
+        xSemaphoreGive(_mutex);
+    }
+    return grams;
+}
 
-    // Phase 2: Close & Tare
-    if (!_closeAndTareHopper()) {
-        return false;
+void RecipeProcessor::_logBowlDelivery()
+{
+    if (std::isnan(_ctx.bowlStartGrams)) {
+        return;
     }
+    float bowlNow = _getBowlWeight();
+    if (!std::isnan(bowlNow)) {
+        ESP_LOGI(TAG, "Bowl gained %.2fg (hopper-measured: %.2fg)", bowlNow - _ctx.bowlStartGrams, _ctx.dispensedGrams);
+    }
+}
 
-    // Phase 3: Dispense batch
-    if (!_dispenseBatch()) {
-        return false;
+float RecipeProcessor::_recipeTargetGrams(const Recipe& recipe, int servings)
+{
+    // Validate recipe.servings for portion calculation
+    int recipeServings = recipe.servings;
+    if (recipeServings <= 0) {
+        ESP_LOGW(TAG, "Recipe '%s' has invalid servings %d, defaulting to %d.",
+                 recipe.name.c_str(), recipeServings, DEFAULT_SERVINGS);
+        recipeServings = DEFAULT_SERVINGS;
     }
 
-    return true;
+    // Total target: (dailyWeight / recipe.servings) * requested servings
+    return recipe.dailyWeight / (float)recipeServings * servings;
+}
+
+bool RecipeProcessor::_hasMoreToDispense() const
+{
+    return _ctx.dispensedGrams < (_ctx.totalTargetGrams - 0.5f); // 0.5g tolerance
 }
 
 // ============================================================================
-// Phase 1: Purge
+// State Machine
 // ============================================================================
 
-bool RecipeProcessor::_purgeHopper()
+void RecipeProcessor::tick(TickType_t now)
 {
-    ESP_LOGI(TAG, "PHASE: Purge - Opening hopper");
-    _ctx.phase = DispensingPhase::PHASE_PURGE_OPEN;
-    _ctx.phaseStartTick = xTaskGetTickCount();
-
-    // Open hopper
-    auto result = _tankManager.openHopper();
-    if (result != PCA9685::I2C_Result_e::I2C_Ok) {
-        ESP_LOGE(TAG, "Failed to open hopper: I2C error");
-        _handleError(DispensingError::ERR_SERVO_TIMEOUT);
-        return false;
+    if (!isBusy()) {
+        return;
     }
-    vTaskDelay(pdMS_TO_TICKS(100)); // Brief delay for servo to move
 
-    // Check emergency stop
-    if (_checkEmergencyStop()) {
-        _handleError(DispensingError::ERR_EMERGENCY_STOP);
-        return false;
+    if (_stopRequested && _ctx.phase != DispensingPhase::PHASE_STOPPING) {
+        _handleError(DispensingError::ERR_EMERGENCY_STOP, now);
+        return;
     }
 
-    // Execute wiggle
-    if (!_executeWiggle()) {
-        return false;
+    // A sample that never comes reads as a failed one
+    if (_ctx.awaitingSample && (now - _ctx.sampleRequestTick) >= pdMS_TO_TICKS(DISPENSING_SAMPLE_TIMEOUT_MS)) {
+        onWeightSample(ScaleChannel::HOPPER, NAN);
     }
 
-    // Settle phase - wait for stray kibbles to fall
-    ESP_LOGI(TAG, "PHASE: Purge settle - waiting %dms", HOPPER_PURGE_DELAY_MS);
-    _ctx.phase = DispensingPhase::PHASE_PURGE_SETTLE;
-    _ctx.phaseStartTick = xTaskGetTickCount();
-    vTaskDelay(pdMS_TO_TICKS(HOPPER_PURGE_DELAY_MS));
+    TickType_t elapsed = now - _ctx.phaseStartTick;
+    float grams;
 
-    return true;
-}
+    switch (_ctx.phase) {
+        case DispensingPhase::PHASE_POWER_UP:
+            if (elapsed < pdMS_TO_TICKS(SERVO_POWER_SETTLE_MS)) {
+                break;
+            }
+            if (_hasMoreToDispense()) {
+                ESP_LOGI(TAG, "Starting dispense cycle. Dispensed so far: %.2fg / %.2fg",
+                         _ctx.dispensedGrams, _ctx.totalTargetGrams);
+                _enterPurge(false, now);
+            } else {
+                // Everything is in the hopper already (staged batch)
+                ESP_LOGI(TAG, "Final purge to release last batch.");
+                _enterPurge(true, now);
+            }
+            break;
 
-bool RecipeProcessor::_executeWiggle()
-{
-    ESP_LOGI(TAG, "PHASE: Purge wiggle - %d cycles", WIGGLE_CYCLE_COUNT);
-    _ctx.phase = DispensingPhase::PHASE_PURGE_WIGGLE;
-    _ctx.phaseStartTick = xTaskGetTickCount();
-    _ctx.wiggleCount = 0;
+        case DispensingPhase::PHASE_PURGE_OPEN:
+            if (elapsed >= pdMS_TO_TICKS(SERVO_MOVE_MS)) {
+                ESP_LOGI(TAG, "PHASE: Purge wiggle - %d cycles", WIGGLE_CYCLE_COUNT);
+                _ctx.wiggleCount = 0;
+                _ctx.wiggleStep  = 0;
+                _tankManager.setServoPWM(HOPPER_SERVO_INDEX, _tankManager.getHopperOpenPwm() + WIGGLE_AMPLITUDE_PWM);
+                _enterPhase(DispensingPhase::PHASE_PURGE_WIGGLE, now);
+            }
+            break;
 
-    uint16_t openPwm = _tankManager.getHopperOpenPwm();
+        case DispensingPhase::PHASE_PURGE_WIGGLE:
+            _tickPurgeWiggle(now);
+            break;
 
-    for (uint8_t i = 0; i < WIGGLE_CYCLE_COUNT; i++) {
-        if (_checkEmergencyStop()) {
-            _handleError(DispensingError::ERR_EMERGENCY_STOP);
-            return false;
-        }
+        case DispensingPhase::PHASE_PURGE_SETTLE:
+            _tickPurgeSettle(now);
+            break;
 
-        // Wiggle one direction
-        _tankManager.setServoPWM(HOPPER_SERVO_INDEX, openPwm + WIGGLE_AMPLITUDE_PWM);
-        vTaskDelay(pdMS_TO_TICKS(WIGGLE_HALF_PERIOD_MS));
+        case DispensingPhase::PHASE_CLOSE_MOVING:
+            if (!_takeSample(grams)) {
+                break;
+            }
+            if (std::isnan(grams)) {
+                ESP_LOGE(TAG, "Scale unresponsive before close");
+                _handleError(DispensingError::ERR_SCALE_UNRESPONSIVE, now);
+                break;
+            }
+            _ctx.preCloseWeight = grams;
+            _ctx.closePwm       = _tankManager.getHopperOpenPwm();
+            ESP_LOGD(TAG, "Starting close detection from PWM %d to %d", _ctx.closePwm, _tankManager.getHopperClosedPwm());
+            _enterPhase(DispensingPhase::PHASE_CLOSE_DETECT_SPIKE, now);
+            _stepClose(now);
+            break;
 
-        // Wiggle other direction
-        _tankManager.setServoPWM(HOPPER_SERVO_INDEX, openPwm - WIGGLE_AMPLITUDE_PWM);
-        vTaskDelay(pdMS_TO_TICKS(WIGGLE_HALF_PERIOD_MS));
+        case DispensingPhase::PHASE_CLOSE_DETECT_SPIKE:
+            _tickCloseDetect(now);
+            break;
 
-        _ctx.wiggleCount++;
-    }
+        case DispensingPhase::PHASE_CLOSE_BACKOFF:
+            if (elapsed >= pdMS_TO_TICKS(SERVO_MOVE_MS)) {
+                _enterPhase(DispensingPhase::PHASE_CLOSE_SETTLE, now);
+            }
+            break;
 
-    // Return to center (open position)
-    _tankManager.setServoPWM(HOPPER_SERVO_INDEX, openPwm);
-    vTaskDelay(pdMS_TO_TICKS(100));
+        case DispensingPhase::PHASE_CLOSE_SETTLE:
+            // Wait for the close (or back-off) motion to stop disturbing the load cells
+            if (_scale.isSettledSinceActuation() || elapsed >= pdMS_TO_TICKS(CLOSE_SETTLE_MS)) {
+                // Capture the empty-hopper baseline; the bowl channel is independent, so no tare is needed
+                ESP_LOGI(TAG, "PHASE: Zero hopper");
+                _enterPhase(DispensingPhase::PHASE_ZERO, now);
+                _requestSample(now);
+            }
+            break;
 
-    return true;
+        case DispensingPhase::PHASE_ZERO:
+            if (!_takeSample(grams)) {
+                break;
+            }
+            if (std::isnan(grams)) {
+                ESP_LOGE(TAG, "Scale unresponsive after close");
+                _handleError(DispensingError::ERR_SCALE_UNRESPONSIVE, now);
+                break;
+            }
+            _ctx.hopperBaselineGrams = grams;
+            _ctx.hopperBaselineValid = true;
+            ESP_LOGI(TAG, "Hopper baseline: %.2fg", grams);
+            _enterDispense(now);
+            break;
+
+        case DispensingPhase::PHASE_DISPENSE_AUGER:
+            _tickAuger(now);
+            break;
+
+        case DispensingPhase::PHASE_DISPENSE_SETTLE:
+            if (elapsed >= pdMS_TO_TICKS(DISPENSE_SETTLE_MS)) {
+                ESP_LOGI(TAG, "Batch complete: dispensed %.2fg (target %.2fg). Total: %.2fg / %.2fg",
+                         _ctx.currentBatchDispensedGrams, _ctx.currentBatchTargetGrams,
+                         _ctx.dispensedGrams, _ctx.totalTargetGrams);
+                _afterBatch(now);
+            }
+            break;
+
+        case DispensingPhase::PHASE_POST_BATCH:
+            if (elapsed >= pdMS_TO_TICKS(POST_BATCH_DELAY_MS)) {
+                ESP_LOGI(TAG, "Starting dispense cycle. Dispensed so far: %.2fg / %.2fg",
+                         _ctx.dispensedGrams, _ctx.totalTargetGrams);
+                _enterPurge(false, now);
+            }
+            break;
+
+        case DispensingPhase::PHASE_STOPPING:
+            if (elapsed >= pdMS_TO_TICKS(STOP_CLOSE_MS)) {
+                _tankManager.stopAllServos();
+                _finishOperation(false);
+            }
+            break;
+
+        default:
+            break;
+    }
 }
 
 // ============================================================================
-// Phase 2: Close & Tare
+// Phase 1: Purge
 // ============================================================================
 
-bool RecipeProcessor::_closeAndTareHopper()
+void RecipeProcessor::_enterPurge(bool final, TickType_t now)
 {
-    ESP_LOGI(TAG, "PHASE: Close hopper with spike detection");
-    _ctx.phase = DispensingPhase::PHASE_CLOSE_MOVING;
-    _ctx.phaseStartTick = xTaskGetTickCount();
-    _ctx.closeAttempts = 0;
+    ESP_LOGI(TAG, "PHASE: Purge - Opening hopper");
+    _ctx.finalPurge = final;
+    _enterPhase(DispensingPhase::PHASE_PURGE_OPEN, now);
 
-    // Record pre-close weight
-    _ctx.preCloseWeight = _scale.getWeight();
-    if (std::isnan(_ctx.preCloseWeight)) {
-        ESP_LOGE(TAG, "Scale unresponsive before close");
-        _handleError(DispensingError::ERR_SCALE_UNRESPONSIVE);
-        return false;
+    // Open hopper
+    auto result = _tankManager.openHopper();
+    if (result != PCA9685::I2C_Result_e::I2C_Ok) {
+        ESP_LOGE(TAG, "Failed to open hopper: I2C error");
+        _handleError(DispensingError::ERR_SERVO_TIMEOUT, now);
+        return;
     }
-
-    // Attempt spike detection
-    bool spikeDetected = _detectCloseSpike();
-
-    if (!spikeDetected) {
-        ESP_LOGW(TAG, "Close spike not detected after %d attempts, using default close PWM",
-                 _ctx.closeAttempts);
-        // Fall back to default close position
-        _tankManager.closeHopper();
-        _ctx.learnedClosePwm = _tankManager.getHopperClosedPwm();
+    if (_ctx.firstKibbleMs == 0 && _ctx.dispensedGrams > 0.0f) {
+        // First time the trapdoor opens over kibble in this operation
+        _ctx.firstKibbleMs = pdTICKS_TO_MS(now - _ctx.startTick);
+        if (_ctx.firstKibbleMs == 0)
+            _ctx.firstKibbleMs = 1;
     }
+}
 
-    // Wait for things to settle
-    vTaskDelay(pdMS_TO_TICKS(TARE_SETTLE_MS));
+void RecipeProcessor::_tickPurgeWiggle(TickType_t now)
+{
+    TickType_t elapsed = now - _ctx.phaseStartTick;
+    uint16_t openPwm = _tankManager.getHopperOpenPwm();
 
-    // Tare the scale
-    ESP_LOGI(TAG, "PHASE: Tare scale");
-    _ctx.phase = DispensingPhase::PHASE_TARE;
-    _ctx.phaseStartTick = xTaskGetTickCount();
-    _scale.tare();
-    vTaskDelay(pdMS_TO_TICKS(TARE_SETTLE_MS));
+    if (_ctx.wiggleStep < 2 * WIGGLE_CYCLE_COUNT) {
+        if (elapsed < pdMS_TO_TICKS(WIGGLE_HALF_PERIOD_MS)) {
+            return;
+        }
+        _ctx.wiggleStep++;
+        if (_ctx.wiggleStep < 2 * WIGGLE_CYCLE_COUNT) {
+            // Alternate around the open position
+            _tankManager.setServoPWM(HOPPER_SERVO_INDEX, (_ctx.wiggleStep & 1) ? openPwm - WIGGLE_AMPLITUDE_PWM : openPwm + WIGGLE_AMPLITUDE_PWM);
+        } else {
+            // Return to center (open position)
+            _tankManager.setServoPWM(HOPPER_SERVO_INDEX, openPwm);
+        }
+        _ctx.wiggleCount = _ctx.wiggleStep / 2;
+        _ctx.phaseStartTick = now;
+        return;
+    }
 
-    float postTareWeight = _scale.getWeight();
-    if (std::isnan(postTareWeight)) {
-        ESP_LOGE(TAG, "Scale unresponsive after tare");
-        _handleError(DispensingError::ERR_SCALE_UNRESPONSIVE);
-        return false;
+    if (elapsed < pdMS_TO_TICKS(SERVO_MOVE_MS)) {
+        return;
     }
 
-    ESP_LOGI(TAG, "Tare complete. Post-tare weight: %.2fg", postTareWeight);
-    return true;
+    // Settle phase - wait for stray kibbles to fall
+    _enterPhase(DispensingPhase::PHASE_PURGE_SETTLE, now);
+    _ctx.prevWeight = NAN;
+    if (_ctx.hopperBaselineValid) {
+        ESP_LOGI(TAG, "PHASE: Purge settle - waiting for hopper to empty (max %dms)", HOPPER_PURGE_DELAY_MS);
+    } else {
+        // Nothing to compare against yet (first purge of the operation)
+        ESP_LOGI(TAG, "PHASE: Purge settle - waiting %dms", HOPPER_PURGE_DELAY_MS);
+    }
 }
 
-bool RecipeProcessor::_detectCloseSpike()
+void RecipeProcessor::_tickPurgeSettle(TickType_t now)
 {
-    _ctx.phase = DispensingPhase::PHASE_CLOSE_DETECT_SPIKE;
-    _ctx.phaseStartTick = xTaskGetTickCount();
+    TickType_t elapsed = now - _ctx.phaseStartTick;
 
-    uint16_t openPwm = _tankManager.getHopperOpenPwm();
-    uint16_t closedPwm = _tankManager.getHopperClosedPwm();
+    if (elapsed >= pdMS_TO_TICKS(HOPPER_PURGE_DELAY_MS)) {
+        if (_ctx.hopperBaselineValid) {
+            ESP_LOGW(TAG, "Hopper did not return to its baseline within %dms", HOPPER_PURGE_DELAY_MS);
+        }
+        _afterPurge(now);
+        return;
+    }
+    if (!_ctx.hopperBaselineValid || elapsed < pdMS_TO_TICKS(HOPPER_PURGE_MIN_SETTLE_MS)) {
+        return;
+    }
 
-    // Determine direction: open->closed
-    int16_t step = (closedPwm > openPwm) ? CLOSE_STEP_PWM : -CLOSE_STEP_PWM;
-    uint16_t currentPwm = openPwm;
+    float hopperWeight;
+    if (_takeSample(hopperWeight)) {
+        if (!std::isnan(hopperWeight) && !std::isnan(_ctx.prevWeight)
+          && std::fabs(hopperWeight - _ctx.hopperBaselineGrams) < HOPPER_EMPTY_TOLERANCE_GRAMS
+          && std::fabs(hopperWeight - _ctx.prevWeight) < HOPPER_EMPTY_TOLERANCE_GRAMS) {
+            ESP_LOGI(TAG, "Hopper empty after %lums", (unsigned long)pdTICKS_TO_MS(elapsed));
+            _afterPurge(now);
+            return;
+        }
+        _ctx.prevWeight = hopperWeight;
+    }
+    if (!_ctx.awaitingSample) {
+        _requestSample(now);
+    }
+}
 
-    float baselineWeight = _scale.getWeight();
-    if (std::isnan(baselineWeight)) {
-        return false;
+void RecipeProcessor::_afterPurge(TickType_t now)
+{
+    _ctx.awaitingSample = false;
+    if (_ctx.finalPurge) {
+        ESP_LOGI(TAG, "Closing hopper to idle position.");
+        _tankManager.closeHopper();
+        _logBowlDelivery();
+        _finishOperation(true);
+        return;
     }
+    _enterClose(now);
+}
 
-    ESP_LOGD(TAG, "Starting close detection from PWM %d to %d (step %d)", openPwm, closedPwm, step);
+// ============================================================================
+// Phase 2: Close & Zero
+// ============================================================================
 
-    while (_ctx.closeAttempts < CLOSE_MAX_ATTEMPTS) {
-        if (_checkEmergencyStop()) {
-            _handleError(DispensingError::ERR_EMERGENCY_STOP);
-            return false;
-        }
+void RecipeProcessor::_enterClose(TickType_t now)
+{
+    ESP_LOGI(TAG, "PHASE: Close hopper with spike detection");
+    _ctx.closeAttempts = 0;
+    // Record pre-close weight, the reference of the spike detection
+    _enterPhase(DispensingPhase::PHASE_CLOSE_MOVING, now);
+    _requestSample(now);
+}
 
-        // Step the PWM
-        currentPwm += step;
+void RecipeProcessor::_stepClose(TickType_t now)
+{
+    uint16_t openPwm = _tankManager.getHopperOpenPwm();
+    uint16_t closedPwm = _tankManager.getHopperClosedPwm();
 
-        // Check if we've passed the target
-        if ((step > 0 && currentPwm >= closedPwm) || (step < 0 && currentPwm <= closedPwm)) {
-            currentPwm = closedPwm;
-        }
+    // Step the PWM in the open->closed direction, without passing the target
+    if (closedPwm > openPwm) {
+        _ctx.closePwm = std::min<uint16_t>(_ctx.closePwm + CLOSE_STEP_PWM, closedPwm);
+    } else {
+        _ctx.closePwm = std::max<int>((int)_ctx.closePwm - CLOSE_STEP_PWM, closedPwm);
+    }
 
-        _tankManager.setServoPWM(HOPPER_SERVO_INDEX, currentPwm);
-        vTaskDelay(pdMS_TO_TICKS(CLOSE_STEP_DELAY_MS));
+    _tankManager.setServoPWM(HOPPER_SERVO_INDEX, _ctx.closePwm);
+    // The requested window leaves out the conversions blanked by the step's transient
+    _requestSample(now);
+}
 
-        // Check for weight spike
-        float currentWeight = _scale.getWeight();
-        if (std::isnan(currentWeight)) {
-            ESP_LOGW(TAG, "Scale read NaN during close detection");
-            continue;
-        }
+void RecipeProcessor::_tickCloseDetect(TickType_t now)
+{
+    float currentWeight;
+    if (!_takeSample(currentWeight)) {
+        return;
+    }
 
-        float weightChange = currentWeight - baselineWeight;
-        _ctx.closeAttempts++;
+    uint16_t openPwm = _tankManager.getHopperOpenPwm();
+    uint16_t closedPwm = _tankManager.getHopperClosedPwm();
+    _ctx.closeAttempts++;
 
+    if (std::isnan(currentWeight)) {
+        ESP_LOGW(TAG, "Scale read NaN during close detection");
+    } else {
+        float weightChange = currentWeight - _ctx.preCloseWeight;
         if (weightChange >= CLOSE_WEIGHT_SPIKE_GRAMS) {
             ESP_LOGI(TAG, "Spike detected! Weight change: %.2fg at PWM %d (attempt %d)",
-                     weightChange, currentPwm, _ctx.closeAttempts);
+                     weightChange, _ctx.closePwm, _ctx.closeAttempts);
 
             // Back off slightly
-            _ctx.phase = DispensingPhase::PHASE_CLOSE_BACKOFF;
-            uint16_t backoffPwm = currentPwm - (step > 0 ? CLOSE_BACKOFF_PWM : -CLOSE_BACKOFF_PWM);
+            uint16_t backoffPwm = _ctx.closePwm - (closedPwm > openPwm ? CLOSE_BACKOFF_PWM : -CLOSE_BACKOFF_PWM);
             _tankManager.setServoPWM(HOPPER_SERVO_INDEX, backoffPwm);
             _ctx.learnedClosePwm = backoffPwm;
             _ctx.closeCalibrated = true;
-            vTaskDelay(pdMS_TO_TICKS(100));
-
-            return true;
-        }
-
-        // If we've reached the target without detecting spike
-        if (currentPwm == closedPwm) {
-            break;
+            _enterPhase(DispensingPhase::PHASE_CLOSE_BACKOFF, now);
+            return;
         }
     }
 
-    return false;
+    if (_ctx.closePwm == closedPwm || _ctx.closeAttempts >= CLOSE_MAX_ATTEMPTS) {
+        ESP_LOGW(TAG, "Close spike not detected after %d attempts, using default close PWM",
+                 _ctx.closeAttempts);
+        // Fall back to default close position
+        _tankManager.closeHopper();
+        _ctx.learnedClosePwm = closedPwm;
+        _enterPhase(DispensingPhase::PHASE_CLOSE_SETTLE, now);
+        return;
+    }
+    _stepClose(now);
 }
 
 // ============================================================================
 // Phase 3: Dispense
 // ============================================================================
 
-bool RecipeProcessor::_dispenseBatch()
+void RecipeProcessor::_enterDispense(TickType_t now)
 {
     ESP_LOGI(TAG, "PHASE: Dispense batch");
-    _ctx.phase = DispensingPhase::PHASE_DISPENSE_AUGER;
-    _ctx.phaseStartTick = xTaskGetTickCount();
+    _enterPhase(DispensingPhase::PHASE_DISPENSE_AUGER, now);
 
     // Calculate batch target
     float batchTarget = _calculateBatchTarget();
     _ctx.currentBatchTargetGrams = batchTarget;
     _ctx.currentBatchDispensedGrams = 0.0f;
+    _ctx.currentIngredientIndex = 0;
 
     ESP_LOGI(TAG, "Batch target: %.2fg", batchTarget);
 
     if (batchTarget < 0.5f) {
         ESP_LOGW(TAG, "Batch target too small (%.2fg), skipping", batchTarget);
-        return true;
-    }
-
-    // Dispense from each ingredient proportionally
-    size_t numIngredients = std::min(_ctx.ingredients.size(), (size_t)MAX_INGREDIENTS);
-
-    for (size_t i = 0; i < numIngredients; i++) {
-        if (_checkEmergencyStop()) {
-            _handleError(DispensingError::ERR_EMERGENCY_STOP);
-            return false;
-        }
-
-        float ingredientRemaining = _ctx.ingredientRemainingGrams[i];
-        if (ingredientRemaining < 0.5f) {
-            continue; // Skip depleted ingredients
-        }
-
-        // Calculate this ingredient's portion of the batch
-        float percentage = _ctx.ingredients[i].percentage / 100.0f;
-        float ingredientTarget = batchTarget * percentage;
-        ingredientTarget = std::min(ingredientTarget, ingredientRemaining);
-
-        if (ingredientTarget < 0.5f) {
-            continue;
-        }
-
-        ESP_LOGI(TAG, "Dispensing %.2fg from ingredient %zu (tank 0x%016llx)",
-                 ingredientTarget, i, _ctx.ingredients[i].tankUid);
-
-        float dispensed = 0.0f;
-        bool success = _runAugerForIngredient(_ctx.ingredients[i].tankUid, ingredientTarget, dispensed);
-
-        // Update tracking regardless of success
-        _ctx.ingredientRemainingGrams[i] -= dispensed;
-        _ctx.currentBatchDispensedGrams += dispensed;
-        _ctx.dispensedGrams += dispensed;
-
-        if (!success) {
-            // Log but don't fail - try other ingredients
-            ESP_LOGW(TAG, "Ingredient %zu dispense incomplete: %.2fg of %.2fg",
-                     i, dispensed, ingredientTarget);
-        }
+        _afterBatch(now);
+        return;
     }
-
-    // Settling phase
-    ESP_LOGI(TAG, "PHASE: Dispense settle - waiting %dms", DISPENSE_SETTLE_MS);
-    _ctx.phase = DispensingPhase::PHASE_DISPENSE_SETTLE;
-    vTaskDelay(pdMS_TO_TICKS(DISPENSE_SETTLE_MS));
-
-    ESP_LOGI(TAG, "Batch complete: dispensed %.2fg (target %.2fg). Total: %.2fg / %.2fg",
-             _ctx.currentBatchDispensedGrams, _ctx.currentBatchTargetGrams,
-             _ctx.dispensedGrams, _ctx.totalTargetGrams);
-
-    return true;
+    _nextIngredient(now);
 }
 
 float RecipeProcessor::_calculateBatchTarget()
 {
     // Remaining to dispense
     float remaining = _ctx.totalTargetGrams - _ctx.dispensedGrams;
+    if (_ctx.operation == DispensingOperation::OP_CALIBRATE_DENSITY) {
+        return remaining; // Fills the hopper whatever the density
+    }
 
     // Calculate max hopper capacity based on densest ingredient
     float minDensityGramsPerLiter = 0.0f;
@@ -549,103 +916,239 @@ float RecipeProcessor::_calculateBatchTarget()
     return std::min(remaining, maxHopperGrams);
 }
 
-bool RecipeProcessor::_runAugerForIngredient(uint64_t tankUid, float targetGrams, float& dispensedOut)
+void RecipeProcessor::_nextIngredient(TickType_t now)
 {
-    dispensedOut = 0.0f;
+    // Dispense from each ingredient proportionally
+    size_t numIngredients = std::min(_ctx.ingredients.size(), (size_t)MAX_INGREDIENTS);
 
-    int8_t servoId = _tankManager.getBusOfTank(tankUid);
-    if (servoId < 0) {
-        ESP_LOGE(TAG, "Auger failed: tank 0x%016llx not found", tankUid);
-        if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
-            _deviceState.lastEvent = DeviceEvent_e::DEVEVENT_TANK_NOT_FOUND;
-            xSemaphoreGive(_mutex);
+    for (; _ctx.currentIngredientIndex < numIngredients; _ctx.currentIngredientIndex++) {
+        size_t i = _ctx.currentIngredientIndex;
+        float ingredientRemaining = _ctx.ingredientRemainingGrams[i];
+        if (ingredientRemaining < 0.5f) {
+            continue; // Skip depleted ingredients
         }
-        return false;
-    }
 
-    float initialWeight = _scale.getWeight();
-    if (std::isnan(initialWeight)) {
-        ESP_LOGE(TAG, "Scale unresponsive before auger run");
-        _handleError(DispensingError::ERR_SCALE_UNRESPONSIVE);
-        return false;
-    }
+        // Calculate this ingredient's portion of the batch
+        float percentage = _ctx.ingredients[i].percentage / 100.0f;
+        float ingredientTarget = std::min(_ctx.currentBatchTargetGrams * percentage, ingredientRemaining);
+        if (ingredientTarget < 0.5f) {
+            continue;
+        }
 
-    // Start auger at full speed
-    _tankManager.setContinuousServo(servoId, AUGER_FULL_SPEED);
+        ESP_LOGI(TAG, "Dispensing %.2fg from ingredient %zu (tank 0x%016llx)",
+                 ingredientTarget, i, _ctx.ingredients[i].tankUid);
 
-    TickType_t startTime = xTaskGetTickCount();
-    float prevWeight = initialWeight;
-    TickType_t lastWeightChangeTime = startTime;
+        _ctx.ingredientTargetGrams = ingredientTarget;
+        _ctx.ingredientDispensedGrams = 0.0f;
+        _ctx.augerServo = -1;
 
-    while (dispensedOut < targetGrams) {
-        if (_checkEmergencyStop()) {
-            _tankManager.setContinuousServo(servoId, 0.0f);
-            _handleError(DispensingError::ERR_EMERGENCY_STOP);
-            return false;
+        if (_tankManager.getBusOfTank(_ctx.ingredients[i].tankUid) < 0) {
+            ESP_LOGE(TAG, "Auger failed: tank 0x%016llx not found", _ctx.ingredients[i].tankUid);
+            if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+                _deviceState.lastEvent = DeviceEvent_e::DEVEVENT_TANK_NOT_FOUND;
+                xSemaphoreGive(_mutex);
+            }
+            // Log but don't fail - try other ingredients
+            ESP_LOGW(TAG, "Ingredient %zu dispense incomplete: 0.00g of %.2fg", i, ingredientTarget);
+            continue;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(DISPENSING_LOOP_PERIOD_MS));
+        // Reference weight, the auger starts once it is in
+        _enterPhase(DispensingPhase::PHASE_DISPENSE_AUGER, now);
+        _requestSample(now);
+        return;
+    }
 
-        float currentWeight = _scale.getWeight();
-        if (std::isnan(currentWeight)) {
-            ESP_LOGW(TAG, "Scale read NaN during auger");
-            continue;
-        }
+    // Settling phase
+    ESP_LOGI(TAG, "PHASE: Dispense settle - waiting %dms", DISPENSE_SETTLE_MS);
+    _enterPhase(DispensingPhase::PHASE_DISPENSE_SETTLE, now);
+}
 
-        dispensedOut = currentWeight - initialWeight;
+void RecipeProcessor::_tickAuger(TickType_t now)
+{
+    uint64_t tankUid = _ctx.ingredients[_ctx.currentIngredientIndex].tankUid;
+    float currentWeight;
 
-        // Check for weight change (stall detection)
-        if (abs(currentWeight - prevWeight) >= _deviceState.Settings.getDispensingWeightChangeThreshold()) {
-            lastWeightChangeTime = xTaskGetTickCount();
+    if (_ctx.augerServo < 0) {
+        if (!_takeSample(currentWeight)) {
+            return;
         }
-        prevWeight = currentWeight;
+        if (std::isnan(currentWeight)) {
+            ESP_LOGE(TAG, "Scale unresponsive before auger run");
+            _handleError(DispensingError::ERR_SCALE_UNRESPONSIVE, now);
+            return;
+        }
+        // Start auger at full speed
+        _ctx.augerServo = _tankManager.getBusOfTank(tankUid);
+        if (_ctx.augerServo < 0) {
+            ESP_LOGE(TAG, "Auger failed: tank 0x%016llx not found", tankUid);
+            _finishIngredient(false, now);
+            return;
+        }
+        _ctx.augerStartGrams = currentWeight;
+        _ctx.augerStartTick = now;
+        _ctx.prevWeight = currentWeight;
+        _ctx.augerSlow = false;
+        _ctx.lastWeightChangeTick = now;
+        _tankManager.setContinuousServo(_ctx.augerServo, AUGER_FULL_SPEED);
+        _requestSample(now);
+        return;
+    }
 
-        // Timeout check
-        uint32_t timeoutMs = _deviceState.Settings.getDispensingNoWeightChangeTimeout_ms();
-        if ((xTaskGetTickCount() - lastWeightChangeTime) > pdMS_TO_TICKS(timeoutMs)) {
-            ESP_LOGW(TAG, "Auger timeout for tank 0x%016llx - tank may be empty", tankUid);
-            _tankManager.setContinuousServo(servoId, 0.0f);
-            if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
-                _deviceState.lastEvent = DeviceEvent_e::DEVEVENT_TANK_EMPTY;
-                xSemaphoreGive(_mutex);
-            }
-            return false;
+    // Timeout check, also covers a scale that stopped answering
+    uint32_t timeoutMs = _deviceState.Settings.getDispensingNoWeightChangeTimeout_ms();
+    if ((now - _ctx.lastWeightChangeTick) > pdMS_TO_TICKS(timeoutMs)) {
+        if (_ctx.operation == DispensingOperation::OP_CALIBRATE_DENSITY) {
+            // The kibble backs up to the auger outlet: the hopper is full since the last weight change
+            _tankManager.setContinuousServo(_ctx.augerServo, 0.0f);
+            _ctx.fillTicks = _ctx.lastWeightChangeTick - _ctx.augerStartTick;
+            ESP_LOGI(TAG, "Hopper full: %.2fg after %lums", _ctx.ingredientDispensedGrams, (unsigned long)pdTICKS_TO_MS(_ctx.fillTicks));
+            _finishIngredient(true, now);
+            return;
         }
+        ESP_LOGW(TAG, "Auger timeout for tank 0x%016llx - tank may be empty", tankUid);
+        _tankManager.setContinuousServo(_ctx.augerServo, 0.0f);
+        if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+            _deviceState.lastEvent = DeviceEvent_e::DEVEVENT_TANK_EMPTY;
+            xSemaphoreGive(_mutex);
+        }
+        _finishIngredient(false, now);
+        return;
+    }
 
-        // Slow down when approaching target
-        float remaining = targetGrams - dispensedOut;
-        if (remaining < AUGER_SLOW_THRESHOLD_GRAMS) {
-            _tankManager.setContinuousServo(servoId, AUGER_SLOW_SPEED);
+    if (!_takeSample(currentWeight)) {
+        return;
+    }
+    if (std::isnan(currentWeight)) {
+        ESP_LOGW(TAG, "Scale read NaN during auger");
+        _requestSample(now);
+        return;
+    }
+
+    _ctx.ingredientDispensedGrams = currentWeight - _ctx.augerStartGrams;
+
+    // Check for weight change (stall detection)
+    if (std::fabs(currentWeight - _ctx.prevWeight) >= _deviceState.Settings.getDispensingWeightChangeThreshold()) {
+        _ctx.lastWeightChangeTick = now;
+    }
+    _ctx.prevWeight = currentWeight;
+
+    if (_ctx.ingredientDispensedGrams >= _ctx.ingredientTargetGrams) {
+        // Stop auger
+        _tankManager.setContinuousServo(_ctx.augerServo, 0.0f);
+        if (!_ctx.augerSlow) {
+            _recordAugerFlow(now);
         }
+        ESP_LOGI(TAG, "Auger complete: dispensed %.2fg (target %.2fg) from tank 0x%016llx",
+                 _ctx.ingredientDispensedGrams, _ctx.ingredientTargetGrams, tankUid);
+        _finishIngredient(true, now);
+        return;
     }
 
-    // Stop auger
-    _tankManager.setContinuousServo(servoId, 0.0f);
+    // Slow down when approaching target
+    if (!_ctx.augerSlow && _ctx.ingredientTargetGrams - _ctx.ingredientDispensedGrams < AUGER_SLOW_THRESHOLD_GRAMS) {
+        _recordAugerFlow(now);
+        _tankManager.setContinuousServo(_ctx.augerServo, AUGER_SLOW_SPEED);
+        _ctx.augerSlow = true;
+    }
+    _requestSample(now);
+}
 
-    ESP_LOGI(TAG, "Auger complete: dispensed %.2fg (target %.2fg) from tank 0x%016llx",
-             dispensedOut, targetGrams, tankUid);
+void RecipeProcessor::_finishIngredient(bool complete, TickType_t now)
+{
+    size_t i = _ctx.currentIngredientIndex;
+    float dispensed = _ctx.ingredientDispensedGrams;
+
+    // Update tracking regardless of success
+    _ctx.ingredientRemainingGrams[i] -= dispensed;
+    _ctx.currentBatchDispensedGrams += dispensed;
+    _ctx.dispensedGrams += dispensed;
+
+    if (!complete) {
+        // Log but don't fail - try other ingredients
+        ESP_LOGW(TAG, "Ingredient %zu dispense incomplete: %.2fg of %.2fg",
+                 i, dispensed, _ctx.ingredientTargetGrams);
+    }
 
-    return true;
+    _ctx.augerServo = -1;
+    _ctx.awaitingSample = false;
+    _ctx.currentIngredientIndex++;
+    _nextIngredient(now);
+}
+
+void RecipeProcessor::_recordAugerFlow(TickType_t now)
+{
+    if (_ctx.operation == DispensingOperation::OP_CALIBRATE_DENSITY) {
+        return; // The fill slows down as the hopper gets full
+    }
+    size_t i = _ctx.currentIngredientIndex;
+    _ctx.ingredientFlowGrams[i] += _ctx.ingredientDispensedGrams;
+    _ctx.ingredientFlowTicks[i] += now - _ctx.augerStartTick;
+}
+
+void RecipeProcessor::_afterBatch(TickType_t now)
+{
+    if (_ctx.operation == DispensingOperation::OP_STAGE) {
+        // The batch stays in the closed hopper until the meal
+        _finishOperation(true);
+    } else if (_ctx.operation == DispensingOperation::OP_CALIBRATE_DENSITY) {
+        _evaluateDensityCalibration();
+        ESP_LOGI(TAG, "Releasing the calibration fill.");
+        _enterPurge(true, now);
+    } else if (_hasMoreToDispense() && _ctx.currentBatchDispensedGrams <= 0.0f) {
+        // Every auger stalled: another cycle would only stall again
+        ESP_LOGE(TAG, "Nothing dispensed by this batch, %.2fg of %.2fg delivered.", _ctx.dispensedGrams, _ctx.totalTargetGrams);
+        _handleError(DispensingError::ERR_TANK_EMPTY, now);
+    } else if (_hasMoreToDispense()) {
+        _enterPhase(DispensingPhase::PHASE_POST_BATCH, now);
+    } else {
+        // Final purge to release last batch, then close hopper
+        ESP_LOGI(TAG, "Final purge to release last batch.");
+        _enterPurge(true, now);
+    }
 }
 
 // ============================================================================
-// Error Handling & Utilities
+// Density
 // ============================================================================
 
-bool RecipeProcessor::_checkEmergencyStop()
+void RecipeProcessor::_evaluateDensityCalibration()
 {
-    bool stopped = false;
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        stopped = (_deviceState.feedCommand.type == FeedCommandType::EMERGENCY_STOP);
-        xSemaphoreGive(_mutex);
+    uint32_t fillMs = pdTICKS_TO_MS(_ctx.fillTicks);
+    if (fillMs < DENSITY_CALIBRATION_MIN_FILL_MS) {
+        ESP_LOGW(TAG, "Density calibration: the hopper %s.", _ctx.fillTicks == 0 ? "never filled" : "filled too fast to be timed");
+        return;
+    }
+    float density = _ctx.dispensedGrams / MAX_HOPPER_VOLUME_LITERS;
+    if (density < DENSITY_MIN_GPL || density > DENSITY_MAX_GPL) {
+        ESP_LOGW(TAG, "Density calibration: %.2fg in the hopper gives an implausible %.0f g/L.", _ctx.dispensedGrams, density);
+        return;
+    }
+    _ctx.measuredDensity   = (uint16_t)lroundf(density);
+    _ctx.measuredAugerFlow = (uint16_t)std::min(lroundf(MAX_HOPPER_VOLUME_LITERS * 1000.0f * 60000.0f / fillMs), (long)UINT16_MAX);
+    ESP_LOGI(TAG, "Density calibration: %.2fg in %lums, %u g/L, auger flow %u mL/min.", _ctx.dispensedGrams, (unsigned long)fillMs,
+             _ctx.measuredDensity, _ctx.measuredAugerFlow);
+}
+
+void RecipeProcessor::_refineTankDensities()
+{
+    size_t numIngredients = std::min(_ctx.ingredients.size(), (size_t)MAX_INGREDIENTS);
+    for (size_t i = 0; i < numIngredients; i++) {
+        uint32_t flowMs = pdTICKS_TO_MS(_ctx.ingredientFlowTicks[i]);
+        if (flowMs < DENSITY_REFINE_MIN_RUN_MS) {
+            continue;
+        }
+        _tankManager.refineDensity(_ctx.ingredients[i].tankUid, _ctx.ingredientFlowGrams[i] * 60000.0f / flowMs);
     }
-    return stopped;
 }
 
-void RecipeProcessor::_handleError(DispensingError error)
+// ============================================================================
+// Error Handling & Utilities
+// ============================================================================
+
+void RecipeProcessor::_handleError(DispensingError error, TickType_t now)
 {
     _ctx.error = error;
-    _ctx.phase = DispensingPhase::PHASE_ERROR;
 
     const char* errorStr = "UNKNOWN";
     DeviceEvent_e event = DeviceEvent_e::DEVEVENT_NONE;
@@ -685,7 +1188,15 @@ void RecipeProcessor::_handleError(DispensingError error)
         }
     }
 
-    stopAllFeeding();
+    // Stop feeding: auger first, then the hopper closes before the servo power is cut
+    ESP_LOGW(TAG, "Stopping all feeding - closing hopper.");
+    if (_ctx.augerServo >= 0) {
+        _tankManager.setContinuousServo(_ctx.augerServo, 0.0f);
+        _ctx.augerServo = -1;
+    }
+    _tankManager.closeHopper();
+    _ctx.awaitingSample = false;
+    _enterPhase(DispensingPhase::PHASE_STOPPING, now);
 }
 
 float RecipeProcessor::_getTankDensityGramsPerLiter(uint64_t tankUid)
@@ -741,6 +1252,7 @@ bool RecipeProcessor::updateRecipe(const Recipe& recipe)
             r.servings    = recipe.servings;
             r.lastUsed    = time(nullptr);
             _saveRecipesToNVS();
+            _onRecipeChanged(r.uid, false);
             _deviceState.storedRecipes = _recipes;
             ESP_LOGI(TAG, "Updated recipe '%s' (UID %u)", r.name.c_str(), r.uid);
             return true;
@@ -757,6 +1269,7 @@ bool RecipeProcessor::deleteRecipe(uint32_t recipeUid)
     if (it != _recipes.end()) {
         _recipes.erase(it, _recipes.end());
         _saveRecipesToNVS();
+        _onRecipeChanged(recipeUid, true);
         _deviceState.storedRecipes = _recipes;
         ESP_LOGI(TAG, "Deleted recipe with UID %u", recipeUid);
         return true;
@@ -54,10 +54,66 @@ static const uint8_t ssd1680_custom_init_code[] {
 
 // clang-format on
 
+void Ssd1680_Driver::begin(bool reset)
+{
+    Adafruit_SSD1680::begin(reset); // sets BUSY as an input
+    if (_busy_pin <= -1)
+        return;
+    _busySemaphore = xSemaphoreCreateBinary();
+    if (_busySemaphore == NULL) {
+        ESP_LOGE("SSD1680", "Could not create the BUSY semaphore, polling BUSY instead.");
+        return;
+    }
+    attachInterruptArg(_busy_pin, _onBusyFalling, this, FALLING);
+}
+
+void IRAM_ATTR Ssd1680_Driver::_onBusyFalling(void* arg)
+{
+    Ssd1680_Driver* driver              = (Ssd1680_Driver*)arg;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    xSemaphoreGiveFromISR(driver->_busySemaphore, &xHigherPriorityTaskWoken);
+    if (xHigherPriorityTaskWoken)
+        portYIELD_FROM_ISR();
+}
+
+void Ssd1680_Driver::busy_wait()
+{
+    if (_busy_pin <= -1) {
+        // No BUSY line: wait out the rest of a refresh started by update()
+        uint32_t elapsed = millis() - _refreshStartMs;
+        if (_refreshStartMs != 0 && elapsed < 1000)
+            vTaskDelay(pdMS_TO_TICKS(1000 - elapsed));
+    } else if (_busySemaphore == NULL) {
+        while (digitalRead(_busy_pin))
+            vTaskDelay(pdMS_TO_TICKS(10));
+    } else {
+        xSemaphoreTake(_busySemaphore, 0); // drop the edge of an earlier, already waited for, busy period
+        TickType_t start = xTaskGetTickCount();
+        while (digitalRead(_busy_pin)) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= pdMS_TO_TICKS(SSD1680_BUSY_TIMEOUT_MS)
+              || xSemaphoreTake(_busySemaphore, pdMS_TO_TICKS(SSD1680_BUSY_TIMEOUT_MS) - elapsed) != pdTRUE) {
+                ESP_LOGE("SSD1680", "Panel still busy after %d ms.", SSD1680_BUSY_TIMEOUT_MS);
+                break;
+            }
+        }
+    }
+    _refreshStartMs = 0;
+}
+
+void Ssd1680_Driver::waitForRefresh()
+{
+    if (_refreshStartMs != 0)
+        busy_wait();
+}
+
 void Ssd1680_Driver::powerUp()
 {
     uint8_t buf[5];
 
+    // A reset would abort the refresh started by the previous frame. BUSY also stays high
+    // in deep sleep, so it is only waited for after an update().
+    waitForRefresh();
     hardwareReset();
     delay(100);
     busy_wait();
@@ -109,10 +165,6 @@ void Ssd1680_Driver::update()
 #endif
     EPD_command(SSD1680_DISP_CTRL2, buf, 1);
     EPD_command(SSD1680_MASTER_ACTIVATE);
-    busy_wait();
-
-    if(_busy_pin <= -1) {
-        ESP_LOGI("SSD1680", "No busy pin defined, waiting for 1s.");
-        delay(1000);
-    }
+    // Not waited for here: powerUp() does before the next frame, and the framebuffer is free meanwhile.
+    _refreshStartMs = millis() | 1; // 0 means no refresh pending
 }
\ No newline at end of file
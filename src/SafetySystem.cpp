@@ -7,13 +7,14 @@ SafetySystem::SafetySystem(DeviceState& deviceState, SemaphoreHandle_t& mutex, T
     : _deviceState(deviceState), _mutex(mutex), _tankManager(tankManager) {}
 
 void SafetySystem::startTask() {
-    xTaskCreate(
+    xTaskCreateStatic(
         _safetyTask,
         "Safety Task",
-        4096,
+        SAFETY_TASK_STACK_SIZE,
         this,
         10, // High priority to ensure it can react quickly
-        NULL
+        _taskStack,
+        &_taskBuffer
     );
 }
 
@@ -30,12 +31,18 @@ void SafetySystem::_safetyTask(void *pvParameters) {
         vTaskDelay(pdMS_TO_TICKS(100));
 
         bool isFeeding = false;
+        bool isCalibrating = false;
         float currentWeight = 0;
+        float bowlWeight = 0;
         bool safetyEngaged = false;
 
         if (xSemaphoreTake(instance->_mutex, portMAX_DELAY) == pdTRUE) {
             isFeeding = (instance->_deviceState.currentFeedingStatus != "Idle" && instance->_deviceState.currentFeedingStatus != "Error");
+            // The density calibration ends when the weight stops rising, the processor times that run itself
+            isCalibrating = instance->_deviceState.currentFeedingStatus == "Calibrating...";
             currentWeight = instance->_deviceState.currentWeight;
+            // Overfill is judged on the bowl load cell; fall back to the hopper one if channel B is silent.
+            bowlWeight = instance->_deviceState.isBowlScaleResponding ? instance->_deviceState.bowlWeight : currentWeight;
             safetyEngaged = instance->_deviceState.safetyModeEngaged;
             xSemaphoreGive(instance->_mutex);
         }
@@ -44,7 +51,7 @@ void SafetySystem::_safetyTask(void *pvParameters) {
             continue;
         }
 
-        if (isFeeding) {
+        if (isFeeding && !isCalibrating) {
             if (stallCheckStartTime == 0) {
                 stallCheckStartTime = xTaskGetTickCount();
                 lastWeightForStallCheck = currentWeight;
@@ -70,8 +77,8 @@ void SafetySystem::_safetyTask(void *pvParameters) {
             stallCheckStartTime = 0;
         }
 
-        if (currentWeight > 500.0) {
-            ESP_LOGE(TAG, "SAFETY ALERT: Bowl overfill detected! Weight: %.2fg. Stopping all servos.", currentWeight);
+        if (bowlWeight > 500.0) {
+            ESP_LOGE(TAG, "SAFETY ALERT: Bowl overfill detected! Weight: %.2fg. Stopping all servos.", bowlWeight);
             instance->_tankManager.stopAllServos();
             if (xSemaphoreTake(instance->_mutex, portMAX_DELAY) == pdTRUE) {
                 instance->_deviceState.safetyModeEngaged = true;
@@ -0,0 +1,45 @@
+#include "ScaleSampler.hpp"
+
+// Out-of-class definition, C++11 requires it as soon as the constant is odr-used.
+constexpr uint8_t ScaleSampler::CHANNEL_SWITCH_DISCARD;
+
+ScaleSampler::ScaleSampler()
+    : _activeChannel(ScaleChannel::HOPPER), _chipChannel(ScaleChannel::HOPPER), _discardCount(0), _rawSum(0), _sampleCount(0), _failureCount(0),
+      _blankedCount(0)
+{}
+
+ScaleConversion ScaleSampler::onConversion(long raw, bool settled)
+{
+    // The gain pulses trailing this read selected the active channel for the *next* conversion.
+    bool staleInput = (_chipChannel != _activeChannel);
+    _chipChannel    = _activeChannel;
+    if (staleInput) {
+        _discardCount = CHANNEL_SWITCH_DISCARD;
+        return ScaleConversion::STALE_INPUT;
+    }
+    if (raw == 0) {
+        _failureCount++;
+        return ScaleConversion::FAILED;
+    }
+    if (_discardCount > 0) {
+        _discardCount--;
+        return ScaleConversion::DISCARDED;
+    }
+    if (!settled) {
+        _blankedCount++;
+        return ScaleConversion::BLANKED;
+    }
+    _rawSum += raw;
+    _sampleCount++;
+    return ScaleConversion::ACCEPTED;
+}
+
+void ScaleSampler::startWindow(ScaleChannel channel)
+{
+    _activeChannel = channel;
+    _rawSum        = 0;
+    _sampleCount   = 0;
+    _failureCount  = 0;
+    _blankedCount  = 0;
+    _discardCount  = 0;
+}
@@ -0,0 +1,148 @@
+#include "ScaleTrace.hpp"
+#include <time.h>
+#include "esp_log.h"
+
+static const char* TAG = "ScaleTrace";
+
+ScaleTrace::ScaleTrace(fs::FS& fs, const char* path)
+    : _fs(fs), _path(path), _traceMutex(NULL), _armed(false), _recording(false), _lastRecordMs(0), _lastRaw { 0, 0 }, _bytesWritten(0),
+      _bufferLen(0)
+{}
+
+bool ScaleTrace::begin()
+{
+    _traceMutex = xSemaphoreCreateMutex();
+    if (_traceMutex == NULL) {
+        ESP_LOGE(TAG, "Could not create trace mutex.");
+        return false;
+    }
+    return true;
+}
+
+bool ScaleTrace::start()
+{
+    if (!_armed || _traceMutex == NULL)
+        return false;
+    if (xSemaphoreTake(_traceMutex, pdMS_TO_TICKS(100)) != pdTRUE)
+        return false;
+
+    _armed = false;
+    _file  = _fs.open(_path, FILE_WRITE);
+    if (!_file) {
+        ESP_LOGE(TAG, "Could not create %s", _path);
+        xSemaphoreGive(_traceMutex);
+        return false;
+    }
+
+    uint8_t header[SCALE_TRACE_HEADER_SIZE] = { 0 };
+    memcpy(header, SCALE_TRACE_MAGIC, 4);
+    header[4] = SCALE_TRACE_VERSION;
+    _lastRecordMs = millis();
+    ScaleTraceCodec::putLe32(header + 8, _lastRecordMs);
+    ScaleTraceCodec::putLe32(header + 12, (uint32_t)time(nullptr));
+
+    _bufferLen    = 0;
+    _bytesWritten = 0;
+    _lastRaw[0] = _lastRaw[1] = 0;
+    _append(header, sizeof(header));
+    _writeMark(ScaleTraceMark::CAPTURE_START);
+    _recording = true;
+    xSemaphoreGive(_traceMutex);
+
+    ESP_LOGI(TAG, "Capture started into %s", _path);
+    return true;
+}
+
+void ScaleTrace::stop()
+{
+    if (!_recording)
+        return;
+    if (xSemaphoreTake(_traceMutex, pdMS_TO_TICKS(500)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire trace mutex for stop().");
+        return;
+    }
+    _writeMark(ScaleTraceMark::CAPTURE_END);
+    _flush();
+    _file.close();
+    _recording = false;
+    xSemaphoreGive(_traceMutex);
+    ESP_LOGI(TAG, "Capture ended, %u bytes written.", (unsigned)_bytesWritten);
+}
+
+void ScaleTrace::recordSample(uint8_t channel, long raw)
+{
+    if (!_recording || channel > 1)
+        return;
+    // Never hold the sampling task back for long; a missing sample is preferable to a late one.
+    if (xSemaphoreTake(_traceMutex, pdMS_TO_TICKS(5)) != pdTRUE)
+        return;
+    if (_recording && _hasRoomFor(SCALE_TRACE_MAX_RECORD)) {
+        uint8_t record[SCALE_TRACE_MAX_RECORD];
+        size_t len       = _putTag(record, (ScaleTraceRecordType)channel);
+        len             += ScaleTraceCodec::putVarint(record + len, ScaleTraceCodec::zigzag((int32_t)raw - _lastRaw[channel]));
+        _lastRaw[channel] = (int32_t)raw;
+        _append(record, len);
+    }
+    xSemaphoreGive(_traceMutex);
+}
+
+void ScaleTrace::recordServo(uint8_t servoNum, uint16_t pwm)
+{
+    if (!_recording)
+        return;
+    if (xSemaphoreTake(_traceMutex, pdMS_TO_TICKS(20)) != pdTRUE)
+        return;
+    if (_recording && _hasRoomFor(SCALE_TRACE_MAX_RECORD)) {
+        uint8_t record[SCALE_TRACE_MAX_RECORD];
+        size_t len    = _putTag(record, ScaleTraceRecordType::SERVO);
+        record[len++] = servoNum;
+        len          += ScaleTraceCodec::putVarint(record + len, pwm);
+        _append(record, len);
+    }
+    xSemaphoreGive(_traceMutex);
+}
+
+// ============================================================================
+// Encoding (caller must hold _traceMutex)
+// ============================================================================
+
+size_t ScaleTrace::_putTag(uint8_t* out, ScaleTraceRecordType type)
+{
+    uint32_t now  = millis();
+    uint32_t dt   = now - _lastRecordMs;
+    _lastRecordMs = now;
+    return ScaleTraceCodec::putVarint(out, (dt << 2) | (uint8_t)type);
+}
+
+bool ScaleTrace::_hasRoomFor(size_t len) const
+{
+    // Always keep room for the closing mark; past the cap the rest of the capture is dropped.
+    return _bytesWritten + _bufferLen + len + SCALE_TRACE_MAX_RECORD <= SCALE_TRACE_MAX_BYTES;
+}
+
+void ScaleTrace::_append(const uint8_t* record, size_t len)
+{
+    if (_bufferLen + len > sizeof(_buffer))
+        _flush();
+    memcpy(_buffer + _bufferLen, record, len);
+    _bufferLen += len;
+}
+
+void ScaleTrace::_flush()
+{
+    if (_bufferLen == 0)
+        return;
+    size_t written = _file.write(_buffer, _bufferLen);
+    if (written != _bufferLen)
+        ESP_LOGW(TAG, "Short write on %s (%u/%u)", _path, (unsigned)written, (unsigned)_bufferLen);
+    _bytesWritten += written;
+    _bufferLen = 0;
+}
+
+void ScaleTrace::_writeMark(ScaleTraceMark mark)
+{
+    uint8_t record[SCALE_TRACE_MAX_RECORD];
+    size_t len    = _putTag(record, ScaleTraceRecordType::MARK);
+    record[len++] = (uint8_t)mark;
+    _append(record, len);
+}
@@ -0,0 +1,405 @@
+#include "Storage.hpp"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "rom/crc.h"
+#include "vfs_api.h"
+#include <LittleFS.h>
+#include <SPIFFS.h>
+#include <cstddef>
+#include <cstring>
+
+static const char* TAG = "Storage";
+
+Storage storage;
+
+Storage::Storage()
+    : fs::FS(fs::FSImplPtr(new VFSImpl())), _backend(StorageBackend::NONE), _migration(StorageMigration::NOT_NEEDED), _openLatencyUs(0)
+{}
+
+bool Storage::begin()
+{
+    uint32_t startMs = millis();
+    // The inactive OTA slot is the only flash large enough to hold the partition content meanwhile
+    const esp_partition_t* scratch = esp_ota_get_next_update_partition(NULL);
+    ArchiveHeader header;
+
+    if (scratch != nullptr && _readArchiveHeader(scratch, header)) {
+        ESP_LOGW(TAG, "Found the archive of an interrupted migration (%lu files), resuming it.", (unsigned long)header.fileCount);
+        _migration = _resume(scratch, header);
+    } else if (_mountLittleFS(false)) {
+        _migration = StorageMigration::NOT_NEEDED;
+        _use(StorageBackend::LITTLEFS);
+    } else if (_mountSPIFFS(false)) {
+        _migration = _migrate(scratch);
+    } else if (_mountLittleFS(true)) {
+        ESP_LOGW(TAG, "Data partition blank or unreadable, formatted as LittleFS.");
+        _migration = StorageMigration::NOT_NEEDED;
+        _use(StorageBackend::LITTLEFS);
+    } else {
+        ESP_LOGE(TAG, "Could not mount nor format the data partition.");
+        return false;
+    }
+
+    if (_backend == StorageBackend::NONE)
+        return false;
+
+    _measureOpenLatency();
+    ESP_LOGI(TAG, "Data partition: %s (%s), %u of %u bytes used, mounted in %lums, %luus per open.", getBackendName(_backend),
+      getMigrationName(_migration), usedBytes(), totalBytes(), (unsigned long)(millis() - startMs), (unsigned long)_openLatencyUs);
+    return true;
+}
+
+const char* Storage::getBackendName(StorageBackend backend)
+{
+    switch (backend) {
+        case StorageBackend::LITTLEFS:
+            return "littlefs";
+        case StorageBackend::SPIFFS:
+            return "spiffs";
+        default:
+            return "none";
+    }
+}
+
+const char* Storage::getMigrationName(StorageMigration migration)
+{
+    switch (migration) {
+        case StorageMigration::MIGRATED:
+            return "migrated";
+        case StorageMigration::RESUMED:
+            return "resumed";
+        case StorageMigration::KEPT_SPIFFS:
+            return "kept_spiffs";
+        case StorageMigration::ROLLED_BACK:
+            return "rolled_back";
+        case StorageMigration::FAILED:
+            return "failed";
+        default:
+            return "not_needed";
+    }
+}
+
+size_t Storage::totalBytes()
+{
+    switch (_backend) {
+        case StorageBackend::LITTLEFS:
+            return LittleFS.totalBytes();
+        case StorageBackend::SPIFFS:
+            return SPIFFS.totalBytes();
+        default:
+            return 0;
+    }
+}
+
+size_t Storage::usedBytes()
+{
+    switch (_backend) {
+        case StorageBackend::LITTLEFS:
+            return LittleFS.usedBytes();
+        case StorageBackend::SPIFFS:
+            return SPIFFS.usedBytes();
+        default:
+            return 0;
+    }
+}
+
+bool Storage::commit(const char* tmpPath, const char* path)
+{
+    if (_backend == StorageBackend::SPIFFS && exists(path) && !remove(path)) {
+        ESP_LOGE(TAG, "Could not remove %s to replace it.", path);
+        return false;
+    }
+    if (!rename(tmpPath, path)) {
+        ESP_LOGE(TAG, "Could not rename %s to %s.", tmpPath, path);
+        remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Mounting
+// ============================================================================
+
+bool Storage::_mountLittleFS(bool format)
+{
+    return LittleFS.begin(format, STORAGE_LITTLEFS_PATH, STORAGE_MAX_OPEN_FILES, STORAGE_PARTITION_LABEL);
+}
+
+bool Storage::_mountSPIFFS(bool format)
+{
+    return SPIFFS.begin(format, STORAGE_SPIFFS_PATH, STORAGE_MAX_OPEN_FILES, STORAGE_PARTITION_LABEL);
+}
+
+void Storage::_use(StorageBackend backend)
+{
+    // Both filesystems are VFS mounts: pointing this FS at the mount point forwards every call
+    _backend = backend;
+    _impl->mountpoint(backend == StorageBackend::SPIFFS ? STORAGE_SPIFFS_PATH : STORAGE_LITTLEFS_PATH);
+}
+
+void Storage::_measureOpenLatency()
+{
+    static constexpr uint8_t MAX_PROBES = 8;
+    String paths[MAX_PROBES];
+    uint8_t count = 0;
+
+    File root = open("/");
+    for (File file = root.openNextFile(); file && count < MAX_PROBES; file = root.openNextFile()) {
+        if (!file.isDirectory())
+            paths[count++] = file.path();
+    }
+    root.close();
+    if (count == 0)
+        return;
+
+    uint32_t startUs = micros();
+    for (uint8_t i = 0; i < count; i++) {
+        File file = open(paths[i], FILE_READ);
+        file.close();
+    }
+    _openLatencyUs = (micros() - startUs) / count;
+}
+
+// ============================================================================
+// SPIFFS Migration
+// ============================================================================
+
+StorageMigration Storage::_migrate(const esp_partition_t* scratch)
+{
+    ESP_LOGW(TAG, "Data partition holds SPIFFS, migrating it to LittleFS.");
+    if (scratch == nullptr || !_packArchive(scratch)) {
+        ESP_LOGE(TAG, "Could not archive the SPIFFS content, staying on SPIFFS.");
+        _use(StorageBackend::SPIFFS);
+        return StorageMigration::KEPT_SPIFFS;
+    }
+    SPIFFS.end();
+
+    ArchiveHeader header;
+    if (!_readArchiveHeader(scratch, header)) {
+        // Cannot happen after a verified pack, short of a flash fault
+        _mountSPIFFS(false);
+        _use(StorageBackend::SPIFFS);
+        return StorageMigration::KEPT_SPIFFS;
+    }
+    StorageMigration result = _resume(scratch, header);
+    return result == StorageMigration::RESUMED ? StorageMigration::MIGRATED : result;
+}
+
+StorageMigration Storage::_resume(const esp_partition_t* scratch, const ArchiveHeader& header)
+{
+    // The partition may still hold the only good copy: nothing is formatted for a damaged archive
+    if (!_verifyArchive(scratch, header)) {
+        ESP_LOGE(TAG, "Archive CRC mismatch, discarded; the data partition is left as it is.");
+        _eraseArchive(scratch);
+        if (_mountSPIFFS(false)) {
+            _use(StorageBackend::SPIFFS);
+            return StorageMigration::KEPT_SPIFFS;
+        }
+        if (_mountLittleFS(true))
+            _use(StorageBackend::LITTLEFS);
+        return StorageMigration::FAILED;
+    }
+
+    // Formatting wipes whatever a previous attempt left, whichever filesystem it was
+    if (_mountLittleFS(true) && LittleFS.format()) {
+        if (_unpackArchive(scratch, header, LittleFS)) {
+            _eraseArchive(scratch);
+            _use(StorageBackend::LITTLEFS);
+            ESP_LOGI(TAG, "Migrated %lu files to LittleFS.", (unsigned long)header.fileCount);
+            return StorageMigration::RESUMED;
+        }
+        LittleFS.end();
+    }
+
+    ESP_LOGE(TAG, "Could not populate LittleFS, restoring SPIFFS.");
+    if (_mountSPIFFS(true) && SPIFFS.format() && _unpackArchive(scratch, header, SPIFFS)) {
+        _eraseArchive(scratch);
+        _use(StorageBackend::SPIFFS);
+        return StorageMigration::ROLLED_BACK;
+    }
+
+    // Keep the archive: the next boot tries again
+    ESP_LOGE(TAG, "Could not restore SPIFFS either, the archive is kept for the next boot.");
+    SPIFFS.end();
+    if (_mountLittleFS(true))
+        _use(StorageBackend::LITTLEFS);
+    return StorageMigration::FAILED;
+}
+
+bool Storage::_readArchiveHeader(const esp_partition_t* scratch, ArchiveHeader& header)
+{
+    if (esp_partition_read(scratch, 0, &header, sizeof(header)) != ESP_OK)
+        return false;
+    if (header.magic != STORAGE_ARCHIVE_MAGIC || header.version != STORAGE_ARCHIVE_VERSION)
+        return false;
+    if (header.headerCrc != crc32_le(0, (const uint8_t*)&header, offsetof(ArchiveHeader, headerCrc)))
+        return false;
+    return ARCHIVE_DATA_OFFSET + header.dataLength <= scratch->size;
+}
+
+bool Storage::_packArchive(const esp_partition_t* scratch)
+{
+    // First pass: size the archive, so that nothing is erased unless it fits
+    uint32_t dataLength = 0;
+    uint32_t fileCount  = 0;
+    File root           = SPIFFS.open("/");
+    for (File file = root.openNextFile(); file; file = root.openNextFile()) {
+        if (file.isDirectory())
+            continue;
+        dataLength += sizeof(ArchiveRecord) + strlen(file.path()) + file.size();
+        fileCount++;
+    }
+    root.close();
+
+    if (ARCHIVE_DATA_OFFSET + dataLength > scratch->size) {
+        ESP_LOGE(TAG, "%lu bytes of SPIFFS content do not fit the %lu-byte scratch slot.", (unsigned long)dataLength,
+          (unsigned long)scratch->size);
+        return false;
+    }
+    size_t eraseLength = (ARCHIVE_DATA_OFFSET + dataLength + STORAGE_SECTOR_SIZE - 1) & ~(size_t)(STORAGE_SECTOR_SIZE - 1);
+    if (esp_partition_erase_range(scratch, 0, eraseLength) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not erase the scratch slot.");
+        return false;
+    }
+
+    uint8_t* buffer = new uint8_t[STORAGE_COPY_CHUNK];
+    uint32_t offset = ARCHIVE_DATA_OFFSET;
+    uint32_t dataCrc = 0;
+    uint32_t packed  = 0;
+    bool ok          = true;
+
+    // Second pass: one record per file, content CRC in the record
+    root = SPIFFS.open("/");
+    for (File file = root.openNextFile(); file && ok; file = root.openNextFile()) {
+        if (file.isDirectory())
+            continue;
+        const char* path     = file.path();
+        ArchiveRecord record = {};
+        record.pathLength    = strlen(path);
+        record.size          = file.size();
+        uint32_t recordAt    = offset;
+        offset += sizeof(record);
+        ok = esp_partition_write(scratch, offset, path, record.pathLength) == ESP_OK;
+        offset += record.pathLength;
+
+        uint32_t remaining = record.size;
+        while (ok && remaining > 0) {
+            size_t len = file.read(buffer, remaining < STORAGE_COPY_CHUNK ? remaining : STORAGE_COPY_CHUNK);
+            if (len == 0 || esp_partition_write(scratch, offset, buffer, len) != ESP_OK) {
+                ok = false;
+                break;
+            }
+            record.crc = crc32_le(record.crc, buffer, len);
+            offset += len;
+            remaining -= len;
+        }
+        ok = ok && offset - ARCHIVE_DATA_OFFSET <= dataLength
+          && esp_partition_write(scratch, recordAt, &record, sizeof(record)) == ESP_OK;
+        if (!ok)
+            ESP_LOGE(TAG, "Could not archive %s.", path);
+        packed++;
+    }
+    root.close();
+    ok = ok && packed == fileCount && offset - ARCHIVE_DATA_OFFSET == dataLength;
+
+    // Read everything back before committing the header
+    for (uint32_t at = ARCHIVE_DATA_OFFSET; ok && at < offset;) {
+        size_t len = offset - at < STORAGE_COPY_CHUNK ? offset - at : STORAGE_COPY_CHUNK;
+        ok         = esp_partition_read(scratch, at, buffer, len) == ESP_OK;
+        dataCrc    = crc32_le(dataCrc, buffer, len);
+        at += len;
+    }
+    delete[] buffer;
+    if (!ok) {
+        ESP_LOGE(TAG, "Archive of the SPIFFS content failed.");
+        return false;
+    }
+
+    ArchiveHeader header = {};
+    header.magic         = STORAGE_ARCHIVE_MAGIC;
+    header.version       = STORAGE_ARCHIVE_VERSION;
+    header.fileCount     = fileCount;
+    header.dataLength    = dataLength;
+    header.dataCrc       = dataCrc;
+    header.headerCrc     = crc32_le(0, (const uint8_t*)&header, offsetof(ArchiveHeader, headerCrc));
+    if (esp_partition_write(scratch, 0, &header, sizeof(header)) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not commit the archive header.");
+        return false;
+    }
+    ESP_LOGI(TAG, "Archived %lu files (%lu bytes) into the '%s' slot.", (unsigned long)fileCount, (unsigned long)dataLength,
+      scratch->label);
+    return true;
+}
+
+bool Storage::_verifyArchive(const esp_partition_t* scratch, const ArchiveHeader& header)
+{
+    uint8_t* buffer  = new uint8_t[STORAGE_COPY_CHUNK];
+    uint32_t end     = ARCHIVE_DATA_OFFSET + header.dataLength;
+    uint32_t dataCrc = 0;
+    bool ok          = true;
+    for (uint32_t at = ARCHIVE_DATA_OFFSET; ok && at < end;) {
+        size_t len = end - at < STORAGE_COPY_CHUNK ? end - at : STORAGE_COPY_CHUNK;
+        ok         = esp_partition_read(scratch, at, buffer, len) == ESP_OK;
+        dataCrc    = crc32_le(dataCrc, buffer, len);
+        at += len;
+    }
+    delete[] buffer;
+    return ok && dataCrc == header.dataCrc;
+}
+
+bool Storage::_unpackArchive(const esp_partition_t* scratch, const ArchiveHeader& header, fs::FS& dest)
+{
+    // The records were checked as a whole by _verifyArchive(), each file is checked again once copied
+    uint8_t* buffer = new uint8_t[STORAGE_COPY_CHUNK];
+    uint32_t offset = ARCHIVE_DATA_OFFSET;
+    uint32_t end    = ARCHIVE_DATA_OFFSET + header.dataLength;
+    bool ok         = true;
+
+    for (uint32_t i = 0; ok && i < header.fileCount; i++) {
+        ArchiveRecord record;
+        char path[256];
+        ok = offset + sizeof(record) <= end && esp_partition_read(scratch, offset, &record, sizeof(record)) == ESP_OK
+          && record.pathLength > 0 && record.pathLength < sizeof(path)
+          && offset + sizeof(record) + record.pathLength + record.size <= end;
+        ok = ok && esp_partition_read(scratch, offset + sizeof(record), path, record.pathLength) == ESP_OK;
+        if (!ok)
+            break;
+        path[record.pathLength] = '\0';
+        offset += sizeof(record) + record.pathLength;
+
+        File file = dest.open(path, FILE_WRITE, true);
+        uint32_t remaining = record.size;
+        ok                 = (bool)file;
+        while (ok && remaining > 0) {
+            size_t len = remaining < STORAGE_COPY_CHUNK ? remaining : STORAGE_COPY_CHUNK;
+            ok         = esp_partition_read(scratch, offset, buffer, len) == ESP_OK && file.write(buffer, len) == len;
+            offset += len;
+            remaining -= len;
+        }
+        file.close();
+
+        // Read the copy back
+        uint32_t crc = 0;
+        file         = dest.open(path, FILE_READ);
+        ok           = ok && file && file.size() == record.size;
+        while (ok) {
+            size_t len = file.read(buffer, STORAGE_COPY_CHUNK);
+            if (len == 0)
+                break;
+            crc = crc32_le(crc, buffer, len);
+        }
+        file.close();
+        ok = ok && crc == record.crc;
+        if (!ok)
+            ESP_LOGE(TAG, "Could not restore %s.", path);
+    }
+    delete[] buffer;
+    return ok && offset == end;
+}
+
+void Storage::_eraseArchive(const esp_partition_t* scratch)
+{
+    // Without its header the archive is never considered again; an OTA update overwrites the rest
+    esp_partition_erase_range(scratch, 0, STORAGE_SECTOR_SIZE);
+}
@@ -5,6 +5,9 @@
 
 static const char* TAG = "SwiMuxSerial";
 
+// Out-of-class definition: the array is ODR-used by negotiateBaudRate() and C++11 has no inline variables.
+constexpr uint32_t SwiMuxSerial_t::SUPPORTED_BAUDS[];
+
 #if defined(DEBUG_SWIMUX) && defined(ARDUINO)
 #include <HardwareSerial.h>
 #define SWI_DBGF(fmt, ...)                                                                                                                           \
@@ -183,11 +186,100 @@ inline static constexpr bool areNegates(uint8_t a, uint8_t b) noexcept
 void SwiMuxSerial_t::begin()
 {
     if (!_beginCalled) {
-        _sPort.begin(57600, SerialConfig::SERIAL_8N1, _rxPin, _txPin);
+        _bauds = DEFAULT_SERIAL_BAUDS;
+        _sPort.begin(_bauds, SerialConfig::SERIAL_8N1, _rxPin, _txPin);
         SWI_DBG("Serial port initialized.");
     }
 }
 
+SwiMuxSerialResult_e SwiMuxSerial_t::negotiateBaudRate(uint32_t preferredBauds)
+{
+    if (!assertAwake())
+        return SwiMuxSerialResult_e::SMREZ_SWIMUX_SILENT;
+
+    // Preferred rate first, then the others from the fastest down
+    uint32_t candidates[1 + sizeof(SUPPORTED_BAUDS) / sizeof(SUPPORTED_BAUDS[0])];
+    size_t count = 0;
+    if (preferredBauds > DEFAULT_SERIAL_BAUDS)
+        candidates[count++] = preferredBauds;
+    for (uint32_t bauds : SUPPORTED_BAUDS) {
+        if (bauds != preferredBauds)
+            candidates[count++] = bauds;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!_requestBaudRate(candidates[i])) {
+            if (_lastResult == SMREZ_UnkownCommand) {
+                ESP_LOGI(TAG, "SwiMux does not support baud negotiation, staying at %u bauds.", DEFAULT_SERIAL_BAUDS);
+                return _lastResult;
+            }
+            continue;
+        }
+        if (_linkTest()) {
+            ESP_LOGI(TAG, "SwiMux link running at %u bauds.", _bauds);
+            return SMREZ_OK;
+        }
+        ESP_LOGW(TAG, "Link test failed at %u bauds.", candidates[i]);
+        if (_bauds != DEFAULT_SERIAL_BAUDS)
+            _fallbackToDefaultBaudRate();
+        if (!assertAwake())
+            return SwiMuxSerialResult_e::SMREZ_SWIMUX_SILENT;
+    }
+    ESP_LOGW(TAG, "No faster rate passed the link test, staying at %u bauds.", DEFAULT_SERIAL_BAUDS);
+    return SMREZ_TIMED_OUT;
+}
+
+bool SwiMuxSerial_t::_requestBaudRate(uint32_t bauds)
+{
+    SwiMuxCmdSetBaud_t cmd = { .Opcode = SMCMD_SetBaudRate, .NegOpcode = (uint8_t)(0xFF & ~SMCMD_SetBaudRate), .bauds = {} };
+    for (int i = 0; i < 4; i++)
+        cmd.bauds[i] = (uint8_t)(bauds >> (8 * i));
+
+    _codec.encode((const uint8_t*)&cmd, sizeof(cmd), [this](uint8_t val) { this->_sPort.write(val); });
+    if (!_codec.waitForAckTo(
+          SMCMD_SetBaudRate, millis, [this]() -> int { return this->_sPort.read(); }, [](unsigned long ms) { vTaskDelay(pdMS_TO_TICKS(ms)); })) {
+        _lastResult = (SwiMuxSerialResult_e)_codec.getLastAckError();
+        return false;
+    }
+
+    // The SwiMux switches once its ACK is out; follow it.
+    _sPort.flush();
+    vTaskDelay(pdMS_TO_TICKS(BAUD_SWITCH_GUARD_MS));
+    _sPort.updateBaudRate(bauds);
+    _bauds = bauds;
+    _resetRoundTripStats();
+    while (_sPort.available()) {
+        _sPort.read();
+    }
+    return true;
+}
+
+bool SwiMuxSerial_t::_linkTest()
+{
+    RollCallArray_t uids;
+    uint32_t bauds = _bauds;
+    for (uint8_t round = 0; round < LINK_TEST_ROUNDS; round++) {
+        // No retries, they would hide a marginal link. A SwiMux silent at the new rate makes
+        // assertAwake() fall back to the default one, where the roll call would pass.
+        if (_rollCallOnce(uids, ROLLCALL_TIMEOUT_MS) != SMREZ_OK || _bauds != bauds)
+            return false;
+    }
+    return true;
+}
+
+void SwiMuxSerial_t::_fallbackToDefaultBaudRate()
+{
+    // Without valid traffic at the new rate, the SwiMux reverts by itself after SWIMUX_BAUD_COMMIT_MS.
+    _sPort.updateBaudRate(DEFAULT_SERIAL_BAUDS);
+    _bauds   = DEFAULT_SERIAL_BAUDS;
+    _resetRoundTripStats();
+    _isAwake = false;
+    vTaskDelay(pdMS_TO_TICKS(SWIMUX_BAUD_COMMIT_MS + 50));
+    while (_sPort.available()) {
+        _sPort.read();
+    }
+}
+
 
 
 bool SwiMuxSerial_t::assertAwake(size_t retries)
@@ -214,6 +306,12 @@ bool SwiMuxSerial_t::assertAwake(size_t retries)
             SWI_DBGF("\r\n--> waitForAckTo(%d) failed, %d retries remaining.\r\n", SMCMD_Wakeup, retries - 1);
         }
     } while (--retries);
+    if (!success && _bauds != DEFAULT_SERIAL_BAUDS) {
+        // The SwiMux may have been power-cycled back to its default rate
+        ESP_LOGW(TAG, "SwiMux silent at %u bauds, falling back to %u bauds.", _bauds, DEFAULT_SERIAL_BAUDS);
+        _fallbackToDefaultBaudRate();
+        return assertAwake();
+    }
     // Wait for any other message to arrive
     vTaskDelay(pdMS_TO_TICKS(20));
     while (_sPort.available()) {
@@ -310,7 +408,7 @@ SwiMuxPresenceReport_t SwiMuxSerial_t::_pollPresencePacket(uint32_t timeout_ms)
 }
 
 
-SwiMuxSerialResult_e SwiMuxSerial_t::getUid(uint8_t busIndex, uint64_t& uid, uint32_t timeout_ms)
+SwiMuxSerialResult_e SwiMuxSerial_t::_getUidOnce(uint8_t busIndex, uint64_t& uid, uint32_t timeout_ms)
 {
     if (!assertAwake())
         return SwiMuxSerialResult_e::SMREZ_SWIMUX_SILENT;
@@ -321,6 +419,7 @@ SwiMuxSerialResult_e SwiMuxSerial_t::getUid(uint8_t busIndex, uint64_t& uid, uin
     size_t pLen      = 0;
     //vTaskDelay(pdMS_TO_TICKS(GETUID_CMD_DELAY_MS));
     uint32_t startTime = millis();
+    _requestSentAt     = startTime;
 
     do {
         if (_sPort.available()) {
@@ -341,6 +440,8 @@ SwiMuxSerialResult_e SwiMuxSerial_t::getUid(uint8_t busIndex, uint64_t& uid, uin
                             return SwiMuxSerialResult_e::SMREZ_OK;
                         } else if (payload[0] == SMCMD_Nack) {
                             _lastResult = (SwiMuxSerialResult_e)payload[2];
+                            _isAwake    = true;
+                            return _lastResult; // a NACK is a complete answer, no use waiting for the timeout
                         } else {
                             _lastResult = SwiMuxSerialResult_e::SMREZ_Framing;
                         }
@@ -359,7 +460,7 @@ SwiMuxSerialResult_e SwiMuxSerial_t::getUid(uint8_t busIndex, uint64_t& uid, uin
 }
 
 
-SwiMuxSerialResult_e SwiMuxSerial_t::rollCall(RollCallArray_t& uidsList, uint32_t timeout_ms)
+SwiMuxSerialResult_e SwiMuxSerial_t::_rollCallOnce(RollCallArray_t& uidsList, uint32_t timeout_ms)
 {
     if (!assertAwake())
         return SwiMuxSerialResult_e::SMREZ_SWIMUX_SILENT;
@@ -368,6 +469,7 @@ SwiMuxSerialResult_e SwiMuxSerial_t::rollCall(RollCallArray_t& uidsList, uint32_
 
     //vTaskDelay(ROLLCALL_CMD_DELAY_MS);
     uint32_t startTime = millis();
+    _requestSentAt     = startTime;
 
     uint8_t* payload = nullptr;
 
@@ -392,6 +494,8 @@ SwiMuxSerialResult_e SwiMuxSerial_t::rollCall(RollCallArray_t& uidsList, uint32_
                             return SMREZ_OK;
                         } else if (payload[0] == SMCMD_Nack) {
                             _lastResult = (SwiMuxSerialResult_e)payload[2];
+                            _isAwake    = true;
+                            return _lastResult;
                         } else {
                             _lastResult = SMREZ_Framing;
                         }
@@ -414,10 +518,8 @@ SwiMuxSerialResult_e SwiMuxSerial_t::rollCall(RollCallArray_t& uidsList, uint32_
 }
 
 
-SwiMuxSerialResult_e SwiMuxSerial_t::read(uint8_t busIndex, uint8_t* bufferOut, uint8_t offset, uint8_t len, uint32_t timeout_ms)
+SwiMuxSerialResult_e SwiMuxSerial_t::_readOnce(uint8_t busIndex, uint8_t* bufferOut, uint8_t offset, uint8_t len, uint32_t timeout_ms)
 {
-    if (bufferOut == nullptr)
-        return SMREZ_NULL_PARAM;
     if (!assertAwake())
         return SwiMuxSerialResult_e::SMREZ_SWIMUX_SILENT;
     // Start by sending the read request.
@@ -430,6 +532,7 @@ SwiMuxSerialResult_e SwiMuxSerial_t::read(uint8_t busIndex, uint8_t* bufferOut,
 
     //vTaskDelay(pdMS_TO_TICKS(SwiMuxSerial_t::READ_CMD_DELAY_MS));
     uint32_t startTime = millis();
+    _requestSentAt     = startTime;
     uint8_t* payload   = nullptr;
     size_t pLen        = 0;
     int received;
@@ -486,19 +589,8 @@ SwiMuxSerialResult_e SwiMuxSerial_t::write(uint8_t busIndex, const uint8_t* buff
         return SMREZ_NULL_PARAM;
     if (!assertAwake())
         return SwiMuxSerialResult_e::SMREZ_SWIMUX_SILENT;
-    // Create a write command.
-    SwiMuxCmdWrite_t* pCmd = (SwiMuxCmdWrite_t*)malloc(sizeof(SwiMuxCmdWrite_t) + (size_t)len);
-
-    if (pCmd == nullptr) { // allocation failed ?
-        ESP_LOGE(
-          TAG, "Could not allocate %u bytes in internal ram for `SwiMuxSerial_t::write` command buffer.", sizeof(SwiMuxCmdWrite_t) + (size_t)len);
-        return SMREZ_WRITE_OUTOFMEM;
-    }
-
-    //// --- START DEBUG ADDITIONS ---
-    //Serial.printf("[DEBUG] pCmd after malloc: %p\n", pCmd);
-    //Serial.flush();
-    //// --- END DEBUG ADDITIONS ---
+    // Build the write command in the buffer sized for the largest one, callers are serialized by the SwiMux mutex.
+    SwiMuxCmdWrite_t* pCmd = (SwiMuxCmdWrite_t*)(void*)_writeCmdBuffer;
 
     pCmd->Opcode    = SMCMD_WriteBytes;
     pCmd->NegOpcode = (uint8_t)(0xFF & ~SMCMD_WriteBytes);
@@ -519,16 +611,102 @@ SwiMuxSerialResult_e SwiMuxSerial_t::write(uint8_t busIndex, const uint8_t* buff
     memcpy(&pCmd->length + 1, bufferIn, len);
 
     SwiMuxSerialResult_e result = SMREZ_WRITE_ENCODE_FAILED;
+    uint32_t ackTimeout         = _timeoutFor(SMRTT_WRITE, timeout_ms, WRITE_TIMEOUT_MS);
+    _requestSentAt              = millis();
     if (_codec.encode((const uint8_t*)(void*)pCmd, sizeof(SwiMuxCmdWrite_t) + (size_t)len, [this](uint8_t wrtVal) { this->_sPort.write(wrtVal); })) {
         if (_codec.waitForAckTo(
               SMCMD_WriteBytes, millis, [this]() -> int { return this->_sPort.read(); }, [](unsigned long wms) { vTaskDelay(pdMS_TO_TICKS(wms)); },
-              3000)) /* <-- timeout_ms = 13ms per character + 70ms per block of 8 bytes + 70ms for a single write */ {
+              ackTimeout)) {
             _isAwake = true;
             result   = SMREZ_OK;
         } else {
             result = (SwiMuxSerialResult_e)_codec.getLastAckError();
         }
+        // Not retried: a write whose ACK was lost may still have reached the EEPROM.
+        _recordRoundTrip(SMRTT_WRITE, result);
     }
-    free(pCmd);
     return result;
 }
+
+
+// ============================================================================
+// Adaptive timeouts and retries
+// ============================================================================
+
+SwiMuxSerialResult_e SwiMuxSerial_t::getUid(uint8_t busIndex, uint64_t& uid, uint32_t timeout_ms)
+{
+    SwiMuxSerialResult_e result;
+    uint8_t attempt = 0;
+    do {
+        result = _getUidOnce(busIndex, uid, _timeoutFor(SMRTT_GETUID, timeout_ms, GETUID_TIMEOUT_MS));
+        _recordRoundTrip(SMRTT_GETUID, result);
+    } while (_shouldRetry(result, attempt++));
+    return result;
+}
+
+SwiMuxSerialResult_e SwiMuxSerial_t::rollCall(RollCallArray_t& uidsList, uint32_t timeout_ms)
+{
+    SwiMuxSerialResult_e result;
+    uint8_t attempt = 0;
+    do {
+        result = _rollCallOnce(uidsList, _timeoutFor(SMRTT_ROLLCALL, timeout_ms, ROLLCALL_TIMEOUT_MS));
+        _recordRoundTrip(SMRTT_ROLLCALL, result);
+    } while (_shouldRetry(result, attempt++));
+    return result;
+}
+
+SwiMuxSerialResult_e SwiMuxSerial_t::read(uint8_t busIndex, uint8_t* bufferOut, uint8_t offset, uint8_t len, uint32_t timeout_ms)
+{
+    if (bufferOut == nullptr)
+        return SMREZ_NULL_PARAM;
+    SwiMuxSerialResult_e result;
+    uint8_t attempt = 0;
+    do {
+        result = _readOnce(busIndex, bufferOut, offset, len, _timeoutFor(SMRTT_READ, timeout_ms, READ_TIMEOUT_MS));
+        _recordRoundTrip(SMRTT_READ, result);
+    } while (_shouldRetry(result, attempt++));
+    return result;
+}
+
+uint32_t SwiMuxSerial_t::_timeoutFor(SwiMuxRttSlot_e slot, uint32_t requested, uint32_t ceiling) const
+{
+    return requested != ADAPTIVE_TIMEOUT ? requested : _rtt[slot].timeoutMs(ceiling);
+}
+
+void SwiMuxSerial_t::_recordRoundTrip(SwiMuxRttSlot_e slot, SwiMuxSerialResult_e result)
+{
+    if (result == SMREZ_TIMED_OUT || result == SMREZ_WRITE_ACK_MISSING)
+        _rtt[slot].onTimeout();
+    else if (result == SMREZ_OK)
+        _rtt[slot].addSample(millis() - _requestSentAt);
+    // Other failures say nothing about the link latency.
+}
+
+bool SwiMuxSerial_t::_shouldRetry(SwiMuxSerialResult_e result, uint8_t attempt)
+{
+    switch (result) {
+        case SMREZ_TIMED_OUT:
+        case SMREZ_Framing:
+        case SMREZ_WrongEscape:
+        case SMREZ_INVALID_PAYLOAD:
+        case SMREZ_READ_RESP_ERROR:
+            break;
+        default:
+            return false;
+    }
+    if (attempt >= IDEMPOTENT_RETRIES)
+        return false;
+    ESP_LOGD(TAG, "Retrying after %s (attempt %u).", getSwiMuxErrorString(result), attempt + 2);
+    // Drop whatever is left of the garbled frame before asking again.
+    vTaskDelay(pdMS_TO_TICKS(UART_DURATION_MS_ROUND(16, _bauds) + 1));
+    while (_sPort.available()) {
+        _sPort.read();
+    }
+    return true;
+}
+
+void SwiMuxSerial_t::_resetRoundTripStats()
+{
+    for (auto& rtt : _rtt)
+        rtt.reset();
+}
@@ -5,9 +5,9 @@
 #include <algorithm>
 #include <cstring>
 #include <cmath>
-#include <cstddef> // Required for offsetof
 #include <esp_mac.h>
 #include "ReedSolomon.hpp"
+#include "HeapGuard.hpp"
 
 static const char* TAG = "TankManager";
 
@@ -46,6 +46,10 @@ void TankEEpromData_t::printTo(Stream& stream, TankEEpromData_t* eeprom)
     stream.flush();
     stream.printf("remainingGrams: %d\r\n", eeprom->data.remainingGrams);
     stream.flush();
+    stream.printf("augerFlow:      %d mL/min\r\n", eeprom->data.augerFlow);
+    stream.flush();
+    stream.printf("densitySource:  %d (%d samples)\r\n", eeprom->data.densitySource, eeprom->data.densitySamples);
+    stream.flush();
 
     { // shallow scope for the `nameCpy` array
         char* pChar             = eeprom->data.name;
@@ -99,6 +103,9 @@ void TankEEpromData_t::format(TankEEpromData_t& eedata)
     eedata.data.density        = 0;
     eedata.data.remainingGrams = 0;
     eedata.data.servoIdlePwm   = 1500; // Safe default
+    eedata.data.augerFlow      = 0;
+    eedata.data.densitySource  = (uint8_t)DensitySource::NONE;
+    eedata.data.densitySamples = 0;
 
     // Finalize will handle ECC
 }
@@ -117,10 +124,25 @@ bool TankEEpromData_t::sanitize(TankEEpromData_t& eedata)
     bool structuralIntegrity = true;
 
     // Check ranges that would indicate corruption or fresh flash (0xFF)
-    if (eedata.data.nameLength > TankEEpromData_t::NAME_FIELD_SIZE) {
+    if (eedata.data.nameLength > TANK_EEPROM_LEGACY_NAME_SIZE) {
         structuralIntegrity = false;
     }
 
+    // Older records had an 80-byte name where the density calibration now lies: shorten a longer name,
+    // and drop calibration fields that can only be leftover characters.
+    bool legacyName = eedata.data.nameLength > TankEEpromData_t::NAME_FIELD_SIZE;
+    if (legacyName) {
+        eedata.data.nameLength                                  = TankEEpromData_t::NAME_FIELD_SIZE;
+        eedata.data.name[TankEEpromData_t::NAME_FIELD_SIZE - 1] = '\0';
+    }
+    DensitySource source = (DensitySource)eedata.data.densitySource;
+    if (legacyName || source > DensitySource::MEASURED
+      || (source == DensitySource::NONE && (eedata.data.augerFlow != 0 || eedata.data.densitySamples != 0))) {
+        eedata.data.augerFlow      = 0;
+        eedata.data.densitySource  = (uint8_t)DensitySource::NONE;
+        eedata.data.densitySamples = 0;
+    }
+
     if (eedata.data.history.lastBusIndex > 6 && eedata.data.history.lastBusIndex != 0xFF)
         structuralIntegrity = false;
 
@@ -132,7 +154,7 @@ bool TankEEpromData_t::sanitize(TankEEpromData_t& eedata)
 }
 
 
-void TankManager::begin(uint16_t hopper_closed_pwm, uint16_t hopper_open_pwm)
+void TankManager::begin(uint16_t hopper_closed_pwm, uint16_t hopper_open_pwm, uint32_t swimuxBauds)
 {
     _hopperClosedPwm = hopper_closed_pwm;
     _hopperOpenPwm   = hopper_open_pwm;
@@ -152,7 +174,21 @@ void TankManager::begin(uint16_t hopper_closed_pwm, uint16_t hopper_open_pwm)
 
     setServoPower(false);
 
+    // Speed up the link before the first discovery
+    if (swimuxBauds != SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS) {
+        if (xSemaphoreTakeRecursive(_swimuxMutex, MUTEX_ACQUISITION_TIMEOUT) == pdTRUE) {
+            _swiMux.negotiateBaudRate(swimuxBauds);
+            xSemaphoreGiveRecursive(_swimuxMutex);
+        }
+    }
+
     ESP_LOGI(TAG, "Initializing Tank Manager with SwiMux interface...");
+    // One tank per bus at most: attaching one does not grow the lists.
+    _knownTanks.reserve(NUMBER_OF_BUSES);
+    if (xSemaphoreTake(_deviceStateMutex, MUTEX_ACQUISITION_TIMEOUT) == pdTRUE) {
+        _deviceState.connectedTanks.reserve(NUMBER_OF_BUSES);
+        xSemaphoreGive(_deviceStateMutex);
+    }
     refresh();
 }
 
@@ -171,15 +207,21 @@ void TankManager::_switchToSwiMode()
 
 void TankManager::_switchToServoMode()
 {
+    // Servo mode cuts the EEPROM power: never under a SwiMux transaction (recursive, callers may hold it already).
+    if (xSemaphoreTakeRecursive(_swimuxMutex, MUTEX_ACQUISITION_TIMEOUT) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire SwiMux mutex to switch to servo mode!");
+        return;
+    }
     _pwm.setPWMFreq(50); // Standard servo frequency
     _pwm.setFull(-1, false); // Set all channel to mute for now.
     // Set each connected tank pulse duration to its idle value.
     for (auto t : _knownTanks) {
-        _pwm.writeMicroseconds(t.busIndex, t.servoIdlePwm);
+        _writeServoPulse(t.busIndex, t.servoIdlePwm);
     }
     // Wait for a full RC servo cycle to elapse.
     vTaskDelay(pdMS_TO_TICKS(20) + 1); // 20ms plus chaff.
     _isServoMode = true;
+    xSemaphoreGiveRecursive(_swimuxMutex);
     ESP_LOGI(TAG, "PCA9685 switched to Servo PWM mode.");
 }
 
@@ -190,6 +232,7 @@ void TankManager::_tankDetectionTask(void* pvParam)
     TankManager* pInst = (TankManager*)pvParam;
     RollCallArray_t currentUids;
     bool changesDetected = false;
+    HeapGuard::watchCurrentTask();
 
     // Task loop
     while (1) {
@@ -214,15 +257,15 @@ void TankManager::_tankDetectionTask(void* pvParam)
                     }
 
                     if (changedBuses != 0) {
+                        // Reading the new tanks and notifying the web clients allocates, a tank swap is no steady state.
+                        HeapGuard::Allow allowance;
                         changesDetected = true;
                         ESP_LOGI(TAG, "Tank population change detected on buses: 0x%02X", changedBuses);
                         // We are already holding the mutex, but refresh() expects to take it.
                         // Since it's a recursive mutex, this is fine.
                         pInst->refresh(changedBuses);
-                        // Notify listeners (e.g., WebServer SSE) of tank population change.
-                        if (pInst->_onTanksChangedCallback) {
-                            pInst->_onTanksChangedCallback();
-                        }
+                        // Notify listeners (e.g., WebServer SSE) of tank population change, on their own tasks.
+                        pInst->_tankEvents.publish({ (uint8_t)changedBuses });
                     }
                 }
                 xSemaphoreGiveRecursive(pInst->_swimuxMutex);
@@ -237,6 +280,150 @@ void TankManager::_tankDetectionTask(void* pvParam)
     }
 }
 
+// ============================================================================
+// EEPROM Scrubbing
+// ============================================================================
+
+bool TankManager::_areServosIdle() const
+{
+    return !_feedingActive && (xTaskGetTickCount() - _lastActuationTick) >= (TickType_t)(TANK_SCRUB_IDLE_MS / portTICK_PERIOD_MS);
+}
+
+void TankManager::_scrubTask(void* pvParam)
+{
+    if (pvParam == nullptr)
+        return;
+    TankManager* pInst = (TankManager*)pvParam;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(TANK_SCRUB_POLL_MS));
+        if (!pInst->_areServosIdle())
+            continue;
+        // Never wait for the SwiMux: if anyone else is using it, this is not an idle window.
+        if (xSemaphoreTakeRecursive(pInst->_swimuxMutex, 0) != pdTRUE)
+            continue;
+        // A feed may have started between the check and the lock: it now waits for us in setServoPower().
+        if (!pInst->_areServosIdle()) {
+            xSemaphoreGiveRecursive(pInst->_swimuxMutex);
+            continue;
+        }
+        if (pInst->_isServoMode) {
+            // A feed leaves the servos powered, and the EEPROMs are powered through the servo outputs.
+            ESP_LOGI(TAG, "Releasing the idle servos for the EEPROM maintenance.");
+            pInst->setServoPower(false);
+        }
+        if (pInst->_densityDirtyBuses != 0) {
+            pInst->_flushDensity();
+            xSemaphoreGiveRecursive(pInst->_swimuxMutex);
+            continue;
+        }
+
+        // One tank per window, round-robin, so that the SwiMux is never held for long.
+        TickType_t now = xTaskGetTickCount();
+        for (uint8_t i = 0; i < NUMBER_OF_BUSES; i++) {
+            uint8_t bus           = (pInst->_nextScrubBus + i) % NUMBER_OF_BUSES;
+            const TankInfo* tank  = pInst->getKnownTankOfBus(bus);
+            const TankScrubStats& stats = pInst->_scrubStats[bus];
+            if (tank == nullptr || !tank->isFullInfo)
+                continue;
+            if (stats.uid == tank->uid && (now - stats.lastScrubTick) < (TickType_t)(TANK_SCRUB_INTERVAL_MS / portTICK_PERIOD_MS))
+                continue;
+            pInst->_scrubTank(bus);
+            pInst->_nextScrubBus = (bus + 1) % NUMBER_OF_BUSES;
+            break;
+        }
+        xSemaphoreGiveRecursive(pInst->_swimuxMutex);
+    }
+}
+
+SwiMuxSerialResult_e TankManager::scrubTank(uint8_t busIndex)
+{
+    if (busIndex >= NUMBER_OF_BUSES)
+        return SMREZ_BUS_INDEX_OUT_OF_RANGE;
+    if (xSemaphoreTakeRecursive(_swimuxMutex, MUTEX_ACQUISITION_TIMEOUT) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire SwiMux mutex for scrubTank!");
+        return SMREZ_MutexAcquisition;
+    }
+    SwiMuxSerialResult_e result = _scrubTank(busIndex);
+    xSemaphoreGiveRecursive(_swimuxMutex);
+    return result;
+}
+
+TankScrubStats TankManager::getScrubStats(uint8_t busIndex) const
+{
+    return busIndex < NUMBER_OF_BUSES ? _scrubStats[busIndex] : TankScrubStats();
+}
+
+SwiMuxSerialResult_e TankManager::_scrubTank(uint8_t busIndex)
+{
+    if (_isServoMode)
+        return SMREZ_OW_NO_BUS_POWER; // The EEPROMs are powered through the PCA9685 outputs
+    TankInfo* tank = getKnownTankOfBus(busIndex);
+    if (tank == nullptr || !tank->isFullInfo)
+        return SMREZ_NO_DEVICE;
+
+    TankScrubStats& stats = _scrubStats[busIndex];
+    if (stats.uid != tank->uid) {
+        stats     = TankScrubStats();
+        stats.uid = tank->uid;
+    }
+    stats.lastScrubTick = xTaskGetTickCount();
+
+    TankEEpromData_t raw;
+    SwiMuxSerialResult_e result = _swiMux.read(busIndex, (uint8_t*)&raw, 0, sizeof(TankEEpromData_t));
+    if (result != SMREZ_OK) {
+        stats.readFailures++;
+        ESP_LOGW(TAG, "Scrub of tank 0x%016llX: read failed (%s)", tank->uid, SwiMuxSerial_t::getSwiMuxErrorString(result));
+        return result;
+    }
+    stats.scrubs++;
+
+    TankEEpromData_t fixed(raw);
+    int corrected = rs.decode((uint8_t*)&fixed.data, fixed.ecc);
+    if (corrected < 0) {
+        stats.uncorrectable++;
+        ESP_LOGW(TAG, "Scrub of tank 0x%016llX: uncorrectable errors, left for the next discovery.", tank->uid);
+        return SMREZ_OK;
+    }
+    if (corrected == 0)
+        return SMREZ_OK;
+
+    // Regenerate the ECC from the corrected data, so that errors in the parity bytes get fixed as well.
+    TankEEpromData_t::finalize(fixed);
+    stats.correctedBytes += corrected;
+
+    // Write back the runs of rows that differ, and only those.
+    const uint8_t* before  = (const uint8_t*)&raw;
+    const uint8_t* after   = (const uint8_t*)&fixed;
+    uint32_t rowsRewritten = 0;
+    for (size_t row = 0; row < sizeof(TankEEpromData_t); row += TANK_EEPROM_ROW_SIZE) {
+        if (memcmp(before + row, after + row, TANK_EEPROM_ROW_SIZE) == 0)
+            continue;
+        if (_feedingActive) {
+            // The feed waits for the SwiMux to power the servos: leave the remaining rows to the next window.
+            ESP_LOGI(TAG, "Scrub of tank 0x%016llX: interrupted by a feed at offset %u.", tank->uid, (unsigned)row);
+            result = SMREZ_CommandDisabled;
+            break;
+        }
+        size_t end = row + TANK_EEPROM_ROW_SIZE;
+        while (end < sizeof(TankEEpromData_t) && memcmp(before + end, after + end, TANK_EEPROM_ROW_SIZE) != 0)
+            end += TANK_EEPROM_ROW_SIZE;
+        result = _swiMux.write(busIndex, after + row, (uint8_t)row, (uint8_t)(end - row));
+        if (result != SMREZ_OK) {
+            ESP_LOGE(TAG, "Scrub of tank 0x%016llX: write-back at offset %u failed (%s)", tank->uid, (unsigned)row,
+              SwiMuxSerial_t::getSwiMuxErrorString(result));
+            break;
+        }
+        rowsRewritten += (end - row) / TANK_EEPROM_ROW_SIZE;
+        row = end - TANK_EEPROM_ROW_SIZE;
+    }
+    stats.rowsRewritten += rowsRewritten;
+    ESP_LOGI(TAG, "Scrub of tank 0x%016llX: %d byte(s) corrected, %u row(s) rewritten (%.2f bytes/pass).", tank->uid, corrected,
+      (unsigned)rowsRewritten, stats.errorRate());
+    return result;
+}
+
+
 bool TankInfo::fillFromEeprom(TankEEpromData_t& eeprom)
 {
     // Warning: fillFromEeprom assumes the data is SANITIZED.
@@ -261,6 +448,12 @@ bool TankInfo::fillFromEeprom(TankEEpromData_t& eeprom)
     // Remaining kibble (in kg in TankInfo, in 16-bits integer grams in eeprom)
     remaining_weight_grams = eeprom.data.remainingGrams;
     servoIdlePwm        = eeprom.data.servoIdlePwm;
+    augerFlow           = eeprom.data.augerFlow;
+    densitySource       = (DensitySource)eeprom.data.densitySource;
+    densitySamples      = eeprom.data.densitySamples;
+    // A density written before the calibration existed was entered by hand
+    if (densitySource == DensitySource::NONE && eeprom.data.density != 0)
+        densitySource = DensitySource::USER;
     isFullInfo          = true;
     return true;
 }
@@ -291,11 +484,16 @@ TankInfo::TankInfoDiscrepancies_e TankInfo::toTankData(TankEEpromData_t& eeprom)
     // Specs
     uint16_t capMl   = (uint16_t)(capacityLiters * 1000.0);  // L to mL
     uint16_t densGpL = (uint16_t)(kibbleDensity * 1000.0);   // kg/L to g/L
-    if (eeprom.data.servoIdlePwm != servoIdlePwm || eeprom.data.capacity != capMl || eeprom.data.density != densGpL) {
+    if (eeprom.data.servoIdlePwm != servoIdlePwm || eeprom.data.capacity != capMl || eeprom.data.density != densGpL
+      || eeprom.data.augerFlow != augerFlow || eeprom.data.densitySource != (uint8_t)densitySource
+      || eeprom.data.densitySamples != densitySamples) {
         result |= TID_SPECS_CHANGED;
-        eeprom.data.servoIdlePwm = servoIdlePwm;
-        eeprom.data.capacity     = capMl;
-        eeprom.data.density      = densGpL;
+        eeprom.data.servoIdlePwm   = servoIdlePwm;
+        eeprom.data.capacity       = capMl;
+        eeprom.data.density        = densGpL;
+        eeprom.data.augerFlow      = augerFlow;
+        eeprom.data.densitySource  = (uint8_t)densitySource;
+        eeprom.data.densitySamples = densitySamples;
     }
     // Remaining kibble (in grams in eeprom, in kg in TankInfo)
     // Clamp to uint16_t max (65535 grams = 65.535 kg) to prevent overflow
@@ -759,27 +957,167 @@ bool TankManager::updateRemaingKibble(const uint64_t uid, uint16_t newRemainingG
     return true;
 }
 
+// --- Density Calibration ---
+
+bool TankManager::setMeasuredDensity(uint64_t uid, uint16_t gramsPerLiter, uint16_t augerFlow)
+{
+    TankInfo* tank = getKnownTankOfUis(uid);
+    if (tank == nullptr || tank->busIndex < 0) {
+        ESP_LOGE(TAG, "setMeasuredDensity: Tank 0x%016llX not found.", uid);
+        return false;
+    }
+    tank->kibbleDensity  = gramsPerLiter / 1000.0; // g/L to kg/L
+    tank->augerFlow      = augerFlow;
+    tank->densitySource  = DensitySource::MEASURED;
+    tank->densitySamples = 0;
+    _densityChanged(*tank);
+    ESP_LOGI(TAG, "Tank 0x%016llX density measured at %u g/L, auger flow %u mL/min.", uid, gramsPerLiter, augerFlow);
+    return true;
+}
+
+bool TankManager::refineDensity(uint64_t uid, float gramsPerMinute)
+{
+    TankInfo* tank = getKnownTankOfUis(uid);
+    if (tank == nullptr || tank->busIndex < 0 || tank->augerFlow == 0 || tank->kibbleDensity <= 0.0)
+        return false;
+
+    float current  = tank->kibbleDensity * 1000.0f;                // g/L
+    float estimate = gramsPerMinute / tank->augerFlow * 1000.0f;  // g/mL to g/L
+    if (estimate < DENSITY_MIN_GPL || estimate > DENSITY_MAX_GPL || std::fabs(estimate - current) > current * DENSITY_REFINE_MAX_DEVIATION) {
+        ESP_LOGW(TAG, "Tank 0x%016llX: density estimate of %.0f g/L discarded (density %.0f g/L).", uid, estimate, current);
+        return false;
+    }
+    // Integer g/L in EEPROM: round, or small corrections would never stick
+    uint16_t refined     = (uint16_t)lroundf(current + (estimate - current) * DENSITY_REFINE_WEIGHT);
+    tank->kibbleDensity  = refined / 1000.0;
+    tank->densitySamples = (uint8_t)std::min(tank->densitySamples + 1, (int)UINT8_MAX);
+    _densityChanged(*tank);
+    ESP_LOGI(TAG, "Tank 0x%016llX: density refined to %u g/L (estimate %.0f g/L, %u feeds).", uid, refined, estimate,
+      tank->densitySamples);
+    return true;
+}
+
+void TankManager::_densityChanged(const TankInfo& tank)
+{
+    if (xSemaphoreTake(_deviceStateMutex, MUTEX_ACQUISITION_TIMEOUT) == pdTRUE) {
+        for (auto& t : _deviceState.connectedTanks) {
+            if (t.uid == tank.uid) {
+                t.kibbleDensity  = tank.kibbleDensity;
+                t.augerFlow      = tank.augerFlow;
+                t.densitySource  = tank.densitySource;
+                t.densitySamples = tank.densitySamples;
+                break;
+            }
+        }
+        xSemaphoreGive(_deviceStateMutex);
+    }
+    portENTER_CRITICAL(&_densityLock);
+    _densityDirtyBuses |= (uint8_t)(1 << tank.busIndex);
+    portEXIT_CRITICAL(&_densityLock);
+}
+
+void TankManager::_flushDensity()
+{
+    uint8_t bus = 0;
+    while (bus < NUMBER_OF_BUSES && !(_densityDirtyBuses & (1 << bus)))
+        bus++;
+    if (bus >= NUMBER_OF_BUSES)
+        return;
+    portENTER_CRITICAL(&_densityLock);
+    _densityDirtyBuses &= (uint8_t)~(1 << bus);
+    portEXIT_CRITICAL(&_densityLock);
+
+    const TankInfo* tank = getKnownTankOfBus(bus);
+    if (tank == nullptr || !tank->isFullInfo)
+        return; // Unplugged since: its EEPROM still holds the former density
+    TankInfo copy = *tank;
+    if (!commitTankInfo(copy)) {
+        portENTER_CRITICAL(&_densityLock);
+        _densityDirtyBuses |= (uint8_t)(1 << bus); // Retried on the next idle window
+        portEXIT_CRITICAL(&_densityLock);
+    }
+}
+
 // --- Servo Control Implementation ---
 void TankManager::setServoPower(bool on)
 {
+    // Waits for a scrub or a discovery to let go of the SwiMux, as the mode switch changes the EEPROM power.
+    if (xSemaphoreTakeRecursive(_swimuxMutex, MUTEX_ACQUISITION_TIMEOUT) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire SwiMux mutex for setServoPower!");
+        return;
+    }
     if (on) {
         _switchToServoMode();
     } else {
         _switchToSwiMode();
     }
     digitalWrite(SERVO_POWER_ENABLE_PIN, on ? LOW : HIGH);
+    xSemaphoreGiveRecursive(_swimuxMutex);
     ESP_LOGI(TAG, "Servo power %s", on ? "ON" : "OFF");
 }
 
+PCA9685::I2C_Result_e TankManager::jogServo(uint8_t servoNum, uint16_t pwm)
+{
+    if (servoNum >= TOTAL_SERVO_COUNT)
+        return PCA9685::I2C_Result_e::I2C_Unknown;
+    if (!_isServoMode) {
+        setServoPower(true);
+        if (!_isServoMode)
+            return PCA9685::I2C_Result_e::I2C_Timeout; // The SwiMux was not released
+    }
+    return setServoPWM(servoNum, pwm);
+}
+
 PCA9685::I2C_Result_e TankManager::setServoPWM(uint8_t servoNum, uint16_t pwm)
+{
+    return _setServoPWM(servoNum, pwm, I2CPriority::CONTROL);
+}
+
+PCA9685::I2C_Result_e TankManager::_setServoPWM(uint8_t servoNum, uint16_t pwm, I2CPriority priority)
 {
     if (servoNum >= TOTAL_SERVO_COUNT)
         return PCA9685::I2C_Result_e::I2C_Unknown;
     if (!_isServoMode)
         _switchToServoMode();
 
-    uint16_t ticks = map(pwm, 0, 20000, 0, 4095);
-    return _pwm.setPWM(servoNum, 0, ticks);
+    PCA9685::I2C_Result_e result = _writeServoPulse(servoNum, pwm, priority);
+
+    // Publish the actuation once issued, with a load cell blanking window sized by the travel.
+    ServoActuation actuation = { servoNum, pwm, xTaskGetTickCount(), 0 };
+    uint16_t travel          = (uint16_t)abs((int)pwm - (int)_lastCommandedPwm[servoNum]);
+    if (travel > 0) {
+        actuation.blankingMs = servoBlankingMs(travel);
+        _lastCommandedPwm[servoNum] = pwm;
+        _lastActuationTick          = actuation.tick;
+    }
+    if (_onServoCommandCallback)
+        _onServoCommandCallback(actuation);
+    return result;
+}
+
+PCA9685::I2C_Result_e TankManager::_writeServoPulse(uint8_t servoNum, uint16_t pwm, I2CPriority priority)
+{
+    uint16_t width = map(pwm, 0, 20000, 0, 4095);
+    if (width == 0)
+        return _pwm.queuePWM(servoNum, 0, 4096, priority); // full off
+    // Same width, but starting in the slot of this channel; the PCA9685 handles OFF < ON as a wrapped pulse.
+    uint16_t on = getServoPhaseOffset(servoNum);
+    return _pwm.queuePWM(servoNum, on, (on + width) % SERVO_PWM_FRAME_TICKS, priority);
+}
+
+std::vector<ServoPhaseSlot> TankManager::getServoSchedule() const
+{
+    std::vector<ServoPhaseSlot> schedule;
+    schedule.reserve(TOTAL_SERVO_COUNT);
+    for (uint8_t servoNum = 0; servoNum < TOTAL_SERVO_COUNT; servoNum++) {
+        ServoPhaseSlot slot;
+        slot.servoNum = servoNum;
+        slot.onTick   = getServoPhaseOffset(servoNum);
+        slot.pulseUs  = _lastCommandedPwm[servoNum];
+        slot.offTick  = (slot.onTick + map(slot.pulseUs, 0, 20000, 0, 4095)) % SERVO_PWM_FRAME_TICKS;
+        schedule.push_back(slot);
+    }
+    return schedule;
 }
 
 PCA9685::I2C_Result_e TankManager::setContinuousServo(uint8_t servoNum, float speed)
@@ -812,10 +1150,10 @@ PCA9685::I2C_Result_e TankManager::stopAllServos()
         _switchToServoMode(); // Ensure we are in a mode where we can send stop commands
     }
 
-    // 1. Command all servos to their neutral/stop position
+    // 1. Command all servos to their neutral/stop position, ahead of (and cancelling) any queued command
     PCA9685::I2C_Result_e result = PCA9685::I2C_Result_e::I2C_Success;
-    for (uint8_t i = 0; i < 16; i++) {
-        PCA9685::I2C_Result_e res = setContinuousServo(i, 0.0);
+    for (uint8_t i = 0; i < TOTAL_SERVO_COUNT; i++) {
+        PCA9685::I2C_Result_e res = _setServoPWM(i, SERVO_CONTINUOUS_STOP_PWM, I2CPriority::EMERGENCY);
         if (!result && res)
             result = res;
     }
@@ -830,9 +1168,9 @@ PCA9685::I2C_Result_e TankManager::stopAllServos()
     return result;
 }
 
-void TankManager::setOnTanksChangedCallback(std::function<void()> cb)
+void TankManager::setOnServoCommandCallback(std::function<void(const ServoActuation&)> cb)
 {
-    _onTanksChangedCallback = cb;
+    _onServoCommandCallback = cb;
 }
 
 void TankManager::printConnectedTanks(Stream& stream)
@@ -861,6 +1199,9 @@ void TankManager::printConnectedTanks(Stream& stream)
         if (tank.isFullInfo) {
             stream.printf("  Capacity:         %.3f L\r\n", tank.capacityLiters);
             stream.printf("  Density:          %.3f kg/L\r\n", tank.kibbleDensity);
+            static const char* const SOURCES[] = { "none", "user", "measured" };
+            stream.printf("  Density Source:   %s, %u feed(s) since, auger flow %u mL/min\r\n",
+              SOURCES[std::min((int)tank.densitySource, 2)], tank.densitySamples, tank.augerFlow);
             stream.printf("  Remaining:        %.0f g\r\n", tank.remaining_weight_grams);
             stream.printf("  Servo Idle PWM:   %u\r\n", tank.servoIdlePwm);
 
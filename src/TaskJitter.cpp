@@ -0,0 +1,120 @@
+#include "TaskJitter.hpp"
+#include "esp_timer.h"
+
+JitterProbe* JitterProbe::_probes[JITTER_MAX_PROBES] = {};
+size_t JitterProbe::_probeCount                       = 0;
+int64_t JitterProbe::_windowStartUs                   = 0;
+portMUX_TYPE JitterProbe::_lock                       = portMUX_INITIALIZER_UNLOCKED;
+
+JitterProbe::JitterProbe(const char* name)
+    : _name(name), _sleepStartUs(0), _wakeUs(0), _expectedUs(0), _periodMs(0), _samples(0), _maxLateUs(0), _maxBusyUs(0),
+      _sumLateUs(0), _buckets {}
+{
+    // Probes are file-scope objects, constructed before the scheduler starts.
+    if (_probeCount < JITTER_MAX_PROBES)
+        _probes[_probeCount++] = this;
+}
+
+#ifdef JITTER_BENCHMARK
+void JitterProbe::sleeping(uint32_t ticks)
+{
+    int64_t now = esp_timer_get_time();
+    if (_wakeUs != 0) {
+        uint32_t busyUs = (uint32_t)(now - _wakeUs);
+        portENTER_CRITICAL(&_lock);
+        if (busyUs > _maxBusyUs)
+            _maxBusyUs = busyUs;
+        portEXIT_CRITICAL(&_lock);
+    }
+    // Measured against the full delay: a delay of n ticks may return after n-1 ticks and a fraction,
+    // and that rounding is not lateness.
+    _periodMs     = ticks * portTICK_PERIOD_MS;
+    _expectedUs   = _periodMs * 1000;
+    _sleepStartUs = now;
+}
+
+void JitterProbe::woke()
+{
+    int64_t now = esp_timer_get_time();
+    if (_sleepStartUs != 0) {
+        int64_t late    = now - _sleepStartUs - _expectedUs;
+        uint32_t lateUs = late > 0 ? (uint32_t)late : 0; // woken early by a notification
+        size_t bucket   = 0;
+        if (lateUs >= JITTER_FIRST_EDGE_US)
+            bucket = std::min<size_t>(JITTER_BUCKETS - 1, 32 - __builtin_clz(lateUs / JITTER_FIRST_EDGE_US));
+        portENTER_CRITICAL(&_lock);
+        _buckets[bucket]++;
+        _samples++;
+        _sumLateUs += lateUs;
+        if (lateUs > _maxLateUs)
+            _maxLateUs = lateUs;
+        portEXIT_CRITICAL(&_lock);
+    }
+    _sleepStartUs = 0;
+    _wakeUs       = now;
+}
+#endif
+
+uint32_t JitterProbe::_bucketUpperUs(size_t bucket)
+{
+    return (uint32_t)JITTER_FIRST_EDGE_US << bucket;
+}
+
+uint32_t JitterProbe::_percentileUs(uint32_t permille) const
+{
+    if (_samples == 0)
+        return 0;
+    // Upper edge of the bucket holding the percentile, which is never beyond the largest lateness seen.
+    uint32_t rank       = (uint32_t)(((uint64_t)_samples * permille + 999) / 1000);
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < JITTER_BUCKETS - 1; i++) {
+        cumulative += _buckets[i];
+        if (cumulative >= rank)
+            return std::min(_bucketUpperUs(i), _maxLateUs);
+    }
+    return _maxLateUs;
+}
+
+void JitterProbe::report(JsonDocument& doc)
+{
+    doc["windowMs"] = (uint32_t)((esp_timer_get_time() - _windowStartUs) / 1000);
+    // The last bucket is open-ended, so there is one edge less than buckets.
+    JsonArray edges = doc["bucketUpperUs"].to<JsonArray>();
+    for (size_t i = 0; i < JITTER_BUCKETS - 1; i++)
+        edges.add(_bucketUpperUs(i));
+
+    JsonArray tasks = doc["tasks"].to<JsonArray>();
+    for (size_t p = 0; p < _probeCount; p++) {
+        portENTER_CRITICAL(&_lock);
+        JitterProbe snapshot(*_probes[p]);
+        portEXIT_CRITICAL(&_lock);
+
+        JsonObject task   = tasks.add<JsonObject>();
+        task["name"]      = snapshot._name;
+        task["periodMs"]  = snapshot._periodMs;
+        task["samples"]   = snapshot._samples;
+        task["meanUs"]    = snapshot._samples ? (uint32_t)(snapshot._sumLateUs / snapshot._samples) : 0;
+        task["p50Us"]     = snapshot._percentileUs(500);
+        task["p99Us"]     = snapshot._percentileUs(990);
+        task["maxUs"]     = snapshot._maxLateUs;
+        task["maxBusyUs"] = snapshot._maxBusyUs;
+        JsonArray histogram = task["histogram"].to<JsonArray>();
+        for (uint32_t count : snapshot._buckets)
+            histogram.add(count);
+    }
+}
+
+void JitterProbe::resetAll()
+{
+    portENTER_CRITICAL(&_lock);
+    for (size_t p = 0; p < _probeCount; p++) {
+        JitterProbe* probe = _probes[p];
+        probe->_samples    = 0;
+        probe->_maxLateUs  = 0;
+        probe->_maxBusyUs  = 0;
+        probe->_sumLateUs  = 0;
+        memset(probe->_buckets, 0, sizeof(probe->_buckets));
+    }
+    _windowStartUs = esp_timer_get_time();
+    portEXIT_CRITICAL(&_lock);
+}
@@ -24,13 +24,14 @@ void TimeKeeping::begin() {
 }
 
 void TimeKeeping::startTask() {
-    xTaskCreate(
+    xTaskCreateStatic(
         _timekeepingTask,
         "Timekeeping Task",
-        4096,
+        TIMEKEEPING_TASK_STACK_SIZE,
         this,
         3, // Low priority task
-        NULL
+        _taskStack,
+        &_taskBuffer
     );
 }
 
@@ -2,9 +2,14 @@
 #include "ArduinoJson.h"
 #include "esp_log.h"
 #include <WiFi.h>
-#include <SPIFFS.h>
+#include "Storage.hpp"
 #include <ESPmDNS.h>
 #include <Update.h>
+#include <memory>
+#include <new>
+#include "GzipStream.hpp"
+#include "TaskJitter.hpp"
+#include "HeapGuard.hpp"
 
 static const char* TAG = "WebServer";
 
@@ -85,6 +90,7 @@ WebServer::WebServer(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigM
   TankManager& tankManager, HX711Scale& scale, EPaperDisplay& display)
     : _server(80),
       _events("/api/events"),
+      _ws("/api/ws"),
       _deviceState(deviceState),
       _mutex(mutex),
       _configManager(configManager),
@@ -92,8 +98,26 @@ WebServer::WebServer(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigM
       _tankManager(tankManager),
       _scale(scale),
       _display(display),
-      _captive_portal_buffer(nullptr)
-{}
+      _api(deviceState, mutex, configManager, recipeProcessor, tankManager),
+      _captive_portal_buffer(nullptr),
+      _mdnsStarted(false),
+      _mdnsPublished {},
+      _mdnsTaskHandle(NULL),
+      _eventSubscriber("web"),
+      _weightSubscription(EventPolicy::QUEUE, [this](const WeightEvent& event) { _pushWeight(event); }),
+      _tanksSubscription(EventPolicy::LATEST, [this](const TanksChangedEvent& event) { _pushTanksChanged(event); }),
+      _eventsTaskHandle(NULL),
+      _expensiveInFlight(0),
+      _throttledCount(0),
+      _deferredCount(0),
+      _bodyRefusedCount(0)
+{
+    memset(_buckets, 0, sizeof(_buckets));
+    for (auto& slot : _bodySlots)
+        slot.owner = nullptr;
+    memset(_wsSubscribers, 0, sizeof(_wsSubscribers));
+    _wsSubscribersLock = portMUX_INITIALIZER_UNLOCKED;
+}
 
 void WebServer::_scanWifiNetworks()
 {
@@ -159,6 +183,11 @@ bool WebServer::manageWiFiConnection()
 
     if (MDNS.begin(hostname.c_str())) {
         MDNS.addService("http", "tcp", 80);
+        // Status in the TXT records: one multicast query lists the feeders and their state, no HTTP involved.
+        MDNS.addService("kittyble", "tcp", 80);
+        MDNS.addServiceTxt("kittyble", "tcp", "ver", _deviceState.firmwareVersion.c_str());
+        MDNS.addServiceTxt("kittyble", "tcp", "api", "/api");
+        _mdnsStarted = true;
         ESP_LOGI(TAG, "mDNS responder started. You can now connect to http://%s.local", hostname.c_str());
         _display.showStatus("Online!", (hostname + ".local").c_str());
     } else {
@@ -170,6 +199,98 @@ bool WebServer::manageWiFiConnection()
     return true;
 }
 
+// --- mDNS Status ---
+
+bool WebServer::MdnsStatus::operator==(const MdnsStatus& other) const
+{
+    // The battery level drifts by a point now and then; only larger moves are announced.
+    int batteryDelta = (int)battery - (int)other.battery;
+    return state == other.state && lastFeedTime == other.lastFeedTime && tankCount == other.tankCount
+      && batteryDelta < MDNS_BATTERY_STEP_PERCENT && batteryDelta > -MDNS_BATTERY_STEP_PERCENT;
+}
+
+bool WebServer::_readMdnsStatus(MdnsStatus& status)
+{
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) != pdTRUE)
+        return false;
+    status.state        = (uint8_t)_deviceState.operationState;
+    status.battery      = _deviceState.batteryLevel;
+    status.lastFeedTime = _deviceState.lastFeedTime;
+    status.tankCount    = 0;
+    for (const auto& tank : _deviceState.connectedTanks) {
+        if (tank.busIndex > -1)
+            status.tankCount++;
+    }
+    xSemaphoreGive(_mutex);
+    return true;
+}
+
+void WebServer::_publishMdnsStatus(const MdnsStatus& status)
+{
+    static const char* const STATE_NAMES[] = { "idle", "feeding", "error", "calibrating" };
+    char value[24];
+    MDNS.addServiceTxt("kittyble", "tcp", "state", status.state < 4 ? STATE_NAMES[status.state] : "unknown");
+    snprintf(value, sizeof(value), "%u", status.battery);
+    MDNS.addServiceTxt("kittyble", "tcp", "batt", value);
+    snprintf(value, sizeof(value), "%lld", status.lastFeedTime);
+    MDNS.addServiceTxt("kittyble", "tcp", "last", value);
+    snprintf(value, sizeof(value), "%u", status.tankCount);
+    MDNS.addServiceTxt("kittyble", "tcp", "tanks", value);
+    _mdnsPublished = status;
+}
+
+void WebServer::_mdnsStatusTask(void* pvParam)
+{
+    WebServer* pInst           = (WebServer*)pvParam;
+    TickType_t lastPublishTick = xTaskGetTickCount();
+    MdnsStatus status;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(MDNS_STATUS_POLL_MS));
+        // A change within the interval is not lost: it is still pending when the interval ends.
+        if (xTaskGetTickCount() - lastPublishTick < pdMS_TO_TICKS(MDNS_STATUS_MIN_INTERVAL_MS))
+            continue;
+        if (!pInst->_readMdnsStatus(status) || status == pInst->_mdnsPublished)
+            continue;
+        pInst->_publishMdnsStatus(status);
+        lastPublishTick = xTaskGetTickCount();
+        ESP_LOGD(TAG, "mDNS status updated (state %u, battery %u%%, %u tanks).", status.state, status.battery, status.tankCount);
+    }
+}
+
+// --- Event Push ---
+void WebServer::_eventsTask(void* pvParam)
+{
+    WebServer* pInst = (WebServer*)pvParam;
+    while (1) {
+        pInst->_eventSubscriber.dispatch(portMAX_DELAY);
+    }
+}
+
+void WebServer::_pushWeight(const WeightEvent& event)
+{
+    uint8_t stream   = event.channel == ScaleChannel::BOWL ? WSSTREAM_BOWL_WEIGHT : WSSTREAM_WEIGHT;
+    bool toWebSocket = _hasWsSubscribers(stream);
+    bool anyListener = _events.count() > 0 || _hasWsSubscribers(WSSTREAM_WEIGHT | WSSTREAM_BOWL_WEIGHT);
+    _scale.setSubscribed(anyListener);
+    if (_events.count() > 0 || toWebSocket) {
+        char buf[80];
+        snprintf(buf, sizeof(buf), "{\"weight\":%.2f,\"raw\":%ld,\"ts\":%lu}", event.weight, event.raw,
+          (unsigned long)event.timestampDs);
+        const char* name = event.channel == ScaleChannel::BOWL ? "bowl_weight" : "weight";
+        if (_events.count() > 0)
+            _events.send(buf, name);
+        if (toWebSocket)
+            _publishWs(stream, name, buf);
+    }
+}
+
+void WebServer::_pushTanksChanged(const TanksChangedEvent& event)
+{
+    _events.send("{}", "tanks_changed");
+    _publishWs(WSSTREAM_TANKS_CHANGED, "tanks_changed", "{}");
+}
+
 void WebServer::_startAPMode()
 {
     const char* ap_ssid = "KibbleT5-Setup";
@@ -246,6 +367,7 @@ void WebServer::_handleWifiSave(AsyncWebServerRequest* request)
         ESP_LOGI(TAG, "WiFi credentials received. Restarting in 3 seconds...");
         _display.showStatus("Credentials Saved", "Restarting...");
         vTaskDelay(pdMS_TO_TICKS(3000));
+        _display.waitForRefresh();
         ESP.restart();
     } else {
         request->send(400, "text/plain", "Bad Request: SSID is required");
@@ -265,30 +387,45 @@ void WebServer::startAPIServer()
     }));
 #endif //DEBUG_HTTP_ENABLED
 
-    _setupAPIRoutes();
+    // Admission control of the requests not routed to a body handler, see _admitRequest()
+    _server.addMiddleware(new AsyncMiddlewareFunction([this](AsyncWebServerRequest* request, ArMiddlewareNext next) {
+        RouteParams params;
+        int route         = _matchRoute(request, params);
+        bool judgedOnBody = request->contentLength() > 0 && route >= 0 && _routes[route].onBody;
+        if (judgedOnBody || _admitRequest(request))
+            next();
+    }));
 
     // SSE endpoint for tank population change notifications
     _server.addHandler(&_events);
-    _tankManager.setOnTanksChangedCallback([this]() { _events.send("{}", "tanks_changed"); });
-    _scale.setOnWeightChangedCallback([this](float weight, long raw) {
-        if (_events.count() > 0) {
-            uint32_t ts = (uint32_t)(esp_timer_get_time() / 100000);
-            char buf[80];
-            snprintf(buf, sizeof(buf), "{\"weight\":%.2f,\"raw\":%ld,\"ts\":%lu}", weight, raw, ts);
-            _events.send(buf, "weight");
-        }
-    });
+    // A fresh subscriber wakes the scale out of its sparse duty cycle; the last one leaving lets it step down again.
+    _events.onConnect([this](AsyncEventSourceClient* client) { _scale.setSubscribed(true); });
+    // The scale and tank tasks only publish: the pushes to the clients run on the web events task.
+    if (_eventsTaskHandle == NULL) {
+        _scale.weightEvents().subscribe(_eventSubscriber, _weightSubscription);
+        _tankManager.tankEvents().subscribe(_eventSubscriber, _tanksSubscription);
+        _eventsTaskHandle = xTaskCreateStatic(_eventsTask, "Web Events", WEB_EVENTS_STACK_SIZE, this, WEB_EVENTS_PRIORITY,
+          _eventsTaskStack, &_eventsTaskBuffer);
+    }
+
+    // WebSocket endpoint: commands and telemetry over a single connection
+    _ws.onEvent(std::bind(&WebServer::_onWsEvent, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+      std::placeholders::_4, std::placeholders::_5, std::placeholders::_6));
+    _server.addHandler(&_ws);
+
+    // After the SSE and WebSocket handlers, which the /api/ catch-all would otherwise shadow
+    _setupAPIRoutes();
 
     // Serve static files with Gzip support
     _server.on("/", HTTP_GET, [](AsyncWebServerRequest* request) {
         String path       = "/index.html";
         String pathWithGz = path + ".gz";
-        if (SPIFFS.exists(pathWithGz)) {
-            AsyncWebServerResponse* response = request->beginResponse(SPIFFS, pathWithGz, "text/html");
+        if (storage.exists(pathWithGz)) {
+            AsyncWebServerResponse* response = request->beginResponse(storage, pathWithGz, "text/html");
             response->addHeader("Content-Encoding", "gzip");
             request->send(response);
         } else {
-            request->send(SPIFFS, path, "text/html");
+            request->send(storage, path, "text/html");
         }
     });
 
@@ -303,12 +440,12 @@ void WebServer::startAPIServer()
             contentType = "image/svg+xml";
 
         String pathWithGz = path + ".gz";
-        if (SPIFFS.exists(pathWithGz)) {
-            AsyncWebServerResponse* response = request->beginResponse(SPIFFS, pathWithGz, contentType);
+        if (storage.exists(pathWithGz)) {
+            AsyncWebServerResponse* response = request->beginResponse(storage, pathWithGz, contentType);
             response->addHeader("Content-Encoding", "gzip");
             request->send(response);
-        } else if (SPIFFS.exists(path)) {
-            request->send(SPIFFS, path, contentType);
+        } else if (storage.exists(path)) {
+            request->send(storage, path, contentType);
         } else {
             request->send(404);
         }
@@ -316,85 +453,81 @@ void WebServer::startAPIServer()
 
     _server.onNotFound(std::bind(&WebServer::_handleNotFound, this, std::placeholders::_1));
     _server.begin();
+
+    if (_mdnsStarted && _mdnsTaskHandle == NULL) {
+        MdnsStatus status;
+        if (_readMdnsStatus(status))
+            _publishMdnsStatus(status);
+        _mdnsTaskHandle =
+          xTaskCreateStatic(_mdnsStatusTask, "mDNS Status", MDNS_STATUS_STACK_SIZE, this, 1, _mdnsTaskStack, &_mdnsTaskBuffer);
+    }
     ESP_LOGI(TAG, "API Web Server started.");
 }
 
 void WebServer::_setupAPIRoutes()
 {
     // System Routes
-    _server.on("/api/status", HTTP_GET, std::bind(&WebServer::_handleGetStatus, this, std::placeholders::_1));
+    _route("/api/status", RouteMethod::GET, std::bind(&ApiHandlers::getStatus, &_api, std::placeholders::_1));
+    _route("/api/system/info", RouteMethod::GET, std::bind(&WebServer::_handleGetSystemInfo, this, std::placeholders::_1));
+    _route("/api/system/reboot", RouteMethod::POST, std::bind(&WebServer::_handleRestart, this, std::placeholders::_1));
+    _route("/api/system/factory-reset", RouteMethod::POST, std::bind(&WebServer::_handleFactoryReset, this, std::placeholders::_1));
+    _routeBody("/api/system/time", RouteMethod::POST, std::bind(&WebServer::_handleSetTime, this, std::placeholders::_1, std::placeholders::_3));
 
-    _server.on("/api/system/info", HTTP_GET, std::bind(&WebServer::_handleGetSystemInfo, this, std::placeholders::_1));
-    _server.on("/api/system/reboot", HTTP_POST, std::bind(&WebServer::_handleRestart, this, std::placeholders::_1));
-    _server.on("/api/system/factory-reset", HTTP_POST, std::bind(&WebServer::_handleFactoryReset, this, std::placeholders::_1));
-    _server.on(
-      "/api/system/time", HTTP_POST, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleSetTime(req, doc); });
-      });
     // Settings Routes
-    _server.on("/api/settings", HTTP_GET, std::bind(&WebServer::_handleGetSettings, this, std::placeholders::_1));
-    _server.on(
-      "/api/settings", HTTP_PUT, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleUpdateSettings(req, doc); });
-      });
-    _server.on("/api/settings/export", HTTP_GET, std::bind(&WebServer::_handleExportSettings, this, std::placeholders::_1));
+    _route("/api/settings", RouteMethod::GET, std::bind(&ApiHandlers::getSettings, &_api, std::placeholders::_1));
+    _routeBody("/api/settings", RouteMethod::PUT, std::bind(&ApiHandlers::updateSettings, &_api, std::placeholders::_1, std::placeholders::_3));
+    _route("/api/settings/export", RouteMethod::GET, std::bind(&ApiHandlers::exportSettings, &_api, std::placeholders::_1));
 
     // Tank Routes
-    _server.on("/api/tanks", HTTP_GET, std::bind(&WebServer::_handleGetTanks, this, std::placeholders::_1));
-    _server.on(
-      "^/api/tanks/([0-9A-Fa-f]+)$", HTTP_PUT, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleUpdateTank(req, doc); });
-      });
-    _server.on("^/api/tanks/([0-9A-Fa-f]+)/history$", HTTP_GET, std::bind(&WebServer::_handleGetTankHistory, this, std::placeholders::_1));
+    _route("/api/tanks", RouteMethod::GET, std::bind(&ApiHandlers::getTanks, &_api, std::placeholders::_1));
+    _routeBody("/api/tanks/{hex}", RouteMethod::PUT,
+      [this](ApiExchange& r, const RouteParams& p, JsonDocument& doc) { _api.updateTank(r, p[0], doc); });
+    _route("/api/tanks/{hex}/history", RouteMethod::GET, [this](ApiExchange& r, const RouteParams& p) { _api.getTankHistory(r, p[0]); });
+    _route("/api/tanks/{hex}/density/calibrate", RouteMethod::POST,
+      [this](ApiExchange& r, const RouteParams& p) { _api.calibrateDensity(r, p[0]); });
 
     // Feeding Routes
-    _server.on(
-      "^/api/feed/immediate/([0-9A-Fa-f]+)$", HTTP_POST, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleFeedImmediate(req, doc); });
-      });
-    _server.on(
-      "^/api/feed/recipe/([0-9]+)$", HTTP_POST, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleFeedRecipe(req, doc); });
-      });
-    _server.on("/api/feed/stop", HTTP_POST, std::bind(&WebServer::_handleStopFeeding, this, std::placeholders::_1));
-    _server.on("/api/feeding/history", HTTP_GET, std::bind(&WebServer::_handleGetFeedingHistory, this, std::placeholders::_1));
+    _routeBody("/api/feed/immediate/{hex}", RouteMethod::POST,
+      [this](ApiExchange& r, const RouteParams& p, JsonDocument& doc) { _api.feedImmediate(r, p[0], doc); });
+    _routeBody("/api/feed/recipe/{uint}", RouteMethod::POST,
+      [this](ApiExchange& r, const RouteParams& p, JsonDocument& doc) { _api.feedRecipe(r, (uint32_t)p[0], doc); });
+    _route("/api/feed/stop", RouteMethod::POST, std::bind(&ApiHandlers::stopFeeding, &_api, std::placeholders::_1));
+    _route("/api/feeding/history", RouteMethod::GET, std::bind(&ApiHandlers::getFeedingHistory, &_api, std::placeholders::_1));
+    _route("/api/feeding/schedule", RouteMethod::GET, std::bind(&ApiHandlers::getMealSchedule, &_api, std::placeholders::_1));
+    _routeBody("/api/feeding/schedule", RouteMethod::PUT, std::bind(&ApiHandlers::setMealSchedule, &_api, std::placeholders::_1, std::placeholders::_3));
+    _route("/api/feeding/schedule", RouteMethod::DELETE, std::bind(&ApiHandlers::cancelMealSchedule, &_api, std::placeholders::_1));
 
     // Recipe Routes
-    _server.on("/api/recipes", HTTP_GET, std::bind(&WebServer::_handleGetRecipes, this, std::placeholders::_1));
-    _server.on(
-      "/api/recipes", HTTP_POST, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleAddRecipe(req, doc); });
-      });
-    _server.on(
-      "^/api/recipes/([0-9]+)$", HTTP_PUT, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleUpdateRecipe(req, doc); });
-      });
-    _server.on("^/api/recipes/([0-9]+)$", HTTP_DELETE, std::bind(&WebServer::_handleDeleteRecipe, this, std::placeholders::_1));
+    _route("/api/recipes", RouteMethod::GET, std::bind(&ApiHandlers::getRecipes, &_api, std::placeholders::_1));
+    _routeBody("/api/recipes", RouteMethod::POST, std::bind(&ApiHandlers::addRecipe, &_api, std::placeholders::_1, std::placeholders::_3));
+    _routeBody("/api/recipes/{uint}", RouteMethod::PUT,
+      [this](ApiExchange& r, const RouteParams& p, JsonDocument& doc) { _api.updateRecipe(r, (uint32_t)p[0], doc); });
+    _route("/api/recipes/{uint}", RouteMethod::DELETE,
+      [this](ApiExchange& r, const RouteParams& p) { _api.deleteRecipe(r, (uint32_t)p[0]); });
 
     // Scale Routes
-    _server.on("/api/scale/current", HTTP_GET, std::bind(&WebServer::_handleGetScale, this, std::placeholders::_1));
-    _server.on("/api/scale/tare", HTTP_POST, std::bind(&WebServer::_handleTareScale, this, std::placeholders::_1));
-    _server.on(
-      "/api/scale/calibrate", HTTP_POST, [this](AsyncWebServerRequest* r) {}, NULL,
-      [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) {
-          _handleBody(r, d, l, i, t, [this](AsyncWebServerRequest* req, JsonDocument& doc) { this->_handleCalibrateScale(req, doc); });
-      });
+    _route("/api/scale/current", RouteMethod::GET, std::bind(&ApiHandlers::getScale, &_api, std::placeholders::_1));
+    _route("/api/scale/tare", RouteMethod::POST, std::bind(&ApiHandlers::tareScale, &_api, std::placeholders::_1));
+    _routeBody("/api/scale/calibrate", RouteMethod::POST, std::bind(&ApiHandlers::calibrateScale, &_api, std::placeholders::_1, std::placeholders::_3));
+    _route("/api/scale/trace/replay", RouteMethod::POST, std::bind(&WebServer::_handleReplayScaleTrace, this, std::placeholders::_1));
+    _route("/api/scale/trace", RouteMethod::GET, std::bind(&WebServer::_handleGetScaleTrace, this, std::placeholders::_1));
+    _routeBody("/api/scale/trace", RouteMethod::POST, std::bind(&WebServer::_handleArmScaleTrace, this, std::placeholders::_1, std::placeholders::_3));
+
+    // Servo Routes
+    _routeBody("/api/servos/jog", RouteMethod::POST, std::bind(&ApiHandlers::jogServo, &_api, std::placeholders::_1, std::placeholders::_3));
 
     // Diagnostics & Logs
-    _server.on("/api/diagnostics/sensors", HTTP_GET, std::bind(&WebServer::_handleGetSensorDiagnostics, this, std::placeholders::_1));
-    _server.on("/api/diagnostics/servos", HTTP_GET, std::bind(&WebServer::_handleGetServoDiagnostics, this, std::placeholders::_1));
-    _server.on("/api/network/info", HTTP_GET, std::bind(&WebServer::_handleGetNetworkInfo, this, std::placeholders::_1));
-    _server.on("/api/logs/system", HTTP_GET, std::bind(&WebServer::_handleGetSystemLogs, this, std::placeholders::_1));
-    _server.on("/api/logs/feeding", HTTP_GET, std::bind(&WebServer::_handleGetFeedingLogs, this, std::placeholders::_1));
+    _route("/api/diagnostics/sensors", RouteMethod::GET, std::bind(&ApiHandlers::getSensorDiagnostics, &_api, std::placeholders::_1));
+    _route("/api/diagnostics/servos", RouteMethod::GET, std::bind(&ApiHandlers::getServoDiagnostics, &_api, std::placeholders::_1));
+    _route("/api/network/info", RouteMethod::GET, std::bind(&WebServer::_handleGetNetworkInfo, this, std::placeholders::_1));
+#ifdef JITTER_BENCHMARK
+    _route("/api/diagnostics/jitter", RouteMethod::GET, std::bind(&WebServer::_handleGetJitterReport, this, std::placeholders::_1));
+    _route("/api/diagnostics/jitter", RouteMethod::DELETE, std::bind(&WebServer::_handleResetJitter, this, std::placeholders::_1));
+#endif
+    _route("/api/logs/system", RouteMethod::GET, std::bind(&WebServer::_handleGetSystemLogs, this, std::placeholders::_1));
+    _route("/api/logs/feeding", RouteMethod::GET, std::bind(&WebServer::_handleGetFeedingLogs, this, std::placeholders::_1));
 
-    // OTA Update Route
+    // OTA Update Route: an upload handler, registered on its own ahead of the catch-all
     _server.on(
       "/api/update", HTTP_POST,
       [](AsyncWebServerRequest* request) {
@@ -405,10 +538,89 @@ void WebServer::_setupAPIRoutes()
       },
       std::bind(&WebServer::_onUpdate, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4,
         std::placeholders::_5, std::placeholders::_6));
+
+    // Every other API request goes through the router
+    _server.on("/api/*", HTTP_ANY, std::bind(&WebServer::_dispatchRequest, this, std::placeholders::_1), NULL,
+      std::bind(&WebServer::_dispatchBody, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4,
+        std::placeholders::_5));
+}
+
+void WebServer::_route(const char* pathTemplate, RouteMethod method, ApiRequestHandler handler)
+{
+    if (_router.add(pathTemplate, method) != (int)_routes.size()) {
+        ESP_LOGE(TAG, "Invalid or duplicate route %s", pathTemplate);
+        return;
+    }
+    _routes.push_back({ handler, nullptr });
+}
+
+void WebServer::_routeBody(const char* pathTemplate, RouteMethod method, ApiBodyHandler handler)
+{
+    if (_router.add(pathTemplate, method) != (int)_routes.size()) {
+        ESP_LOGE(TAG, "Invalid or duplicate route %s", pathTemplate);
+        return;
+    }
+    _routes.push_back({ nullptr, handler });
+}
+
+int WebServer::_matchRoute(AsyncWebServerRequest* request, RouteParams& params)
+{
+    RouteMethod method;
+    switch (request->method()) {
+        case HTTP_GET:
+            method = RouteMethod::GET;
+            break;
+        case HTTP_POST:
+            method = RouteMethod::POST;
+            break;
+        case HTTP_PUT:
+            method = RouteMethod::PUT;
+            break;
+        case HTTP_DELETE:
+            method = RouteMethod::DELETE;
+            break;
+        case HTTP_PATCH:
+            method = RouteMethod::PATCH;
+            break;
+        default:
+            params.count = 0;
+            return ApiRouter::METHOD_NOT_ALLOWED;
+    }
+    const String& url = request->url();
+    return _router.match(url.c_str(), url.length(), method, params);
+}
+
+void WebServer::_dispatchRequest(AsyncWebServerRequest* request)
+{
+    RouteParams params;
+    int route = _matchRoute(request, params);
+    if (route == ApiRouter::NO_ROUTE) {
+        _handleNotFound(request);
+    } else if (route == ApiRouter::METHOD_NOT_ALLOWED) {
+        request->send(405, "application/json", "{\"error\":\"Method not allowed\"}");
+    } else if (_routes[route].onRequest) {
+        AsyncApiExchange exchange(request);
+        _routes[route].onRequest(exchange, params);
+    } else if (request->contentLength() == 0) {
+        request->send(400, "application/json", "{\"error\":\"Missing JSON body\"}");
+    } // else answered by _dispatchBody() once the body was complete
+}
+
+void WebServer::_dispatchBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)
+{
+    RouteParams params;
+    int route = _matchRoute(request, params);
+    if (route < 0 || !_routes[route].onBody)
+        return; // answered by _dispatchRequest()
+    _handleBody(request, data, len, index, total,
+      [this, route, params](AsyncWebServerRequest* req, JsonDocument& doc) {
+          AsyncApiExchange exchange(req);
+          _routes[route].onBody(exchange, params, doc);
+      });
 }
 
 // --- System Handlers ---
-void WebServer::_handleGetSystemInfo(AsyncWebServerRequest* request)
+void WebServer::_handleGetSystemInfo(ApiExchange& exchange)
 {
     JsonDocument doc;
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
@@ -420,55 +632,40 @@ void WebServer::_handleGetSystemInfo(AsyncWebServerRequest* request)
         doc["wifiStrength"]    = _deviceState.wifiStrength;
         xSemaphoreGive(_mutex);
     } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
         return;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
-}
-
-void WebServer::_handleGetStatus(AsyncWebServerRequest* request)
-{
-    JsonDocument doc;
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(200)) == pdTRUE) {
-        doc["battery"] = _deviceState.batteryLevel; // Integer (0-100). Current battery percentage.
-        doc["state"]
-          = static_cast<uint8_t>(_deviceState.operationState); // Integer. DeviceOperationState_e: 0=IDLE, 1=FEEDING, 2=ERROR, 3=CALIBRATING.
-        doc["lastFeedTime"] = _deviceState.lastFeedTime; // Integer. Unix timestamp of the last successful feed.
-        doc["lastRecipe"]   = _deviceState.lastRecipe.name; // String. Name of the recipe last used.
-        doc["event"]        = static_cast<uint8_t>(_deviceState.lastEvent); // Integer. DeviceEvent_e: 0=NONE, 1-9 for various events.
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
-        return;
-    }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    // Fragmentation shows as a largest block shrinking while the free total holds.
+    doc["minFreeHeap"]      = esp_get_minimum_free_heap_size();
+    doc["largestFreeBlock"] = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    doc["eventsDropped"]    = _weightSubscription.dropped(); // Weight windows the web events task fell behind on
+#ifdef HEAP_STEADY_STATE_CHECK
+    HeapGuard::report(doc["steadyState"].to<JsonObject>());
+#endif
+    exchange.sendJson(200, doc);
 }
 
-void WebServer::_handleRestart(AsyncWebServerRequest* request)
+void WebServer::_handleRestart(ApiExchange& exchange)
 {
-    request->send(200, "application/json", "{\"success\":true, \"message\":\"Restarting in 3 seconds\"}");
+    exchange.sendJson(200, "{\"success\":true, \"message\":\"Restarting in 3 seconds\"}");
     vTaskDelay(pdMS_TO_TICKS(3000));
     ESP.restart();
 }
 
-void WebServer::_handleFactoryReset(AsyncWebServerRequest* request)
+void WebServer::_handleFactoryReset(ApiExchange& exchange)
 {
     _configManager.factoryReset();
-    request->send(200, "application/json", "{\"success\":true, \"message\":\"Factory reset complete. Restarting in 3 seconds\"}");
+    exchange.sendJson(200, "{\"success\":true, \"message\":\"Factory reset complete. Restarting in 3 seconds\"}");
     vTaskDelay(pdMS_TO_TICKS(3000));
     ESP.restart();
 }
 
-void WebServer::_handleSetTime(AsyncWebServerRequest* request, JsonDocument& doc)
+void WebServer::_handleSetTime(ApiExchange& exchange, JsonDocument& doc)
 {
     // 1. Validate that both required fields exist and are the correct type
     if (!doc["epoch"].is<time_t>() || !doc["tz"].is<const char*>()) {
         ESP_LOGW(TAG, "Invalid time payload received");
-        request->send(400, "application/json", "{\"error\":\"Missing 'epoch' or 'tz' in payload\"}");
+        exchange.sendJson(400, "{\"error\":\"Missing 'epoch' or 'tz' in payload\"}");
         return;
     }
 
@@ -484,7 +681,7 @@ void WebServer::_handleSetTime(AsyncWebServerRequest* request, JsonDocument& doc
 
     if (settimeofday(&tv, NULL) < 0) {
         ESP_LOGE(TAG, "Failed to update system time");
-        request->send(500, "application/json", "{\"error\":\"Internal system error setting time\"}");
+        exchange.sendJson(500, "{\"error\":\"Internal system error setting time\"}");
         return;
     }
 
@@ -497,622 +694,439 @@ void WebServer::_handleSetTime(AsyncWebServerRequest* request, JsonDocument& doc
     ESP_LOGI(TAG, "Time updated. Epoch: %ld, TZ: %s", (long)epoch, tzRule);
 
     // 5. Send Success Response
-    request->send(200, "application/json", "{\"success\":true}");
+    exchange.sendJson(200, "{\"success\":true}");
     _display.forceUpdate();
 }
 
-// --- Settings Handlers ---
-void WebServer::_handleGetSettings(AsyncWebServerRequest* request)
+// --- Scale Trace Handlers ---
+void WebServer::_handleGetScaleTrace(ApiExchange& exchange)
 {
-    JsonDocument doc;
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        doc["deviceName"]   = _deviceState.deviceName;
-        doc["timezone"]     = _configManager.loadTimezone();
-        doc["wifiStrength"] = _deviceState.wifiStrength;
-        doc["safetyMode"]   = _deviceState.safetyModeEngaged;
-        // These are placeholders as they are not yet in DeviceState
-        doc["autoRefillAlerts"]                = true;
-        JsonObject feedingSettings             = doc["feedingSettings"].to<JsonObject>();
-        feedingSettings["timeOfFirstServing"]  = "08:30";
-        feedingSettings["minTimeBetweenFeeds"] = 300;
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
+    ScaleTrace* trace = _scale.getTrace();
+    if (trace == nullptr || !storage.exists(trace->getPath())) {
+        exchange.sendJson(404, "{\"error\":\"No trace recorded\"}");
+        return;
+    }
+    if (trace->isRecording()) {
+        exchange.sendJson(409, "{\"error\":\"Capture in progress\"}");
         return;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    exchange.sendFile(trace->getPath(), "application/octet-stream", true);
 }
 
-void WebServer::_handleUpdateSettings(AsyncWebServerRequest* request, JsonDocument& doc)
+void WebServer::_handleArmScaleTrace(ApiExchange& exchange, JsonDocument& doc)
 {
-    const char* deviceName = doc["deviceName"];
-    const char* timezone   = doc["timezone"];
-
-    if (deviceName) {
-        if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-            _deviceState.deviceName = deviceName;
-            xSemaphoreGive(_mutex);
-        }
+    ScaleTrace* trace = _scale.getTrace();
+    if (trace == nullptr) {
+        exchange.sendJson(503, "{\"error\":\"Trace capture unavailable\"}");
+        return;
     }
-    if (timezone) {
-        _configManager.saveTimezone(timezone);
+    if (!doc["armed"].is<bool>()) {
+        exchange.sendJson(400, "{\"error\":\"Missing armed\"}");
+        return;
     }
+    trace->arm(doc["armed"].as<bool>());
 
-    // Add logic for other settings as they are implemented
+    JsonDocument responseDoc;
+    responseDoc["success"]   = true;
+    responseDoc["armed"]     = trace->isArmed();
+    responseDoc["recording"] = trace->isRecording();
 
-    request->send(200, "application/json", "{\"success\":true}");
+    exchange.sendJson(200, responseDoc);
 }
 
-void WebServer::_handleExportSettings(AsyncWebServerRequest* request)
+void WebServer::_handleReplayScaleTrace(ApiExchange& exchange)
 {
-    JsonDocument doc;
-
-    // Settings
-    JsonObject settings = doc["settings"].to<JsonObject>();
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        settings["deviceName"] = _deviceState.deviceName;
-        xSemaphoreGive(_mutex);
+    ScaleTrace* trace = _scale.getTrace();
+    if (trace == nullptr || !storage.exists(trace->getPath())) {
+        exchange.sendJson(404, "{\"error\":\"No trace recorded\"}");
+        return;
     }
-    settings["timezone"] = _configManager.loadTimezone();
-
-    // Tanks
-    JsonArray tanks = doc["tanks"].to<JsonArray>();
+    bool idle = false;
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        for (const auto& tank : _deviceState.connectedTanks) {
-            JsonObject tankObj = tanks.add<JsonObject>();
-            char hexUid[17];
-            snprintf(hexUid, sizeof(hexUid), "%llX", (unsigned long long)tank.uid);
-            tankObj["uid"]  = hexUid;
-            tankObj["name"] = tank.name;
-        }
+        idle = _deviceState.feedCommand.processed && _deviceState.currentFeedingStatus != "Processing..."
+          && _deviceState.currentFeedingStatus != "Calibrating...";
         xSemaphoreGive(_mutex);
     }
-
-    // Recipes
-    JsonArray recipes = doc["recipes"].to<JsonArray>();
-    for (const auto& recipe : _recipeProcessor.getRecipes()) {
-        JsonObject recipeObj     = recipes.add<JsonObject>();
-        recipeObj["uid"]         = recipe.uid;
-        recipeObj["name"]        = recipe.name;
-        recipeObj["dailyWeight"] = recipe.dailyWeight;
-        recipeObj["servings"]    = recipe.servings;
+    if (!idle) {
+        exchange.sendJson(409, "{\"error\":\"Device busy\"}");
+        return;
     }
-
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    if (!_scale.startReplay(storage, trace->getPath())) {
+        exchange.sendJson(500, "{\"error\":\"Trace could not be replayed\"}");
+        return;
+    }
+    exchange.sendJson(202, "{\"success\":true, \"message\":\"Trace replay started\"}");
 }
 
-
-// --- Tank Handlers ---
-void WebServer::_handleGetTanks(AsyncWebServerRequest* request)
+// --- Diagnostics & Logs Handlers ---
+void WebServer::_handleGetNetworkInfo(ApiExchange& exchange)
 {
     JsonDocument doc;
-    JsonArray tanksArray = doc.to<JsonArray>();
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        ESP_LOGI(TAG, "_handleGetTanks: _deviceState.connectedTanks.size==%d", _deviceState.connectedTanks.size());
-        for (const auto& tank : _deviceState.connectedTanks) {
-            JsonObject tankObj = tanksArray.add<JsonObject>();
-            char hexUid[17];
-            snprintf(hexUid, sizeof(hexUid), "%llX", (unsigned long long)tank.uid);
-            tankObj["uid"]                  = hexUid;
-            tankObj["name"]                 = tank.name;
-            tankObj["busIndex"]             = tank.busIndex;
-            tankObj["remainingWeightGrams"] = tank.remaining_weight_grams;
-            tankObj["capacity"]             = tank.capacityLiters;
-            tankObj["density"]              = tank.kibbleDensity * 1000.0; // Internal kg/L to API g/L
-            JsonObject calib                = tankObj["calibration"].to<JsonObject>();
-            calib["idlePwm"]                = tank.servoIdlePwm;
-
-            tankObj["lastDispensed"]  = 0;
-            tankObj["totalDispensed"] = 0;
-        }
+        doc["ssid"]       = WiFi.SSID();
+        doc["ipAddress"]  = WiFi.localIP().toString();
+        doc["macAddress"] = WiFi.macAddress();
+        doc["rssi"]       = WiFi.RSSI();
+        doc["connected"]  = (WiFi.status() == WL_CONNECTED);
+        doc["uptime"]     = _deviceState.uptime_s;
         xSemaphoreGive(_mutex);
     } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
+        exchange.sendJson(503, "{\"error\":\"Could not acquire state lock\"}");
         return;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    JsonObject http          = doc["http"].to<JsonObject>();
+    http["throttled"]        = _throttledCount;
+    http["deferred"]         = _deferredCount;
+    http["expensiveInFlight"] = _expensiveInFlight;
+    http["bodyRefused"]       = _bodyRefusedCount;
+    exchange.sendJson(200, doc);
 }
 
-
-void WebServer::_handleUpdateTank(AsyncWebServerRequest* request, JsonDocument& doc)
+#ifdef JITTER_BENCHMARK
+void WebServer::_handleGetJitterReport(ApiExchange& exchange)
 {
-    // 1. Extract UID from the path and perform basic validation.
-    String uidStr = request->pathArg(0);
-    ESP_LOGI(TAG, "_handleUpdateTank invoked for %s", uidStr.c_str());
-    if (uidStr.isEmpty()) {
-        request->send(400, "application/json", "{\"error\":\"Missing tank UID in request path\"}");
-        return;
-    }
-    uint64_t uid = hexStrToU64(uidStr);
-
-    // 2. Create a TankInfo object to hold the new data.
-    // We must first read the existing data to have a complete object to modify.
-    TankInfo tankToUpdate;
-    tankToUpdate.uid = uid;
-
-    if (!_tankManager.refreshTankInfo(tankToUpdate)) {
-        request->send(404, "application/json", "{\"error\":\"Tank not found\"}");
-        return;
-    }
-
-    // 3. Populate the TankInfo object from the JSON document.
-    // The JSON might only contain a subset of fields, so we check for existence.
-    if (!doc["name"].isNull()) {
-        tankToUpdate.name = doc["name"].as<std::string>();
-    }
-    if (!doc["remainingWeightGrams"].isNull()) {
-        double weightGrams = doc["remainingWeightGrams"].as<double>();
-        if (weightGrams < 0.0 || weightGrams > 65535.0) {
-            request->send(400, "application/json", "{\"error\":\"remainingWeightGrams must be between 0 and 65535 grams\"}");
-            return;
-        }
-        tankToUpdate.remaining_weight_grams = weightGrams; // API grams to internal kg
-    }
-    if (!doc["capacity"].isNull()) {
-        tankToUpdate.capacityLiters = doc["capacity"].as<double>();
-    }
-    if (!doc["density"].isNull()) {
-        tankToUpdate.kibbleDensity = doc["density"].as<double>() / 1000.0; // API g/L to internal kg/L
-    } else if (!doc["kibbleDensity"].isNull()) {
-        tankToUpdate.kibbleDensity = doc["kibbleDensity"].as<double>() / 1000.0; // API g/L to internal kg/L
-    }
-
-    // Handle nested calibration object
-    if (doc["calibration"].is<JsonObject>()) {
-        JsonObject calib = doc["calibration"];
-        if (!calib["idlePwm"].isNull()) {
-            tankToUpdate.servoIdlePwm = calib["idlePwm"].as<uint16_t>();
-        }
-    }
-
-
-
-    // 4. Commit the changes using the full-featured TankManager method.
-    if (_tankManager.commitTankInfo(tankToUpdate)) {
-        request->send(200, "application/json", "{\"success\":true}");
-        // Print updated tank info for debugging using ESP_LOGI
-        ESP_LOGI(TAG, "Tank %llX updated: name=%s, remainingWeightGrams=%.2fg, capacity=%.2f L, kibbleDensity=%.2f kg/L, servoIdlePwm=%d",
-          (unsigned long long)tankToUpdate.uid, tankToUpdate.name.c_str(), tankToUpdate.remaining_weight_grams, tankToUpdate.capacityLiters,
-          tankToUpdate.kibbleDensity, tankToUpdate.servoIdlePwm);
-    } else {
-        // This could fail if the tank was disconnected between the check and the commit.
-        request->send(500, "application/json", "{\"error\":\"Failed to write update to tank EEPROM\"}");
-    }
+    JsonDocument doc;
+    JitterProbe::report(doc);
+    // The load the window was measured under, as seen by the server
+    JsonObject load    = doc["load"].to<JsonObject>();
+    load["sseClients"] = _events.count();
+    load["wsClients"]  = _ws.count();
+    load["throttled"]  = _throttledCount; // since boot
+    load["deferred"]   = _deferredCount;
+    exchange.sendJson(200, doc);
 }
 
-void WebServer::_handleGetTankHistory(AsyncWebServerRequest* request)
+void WebServer::_handleResetJitter(ApiExchange& exchange)
 {
-    String tankUid = request->pathArg(0);
-    JsonDocument doc;
-    JsonArray historyArray = doc.to<JsonArray>();
-
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        for (const auto& entry : _deviceState.feedingHistory) {
-            // This is a simplified implementation. A real implementation would need to check
-            // if the tank was part of the recipe or immediate feed.
-            JsonObject entryObj    = historyArray.add<JsonObject>();
-            entryObj["timestamp"]  = entry.timestamp;
-            entryObj["amount"]     = entry.amount;
-            entryObj["recipeUid"]  = entry.recipeUid;
-            entryObj["recipeName"] = entry.description;
-        }
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
-        return;
-    }
-
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    JitterProbe::resetAll();
+    exchange.sendJson(200, "{\"success\":true}");
 }
+#endif
 
-
-// --- Feeding Handlers ---
-void WebServer::_handleFeedImmediate(AsyncWebServerRequest* request, JsonDocument& doc)
+void WebServer::_handleGetSystemLogs(ApiExchange& exchange)
 {
-    String tankUid            = request->pathArg(0);
-    JsonVariant amountVariant = doc["amount"];
+    // This is a placeholder. A real implementation would require a logging buffer.
+    JsonDocument doc;
+    JsonArray logs        = doc.to<JsonArray>();
+    JsonObject logEntry   = logs.add<JsonObject>();
+    logEntry["timestamp"] = time(nullptr);
+    logEntry["level"]     = "INFO";
+    logEntry["message"]   = "Device started successfully";
+    logEntry["component"] = "SYSTEM";
 
-    if (amountVariant.isNull() || !amountVariant.is<float>() || amountVariant.as<float>() <= 0) {
-        request->send(400, "application/json", "{\"error\":\"Invalid or missing amount\"}");
-        return;
-    }
-    float amount = amountVariant.as<float>();
-
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-        if (_deviceState.feedCommand.processed) {
-            _deviceState.feedCommand.type        = FeedCommandType::IMMEDIATE;
-            _deviceState.feedCommand.tankUid     = hexStrToU64(tankUid);
-            _deviceState.feedCommand.amountGrams = amount;
-            _deviceState.feedCommand.processed   = false;
-            request->send(202, "application/json", "{\"success\":true, \"message\":\"Immediate feed command accepted\"}");
-        } else {
-            request->send(429, "application/json", "{\"error\":\"Device busy\"}");
-        }
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
-    }
+    exchange.sendJson(200, doc);
 }
 
-void WebServer::_handleFeedRecipe(AsyncWebServerRequest* request, JsonDocument& doc)
+void WebServer::_handleGetFeedingLogs(ApiExchange& exchange)
 {
-    uint32_t recipeUid = (uint32_t)request->pathArg(0).toInt();
-    int servings       = doc["servings"] | 1; // Default to 1 serving if not provided
+    // This is an alias for /feeding/history
+    _api.getFeedingHistory(exchange);
+}
 
-    if (recipeUid == 0) {
-        request->send(400, "application/json", "{\"error\":\"Invalid recipeUid\"}");
-        return;
-    }
 
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-        if (_deviceState.feedCommand.processed) {
-            _deviceState.feedCommand.type      = FeedCommandType::RECIPE;
-            _deviceState.feedCommand.recipeUid = recipeUid;
-            _deviceState.feedCommand.servings  = servings;
-            _deviceState.feedCommand.processed = false;
-            request->send(202, "application/json", "{\"success\":true, \"message\":\"Recipe feed command accepted\"}");
-        } else {
-            request->send(429, "application/json", "{\"error\":\"Device busy\"}");
-        }
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
-    }
-}
+// --- Admission Control ---
 
-void WebServer::_handleStopFeeding(AsyncWebServerRequest* request)
+bool WebServer::_isExpensive(const String& url)
 {
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-        _deviceState.feedCommand.type      = FeedCommandType::EMERGENCY_STOP;
-        _deviceState.feedCommand.processed = false;
-        request->send(202, "application/json", "{\"success\":true, \"message\":\"Stop command accepted\"}");
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
-    }
+    // Endpoints that serialize whole lists, read flash or hold the state mutex for long.
+    static const char* const EXPENSIVE_PREFIXES[] = { "/api/feeding/history", "/api/logs/", "/api/tanks", "/api/settings/export",
+        "/api/diagnostics/", "/api/scale/trace", "/api/recipes" };
+    for (const char* prefix : EXPENSIVE_PREFIXES) {
+        if (url.startsWith(prefix))
+            return true;
+    }
+    return false;
 }
 
-void WebServer::_handleGetFeedingHistory(AsyncWebServerRequest* request)
+bool WebServer::_takeTokens(uint32_t ip, uint8_t cost, uint32_t& retryAfterS)
 {
-    JsonDocument doc;
-    JsonArray historyArray = doc.to<JsonArray>();
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        for (const auto& entry : _deviceState.feedingHistory) {
-            JsonObject entryObj   = historyArray.add<JsonObject>();
-            entryObj["timestamp"] = entry.timestamp;
-            entryObj["type"]      = entry.type;
-            if (entry.recipeUid != 0) {
-                entryObj["recipeUid"] = entry.recipeUid;
-            }
-            entryObj["success"] = entry.success;
-            entryObj["amount"]  = entry.amount;
+    uint32_t now          = millis();
+    ClientBucket* bucket  = nullptr;
+    ClientBucket* oldest  = &_buckets[0];
+    for (auto& candidate : _buckets) {
+        if (candidate.ip == ip) {
+            bucket = &candidate;
+            break;
         }
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
-        return;
+        if (candidate.ip == 0 || (oldest->ip != 0 && now - candidate.lastRefillMs > now - oldest->lastRefillMs))
+            oldest = &candidate;
+    }
+    if (bucket == nullptr) {
+        // A new client starts with a full bucket, in place of the one seen the longest ago.
+        bucket               = oldest;
+        bucket->ip           = ip;
+        bucket->milliTokens  = HTTP_BUCKET_CAPACITY * 1000UL;
+        bucket->lastRefillMs = now;
+    }
+
+    uint32_t elapsed     = now - bucket->lastRefillMs;
+    uint32_t refill      = elapsed > HTTP_BUCKET_CAPACITY * 1000UL ? HTTP_BUCKET_CAPACITY * 1000UL : elapsed * HTTP_BUCKET_REFILL_PER_SEC;
+    bucket->milliTokens  = min(bucket->milliTokens + refill, (uint32_t)(HTTP_BUCKET_CAPACITY * 1000UL));
+    bucket->lastRefillMs = now;
+
+    uint32_t needed = cost * 1000UL;
+    if (bucket->milliTokens < needed) {
+        uint32_t rate = HTTP_BUCKET_REFILL_PER_SEC * 1000UL;
+        retryAfterS   = (needed - bucket->milliTokens + rate - 1) / rate;
+        return false;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    bucket->milliTokens -= needed;
+    return true;
 }
 
-// --- Scale Handlers ---
-void WebServer::_handleGetScale(AsyncWebServerRequest* request)
+void WebServer::_sendRetryLater(AsyncWebServerRequest* request, int code, const char* body, uint32_t retryAfterS)
 {
-    JsonDocument doc;
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        doc["rawValue"]  = _deviceState.currentRawValue;
-        doc["weight"]    = _deviceState.currentWeight;
-        doc["stable"]    = _deviceState.isWeightStable;
-        doc["timestamp"] = _deviceState.currentTime;
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
-        return;
-    }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    AsyncWebServerResponse* response = request->beginResponse(code, "application/json", body);
+    response->addHeader("Retry-After", String(retryAfterS));
+    request->send(response);
 }
 
-void WebServer::_handleTareScale(AsyncWebServerRequest* request)
+bool WebServer::_admitRequest(AsyncWebServerRequest* request)
 {
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
-        if (_deviceState.feedCommand.processed) {
-            _deviceState.feedCommand.type      = FeedCommandType::TARE_SCALE;
-            _deviceState.feedCommand.processed = false;
-            request->send(202, "application/json", "{\"success\":true, \"message\":\"Tare command accepted\"}");
-        } else {
-            request->send(429, "application/json", "{\"error\":\"Device busy\"}");
+    const String& url = request->url();
+    // Static files take no lock, and the SSE, WebSocket and OTA endpoints are long-lived connections.
+    if (!url.startsWith("/api/") || url == "/api/events" || url == "/api/ws" || url == "/api/update")
+        return true;
+    // Always admitted, whatever the load: stopping must never wait behind a throttled client.
+    if (url == "/api/feed/stop")
+        return true;
+
+    bool expensive = _isExpensive(url);
+    if (expensive) {
+        // While dispensing, the feeding task's deadlines come first; those requests can wait a few seconds.
+        if (_tankManager.isFeedingActive()) {
+            _deferredCount++;
+            _sendRetryLater(request, 503, "{\"error\":\"Feeding in progress, retry later\"}", HTTP_RETRY_FEEDING_S);
+            return false;
+        }
+        if (_expensiveInFlight >= HTTP_MAX_EXPENSIVE) {
+            _deferredCount++;
+            _sendRetryLater(request, 503, "{\"error\":\"Server busy, retry later\"}", HTTP_RETRY_BUSY_S);
+            return false;
         }
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
     }
-}
 
-void WebServer::_handleCalibrateScale(AsyncWebServerRequest* request, JsonDocument& doc)
-{
-    if (doc["knownWeight"].isNull()) {
-        request->send(400, "application/json", "{\"error\":\"Missing knownWeight\"}");
-        return;
+    uint32_t retryAfterS;
+    if (!_takeTokens((uint32_t)request->client()->remoteIP(), expensive ? HTTP_EXPENSIVE_COST : 1, retryAfterS)) {
+        _throttledCount++;
+        _sendRetryLater(request, 429, "{\"error\":\"Too many requests\"}", retryAfterS);
+        return false;
     }
-    float knownWeight = doc["knownWeight"];
-    float newFactor   = _recipeProcessor.getScale().calibrateWithKnownWeight(knownWeight);
 
-    JsonDocument responseDoc;
-    responseDoc["success"]              = true;
-    responseDoc["newCalibrationFactor"] = newFactor;
-    responseDoc["message"]              = "Scale calibrated";
-
-    String response;
-    serializeJson(responseDoc, response);
-    request->send(200, "application/json", response);
+    if (expensive) {
+        // The request lives until its response is fully sent (gzip and file responses outlast the handler).
+        _expensiveInFlight++;
+        request->onDisconnect([this]() {
+            if (_expensiveInFlight > 0)
+                _expensiveInFlight--;
+        });
+    }
+    return true;
 }
 
-// --- Recipe Handlers ---
-void WebServer::_handleGetRecipes(AsyncWebServerRequest* request)
+// --- WebSocket ---
+
+void WebServer::_onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
-    std::vector<Recipe> recipes = _recipeProcessor.getRecipes();
-    JsonDocument doc;
-    JsonArray recipesArray = doc.to<JsonArray>();
-    for (const auto& recipe : recipes) {
-        JsonObject recipeObj     = recipesArray.add<JsonObject>();
-        recipeObj["uid"]         = recipe.uid;
-        recipeObj["name"]        = recipe.name;
-        recipeObj["dailyWeight"] = recipe.dailyWeight;
-        recipeObj["servings"]    = recipe.servings;
-
-        JsonArray ingredients = recipeObj["ingredients"].to<JsonArray>();
-        for (const auto& ing : recipe.ingredients) {
-            JsonObject ingObj = ingredients.add<JsonObject>();
-            char hexUid[17];
-            snprintf(hexUid, sizeof(hexUid), "%llX", (unsigned long long)ing.tankUid);
-            ingObj["tankUid"]    = hexUid;
-            ingObj["percentage"] = ing.percentage;
+    switch (type) {
+        case WS_EVT_CONNECT:
+            // Each client holds buffers in the TCP stack: the oldest ones go first beyond the limit.
+            _ws.cleanupClients(WS_MAX_CLIENTS);
+            ESP_LOGI(TAG, "WebSocket client #%lu connected.", (unsigned long)client->id());
+            break;
+        case WS_EVT_DISCONNECT:
+            _removeWsSubscriber(client->id());
+            ESP_LOGI(TAG, "WebSocket client #%lu disconnected.", (unsigned long)client->id());
+            break;
+        case WS_EVT_DATA: {
+            AwsFrameInfo* info = (AwsFrameInfo*)arg;
+            // Requests are small: only whole, single-frame text messages are accepted.
+            if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+                client->text("{\"status\":400,\"body\":{\"error\":\"Fragmented or binary message\"}}");
+            } else if (len > WS_MAX_MESSAGE_LEN) {
+                client->text("{\"status\":413,\"body\":{\"error\":\"Message too long\"}}");
+            } else {
+                _handleWsMessage(client, data, len);
+            }
+            break;
         }
-        recipeObj["created"]  = recipe.created;
-        recipeObj["lastUsed"] = recipe.lastUsed;
+        default:
+            break;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
 }
 
-void WebServer::_handleAddRecipe(AsyncWebServerRequest* request, JsonDocument& doc)
+void WebServer::_handleWsMessage(AsyncWebSocketClient* client, const uint8_t* data, size_t len)
 {
-#if ESP_LOG_LEVEL >= ESP_LOG_INFO && !defined(LOG_TO_FILE_ENABLED)
-    {
-        String payload;
-        serializeJson(doc, payload);
-        ESP_LOGI(TAG, "_handleAddRecipe: payload=%s", payload.c_str());
-    }
-#endif
-
-    Recipe recipe;
-    recipe.name = doc["name"].as<std::string>();
-    if (recipe.name.empty()) {
-        ESP_LOGI(TAG, "_handleAddRecipe: Recipe name is required");
-        request->send(400, "application/json", "{\"error\":\"Recipe name is required\"}");
-        return;
-    }
-
-    recipe.dailyWeight = doc["dailyWeight"];
-    recipe.servings    = doc["servings"];
-
-    JsonArray tanks    = doc["ingredients"];
-    float totalPercent = 0;
-    for (JsonObject tank : tanks) {
-        totalPercent += tank["percentage"].as<float>();
-    }
-
-    if (abs(totalPercent - 100.0) > 0.1) {
-        ESP_LOGI(TAG, "_handleAddRecipe: Percentages must sum to 100 (got %.2f)", totalPercent);
-        request->send(400, "application/json", "{\"error\":\"Percentages must sum to 100\"}");
+    JsonDocument doc;
+    if (deserializeJson(doc, data, len)) {
+        client->text("{\"status\":400,\"body\":{\"error\":\"Invalid JSON\"}}");
         return;
     }
 
-    for (JsonObject tank : tanks) {
-        RecipeIngredient ing;
-        ing.tankUid    = hexStrToU64(tank["tankUid"].as<String>());
-        ing.percentage = tank["percentage"].as<float>();
-        recipe.ingredients.push_back(ing);
-    }
-
-    if (_recipeProcessor.addRecipe(recipe)) {
-        request->send(200, "application/json", "{\"success\":true}");
-    } else {
-        ESP_LOGI(TAG, "_handleAddRecipe: Failed to save recipe '%s'", recipe.name.c_str());
-        request->send(500, "application/json", "{\"error\":\"Failed to save recipe\"}");
-    }
+    const char* op   = doc["op"] | "";
+    ApiResult result = { 400, "{\"error\":\"Unknown op\"}" };
+    uint32_t retryAfterS;
+    // Same budget as the REST API, stop requests excepted.
+    if (strcmp(op, "stop") != 0 && !_takeTokens((uint32_t)client->remoteIP(), 1, retryAfterS)) {
+        _throttledCount++;
+        result = { 429, "{\"error\":\"Too many requests\"}" };
+    } else if (strcmp(op, "feed") == 0) {
+        result = _api.commandFeedImmediate(hexStrToU64(doc["tank"] | ""), doc["amount"]);
+    } else if (strcmp(op, "recipe") == 0) {
+        result = _api.commandFeedRecipe(doc["recipe"] | 0UL, doc["servings"] | 1);
+    } else if (strcmp(op, "stop") == 0) {
+        result = _api.commandStopFeeding();
+    } else if (strcmp(op, "tare") == 0) {
+        result = _api.commandTareScale();
+    } else if (strcmp(op, "calibrateDensity") == 0) {
+        result = _api.commandCalibrateDensity(hexStrToU64(doc["tank"] | ""));
+    } else if (strcmp(op, "jog") == 0) {
+        result = _api.commandJogServo(doc["servo"], doc["pwm"]);
+    } else if (strcmp(op, "subscribe") == 0 || strcmp(op, "unsubscribe") == 0) {
+        bool subscribe = op[0] == 's';
+        _setWsSubscription(client->id(), doc["streams"], subscribe);
+        if (subscribe && _hasWsSubscribers(WSSTREAM_WEIGHT | WSSTREAM_BOWL_WEIGHT))
+            _scale.setSubscribed(true);
+        result = { 200, "{\"success\":true}" };
+    }
+
+    char reply[160];
+    snprintf(reply, sizeof(reply), "{\"id\":%lu,\"status\":%d,\"body\":%s}", (unsigned long)(doc["id"] | 0UL), result.status, result.body);
+    client->text(reply);
 }
 
-void WebServer::_handleUpdateRecipe(AsyncWebServerRequest* request, JsonDocument& doc)
+void WebServer::_setWsSubscription(uint32_t clientId, JsonVariantConst streams, bool subscribe)
 {
-#if ESP_LOG_LEVEL >= ESP_LOG_INFO && !defined(LOG_TO_FILE_ENABLED)
-    {
-        String payload;
-        serializeJson(doc, payload);
-        ESP_LOGI(TAG, "_handleUpdateRecipe: payload=%s", payload.c_str());
-    }
-#endif
-
-    uint32_t recipeUid = (uint32_t)request->pathArg(0).toInt();
-    if (recipeUid == 0) {
-        ESP_LOGI(TAG, "_handleUpdateRecipe: Invalid recipeUid %u", recipeUid);
-        request->send(400, "application/json", "{\"error\":\"Invalid recipeUid\"}");
-        return;
-    }
-
-    Recipe recipe;
-    recipe.uid  = recipeUid;
-    recipe.name = doc["name"].as<std::string>();
-    if (recipe.name.empty()) {
-        ESP_LOGI(TAG, "_handleUpdateRecipe: Recipe name is required for recipeUid %u", recipeUid);
-        request->send(400, "application/json", "{\"error\":\"Recipe name is required\"}");
-        return;
-    }
-
-    recipe.dailyWeight = doc["dailyWeight"];
-    recipe.servings    = doc["servings"];
-
-    JsonArray tanks    = doc["ingredients"];
-    float totalPercent = 0;
-    for (JsonObject tank : tanks) {
-        totalPercent += tank["percentage"].as<float>();
-    }
-
-    if (abs(totalPercent - 100.0) > 0.1) {
-        ESP_LOGI(TAG, "_handleUpdateRecipe: Percentages must sum to 100 (got %.2f) for recipeUid %u", totalPercent, recipeUid);
-        request->send(400, "application/json", "{\"error\":\"Percentages must sum to 100\"}");
-        return;
-    }
-
-    recipe.ingredients.clear();
-    for (JsonObject tank : tanks) {
-        RecipeIngredient ing;
-        ing.tankUid    = hexStrToU64(tank["tankUid"].as<String>());
-        ing.percentage = tank["percentage"].as<float>();
-        recipe.ingredients.push_back(ing);
-    }
-
-    if (_recipeProcessor.updateRecipe(recipe)) {
-        request->send(200, "application/json", "{\"success\":true}");
-    } else {
-        ESP_LOGI(TAG, "_handleUpdateRecipe: Recipe not found for recipeUid %u", recipeUid);
-        request->send(404, "application/json", "{\"error\":\"Recipe not found\"}");
-    }
+    uint8_t mask = 0;
+    for (JsonVariantConst stream : streams.as<JsonArrayConst>()) {
+        const char* name = stream | "";
+        if (strcmp(name, "weight") == 0)
+            mask |= WSSTREAM_WEIGHT;
+        else if (strcmp(name, "bowl_weight") == 0)
+            mask |= WSSTREAM_BOWL_WEIGHT;
+        else if (strcmp(name, "tanks_changed") == 0)
+            mask |= WSSTREAM_TANKS_CHANGED;
+    }
+
+    portENTER_CRITICAL(&_wsSubscribersLock);
+    WsSubscriber* slot = nullptr;
+    WsSubscriber* vacant = nullptr;
+    for (auto& subscriber : _wsSubscribers) {
+        if (subscriber.clientId == clientId)
+            slot = &subscriber;
+        else if (vacant == nullptr && subscriber.clientId == 0)
+            vacant = &subscriber;
+    }
+    if (slot == nullptr && subscribe)
+        slot = vacant; // streams of a free slot are always 0
+    if (slot != nullptr) {
+        uint8_t streamsMask = subscribe ? (slot->streams | mask) : (slot->streams & ~mask);
+        slot->clientId      = streamsMask ? clientId : 0; // the slot is given back with its last stream
+        slot->streams       = streamsMask;
+    }
+    portEXIT_CRITICAL(&_wsSubscribersLock);
 }
 
-void WebServer::_handleDeleteRecipe(AsyncWebServerRequest* request)
+void WebServer::_removeWsSubscriber(uint32_t clientId)
 {
-    uint32_t recipeUid = (uint32_t)request->pathArg(0).toInt();
-    if (recipeUid == 0) {
-        request->send(400, "application/json", "{\"error\":\"Invalid recipeUid\"}");
-        return;
-    }
-
-    if (_recipeProcessor.deleteRecipe(recipeUid)) {
-        request->send(200, "application/json", "{\"success\":true}");
-    } else {
-        request->send(404, "application/json", "{\"error\":\"Recipe not found\"}");
+    portENTER_CRITICAL(&_wsSubscribersLock);
+    for (auto& subscriber : _wsSubscribers) {
+        if (subscriber.clientId == clientId) {
+            subscriber.clientId = 0;
+            subscriber.streams  = 0;
+        }
     }
+    portEXIT_CRITICAL(&_wsSubscribersLock);
 }
 
-// --- Diagnostics & Logs Handlers ---
-void WebServer::_handleGetSensorDiagnostics(AsyncWebServerRequest* request)
+bool WebServer::_hasWsSubscribers(uint8_t stream)
 {
-    JsonDocument doc;
-
-    // Scale
-    JsonObject scale = doc["scale"].to<JsonObject>();
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        scale["weight"]   = _deviceState.currentWeight;
-        scale["rawValue"] = _deviceState.currentRawValue;
-        scale["stable"]   = _deviceState.isWeightStable;
-        xSemaphoreGive(_mutex);
-    }
-
-    // Tank Levels
-    JsonArray tankLevels = doc["tankLevels"].to<JsonArray>();
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        for (const auto& tank : _deviceState.connectedTanks) {
-            JsonObject tankLevel              = tankLevels.add<JsonObject>();
-            tankLevel["uid"]                  = tank.uid;
-            tankLevel["remainingWeightGrams"] = tank.remaining_weight_grams;
-            tankLevel["sensorType"]           = "estimation";
+    bool found = false;
+    portENTER_CRITICAL(&_wsSubscribersLock);
+    for (const auto& subscriber : _wsSubscribers) {
+        if (subscriber.clientId != 0 && (subscriber.streams & stream)) {
+            found = true;
+            break;
         }
-        xSemaphoreGive(_mutex);
     }
-
-    // Placeholders for other sensors
-    doc["temperature"] = 23.5;
-    doc["humidity"]    = 45.2;
-
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    portEXIT_CRITICAL(&_wsSubscribersLock);
+    return found;
 }
 
-void WebServer::_handleGetServoDiagnostics(AsyncWebServerRequest* request)
+void WebServer::_publishWs(uint8_t stream, const char* name, const char* payload)
 {
-    // This is a placeholder implementation as servo positions are not tracked in state.
-    JsonDocument doc;
-    JsonArray tanks = doc["tanks"].to<JsonArray>();
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        for (const auto& tank : _deviceState.connectedTanks) {
-            JsonObject tankDiag         = tanks.add<JsonObject>();
-            tankDiag["uid"]             = tank.uid;
-            tankDiag["connected"]       = tank.busIndex > -1;
-            tankDiag["currentPosition"] = 1500; // Placeholder
-        }
-        xSemaphoreGive(_mutex);
-    }
-
-    JsonObject hopper         = doc["hopper"].to<JsonObject>();
-    hopper["connected"]       = true;
-    hopper["currentPosition"] = 1000; // Placeholder
+    uint32_t recipients[WS_MAX_CLIENTS];
+    size_t count = 0;
+    portENTER_CRITICAL(&_wsSubscribersLock);
+    for (const auto& subscriber : _wsSubscribers) {
+        if (subscriber.clientId != 0 && (subscriber.streams & stream))
+            recipients[count++] = subscriber.clientId;
+    }
+    portEXIT_CRITICAL(&_wsSubscribersLock);
+    if (count == 0)
+        return;
 
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    char message[128];
+    snprintf(message, sizeof(message), "{\"stream\":\"%s\",\"data\":%s}", name, payload);
+    for (size_t i = 0; i < count; i++) {
+        AsyncWebSocketClient* client = _ws.client(recipients[i]);
+        // Telemetry is dropped, not queued, for a client that cannot keep up.
+        if (client != nullptr && client->canSend())
+            client->text(message);
+    }
 }
 
+// --- Utility Functions ---
+void AsyncApiExchange::send(int status, const char* contentType, const char* body)
+{
+    _request->send(status, contentType, body);
+}
 
-
-void WebServer::_handleGetNetworkInfo(AsyncWebServerRequest* request)
+void AsyncApiExchange::sendJson(int status, const JsonDocument& doc, bool compressible)
 {
-    JsonDocument doc;
-    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        doc["ssid"]       = WiFi.SSID();
-        doc["ipAddress"]  = WiFi.localIP().toString();
-        doc["macAddress"] = WiFi.macAddress();
-        doc["rssi"]       = WiFi.RSSI();
-        doc["connected"]  = (WiFi.status() == WL_CONNECTED);
-        doc["uptime"]     = _deviceState.uptime_s;
-        xSemaphoreGive(_mutex);
-    } else {
-        request->send(503, "application/json", "{\"error\":\"Could not acquire state lock\"}");
+    String body;
+    serializeJson(doc, body);
+    const AsyncWebHeader* acceptEncoding = _request->getHeader("Accept-Encoding");
+    if (!compressible || body.length() < GZIP_MIN_RESPONSE_SIZE || acceptEncoding == nullptr
+      || acceptEncoding->value().indexOf("gzip") < 0) {
+        _request->send(status, "application/json", body);
         return;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
-}
 
-void WebServer::_handleGetSystemLogs(AsyncWebServerRequest* request)
-{
-    // This is a placeholder. A real implementation would require a logging buffer.
-    JsonDocument doc;
-    JsonArray logs        = doc.to<JsonArray>();
-    JsonObject logEntry   = logs.add<JsonObject>();
-    logEntry["timestamp"] = time(nullptr);
-    logEntry["level"]     = "INFO";
-    logEntry["message"]   = "Device started successfully";
-    logEntry["component"] = "SYSTEM";
+    // The body and the encoder (~6 KB) live as long as the response, which is sent after this handler returns.
+    struct GzipResponse {
+        String body;
+        GzipStream stream;
+        GzipResponse(String& source) : body(std::move(source)), stream((const uint8_t*)body.c_str(), body.length()) {}
+    };
+    std::shared_ptr<GzipResponse> state(new (std::nothrow) GzipResponse(body));
+    if (!state) {
+        _request->send(status, "application/json", body);
+        return;
+    }
 
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    AsyncWebServerResponse* response =
+      _request->beginChunkedResponse("application/json", [state](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+          int64_t start = esp_timer_get_time();
+          size_t len    = state->stream.read(buffer, maxLen);
+          // Over budget: fewer match candidates per position for the rest of the response, down to literals only.
+          if (esp_timer_get_time() - start > GZIP_CHUNK_BUDGET_US && state->stream.getMaxChain() > 0)
+              state->stream.setMaxChain(state->stream.getMaxChain() / 2);
+          if (len == 0)
+              ESP_LOGD(TAG, "Compressed %u bytes into %u.", (unsigned)state->body.length(), (unsigned)index);
+          return len;
+      });
+    response->setCode(status);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("Vary", "Accept-Encoding");
+    _request->send(response);
 }
 
-void WebServer::_handleGetFeedingLogs(AsyncWebServerRequest* request)
+void AsyncApiExchange::sendFile(const char* path, const char* contentType, bool download)
 {
-    // This is an alias for /feeding/history
-    _handleGetFeedingHistory(request);
+    _request->send(_request->beginResponse(storage, path, contentType, download));
 }
 
-
-// --- Utility Functions ---
 void WebServer::_handleNotFound(AsyncWebServerRequest* request)
 {
     // If the request is for an API endpoint, return 404 JSON. Otherwise, let the SPA handle it.
@@ -1122,12 +1136,12 @@ void WebServer::_handleNotFound(AsyncWebServerRequest* request)
     } else {
         // For any other path, serve the index.html. The Vue router will handle the client-side routing.
         String pathWithGz = "/index.html.gz";
-        if (SPIFFS.exists(pathWithGz)) {
-            AsyncWebServerResponse* response = request->beginResponse(SPIFFS, pathWithGz, "text/html");
+        if (storage.exists(pathWithGz)) {
+            AsyncWebServerResponse* response = request->beginResponse(storage, pathWithGz, "text/html");
             response->addHeader("Content-Encoding", "gzip");
             request->send(response);
         } else {
-            request->send(SPIFFS, "/index.html", "text/html");
+            request->send(storage, "/index.html", "text/html");
         }
     }
 }
@@ -1154,27 +1168,69 @@ void WebServer::_onUpdate(AsyncWebServerRequest* request, String filename, size_
     }
 }
 
+WebServer::BodySlot* WebServer::_claimBodySlot(const AsyncWebServerRequest* request)
+{
+    uint32_t now    = millis();
+    BodySlot* taken = nullptr;
+    for (auto& slot : _bodySlots) {
+        // A slot still held under this address belonged to a dropped request whose memory was reused
+        if (slot.owner == request || slot.owner == nullptr || now - slot.touchedMs >= HTTP_BODY_STALE_MS) {
+            taken = &slot;
+            if (slot.owner == request)
+                break;
+        }
+    }
+    if (taken != nullptr) {
+        taken->owner     = request;
+        taken->touchedMs = now;
+    }
+    return taken;
+}
+
+WebServer::BodySlot* WebServer::_findBodySlot(const AsyncWebServerRequest* request)
+{
+    for (auto& slot : _bodySlots) {
+        if (slot.owner == request)
+            return &slot;
+    }
+    return nullptr;
+}
+
 void WebServer::_handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total,
   std::function<void(AsyncWebServerRequest*, JsonDocument&)> handler)
 {
+    BodySlot* slot;
     if (index == 0) {
-        request->_tempObject = malloc(total);
-        if (!request->_tempObject) {
-            request->send(500, "application/json", "{\"error\":\"Not enough memory\"}");
+        if (!_admitRequest(request))
+            return;
+        if (total > HTTP_BODY_SLOT_SIZE) {
+            _bodyRefusedCount++;
+            request->send(413, "application/json", "{\"error\":\"Body too large\"}");
+            return;
+        }
+        slot = _claimBodySlot(request);
+        if (slot == nullptr) {
+            _bodyRefusedCount++;
+            _sendRetryLater(request, 503, "{\"error\":\"Server busy, retry later\"}", HTTP_RETRY_BUSY_S);
             return;
         }
+    } else {
+        slot = _findBodySlot(request);
+        if (slot == nullptr)
+            return; // refused on its first chunk, already answered
     }
 
-    if (request->_tempObject) {
-        memcpy((char*)request->_tempObject + index, data, len);
+    if (index + len > HTTP_BODY_SLOT_SIZE) {
+        slot->owner = nullptr;
+        return;
     }
+    memcpy(slot->data + index, data, len);
+    slot->touchedMs = millis();
 
     if (index + len == total) {
-        char* body = (char*)request->_tempObject;
         JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, body, total);
-        free(request->_tempObject);
-        request->_tempObject = nullptr;
+        DeserializationError error = deserializeJson(doc, (const char*)slot->data, total);
+        slot->owner = nullptr;
 
         if (error) {
             request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
@@ -8,31 +8,47 @@
 #include "ConfigManager.hpp"
 #include "TimeKeeping.hpp"
 #include "board_pinout.h"
+#include "I2CManager.hpp"
 #include "TankManager.hpp"
 #include "HX711Scale.hpp"
 #include "RecipeProcessor.hpp"
 #include "EPaperDisplay.hpp"
 #include "SafetySystem.hpp"
 #include "WebServer.hpp"
-#include <SPIFFS.h>
+#include "Storage.hpp"
+#include "TaskJitter.hpp"
+#include "HeapGuard.hpp"
 #include "Battery.h"
 #include "test.h" // Include the new test header
 
 // --- Global Objects ---
 ConfigManager configManager("KibbleT5");
 TimeKeeping timeKeeping(globalDeviceState, xDeviceStateMutex, configManager);
-TankManager tankManager(globalDeviceState, xDeviceStateMutex);
+I2CManager i2cManager(Wire);
+TankManager tankManager(globalDeviceState, xDeviceStateMutex, i2cManager);
 HX711Scale scale(globalDeviceState, xDeviceStateMutex, configManager);
+ScaleTrace scaleTrace(storage);
 RecipeProcessor recipeProcessor(globalDeviceState, xDeviceStateMutex, configManager, tankManager, scale);
 EPaperDisplay display(globalDeviceState, xDeviceStateMutex);
 SafetySystem safetySystem(globalDeviceState, xDeviceStateMutex, tankManager);
 WebServer webServer(globalDeviceState, xDeviceStateMutex, configManager, recipeProcessor, tankManager, scale, display);
-Battery battMon(3000, 4200, BATT_HALFV_PIN);
+Battery battMon(3000, 4200, BATT_HALFV_PIN, 12);
 
 
 static const char* TAG    = "main";
 static const char* OTATAG = "OTA update";
 
+static JitterProbe feedingJitter("feeding");
+static JitterProbe battJitter("battAndOTA");
+
+// Task stacks are static, so that the heap only holds what the tasks allocate.
+#define BATT_TASK_STACK_SIZE    (3192)
+#define FEEDING_TASK_STACK_SIZE (4096)
+static StackType_t battTaskStack[BATT_TASK_STACK_SIZE];
+static StaticTask_t battTaskBuffer;
+static StackType_t feedingTaskStack[FEEDING_TASK_STACK_SIZE];
+static StaticTask_t feedingTaskBuffer;
+
 // Serial console state machine for multi-step commands
 enum class SerialCmdState : uint8_t
 {
@@ -44,7 +60,7 @@ static SerialCmdState serialCmdState = SerialCmdState::IDLE;
 #if !defined(DEBUG_MENU_ENABLED) && defined(LOG_TO_FILE_ENABLED)
 #define LOG_TO_SPIFFS
 #elif defined(DEBUG_MENU_ENABLED)
-static void printSPIFFSTree(fs::FS& fs, const char* path, uint8_t depth = 0);
+static void printFSTree(fs::FS& fs, const char* path, uint8_t depth = 0);
 #endif
 
 // --- Prototypes for RTOS Tasks ---
@@ -55,7 +71,7 @@ void battAndOTA_Task(void* pvParameters);
 
 #include "RollingLog.hpp"
 #define MAX_SPIFFS_LOG_SIZE (262144UL)
-static RollingLog _spiffsLog(SPIFFS, "/log.txt", 64 * 1024);
+static RollingLog _spiffsLog(storage, "/log.txt", 64 * 1024);
 static bool open_spiffs_log();
 static int log_to_spiff(const char*, va_list);
 
@@ -64,16 +80,16 @@ static int log_to_spiff(const char*, va_list);
 void setup()
 {
 
-    if (!SPIFFS.begin()) {
-        ESP_LOGE(TAG, "Fatal: Could not initialize SPIFFS partition.");
+    // Mounts LittleFS, migrating a SPIFFS data partition on the first boot after the update
+    if (!storage.begin()) {
+        ESP_LOGE(TAG, "Fatal: Could not mount the data partition.");
         return;
     } else {
-        ESP_LOGI(TAG, "SPIFFS partition mounted.");
-        File root = SPIFFS.open("/");
+        File root = storage.open("/");
         File file = root.openNextFile();
-        ESP_LOGI(TAG, "Listing files in SPIFFS:");
+        ESP_LOGI(TAG, "Listing files in the data partition:");
         while (file) {
-            ESP_LOGI(TAG, "  FILE: %s, SIZE: %d", file.name(), file.size());
+            ESP_LOGI(TAG, "  FILE: %s, SIZE: %d", file.path(), file.size());
             file = root.openNextFile();
         }
     }
@@ -92,10 +108,10 @@ void setup()
         esp_log_set_vprintf(log_to_spiff);
         esp_log_level_set("*", esp_log_level_t::ESP_LOG_WARN);
         vTaskDelay(pdMS_TO_TICKS(50));
-        Serial.println("Redirected ESP_LOG to SPIFFS file.");
+        Serial.println("Redirected ESP_LOG to the log file.");
     } else {
-        // Fallback to default Serial output if SPIFFS fails.
-        Serial.print("Failed to initialize SPIFFS logging. Using Serial output.\r\n");
+        // Fallback to default Serial output if the log file fails.
+        Serial.print("Failed to initialize file logging. Using Serial output.\r\n");
         Serial.setDebugOutput(true);
     }
 #else
@@ -124,14 +140,27 @@ void setup()
     // Initialize hardware before running tests
     uint16_t hopper_closed, hopper_open;
     configManager.loadHopperCalibration(hopper_closed, hopper_open);
-    tankManager.begin(hopper_closed, hopper_open);
+    uint32_t swimuxBauds = configManager.loadSwiMuxBaudRate();
+    if (!i2cManager.begin())
+        ESP_LOGE(TAG, "I2C manager failed to start, servo commands will block their callers.");
+    tankManager.begin(hopper_closed, hopper_open, swimuxBauds);
+    // Only a rate that passed the link test is remembered; otherwise the next boot probes again.
+    uint32_t negotiatedBauds = tankManager.getSwiMuxBaudRate() > SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS ? tankManager.getSwiMuxBaudRate() : 0;
+    if (negotiatedBauds != swimuxBauds)
+        configManager.saveSwiMuxBaudRate(negotiatedBauds);
     scale.begin(HX711_DATA_PIN, HX711_CLOCK_PIN);
+    if (scaleTrace.begin())
+        scale.setTrace(&scaleTrace);
+    tankManager.setOnServoCommandCallback([](const ServoActuation& actuation) {
+        scale.notifyActuation(actuation.blankingMs);
+        scaleTrace.recordServo(actuation.servoNum, actuation.pwm);
+    });
 
 #ifdef DEBUG_MENU_ENABLED
     // --- RUN DIAGNOSTIC AND TEST CLI ---
-    Serial.print("\r\n=== Content of the SPIFFS partition ===\r\n");
-    printSPIFFSTree(SPIFFS, "/");
-    Serial.print("\r\n===end of SPIFFS content enumeration ===\r\n");
+    Serial.printf("\r\n=== Content of the data partition (%s) ===\r\n", Storage::getBackendName(storage.getBackend()));
+    printFSTree(storage, "/");
+    Serial.print("\r\n===end of data partition content enumeration ===\r\n");
     doDebugTest(tankManager, scale);
 #endif
 
@@ -165,7 +194,7 @@ void setup()
         ArduinoOTA.begin();
         ESP_LOGI(TAG, "ArduinoOTA initialized on port 3232");
 
-        xTaskCreate(battAndOTA_Task, "Batt monitor", 3192, &battMon, 10, NULL);
+        xTaskCreateStatic(battAndOTA_Task, "Batt monitor", BATT_TASK_STACK_SIZE, &battMon, 10, battTaskStack, &battTaskBuffer);
 
 
         webServer.startAPIServer(); // 1
@@ -176,10 +205,12 @@ void setup()
         tankManager.startTask(); // 6
         recipeProcessor.begin(); // 3
         display.startTask(); // 7
-        xTaskCreate(feedingTask, "Feeding Task", 4096, &recipeProcessor, 10, NULL);
+        xTaskCreateStatic(
+          feedingTask, "Feeding Task", FEEDING_TASK_STACK_SIZE, &recipeProcessor, 10, feedingTaskStack, &feedingTaskBuffer);
 
 
         ESP_LOGI(TAG, "--- Setup Complete, System Operational ---");
+        HeapGuard::arm();
     } else {
         ESP_LOGE(TAG, "Fatal: WiFi could not be configured. Halting.");
         display.showError("WiFi Failed", "Halting system.");
@@ -315,7 +346,7 @@ void battAndOTA_Task(void* pvParameters)
     }
 
     Battery* pBatt = (Battery*)pvParameters;
-    pBatt->begin(3300, 0.5f, asigmoidal);
+    pBatt->begin(3300, 2.0f, asigmoidal); // Half-voltage divider
     uint16_t voltage;
 
     for (;;) {
@@ -334,7 +365,9 @@ void battAndOTA_Task(void* pvParameters)
 #endif
         }
 
+        battJitter.sleeping(pdMS_TO_TICKS(OTA_POLL_PERIOD_MS));
         vTaskDelay(pdMS_TO_TICKS(OTA_POLL_PERIOD_MS));
+        battJitter.woke();
     }
 }
 
@@ -342,13 +375,16 @@ void feedingTask(void* pvParameters)
 {
     RecipeProcessor* processor = (RecipeProcessor*)pvParameters;
     ESP_LOGI(TAG, "Feeding Task Started.");
+    HeapGuard::watchCurrentTask();
 
     for (;;) {
         FeedCommand command = {};
         bool commandPresent = false;
+        bool busy           = processor->isBusy();
 
         if (xSemaphoreTake(xDeviceStateMutex, portMAX_DELAY) == pdTRUE) {
-            if (!globalDeviceState.feedCommand.processed) {
+            // While an operation runs, only a stop is taken: other commands wait for it to end
+            if (!globalDeviceState.feedCommand.processed && (!busy || globalDeviceState.feedCommand.type == FeedCommandType::EMERGENCY_STOP)) {
                 command                                 = globalDeviceState.feedCommand;
                 globalDeviceState.feedCommand.processed = true;
                 commandPresent                          = true;
@@ -356,24 +392,33 @@ void feedingTask(void* pvParameters)
             xSemaphoreGive(xDeviceStateMutex);
         }
 
-        if (commandPresent) {
+        if (commandPresent && busy) {
+            ESP_LOGW(TAG, "Stop requested during operation.");
+            processor->requestStop();
+        } else if (commandPresent) {
             bool success = false;
             ESP_LOGI(TAG, "Processing new command: %d", (int)command.type);
 
             if (xSemaphoreTake(xDeviceStateMutex, portMAX_DELAY) == pdTRUE) {
-                globalDeviceState.currentFeedingStatus = "Processing...";
+                // A density calibration runs the auger into a full hopper on purpose, see SafetySystem
+                globalDeviceState.currentFeedingStatus =
+                  command.type == FeedCommandType::CALIBRATE_DENSITY ? "Calibrating..." : "Processing...";
                 xSemaphoreGive(xDeviceStateMutex);
             }
 
             switch (command.type) {
                 case FeedCommandType::IMMEDIATE:
-                    success = processor->executeImmediateFeed(command.tankUid, command.amountGrams);
+                    success = processor->startImmediateFeed(command.tankUid, command.amountGrams);
                     break;
                 case FeedCommandType::RECIPE:
-                    success = processor->executeRecipeFeed(command.recipeUid, command.servings);
+                    success = processor->startRecipeFeed(command.recipeUid, command.servings);
+                    break;
+                case FeedCommandType::CALIBRATE_DENSITY:
+                    success = processor->startDensityCalibration(command.tankUid);
                     break;
                 case FeedCommandType::TARE_SCALE:
-                    processor->getScale().tare();
+                    processor->getScale().tare(ScaleChannel::HOPPER);
+                    processor->getScale().tare(ScaleChannel::BOWL);
                     success = true;
                     break;
                 case FeedCommandType::EMERGENCY_STOP:
@@ -385,19 +430,50 @@ void feedingTask(void* pvParameters)
                     break;
             }
 
-            if (xSemaphoreTake(xDeviceStateMutex, portMAX_DELAY) == pdTRUE) {
+            if (processor->isBusy()) {
+                // Record the raw stream of this feed if a capture was armed
+                scaleTrace.start();
+            } else if (xSemaphoreTake(xDeviceStateMutex, portMAX_DELAY) == pdTRUE) {
                 globalDeviceState.currentFeedingStatus = success ? "Idle" : "Error";
-                if (!success) {
-                    // Keep the error message that was set by the processor
-                } else {
+                if (success)
                     globalDeviceState.lastEvent = DeviceEvent_e::DEVEVENT_NONE;
+                // Keep the error message that was set by the processor otherwise
+                if (globalDeviceState.feedCommand.processed)
+                    globalDeviceState.feedCommand.type = FeedCommandType::NONE;
+                xSemaphoreGive(xDeviceStateMutex);
+            }
+        } else if (!busy) {
+            // Idle: stage the next scheduled meal, or serve it
+            processor->serviceStaging(time(nullptr));
+        }
+
+        busy = processor->isBusy();
+        if (busy) {
+            // Hand the hopper samples the processor asked for over, then advance it
+            float grams;
+            if (processor->getScale().takeRequestedSample(ScaleChannel::HOPPER, grams))
+                processor->onWeightSample(ScaleChannel::HOPPER, grams);
+            processor->tick(xTaskGetTickCount());
+
+            if (!processor->isBusy()) {
+                bool success = processor->lastOperationSucceeded();
+                scaleTrace.stop();
+                if (xSemaphoreTake(xDeviceStateMutex, portMAX_DELAY) == pdTRUE) {
+                    globalDeviceState.currentFeedingStatus = success ? "Idle" : "Error";
+                    if (success)
+                        globalDeviceState.lastEvent = DeviceEvent_e::DEVEVENT_NONE;
+                    if (globalDeviceState.feedCommand.processed)
+                        globalDeviceState.feedCommand.type = FeedCommandType::NONE;
+                    xSemaphoreGive(xDeviceStateMutex);
                 }
-                globalDeviceState.feedCommand.type = FeedCommandType::NONE;
+                busy = false;
             }
-            xSemaphoreGive(xDeviceStateMutex);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(200));
+        TickType_t delay = pdMS_TO_TICKS(busy ? DISPENSING_TICK_MS : 200);
+        feedingJitter.sleeping(delay);
+        vTaskDelay(delay);
+        feedingJitter.woke();
     }
 }
 
@@ -408,7 +484,7 @@ static void printIndent(uint8_t depth)
         Serial.print("  "); // two spaces per level
 }
 
-static void printSPIFFSTree(fs::FS& fs, const char* path, uint8_t depth)
+static void printFSTree(fs::FS& fs, const char* path, uint8_t depth)
 {
     File dir = fs.open(path);
     if (!dir) {
@@ -423,13 +499,13 @@ static void printSPIFFSTree(fs::FS& fs, const char* path, uint8_t depth)
 
     File file = dir.openNextFile();
     while (file) {
-        // name() returns the full path (e.g. /folder/file.txt)
+        // name() is the last path component, path() the full path (e.g. /folder/file.txt)
         const char* name = file.name();
         if (file.isDirectory()) {
             printIndent(depth);
             Serial.printf("└─ %s/\n", name);
             // recurse into subdirectory
-            printSPIFFSTree(fs, name, depth + 1);
+            printFSTree(fs, file.path(), depth + 1);
         } else {
             printIndent(depth);
             Serial.printf("└─ %s\t%u bytes\n", name, (unsigned int)file.size());
@@ -446,10 +522,10 @@ bool open_spiffs_log()
 {
 
     if (_spiffsLog.begin(true)) {
-        ESP_LOGI(TAG, "SPIFFS log.txt opened successfully.");
+        ESP_LOGI(TAG, "log.txt opened successfully.");
         return true;
     } else {
-        ESP_LOGE(TAG, "Failed to open SPIFFS log.txt.");
+        ESP_LOGE(TAG, "Failed to open log.txt.");
     }
     return false;
 }
@@ -714,6 +714,9 @@ void swiMuxMenu(TankManager& tankManager)
         Serial.println("10. Format memory");
         Serial.println("11. Check memory's ECC");
         Serial.println("12. Test ReedSolomon class");
+        Serial.println("13. Negotiate link speed");
+        Serial.println("14. Show round-trip statistics");
+        Serial.println("15. Scrub a tank's EEPROM");
         Serial.println("99. Back to Main Menu");
         Serial.print("Enter choice: ");
 
@@ -920,6 +923,39 @@ void swiMuxMenu(TankManager& tankManager)
             case 12:
                 testReedSolomon();
                 break;
+            case 13:
+                {
+                    SwiMuxSerialResult_e res = tankManager._swiMux.negotiateBaudRate();
+                    Serial.printf("\r\nLink running at %u bauds (%s).\r\n", tankManager._swiMux.getBaudRate(), SwiMuxSerial_t::getSwiMuxErrorString(res));
+                }
+                break;
+            case 14:
+                {
+                    static const char* const slotNames[SMRTT_COUNT] = { "getUid", "rollCall", "read", "write" };
+                    Serial.printf("\r\nLink at %u bauds.\r\n", tankManager._swiMux.getBaudRate());
+                    for (uint8_t slot = 0; slot < SMRTT_COUNT; slot++) {
+                        const SwiMuxRttEstimator_t& rtt = tankManager._swiMux.getRttEstimator((SwiMuxRttSlot_e)slot);
+                        Serial.printf("%-9s srtt=%6.1fms rttvar=%6.1fms samples=%u timeouts=%u backoff=%u\r\n", slotNames[slot], rtt.srttMs,
+                          rtt.rttvarMs, rtt.samples, rtt.timeouts, rtt.backoff);
+                    }
+                }
+                break;
+            case 15:
+                {
+                    Serial.print("Enter bus index (0-5): ");
+                    flushSerialInputBuffer();
+                    while (!Serial.available()) {
+                        vTaskDelay(pdMS_TO_TICKS(50));
+                    }
+                    int busIndex = readSerialInt();
+                    Serial.println(busIndex);
+                    SwiMuxSerialResult_e res = tankManager.scrubTank((uint8_t)busIndex);
+                    TankScrubStats stats     = tankManager.getScrubStats((uint8_t)busIndex);
+                    Serial.printf("\r\nScrub: %s. Passes=%u corrected=%u rewritten=%u uncorrectable=%u readFailures=%u\r\n",
+                      SwiMuxSerial_t::getSwiMuxErrorString(res), stats.scrubs, stats.correctedBytes, stats.rowsRewritten, stats.uncorrectable,
+                      stats.readFailures);
+                }
+                break;
             case 99:
                 testing = false;
                 break;
@@ -932,9 +968,9 @@ void swiMuxMenu(TankManager& tankManager)
     }
 }
 
-void runCalibrationSequence(HX711Scale& scale)
+void runCalibrationSequence(HX711Scale& scale, ScaleChannel channel)
 {
-    Serial.println("\n--- 10g Calibration Sequence ---");
+    Serial.printf("\n--- 10g Calibration Sequence (%s) ---\n", HX711Scale::getChannelName(channel));
     Serial.println("Step 1: Please remove all weight from the scale.");
     Serial.println("Press any key to continue...");
     flushSerialInputBuffer();
@@ -944,8 +980,8 @@ void runCalibrationSequence(HX711Scale& scale)
     flushSerialInputBuffer();
 
     Serial.println("Taring scale... please wait.");
-    scale.tare();
-    Serial.printf("Tare complete. New offset: %ld\n", scale.getZeroOffset());
+    scale.tare(channel);
+    Serial.printf("Tare complete. New offset: %ld\n", scale.getZeroOffset(channel));
 
     Serial.println("\nStep 2: Place a known 10 gram weight on the scale.");
     Serial.println("Press any key when ready...");
@@ -956,7 +992,7 @@ void runCalibrationSequence(HX711Scale& scale)
     flushSerialInputBuffer();
 
     Serial.println("Calibrating...");
-    float newFactor = scale.calibrateWithKnownWeight(10.0f);
+    float newFactor = scale.calibrateWithKnownWeight(10.0f, channel);
     Serial.printf("Calibration complete. New factor: %.4f\n", newFactor);
     Serial.println("Calibration parameters are now active but NOT SAVED.");
     Serial.println("Use the 'Save Calibration' option to persist them.");
@@ -964,13 +1000,15 @@ void runCalibrationSequence(HX711Scale& scale)
 
 void scaleTestMenu(HX711Scale& scale)
 {
-    bool testing = true;
+    bool testing         = true;
+    ScaleChannel channel = ScaleChannel::HOPPER;
     while (testing) {
-        Serial.println("\n--- Scale (HX711) Test Menu ---");
+        Serial.printf("\n--- Scale (HX711) Test Menu [%s channel] ---\n", HX711Scale::getChannelName(channel));
         Serial.println("1. Monitor Scale (Plotter Mode)");
         Serial.println("2. Tare Scale");
         Serial.println("3. Run 10g Calibration Sequence");
         Serial.println("4. Save Calibration to NVS");
+        Serial.println("5. Switch Channel (Hopper/Bowl)");
         Serial.println("q. Back to Main Menu");
         Serial.print("Enter choice: ");
 
@@ -1000,8 +1038,8 @@ void scaleTestMenu(HX711Scale& scale)
                     flushSerialInputBuffer();
 
                     while (!Serial.available()) {
-                        long raw     = scale.getRawReading();
-                        float weight = scale.getWeight();
+                        long raw     = scale.getRawReading(channel);
+                        float weight = scale.getWeight(channel);
 
                         sum -= samples[sampleIndex];
                         samples[sampleIndex] = raw;
@@ -1020,18 +1058,22 @@ void scaleTestMenu(HX711Scale& scale)
                 }
             case '2':
                 Serial.println("Taring scale... please wait.");
-                scale.tare();
-                Serial.printf("Tare complete. New offset: %ld\n", scale.getZeroOffset());
+                scale.tare(channel);
+                Serial.printf("Tare complete. New offset: %ld\n", scale.getZeroOffset(channel));
                 Serial.println("Note: This tare is temporary. Save to make it permanent.");
                 break;
             case '3':
-                runCalibrationSequence(scale);
+                runCalibrationSequence(scale, channel);
                 break;
             case '4':
                 Serial.println("Saving current calibration factor and offset to NVS...");
                 scale.saveCalibration();
                 Serial.println("Save complete.");
                 break;
+            case '5':
+                channel = (channel == ScaleChannel::HOPPER) ? ScaleChannel::BOWL : ScaleChannel::HOPPER;
+                Serial.printf("Now using the %s channel.\n", HX711Scale::getChannelName(channel));
+                break;
             case 'q':
                 [[fallthrough]];
             case 'Q':
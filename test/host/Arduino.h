@@ -0,0 +1,47 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * @file Arduino.h
+ * @brief Host stand-in of the Arduino core, for the native test environments.
+ *
+ * Only what the units under test use. Time runs on the host's monotonic clock.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#define _NOP() do {} while (0)
+
+inline unsigned long hostMicros()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis() { return hostMicros() / 1000; }
+inline unsigned long micros() { return hostMicros(); }
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+/** @brief IPv4 address, stored as the Arduino core does (first octet in the low byte). */
+class IPAddress {
+  public:
+    IPAddress() : _address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    operator uint32_t() const { return _address; }
+
+  private:
+    uint32_t _address;
+};
+
+#include "HardwareSerial.h"
+#include "WString.h"
+
+#endif // HOST_ARDUINO_H
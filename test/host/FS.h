@@ -0,0 +1,212 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+/**
+ * @file FS.h
+ * @brief Host stand-in of the Arduino filesystem, on in-memory volumes.
+ *
+ * A volume is a map of paths to contents. An FS reaches the volume mounted at the mount point
+ * of its FSImpl, as the VFS of the core does; with no mount point, no file ever opens. Writes
+ * go straight to the volume, as they would to flash, so a power loss keeps what was written.
+ */
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+/** @brief Files of one volume by absolute path; directories are implied by the paths. */
+struct HostVolume {
+    std::map<std::string, std::vector<uint8_t>> files;
+    /** @brief Called before each file write with its length: returns false to fail it, or throws to cut the power. */
+    std::function<bool(size_t)> onWrite;
+
+    size_t usedBytes() const
+    {
+        size_t used = 0;
+        for (const auto& file : files)
+            used += file.first.size() + file.second.size();
+        return used;
+    }
+};
+
+/** @brief Mount table of the VFS: mount point to volume. */
+inline std::map<std::string, HostVolume*>& hostMounts()
+{
+    static std::map<std::string, HostVolume*> mounts;
+    return mounts;
+}
+
+class File {
+  public:
+    File() : _volume(nullptr), _isDir(false), _write(false), _position(0), _next(0) {}
+    File(HostVolume* volume, const std::string& path, bool isDir, bool write)
+        : _volume(volume), _path(path), _isDir(isDir), _write(write), _position(0), _next(0)
+    {}
+
+    explicit operator bool() const { return _volume != nullptr; }
+    const char* path() const { return _path.c_str(); }
+    bool isDirectory() const { return _isDir; }
+
+    size_t size() const
+    {
+        const std::vector<uint8_t>* content = _content();
+        return content ? content->size() : 0;
+    }
+
+    size_t write(const uint8_t* buf, size_t len)
+    {
+        std::vector<uint8_t>* content = _content();
+        if (content == nullptr || !_write || (_volume->onWrite && !_volume->onWrite(len)))
+            return 0;
+        content->insert(content->end(), buf, buf + len);
+        return len;
+    }
+
+    size_t read(uint8_t* buf, size_t len)
+    {
+        const std::vector<uint8_t>* content = _content();
+        if (content == nullptr || _position >= content->size())
+            return 0;
+        if (len > content->size() - _position)
+            len = content->size() - _position;
+        memcpy(buf, content->data() + _position, len);
+        _position += len;
+        return len;
+    }
+
+    /** @brief Next entry of a directory: its files, and one entry per subdirectory. */
+    File openNextFile()
+    {
+        if (_volume == nullptr || !_isDir)
+            return File();
+        std::string prefix = _path == "/" ? "/" : _path + "/";
+        std::vector<std::string> entries;
+        for (const auto& file : _volume->files) {
+            if (file.first.compare(0, prefix.size(), prefix) != 0)
+                continue;
+            size_t slash      = file.first.find('/', prefix.size());
+            std::string entry = slash == std::string::npos ? file.first : file.first.substr(0, slash);
+            if (entries.empty() || entries.back() != entry)
+                entries.push_back(entry);
+        }
+        if (_next >= entries.size())
+            return File();
+        const std::string& entry = entries[_next++];
+        return File(_volume, entry, _volume->files.count(entry) == 0, false);
+    }
+
+    void flush() {}
+    void close() { _volume = nullptr; }
+
+  private:
+    HostVolume* _volume;
+    std::string _path;
+    bool _isDir;
+    bool _write;
+    size_t _position;
+    size_t _next;
+
+    std::vector<uint8_t>* _content() const
+    {
+        if (_volume == nullptr || _isDir)
+            return nullptr;
+        auto it = _volume->files.find(_path);
+        return it == _volume->files.end() ? nullptr : &it->second;
+    }
+};
+
+class FSImpl {
+  public:
+    virtual ~FSImpl() {}
+    void mountpoint(const char* mp) { _mountpoint = mp ? mp : ""; }
+    const char* mountpoint() const { return _mountpoint.c_str(); }
+
+  private:
+    std::string _mountpoint;
+};
+
+typedef std::shared_ptr<FSImpl> FSImplPtr;
+
+class FS {
+  public:
+    FS() : _impl(std::make_shared<FSImpl>()) {}
+    explicit FS(FSImplPtr impl) : _impl(impl) {}
+    virtual ~FS() {}
+
+    File open(const char* path, const char* mode = FILE_READ, bool create = false)
+    {
+        (void)create;
+        HostVolume* volume = _volume();
+        if (volume == nullptr || path == nullptr || path[0] != '/')
+            return File();
+        std::string name = path;
+        if (name.size() > 1 && name.back() == '/')
+            name.pop_back();
+        bool write = mode[0] != 'r';
+        if (mode[0] == 'w')
+            volume->files[name].clear();
+        else if (mode[0] == 'a')
+            volume->files[name];
+        if (volume->files.count(name))
+            return File(volume, name, false, write);
+        return _isDirectory(volume, name) ? File(volume, name, true, false) : File();
+    }
+    File open(const String& path, const char* mode = FILE_READ, bool create = false) { return open(path.c_str(), mode, create); }
+
+    bool exists(const char* path)
+    {
+        HostVolume* volume = _volume();
+        return volume != nullptr && (volume->files.count(path) || _isDirectory(volume, path));
+    }
+
+    bool remove(const char* path)
+    {
+        HostVolume* volume = _volume();
+        return volume != nullptr && volume->files.erase(path) == 1;
+    }
+
+    bool rename(const char* from, const char* to)
+    {
+        HostVolume* volume = _volume();
+        if (volume == nullptr || volume->files.count(from) == 0)
+            return false;
+        volume->files[to] = volume->files[from];
+        volume->files.erase(from);
+        return true;
+    }
+
+  protected:
+    FSImplPtr _impl;
+
+  private:
+    HostVolume* _volume() const
+    {
+        auto it = hostMounts().find(_impl->mountpoint());
+        return it == hostMounts().end() ? nullptr : it->second;
+    }
+
+    static bool _isDirectory(const HostVolume* volume, const std::string& path)
+    {
+        if (path == "/")
+            return true;
+        std::string prefix = path + "/";
+        auto it            = volume->files.lower_bound(prefix);
+        return it != volume->files.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+    }
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif // HOST_FS_H
@@ -0,0 +1,121 @@
+#ifndef HOST_HARDWARESERIAL_H
+#define HOST_HARDWARESERIAL_H
+
+/**
+ * @file HardwareSerial.h
+ * @brief Host stand-in of the ESP32 UART driver, on a file descriptor (typically a pty).
+ *
+ * The line rate is applied to the descriptor's termios, so that the peer of a pty can see which
+ * rate the firmware selected. Copies share the descriptor, which the stand-in never closes.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+
+enum SerialConfig : uint32_t {
+    SERIAL_8N1 = 0x800001c,
+};
+
+class Stream {
+  public:
+    virtual ~Stream() {}
+    virtual int available()        = 0;
+    virtual int read()             = 0;
+    virtual size_t write(uint8_t)  = 0;
+    size_t print(const char* str)
+    {
+        size_t n = 0;
+        while (str && *str)
+            n += write((uint8_t)*str++);
+        return n;
+    }
+};
+
+class HardwareSerial : public Stream {
+  public:
+    explicit HardwareSerial(int uartNum) : _uartNum(uartNum), _fd(-1), _bauds(0) {}
+
+    /** @brief Host only: routes the UART to @p fd. */
+    void attach(int fd) { _fd = fd; }
+
+    void begin(unsigned long bauds, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1)
+    {
+        (void)config;
+        (void)rxPin;
+        (void)txPin;
+        updateBaudRate(bauds);
+    }
+
+    void updateBaudRate(unsigned long bauds)
+    {
+        _bauds = bauds;
+        struct termios tio;
+        if (_fd < 0 || tcgetattr(_fd, &tio) != 0)
+            return;
+        cfmakeraw(&tio);
+        speed_t speed = toSpeed(bauds);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tcsetattr(_fd, TCSANOW, &tio);
+    }
+
+    unsigned long baudRate() const { return _bauds; }
+
+    int available() override
+    {
+        struct pollfd pfd = { _fd, POLLIN, 0 };
+        return (_fd >= 0 && poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) ? 1 : 0;
+    }
+
+    int read() override
+    {
+        uint8_t b;
+        if (!available() || ::read(_fd, &b, 1) != 1)
+            return -1;
+        return b;
+    }
+
+    size_t write(uint8_t b) override { return (_fd >= 0 && ::write(_fd, &b, 1) == 1) ? 1 : 0; }
+
+    void flush()
+    {
+        if (_fd >= 0)
+            tcdrain(_fd);
+    }
+
+    static speed_t toSpeed(unsigned long bauds)
+    {
+        switch (bauds) {
+            case 115200: return B115200;
+            case 230400: return B230400;
+            case 460800: return B460800;
+            case 921600: return B921600;
+            default:     return B57600;
+        }
+    }
+
+    static unsigned long fromSpeed(speed_t speed)
+    {
+        switch (speed) {
+            case B115200: return 115200;
+            case B230400: return 230400;
+            case B460800: return 460800;
+            case B921600: return 921600;
+            default:      return 57600;
+        }
+    }
+
+  private:
+    int _uartNum;
+    int _fd;
+    unsigned long _bauds;
+};
+
+// UARTs of the Arduino core, defined by the test that uses them.
+extern HardwareSerial Serial2;
+
+#endif // HOST_HARDWARESERIAL_H
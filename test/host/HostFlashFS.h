@@ -0,0 +1,75 @@
+#ifndef HOST_FLASHFS_H
+#define HOST_FLASHFS_H
+
+#include <string>
+#include "FS.h"
+#include "vfs_api.h"
+
+/**
+ * @file HostFlashFS.h
+ * @brief Host stand-in of the LittleFS and SPIFFS mounts, both on the one data partition.
+ *
+ * The partition remembers which filesystem it was last formatted with. A filesystem mounts
+ * only a partition formatted with it, or formats it when asked to, which drops every file.
+ */
+
+/** @brief The data partition: its format and its files. */
+struct HostDataPartition {
+    std::string format; ///< "littlefs", "spiffs", or empty when blank
+    fs::HostVolume volume;
+    size_t size;
+    /** @brief Called before each format: may throw to cut the power. */
+    std::function<void()> onFormat;
+
+    HostDataPartition() : size(1536 * 1024) {}
+};
+
+inline HostDataPartition& hostDataPartition()
+{
+    static HostDataPartition partition;
+    return partition;
+}
+
+namespace fs {
+
+class HostFlashFS : public FS {
+  public:
+    explicit HostFlashFS(const char* format) : FS(FSImplPtr(new VFSImpl())), _format(format) {}
+
+    bool begin(bool formatOnFail = false, const char* basePath = "/", uint8_t maxOpenFiles = 10, const char* partitionLabel = nullptr)
+    {
+        (void)maxOpenFiles;
+        (void)partitionLabel;
+        if (hostDataPartition().format != _format && !(formatOnFail && format()))
+            return false;
+        hostMounts()[basePath] = &hostDataPartition().volume;
+        _impl->mountpoint(basePath);
+        return true;
+    }
+
+    bool format()
+    {
+        HostDataPartition& partition = hostDataPartition();
+        if (partition.onFormat)
+            partition.onFormat();
+        partition.format = _format;
+        partition.volume.files.clear();
+        return true;
+    }
+
+    void end()
+    {
+        hostMounts().erase(_impl->mountpoint());
+        _impl->mountpoint(nullptr);
+    }
+
+    size_t totalBytes() { return hostDataPartition().size; }
+    size_t usedBytes() { return hostDataPartition().volume.usedBytes(); }
+
+  private:
+    std::string _format;
+};
+
+} // namespace fs
+
+#endif // HOST_FLASHFS_H
@@ -0,0 +1,16 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include "HostFlashFS.h"
+
+namespace fs {
+class LittleFSFS : public HostFlashFS {
+  public:
+    LittleFSFS() : HostFlashFS("littlefs") {}
+};
+} // namespace fs
+
+// Defined by the test suite that builds Storage.cpp.
+extern fs::LittleFSFS LittleFS;
+
+#endif // HOST_LITTLEFS_H
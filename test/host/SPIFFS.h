@@ -0,0 +1,16 @@
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+#include "HostFlashFS.h"
+
+namespace fs {
+class SPIFFSFS : public HostFlashFS {
+  public:
+    SPIFFSFS() : HostFlashFS("spiffs") {}
+};
+} // namespace fs
+
+// Defined by the test suite that builds Storage.cpp.
+extern fs::SPIFFSFS SPIFFS;
+
+#endif // HOST_SPIFFS_H
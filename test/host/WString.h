@@ -0,0 +1,21 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <string>
+
+/**
+ * @file WString.h
+ * @brief Host stand-in of the Arduino String, on a std::string: only what the units under test use.
+ */
+class String {
+  public:
+    String(const char* str = "") : _str(str ? str : "") {}
+    const char* c_str() const { return _str.c_str(); }
+    unsigned int length() const { return (unsigned int)_str.length(); }
+    bool operator==(const String& other) const { return _str == other._str; }
+
+  private:
+    std::string _str;
+};
+
+#endif // HOST_WSTRING_H
@@ -0,0 +1,44 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+/**
+ * @file Wire.h
+ * @brief Host stand-in of the I2C driver: no device answers, every transaction is a no-op.
+ */
+class TwoWire : public Stream {
+  public:
+    explicit TwoWire(uint8_t busNum) : _busNum(busNum) {}
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0)
+    {
+        (void)sda;
+        (void)scl;
+        (void)frequency;
+        return true;
+    }
+    bool setClock(uint32_t) { return true; }
+    void setTimeOut(uint16_t) {}
+    void beginTransmission(uint8_t) {}
+    uint8_t endTransmission(bool sendStop = true)
+    {
+        (void)sendStop;
+        return 0;
+    }
+    uint8_t requestFrom(uint8_t, uint8_t, bool sendStop = true)
+    {
+        (void)sendStop;
+        return 0;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) { return size; }
+
+  private:
+    uint8_t _busNum;
+};
+
+#endif // HOST_WIRE_H
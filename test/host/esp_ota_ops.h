@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+#include "esp_partition.h"
+
+// Defined by the test suite: the inactive OTA slot, or NULL for a single-slot layout.
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+
+#endif // HOST_ESP_OTA_OPS_H
@@ -0,0 +1,64 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "esp_err.h"
+
+/**
+ * @file esp_partition.h
+ * @brief Host stand-in of the ESP-IDF partition API, on a NOR flash held in RAM.
+ *
+ * As on the chip, an erase sets the bytes to 0xFF and a write can only clear bits.
+ */
+typedef struct {
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+struct HostPartition : esp_partition_t {
+    std::vector<uint8_t> flash;
+    int writesLeft; ///< Writes that succeed before every write fails, -1 for no fault
+
+    HostPartition(const char* name, uint32_t bytes) : flash(bytes, 0xFF), writesLeft(-1)
+    {
+        size = bytes;
+        strncpy(label, name, sizeof(label) - 1);
+        label[sizeof(label) - 1] = '\0';
+    }
+};
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size)
+{
+    const HostPartition* host = static_cast<const HostPartition*>(partition);
+    if (offset + size > host->flash.size())
+        return ESP_ERR_INVALID_ARG;
+    memcpy(dst, host->flash.data() + offset, size);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size)
+{
+    HostPartition* host = const_cast<HostPartition*>(static_cast<const HostPartition*>(partition));
+    if (offset + size > host->flash.size())
+        return ESP_ERR_INVALID_ARG;
+    if (host->writesLeft == 0)
+        return ESP_FAIL;
+    if (host->writesLeft > 0)
+        host->writesLeft--;
+    for (size_t i = 0; i < size; i++)
+        host->flash[offset + i] &= ((const uint8_t*)src)[i];
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size)
+{
+    HostPartition* host = const_cast<HostPartition*>(static_cast<const HostPartition*>(partition));
+    if (offset + size > host->flash.size())
+        return ESP_ERR_INVALID_ARG;
+    memset(host->flash.data() + offset, 0xFF, size);
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_PARTITION_H
@@ -0,0 +1,39 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Host stand-in of the FreeRTOS kernel types, with the ESP32 default 1 ms tick.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define pdTRUE              ((BaseType_t)1)
+#define pdFALSE             ((BaseType_t)0)
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS  ((TickType_t)1)
+#define configTICK_RATE_HZ  (1000)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define pdTICKS_TO_MS(t)    ((uint32_t)(t))
+#define tskNO_AFFINITY      (0x7FFFFFFF)
+
+// Static allocation buffers, opaque to the code under test.
+typedef struct { uint8_t opaque[96]; } StaticSemaphore_t;
+typedef struct { uint8_t opaque[352]; } StaticTask_t;
+typedef struct { uint8_t opaque[80]; } StaticQueue_t;
+typedef struct { uint8_t opaque[32]; } StaticEventGroup_t;
+
+// Critical sections: the host tests run the code under test from a single thread.
+typedef struct { uint32_t owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED  { 0 }
+#define portENTER_CRITICAL(mux)       ((void)(mux))
+#define portEXIT_CRITICAL(mux)        ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)   ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)    ((void)(mux))
+#define portYIELD_FROM_ISR(...)       do {} while (0)
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,34 @@
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H
+#define HOST_FREERTOS_EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+// Host event groups: the bits only, waits return at once with what is set.
+typedef uint32_t EventBits_t;
+struct HostEventGroup {
+    EventBits_t bits;
+};
+typedef HostEventGroup* EventGroupHandle_t;
+
+inline EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t*) { return new HostEventGroup { 0 }; }
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) { return group->bits |= bits; }
+
+inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+inline EventBits_t xEventGroupGetBits(EventGroupHandle_t group) { return group->bits; }
+
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit, BaseType_t, TickType_t)
+{
+    EventBits_t current = group->bits;
+    if (clearOnExit)
+        group->bits &= ~bits;
+    return current;
+}
+
+#endif // HOST_FREERTOS_EVENT_GROUPS_H
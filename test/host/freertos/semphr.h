@@ -0,0 +1,34 @@
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+// Host semaphores: a count, never blocking, for code under test driven from a single thread.
+struct HostSemaphore {
+    UBaseType_t count;
+};
+typedef HostSemaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore { 1 }; }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return new HostSemaphore { 0 }; }
+inline SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t*) { return xSemaphoreCreateMutex(); }
+inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t*) { return xSemaphoreCreateBinary(); }
+inline void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t)
+{
+    if (sem == nullptr || sem->count == 0)
+        return pdFALSE;
+    sem->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem == nullptr)
+        return pdFALSE;
+    sem->count++;
+    return pdTRUE;
+}
+
+#endif // HOST_FREERTOS_SEMPHR_H
@@ -0,0 +1,36 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include <chrono>
+#include <thread>
+#include "FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+/**
+ * @brief Tick count returned by xTaskGetTickCount().
+ * @details Virtual, so that a test steps the kernel time along with the ticks it hands to a state
+ *          machine. vTaskDelay() advances it on top of sleeping.
+ */
+inline TickType_t& hostTickCount()
+{
+    static TickType_t ticks = 0;
+    return ticks;
+}
+
+inline TickType_t xTaskGetTickCount() { return hostTickCount(); }
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+    hostTickCount() += ticks;
+}
+
+// Tasks are not run on the host: the tests call the code under test directly.
+inline TaskHandle_t xTaskCreateStatic(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, StackType_t*, StaticTask_t*)
+{
+    return nullptr;
+}
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,12 @@
+#ifndef HOST_NVS_H
+#define HOST_NVS_H
+
+#include <cstdint>
+#include "esp_err.h"
+
+// Host stand-in of the NVS types. The units built on the host keep their NVS accesses behind
+// ConfigManager, which the tests replace.
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+#endif // HOST_NVS_H
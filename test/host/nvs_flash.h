@@ -0,0 +1,6 @@
+#ifndef HOST_NVS_FLASH_H
+#define HOST_NVS_FLASH_H
+
+#include "nvs.h"
+
+#endif // HOST_NVS_FLASH_H
@@ -0,0 +1,18 @@
+#ifndef HOST_ROM_CRC_H
+#define HOST_ROM_CRC_H
+
+#include <cstdint>
+
+// Host stand-in of the ROM CRC-32 (IEEE 802.3, reflected), chained as the ROM one is.
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+#endif // HOST_ROM_CRC_H
@@ -0,0 +1,9 @@
+#ifndef HOST_VFS_API_H
+#define HOST_VFS_API_H
+
+#include "FS.h"
+
+// Host stand-in of the core's VFS implementation: the mount table of FS.h is the VFS.
+class VFSImpl : public fs::FSImpl {};
+
+#endif // HOST_VFS_API_H
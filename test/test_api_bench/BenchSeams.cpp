@@ -0,0 +1,131 @@
+#include "BenchSeams.hpp"
+#include <LittleFS.h>
+#include <SPIFFS.h>
+#include <esp_ota_ops.h>
+
+std::vector<Recipe> benchRecipes;
+std::vector<TankInfo> benchTanks;
+std::string benchTimezone = "CET-1CEST,M3.5.0,M10.5.0/3";
+
+HardwareSerial Serial2(2);
+fs::LittleFSFS LittleFS;
+fs::SPIFFSFS SPIFFS;
+
+// The data partition is blank, Storage formats it as LittleFS and has nothing to migrate
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t*) { return nullptr; }
+
+// ============================================================================
+// Link seams: the members of the collaborators the handlers and RecipeProcessor use
+// ============================================================================
+
+const Recipe Recipe::EMPTY = { 0, "", {}, 0, 0, 0, 0, false };
+
+ConfigManager::ConfigManager(const char* nvs_namespace) : _namespace(nvs_namespace), _nvs_handle(0) {}
+std::vector<Recipe> ConfigManager::loadRecipes() { return benchRecipes; }
+bool ConfigManager::saveRecipes(const std::vector<Recipe>& recipes)
+{
+    benchRecipes = recipes;
+    return true;
+}
+std::string ConfigManager::loadTimezone() { return benchTimezone; }
+bool ConfigManager::saveTimezone(const std::string& tz)
+{
+    benchTimezone = tz;
+    return true;
+}
+
+float DeviceState::Settings_t::getDispensingWeightChangeThreshold() const { return 0.5f; }
+uint32_t DeviceState::Settings_t::getDispensingNoWeightChangeTimeout_ms() const { return 3000; }
+
+I2CManager::I2CManager(TwoWire& wire) : _wire(wire) {}
+PCA9685::PCA9685(const uint8_t addr, I2CManager& bus) : _i2caddr(addr), _i2c(nullptr), _bus(&bus), _oscillator_freq(0) {}
+
+TaskHandle_t TankManager::_runningTask = nullptr;
+
+void TankManager::begin(uint16_t hopper_closed_pwm, uint16_t hopper_open_pwm, uint32_t)
+{
+    _hopperClosedPwm = hopper_closed_pwm;
+    _hopperOpenPwm   = hopper_open_pwm;
+}
+bool TankManager::refreshTankInfo(TankInfo& tankInfo)
+{
+    for (const auto& tank : benchTanks) {
+        if (tank.uid == tankInfo.uid) {
+            tankInfo = tank;
+            return true;
+        }
+    }
+    return false;
+}
+bool TankManager::commitTankInfo(const TankInfo& tankInfo)
+{
+    for (auto& tank : benchTanks) {
+        if (tank.uid == tankInfo.uid) {
+            tank = tankInfo;
+            return true;
+        }
+    }
+    return false;
+}
+int8_t TankManager::getBusOfTank(const uint64_t tankUid)
+{
+    for (const auto& tank : benchTanks) {
+        if (tank.uid == tankUid)
+            return tank.busIndex;
+    }
+    return -1;
+}
+TankInfo* TankManager::getKnownTankOfUis(uint64_t uid)
+{
+    for (auto& tank : benchTanks) {
+        if (tank.uid == uid)
+            return &tank;
+    }
+    return nullptr;
+}
+TankScrubStats TankManager::getScrubStats(uint8_t busIndex) const
+{
+    TankScrubStats stats;
+    for (const auto& tank : benchTanks) {
+        if (tank.busIndex == busIndex) {
+            stats.uid            = tank.uid;
+            stats.scrubs         = 120;
+            stats.correctedBytes = 3;
+        }
+    }
+    return stats;
+}
+std::vector<ServoPhaseSlot> TankManager::getServoSchedule() const
+{
+    std::vector<ServoPhaseSlot> schedule;
+    for (uint8_t servoNum = 0; servoNum < TOTAL_SERVO_COUNT; servoNum++) {
+        ServoPhaseSlot slot;
+        slot.servoNum = servoNum;
+        slot.onTick   = getServoPhaseOffset(servoNum);
+        slot.pulseUs  = servoNum == HOPPER_SERVO_INDEX ? _hopperClosedPwm : 0;
+        slot.offTick  = (slot.onTick + slot.pulseUs * SERVO_PWM_FRAME_TICKS / 20000) % SERVO_PWM_FRAME_TICKS;
+        schedule.push_back(slot);
+    }
+    return schedule;
+}
+PCA9685::I2C_Result_e TankManager::jogServo(uint8_t, uint16_t) { return PCA9685::I2C_Ok; }
+bool TankManager::setMeasuredDensity(uint64_t, uint16_t, uint16_t) { return true; }
+bool TankManager::refineDensity(uint64_t, float) { return true; }
+void TankManager::setServoPower(bool) {}
+PCA9685::I2C_Result_e TankManager::setContinuousServo(uint8_t, float) { return PCA9685::I2C_Ok; }
+PCA9685::I2C_Result_e TankManager::stopAllServos() { return PCA9685::I2C_Ok; }
+PCA9685::I2C_Result_e TankManager::setServoPWM(uint8_t, uint16_t) { return PCA9685::I2C_Ok; }
+
+HX711::HX711() {}
+HX711::~HX711() {}
+HX711Scale::HX711Scale(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager)
+    : _deviceState(deviceState), _mutex(mutex), _configManager(configManager), _trace(nullptr), _replayBuffer(nullptr)
+{
+    _dutyLevel = ScaleDutyLevel::NORMAL;
+}
+const char* HX711Scale::getDutyLevelName(ScaleDutyLevel) { return "normal"; }
+float HX711Scale::calibrateWithKnownWeight(float knownWeight, ScaleChannel) { return knownWeight > 0 ? 412.5f : 0.0f; }
+void HX711Scale::setFeedingActive(bool active) { _feedingHold = active; }
+bool HX711Scale::isSettledSinceActuation() const { return true; }
+void HX711Scale::requestSample(ScaleChannel) {}
+bool HX711Scale::takeRequestedSample(ScaleChannel, float&) { return false; }
@@ -0,0 +1,26 @@
+#ifndef BENCHSEAMS_HPP
+#define BENCHSEAMS_HPP
+
+/**
+ * @file BenchSeams.hpp
+ * @brief Storage behind the link seams of the API benchmark.
+ *
+ * BenchSeams.cpp defines the ConfigManager, TankManager and HX711Scale members that the handlers and
+ * RecipeProcessor call, in place of the firmware ones: the recipes and the timezone are kept in RAM,
+ * the tank EEPROMs are the entries of benchTanks, and the servo and scale commands do nothing. Each
+ * tank reports a few scrub passes, so that the sensor diagnostics serialize their EEPROM block. The
+ * data partition is the in-memory one of test/host, blank, so Storage formats it as LittleFS.
+ */
+
+#include <string>
+#include <vector>
+#include "RecipeProcessor.hpp"
+
+/** @brief Recipe files, as read and written by ConfigManager::loadRecipes() and saveRecipes(). */
+extern std::vector<Recipe> benchRecipes;
+/** @brief Tank EEPROMs, as read by TankManager::refreshTankInfo() and written by commitTankInfo(). */
+extern std::vector<TankInfo> benchTanks;
+/** @brief NVS timezone. */
+extern std::string benchTimezone;
+
+#endif // BENCHSEAMS_HPP
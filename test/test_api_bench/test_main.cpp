@@ -0,0 +1,535 @@
+/**
+ * @file test_main.cpp
+ * @brief Cost of the REST handlers on a loaded device: pio test -e native_bench -f test_api_bench
+ *
+ * The ApiHandlers run as the router calls them, against a RecordingExchange that answers as
+ * AsyncApiExchange does: the response is serialized, then gzip'd in TCP-sized chunks when it is
+ * compressible, large enough and the client accepts it. The device state holds 6 tanks, 500 feeding
+ * history entries and 50 recipes. Google Benchmark times each endpoint; one call beforehand gives
+ * its counters: the heap allocations it makes, its peak heap above the level it started at, its
+ * response size and the bytes it puts on the wire. malloc, calloc, realloc and free are wrapped at
+ * link time, and operator new goes through malloc, so ArduinoJson's pools, the STL containers and
+ * the gzip encoder are all counted. Host figures are 64-bit and glibc: they compare endpoints and
+ * catch regressions, they do not give the ESP32's.
+ */
+#include <unity.h>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <malloc.h>
+#include <memory>
+#include <new>
+#include <string>
+#include "ApiHandlers.hpp"
+#include "BenchSeams.hpp"
+#include "GzipStream.hpp"
+#include "Storage.hpp"
+
+#define BENCH_TANKS      (6)
+#define BENCH_HISTORY    (500) // The firmware keeps FEEDING_HISTORY_MAX, the handlers serialize whatever is there
+#define BENCH_RECIPES    (50)
+#define BENCH_CHUNK_SIZE (1436) // What the TCP stack asks the chunked response for, about one segment
+
+static const uint64_t FIRST_TANK_UID = 0x2D00C0FFEE000000ULL;
+
+// ============================================================================
+// Heap accounting
+// ============================================================================
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+}
+
+static size_t allocationCount;
+static long long liveBytes; // Relative to the last heapReset(), frees of older blocks take it below 0
+static long long peakBytes;
+
+static void heapReset()
+{
+    allocationCount = 0;
+    liveBytes       = 0;
+    peakBytes       = 0;
+}
+
+static void heapGrow(long long bytes)
+{
+    liveBytes += bytes;
+    if (liveBytes > peakBytes)
+        peakBytes = liveBytes;
+}
+
+extern "C" void* __wrap_malloc(size_t size)
+{
+    void* ptr = __real_malloc(size);
+    if (ptr != nullptr) {
+        allocationCount++;
+        heapGrow((long long)malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size)
+{
+    void* ptr = __real_calloc(count, size);
+    if (ptr != nullptr) {
+        allocationCount++;
+        heapGrow((long long)malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+extern "C" void* __wrap_realloc(void* ptr, size_t size)
+{
+    long long before = ptr != nullptr ? (long long)malloc_usable_size(ptr) : 0;
+    void* moved      = __real_realloc(ptr, size);
+    if (moved != nullptr) {
+        allocationCount++;
+        heapGrow((long long)malloc_usable_size(moved) - before);
+    }
+    return moved;
+}
+
+extern "C" void __wrap_free(void* ptr)
+{
+    if (ptr != nullptr)
+        liveBytes -= (long long)malloc_usable_size(ptr);
+    __real_free(ptr);
+}
+
+// Through malloc, so that the wrappers see the STL allocations too
+void* operator new(size_t size)
+{
+    void* ptr = malloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+
+// ============================================================================
+// Recording exchange
+// ============================================================================
+
+/**
+ * @brief Keeps the last answer, as the client receives it.
+ * @details JSON is serialized into a new string and, when AsyncApiExchange would, gzip'd chunk by chunk
+ *          with the encoder on the heap and the same effort budget per chunk.
+ */
+class RecordingExchange : public ApiExchange {
+  public:
+    RecordingExchange() : status(0), compressible(false), acceptsGzip(true) {}
+
+    using ApiExchange::sendJson;
+    void send(int code, const char* type, const char* text) override
+    {
+        status       = code;
+        contentType  = type;
+        body         = text;
+        compressible = false;
+        wire         = body;
+    }
+    void sendJson(int code, const JsonDocument& doc, bool mayCompress) override
+    {
+        std::string serialized;
+        serializeJson(doc, serialized);
+        status       = code;
+        contentType  = "application/json";
+        compressible = mayCompress;
+        body.swap(serialized);
+        if (!compressible || body.size() < GZIP_MIN_RESPONSE_SIZE || !acceptsGzip) {
+            wire = body;
+            return;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        std::unique_ptr<GzipStream> stream(new GzipStream((const uint8_t*)body.data(), body.size()));
+        uint8_t chunk[BENCH_CHUNK_SIZE];
+        wire.clear();
+        for (;;) {
+            Clock::time_point start = Clock::now();
+            size_t len              = stream->read(chunk, sizeof(chunk));
+            if (std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() > GZIP_CHUNK_BUDGET_US
+              && stream->getMaxChain() > 0)
+                stream->setMaxChain(stream->getMaxChain() / 2);
+            if (len == 0)
+                break;
+            wire.append((const char*)chunk, len);
+        }
+    }
+    void sendFile(const char* path, const char* type, bool) override
+    {
+        status       = 200;
+        contentType  = type;
+        body         = path;
+        compressible = false;
+        wire         = body;
+    }
+
+    int status;
+    std::string contentType;
+    std::string body; ///< Serialized response
+    std::string wire; ///< What the client receives: the body, or its gzip stream
+    bool compressible;
+    bool acceptsGzip; ///< Whether the request carries Accept-Encoding: gzip
+};
+
+// ============================================================================
+// Loaded device
+// ============================================================================
+
+static TwoWire benchWire(0);
+
+struct Device {
+    DeviceState state;
+    SemaphoreHandle_t mutex;
+    ConfigManager config;
+    I2CManager i2c;
+    TankManager tanks;
+    HX711Scale scale;
+    RecipeProcessor processor;
+    ApiHandlers api;
+
+    Device()
+        : mutex(xSemaphoreCreateMutex()), config("bench"), i2c(benchWire), tanks(state, mutex, i2c), scale(state, mutex, config),
+          processor(state, mutex, config, tanks, scale), api(state, mutex, config, processor, tanks)
+    {}
+    ~Device() { vSemaphoreDelete(mutex); }
+};
+
+static Device* device;
+
+static uint64_t tankUid(int index) { return FIRST_TANK_UID + index; }
+
+static void fillTanks()
+{
+    benchTanks.clear();
+    for (int bus = 0; bus < BENCH_TANKS; bus++) {
+        TankInfo tank;
+        char name[40];
+        snprintf(name, sizeof(name), "Tank %d - Salmon & rice kibble", bus + 1);
+        tank.uid                    = tankUid(bus);
+        tank.name                   = name;
+        tank.busIndex               = bus;
+        tank.isFullInfo             = true;
+        tank.capacityLiters         = 2.5;
+        tank.kibbleDensity          = 0.45;
+        tank.remaining_weight_grams = 800.0 + bus * 50.0;
+        tank.augerFlow              = 240;
+        tank.densitySource          = DensitySource::MEASURED;
+        tank.densitySamples         = 3;
+        benchTanks.push_back(tank);
+    }
+    device->state.connectedTanks = benchTanks;
+}
+
+static void fillHistory()
+{
+    std::vector<FeedingHistoryEntry>& history = device->state.feedingHistory;
+    history.clear();
+    history.reserve(BENCH_HISTORY);
+    for (int i = 0; i < BENCH_HISTORY; i++) {
+        bool immediate = (i % 5) == 0;
+        history.emplace_back((time_t)(1760000000 + i * 3600), immediate ? "immediate" : "recipe", immediate ? 0 : (uint32_t)(i % BENCH_RECIPES + 1),
+          (i % 17) != 0, 24.5f + (i % 7), immediate ? "Immediate Feed" : "Recipe 12 - Chicken & fish");
+    }
+}
+
+static Recipe makeRecipe(uint32_t uid)
+{
+    char name[40];
+    snprintf(name, sizeof(name), "Recipe %02u - Chicken & fish", (unsigned)uid);
+    Recipe recipe = { uid, name, { { tankUid(0), 50.0f }, { tankUid(1), 30.0f }, { tankUid(2), 20.0f } }, 1760000000LL, 1760086400LL, 80.0, 2,
+        true };
+    return recipe;
+}
+
+static void fillRecipes()
+{
+    benchRecipes.clear();
+    for (uint32_t uid = 1; uid <= BENCH_RECIPES; uid++)
+        benchRecipes.push_back(makeRecipe(uid));
+    device->processor.begin();
+}
+
+void setUp()
+{
+    device = new Device();
+    fillTanks();
+    fillHistory();
+    fillRecipes();
+}
+
+void tearDown()
+{
+    delete device;
+    device = nullptr;
+}
+
+// ============================================================================
+// Measurement
+// ============================================================================
+
+typedef std::function<void(ApiExchange&)> Handler;
+
+struct Measurement {
+    int status;
+    size_t allocations;
+    long long peakBytes;
+    size_t responseBytes;
+    size_t wireBytes;
+};
+
+/** @brief Heap use and response of one call, after a warm-up call. */
+static Measurement profile(const Handler& handler)
+{
+    Measurement result;
+    RecordingExchange exchange;
+    handler(exchange); // Warm up: a first call may size what the next ones reuse
+
+    heapReset();
+    handler(exchange);
+    result.allocations   = allocationCount;
+    result.peakBytes     = peakBytes;
+    result.status        = exchange.status;
+    result.responseBytes = exchange.body.size();
+    result.wireBytes     = exchange.wire.size();
+    return result;
+}
+
+/** @brief Times @p handler under Google Benchmark, reporting the counters of @p m along. */
+static void registerBenchmark(const char* endpoint, const Handler& handler, const Measurement& m)
+{
+    benchmark::RegisterBenchmark(endpoint, [handler, m](benchmark::State& state) {
+        RecordingExchange exchange;
+        for (auto _ : state)
+            handler(exchange);
+        state.counters["allocs"] = (double)m.allocations;
+        state.counters["peakB"]  = (double)m.peakBytes;
+        state.counters["respB"]  = (double)m.responseBytes;
+        state.counters["wireB"]  = (double)m.wireBytes;
+    });
+}
+
+static bool stateLockIsFree()
+{
+    if (xSemaphoreTake(device->mutex, 0) != pdTRUE)
+        return false;
+    xSemaphoreGive(device->mutex);
+    return true;
+}
+
+static void parse(JsonDocument& doc, const char* json) { TEST_ASSERT_FALSE((bool)deserializeJson(doc, json)); }
+
+static const char* RECIPE_BODY = "{\"name\":\"Recipe 07 - Chicken & fish\",\"dailyWeight\":80,\"servings\":2,\"ingredients\":["
+                                 "{\"tankUid\":\"2D00C0FFEE000000\",\"percentage\":50},"
+                                 "{\"tankUid\":\"2D00C0FFEE000001\",\"percentage\":30},"
+                                 "{\"tankUid\":\"2D00C0FFEE000002\",\"percentage\":20}]}";
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+void test_endpoints_on_a_loaded_device()
+{
+    ApiHandlers& api = device->api;
+    JsonDocument recipeBody, tankBody, feedBody, servingsBody, calibrateBody, jogBody;
+    parse(recipeBody, RECIPE_BODY);
+    parse(tankBody, "{\"name\":\"Tank 3 - Salmon & rice kibble\",\"remainingWeightGrams\":750}");
+    parse(feedBody, "{\"amount\":25}");
+    parse(servingsBody, "{\"servings\":2}");
+    parse(calibrateBody, "{\"knownWeight\":500,\"channel\":\"hopper\"}");
+    parse(jogBody, "{\"servo\":1,\"pwm\":1500}");
+    // The commands queue one at a time: each call finds the previous one taken by the feeding task
+    FeedCommand& command = device->state.feedCommand;
+
+    struct Endpoint {
+        const char* name;
+        int status;
+        Handler handler;
+    };
+    const Endpoint endpoints[] = {
+        { "GET /api/status", 200, [&](ApiExchange& r) { api.getStatus(r); } },
+        { "GET /api/settings", 200, [&](ApiExchange& r) { api.getSettings(r); } },
+        { "GET /api/settings/export", 200, [&](ApiExchange& r) { api.exportSettings(r); } },
+        { "GET /api/tanks", 200, [&](ApiExchange& r) { api.getTanks(r); } },
+        { "GET /api/tanks/{uid}/history", 200, [&](ApiExchange& r) { api.getTankHistory(r, tankUid(0)); } },
+        { "GET /api/scale/current", 200, [&](ApiExchange& r) { api.getScale(r); } },
+        { "GET /api/feeding/history", 200, [&](ApiExchange& r) { api.getFeedingHistory(r); } },
+        { "GET /api/feeding/schedule", 200, [&](ApiExchange& r) { api.getMealSchedule(r); } },
+        { "GET /api/recipes", 200, [&](ApiExchange& r) { api.getRecipes(r); } },
+        { "GET /api/diagnostics/sensors", 200, [&](ApiExchange& r) { api.getSensorDiagnostics(r); } },
+        { "GET /api/diagnostics/servos", 200, [&](ApiExchange& r) { api.getServoDiagnostics(r); } },
+        { "PUT /api/recipes/{uid}", 200, [&](ApiExchange& r) { api.updateRecipe(r, 7, recipeBody); } },
+        { "PUT /api/tanks/{uid}", 200, [&](ApiExchange& r) { api.updateTank(r, tankUid(2), tankBody); } },
+        { "POST /api/feed/immediate/{uid}", 202,
+          [&](ApiExchange& r) {
+              command.processed = true;
+              api.feedImmediate(r, tankUid(0), feedBody);
+          } },
+        { "POST /api/feed/recipe/{uid}", 202,
+          [&](ApiExchange& r) {
+              command.processed = true;
+              api.feedRecipe(r, 7, servingsBody);
+          } },
+        { "POST /api/feed/stop", 202, [&](ApiExchange& r) { api.stopFeeding(r); } },
+        { "POST /api/scale/tare", 202,
+          [&](ApiExchange& r) {
+              command.processed = true;
+              api.tareScale(r);
+          } },
+        { "POST /api/scale/calibrate", 200, [&](ApiExchange& r) { api.calibrateScale(r, calibrateBody); } },
+        { "POST /api/tanks/{uid}/density/calibrate", 202,
+          [&](ApiExchange& r) {
+              command.processed = true;
+              api.calibrateDensity(r, tankUid(1));
+          } },
+        { "POST /api/servos/jog", 200, [&](ApiExchange& r) { api.jogServo(r, jogBody); } },
+    };
+
+    char header[96];
+    snprintf(header, sizeof(header), "%d tanks, %d history entries, %d recipes", BENCH_TANKS, BENCH_HISTORY, BENCH_RECIPES);
+    TEST_MESSAGE(header);
+    for (const Endpoint& endpoint : endpoints) {
+        Measurement m = profile(endpoint.handler);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(endpoint.status, m.status, endpoint.name);
+        TEST_ASSERT_TRUE_MESSAGE(m.responseBytes > 0, endpoint.name);
+        TEST_ASSERT_TRUE_MESSAGE(stateLockIsFree(), endpoint.name);
+        registerBenchmark(endpoint.name, endpoint.handler, m);
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::ClearRegisteredBenchmarks();
+}
+
+void test_responses_hold_the_whole_state()
+{
+    RecordingExchange exchange;
+    JsonDocument doc;
+
+    device->api.getTanks(exchange);
+    parse(doc, exchange.body.c_str());
+    TEST_ASSERT_EQUAL_size_t(BENCH_TANKS, doc.as<JsonArrayConst>().size());
+    TEST_ASSERT_EQUAL_STRING("2D00C0FFEE000005", doc[5]["uid"].as<const char*>());
+
+    device->api.getFeedingHistory(exchange);
+    parse(doc, exchange.body.c_str());
+    TEST_ASSERT_EQUAL_size_t(BENCH_HISTORY, doc.as<JsonArrayConst>().size());
+    TEST_ASSERT_TRUE(exchange.compressible);
+
+    device->api.getRecipes(exchange);
+    parse(doc, exchange.body.c_str());
+    TEST_ASSERT_EQUAL_size_t(BENCH_RECIPES, doc.as<JsonArrayConst>().size());
+    TEST_ASSERT_EQUAL_size_t(3, doc[0]["ingredients"].as<JsonArrayConst>().size());
+
+    device->api.exportSettings(exchange);
+    parse(doc, exchange.body.c_str());
+    TEST_ASSERT_EQUAL_size_t(BENCH_TANKS, doc["tanks"].as<JsonArrayConst>().size());
+    TEST_ASSERT_EQUAL_size_t(BENCH_RECIPES, doc["recipes"].as<JsonArrayConst>().size());
+    TEST_ASSERT_EQUAL_STRING(benchTimezone.c_str(), doc["settings"]["timezone"].as<const char*>());
+}
+
+void test_held_state_lock_answers_503()
+{
+    const Handler lockingHandlers[] = {
+        [](ApiExchange& r) { device->api.getStatus(r); },
+        [](ApiExchange& r) { device->api.getSettings(r); },
+        [](ApiExchange& r) { device->api.getTanks(r); },
+        [](ApiExchange& r) { device->api.getTankHistory(r, tankUid(0)); },
+        [](ApiExchange& r) { device->api.getScale(r); },
+        [](ApiExchange& r) { device->api.getFeedingHistory(r); },
+    };
+    TEST_ASSERT_TRUE(xSemaphoreTake(device->mutex, 0) == pdTRUE);
+    for (const Handler& handler : lockingHandlers) {
+        RecordingExchange exchange;
+        handler(exchange);
+        TEST_ASSERT_EQUAL_INT(503, exchange.status);
+    }
+    xSemaphoreGive(device->mutex);
+}
+
+void test_invalid_recipe_is_rejected_unapplied()
+{
+    RecordingExchange exchange;
+    JsonDocument body;
+    parse(body, "{\"name\":\"Half\",\"ingredients\":[{\"tankUid\":\"2D00C0FFEE000000\",\"percentage\":50}]}");
+    device->api.updateRecipe(exchange, 7, body);
+    TEST_ASSERT_EQUAL_INT(400, exchange.status);
+    Recipe stored = device->processor.getRecipeByUid(7);
+    TEST_ASSERT_EQUAL_STRING("Recipe 07 - Chicken & fish", stored.name.c_str());
+    TEST_ASSERT_EQUAL_size_t(3, stored.ingredients.size());
+}
+
+void test_large_responses_are_gzipped_when_accepted()
+{
+    RecordingExchange exchange;
+    device->api.getFeedingHistory(exchange);
+    TEST_ASSERT_EQUAL_HEX8(0x1f, (uint8_t)exchange.wire[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x8b, (uint8_t)exchange.wire[1]);
+    TEST_ASSERT_TRUE(exchange.wire.size() < exchange.body.size() / 2);
+
+    exchange.acceptsGzip = false;
+    device->api.getFeedingHistory(exchange);
+    TEST_ASSERT_TRUE(exchange.wire == exchange.body);
+
+    // Small, or not marked compressible by its handler: sent as is
+    exchange.acceptsGzip = true;
+    device->api.getStatus(exchange);
+    TEST_ASSERT_TRUE(exchange.wire == exchange.body);
+    device->api.getSensorDiagnostics(exchange);
+    TEST_ASSERT_TRUE(exchange.wire == exchange.body);
+}
+
+void test_diagnostics_hold_every_tank()
+{
+    RecordingExchange exchange;
+    JsonDocument doc;
+
+    device->api.getSensorDiagnostics(exchange);
+    parse(doc, exchange.body.c_str());
+    TEST_ASSERT_EQUAL_size_t(BENCH_TANKS, doc["tankLevels"].as<JsonArrayConst>().size());
+    TEST_ASSERT_EQUAL_UINT32(120, doc["tankLevels"][5]["eeprom"]["scrubs"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_STRING("littlefs", doc["storage"]["backend"].as<const char*>());
+
+    device->api.getServoDiagnostics(exchange);
+    parse(doc, exchange.body.c_str());
+    TEST_ASSERT_EQUAL_size_t(BENCH_TANKS, doc["tanks"].as<JsonArrayConst>().size());
+    TEST_ASSERT_EQUAL_size_t(TOTAL_SERVO_COUNT, doc["schedule"].as<JsonArrayConst>().size());
+}
+
+void test_second_feed_command_finds_the_device_busy()
+{
+    RecordingExchange exchange;
+    JsonDocument body;
+    parse(body, "{\"amount\":25}");
+    device->api.feedImmediate(exchange, tankUid(0), body);
+    TEST_ASSERT_EQUAL_INT(202, exchange.status);
+    TEST_ASSERT_FALSE(device->state.feedCommand.processed);
+    TEST_ASSERT_TRUE(device->state.feedCommand.tankUid == tankUid(0));
+
+    device->api.tareScale(exchange);
+    TEST_ASSERT_EQUAL_INT(429, exchange.status);
+    device->api.stopFeeding(exchange); // Always taken, over any pending command
+    TEST_ASSERT_EQUAL_INT(202, exchange.status);
+    TEST_ASSERT_TRUE(device->state.feedCommand.type == FeedCommandType::EMERGENCY_STOP);
+}
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv); // --benchmark_filter and the other Google Benchmark flags
+    storage.begin();                    // Blank data partition, formatted as LittleFS
+    UNITY_BEGIN();
+    RUN_TEST(test_endpoints_on_a_loaded_device);
+    RUN_TEST(test_responses_hold_the_whole_state);
+    RUN_TEST(test_held_state_lock_answers_503);
+    RUN_TEST(test_invalid_recipe_is_rejected_unapplied);
+    RUN_TEST(test_large_responses_are_gzipped_when_accepted);
+    RUN_TEST(test_diagnostics_hold_every_tank);
+    RUN_TEST(test_second_feed_command_finds_the_device_busy);
+    return UNITY_END();
+}
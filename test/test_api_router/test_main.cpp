@@ -0,0 +1,312 @@
+/**
+ * @file test_main.cpp
+ * @brief ApiRouter matching, and its cost against the std::regex handler walk it replaced: pio test -e native -f test_api_router
+ */
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <regex>
+#include <string>
+#include <vector>
+#include "ApiRouter.hpp"
+
+struct RouteDef {
+    const char* pathTemplate;
+    RouteMethod method;
+};
+
+// As registered by WebServer::_setupAPIRoutes(), JITTER_BENCHMARK off
+static const RouteDef ROUTES[] = {
+    { "/api/status", RouteMethod::GET },
+    { "/api/system/info", RouteMethod::GET },
+    { "/api/system/reboot", RouteMethod::POST },
+    { "/api/system/factory-reset", RouteMethod::POST },
+    { "/api/system/time", RouteMethod::POST },
+    { "/api/settings", RouteMethod::GET },
+    { "/api/settings", RouteMethod::PUT },
+    { "/api/settings/export", RouteMethod::GET },
+    { "/api/tanks", RouteMethod::GET },
+    { "/api/tanks/{hex}", RouteMethod::PUT },
+    { "/api/tanks/{hex}/history", RouteMethod::GET },
+    { "/api/tanks/{hex}/density/calibrate", RouteMethod::POST },
+    { "/api/feed/immediate/{hex}", RouteMethod::POST },
+    { "/api/feed/recipe/{uint}", RouteMethod::POST },
+    { "/api/feed/stop", RouteMethod::POST },
+    { "/api/feeding/history", RouteMethod::GET },
+    { "/api/feeding/schedule", RouteMethod::GET },
+    { "/api/feeding/schedule", RouteMethod::PUT },
+    { "/api/feeding/schedule", RouteMethod::DELETE },
+    { "/api/recipes", RouteMethod::GET },
+    { "/api/recipes", RouteMethod::POST },
+    { "/api/recipes/{uint}", RouteMethod::PUT },
+    { "/api/recipes/{uint}", RouteMethod::DELETE },
+    { "/api/scale/current", RouteMethod::GET },
+    { "/api/scale/tare", RouteMethod::POST },
+    { "/api/scale/calibrate", RouteMethod::POST },
+    { "/api/scale/trace/replay", RouteMethod::POST },
+    { "/api/scale/trace", RouteMethod::GET },
+    { "/api/scale/trace", RouteMethod::POST },
+    { "/api/servos/jog", RouteMethod::POST },
+    { "/api/diagnostics/sensors", RouteMethod::GET },
+    { "/api/diagnostics/servos", RouteMethod::GET },
+    { "/api/network/info", RouteMethod::GET },
+    { "/api/logs/system", RouteMethod::GET },
+    { "/api/logs/feeding", RouteMethod::GET },
+};
+static const size_t ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+
+static ApiRouter router;
+
+static int match(const char* path, RouteMethod method, RouteParams& params) { return router.match(path, strlen(path), method, params); }
+
+static int idOf(const char* pathTemplate, RouteMethod method)
+{
+    for (size_t i = 0; i < ROUTE_COUNT; i++)
+        if (ROUTES[i].method == method && strcmp(ROUTES[i].pathTemplate, pathTemplate) == 0)
+            return (int)i;
+    return ApiRouter::NO_ROUTE;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_every_route_registers_in_order()
+{
+    TEST_ASSERT_EQUAL_size_t(ROUTE_COUNT, router.getRouteCount());
+    // Registering again is refused, the route table stays as it was
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, router.add("/api/status", RouteMethod::GET));
+    TEST_ASSERT_EQUAL_size_t(ROUTE_COUNT, router.getRouteCount());
+}
+
+void test_literal_paths()
+{
+    RouteParams params;
+    TEST_ASSERT_EQUAL_INT(idOf("/api/status", RouteMethod::GET), match("/api/status", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_UINT8(0, params.count);
+    TEST_ASSERT_EQUAL_INT(idOf("/api/settings", RouteMethod::PUT), match("/api/settings", RouteMethod::PUT, params));
+    TEST_ASSERT_EQUAL_INT(idOf("/api/scale/trace/replay", RouteMethod::POST), match("/api/scale/trace/replay", RouteMethod::POST, params));
+    TEST_ASSERT_EQUAL_INT(idOf("/api/scale/trace", RouteMethod::POST), match("/api/scale/trace", RouteMethod::POST, params));
+    // Repeated and trailing slashes are separators like any other
+    TEST_ASSERT_EQUAL_INT(idOf("/api/status", RouteMethod::GET), match("/api//status/", RouteMethod::GET, params));
+}
+
+void test_typed_parameters()
+{
+    RouteParams params;
+    TEST_ASSERT_EQUAL_INT(idOf("/api/tanks/{hex}/history", RouteMethod::GET), match("/api/tanks/2D00C0FFEE000003/history", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_UINT8(1, params.count);
+    TEST_ASSERT_TRUE(params[0] == 0x2D00C0FFEE000003ULL);
+    TEST_ASSERT_TRUE(params[1] == 0); // out of range reads as 0
+
+    TEST_ASSERT_EQUAL_INT(idOf("/api/tanks/{hex}", RouteMethod::PUT), match("/api/tanks/abc", RouteMethod::PUT, params));
+    TEST_ASSERT_TRUE(params[0] == 0xABC);
+    TEST_ASSERT_EQUAL_INT(idOf("/api/recipes/{uint}", RouteMethod::DELETE), match("/api/recipes/4294967295", RouteMethod::DELETE, params));
+    TEST_ASSERT_TRUE(params[0] == 4294967295ULL);
+    TEST_ASSERT_EQUAL_INT(idOf("/api/feed/recipe/{uint}", RouteMethod::POST), match("/api/feed/recipe/7", RouteMethod::POST, params));
+    TEST_ASSERT_TRUE(params[0] == 7);
+}
+
+void test_malformed_parameters_do_not_match()
+{
+    RouteParams params;
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api/tanks/12345678901234567/history", RouteMethod::GET, params)); // 17 digits
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api/tanks/xyz/history", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api/recipes/4294967296", RouteMethod::DELETE, params)); // 2^32
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api/recipes/12a", RouteMethod::DELETE, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api/recipes/-1", RouteMethod::DELETE, params));
+    TEST_ASSERT_EQUAL_UINT8(0, params.count);
+}
+
+void test_unknown_paths_and_methods()
+{
+    RouteParams params;
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api/nothing", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("/api/status/extra", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, match("", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::METHOD_NOT_ALLOWED, match("/api/status", RouteMethod::POST, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::METHOD_NOT_ALLOWED, match("/api/tanks/1f", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, router.match(nullptr, 0, RouteMethod::GET, params));
+}
+
+static int legacyWalk(const std::string& url, RouteMethod method, std::vector<std::string>& args);
+
+void test_tank_history_is_not_taken_by_the_tank_list()
+{
+    // The ESPAsyncWebServer walk let "/api/tanks" answer "/api/tanks/<uid>/history" first
+    RouteParams params;
+    TEST_ASSERT_EQUAL_INT(idOf("/api/tanks/{hex}/history", RouteMethod::GET), match("/api/tanks/1f/history", RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_INT(idOf("/api/tanks", RouteMethod::GET), match("/api/tanks", RouteMethod::GET, params));
+
+    std::vector<std::string> args;
+    TEST_ASSERT_EQUAL_INT(idOf("/api/tanks", RouteMethod::GET), legacyWalk("/api/tanks/1f/history", RouteMethod::GET, args));
+}
+
+void test_literal_wins_and_backtracks_to_parameter()
+{
+    ApiRouter local;
+    int literal = local.add("/a/fade/x", RouteMethod::GET);
+    int param   = local.add("/a/{hex}/y", RouteMethod::GET);
+    RouteParams params;
+    TEST_ASSERT_EQUAL_INT(literal, local.match("/a/fade/x", 9, RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_UINT8(0, params.count);
+    // "fade" is also hex: the literal branch fails on "y", the parameter branch takes it
+    TEST_ASSERT_EQUAL_INT(param, local.match("/a/fade/y", 9, RouteMethod::GET, params));
+    TEST_ASSERT_EQUAL_UINT8(1, params.count);
+    TEST_ASSERT_TRUE(params[0] == 0xFADE);
+}
+
+void test_malformed_templates_are_refused()
+{
+    ApiRouter local;
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, local.add("api/status", RouteMethod::GET));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, local.add("/api/{float}", RouteMethod::GET));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, local.add("/api/x{hex}", RouteMethod::GET));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, local.add("/{hex}/{hex}/{hex}", RouteMethod::GET)); // ROUTER_MAX_PARAMS
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, local.add(nullptr, RouteMethod::GET));
+    TEST_ASSERT_EQUAL_INT(ApiRouter::NO_ROUTE, local.add("/api", RouteMethod::COUNT));
+    TEST_ASSERT_EQUAL_INT(0, local.add("/{hex}/{uint}", RouteMethod::GET));
+    TEST_ASSERT_EQUAL_size_t(1, local.getRouteCount());
+}
+
+// ============================================================================
+// Cost against the replaced handler walk
+// ============================================================================
+
+/**
+ * The routes as they were registered with ESPAsyncWebServer, in order, and its
+ * AsyncCallbackWebHandler::canHandle(): method mask, then either a std::regex built and searched
+ * on every call for "^...$" URIs, or an exact or "uri/" prefix comparison.
+ */
+struct LegacyHandler {
+    const char* uri;
+    RouteMethod method;
+};
+static const LegacyHandler LEGACY_HANDLERS[] = {
+    { "/api/status", RouteMethod::GET },
+    { "/api/system/info", RouteMethod::GET },
+    { "/api/system/reboot", RouteMethod::POST },
+    { "/api/system/factory-reset", RouteMethod::POST },
+    { "/api/system/time", RouteMethod::POST },
+    { "/api/settings", RouteMethod::GET },
+    { "/api/settings", RouteMethod::PUT },
+    { "/api/settings/export", RouteMethod::GET },
+    { "/api/tanks", RouteMethod::GET },
+    { "^/api/tanks/([0-9A-Fa-f]+)$", RouteMethod::PUT },
+    { "^/api/tanks/([0-9A-Fa-f]+)/history$", RouteMethod::GET },
+    { "^/api/feed/immediate/([0-9A-Fa-f]+)$", RouteMethod::POST },
+    { "^/api/feed/recipe/([0-9]+)$", RouteMethod::POST },
+    { "/api/feed/stop", RouteMethod::POST },
+    { "/api/feeding/history", RouteMethod::GET },
+    { "/api/recipes", RouteMethod::GET },
+    { "/api/recipes", RouteMethod::POST },
+    { "^/api/recipes/([0-9]+)$", RouteMethod::PUT },
+    { "^/api/recipes/([0-9]+)$", RouteMethod::DELETE },
+    { "/api/scale/current", RouteMethod::GET },
+    { "/api/scale/tare", RouteMethod::POST },
+    { "/api/scale/calibrate", RouteMethod::POST },
+    { "/api/scale/trace/replay", RouteMethod::POST },
+    { "/api/scale/trace", RouteMethod::GET },
+    { "/api/scale/trace", RouteMethod::POST },
+    { "/api/servos/jog", RouteMethod::POST },
+    { "/api/diagnostics/sensors", RouteMethod::GET },
+    { "/api/diagnostics/servos", RouteMethod::GET },
+    { "/api/network/info", RouteMethod::GET },
+    { "/api/logs/system", RouteMethod::GET },
+    { "/api/logs/feeding", RouteMethod::GET },
+};
+
+static int legacyWalk(const std::string& url, RouteMethod method, std::vector<std::string>& args)
+{
+    int index = 0;
+    for (const LegacyHandler& handler : LEGACY_HANDLERS) {
+        index++;
+        if (handler.method != method)
+            continue;
+        std::string uri(handler.uri);
+        if (uri[0] == '^' && uri[uri.size() - 1] == '$') {
+            std::regex pattern(uri);
+            std::smatch matches;
+            if (!std::regex_search(url, matches, pattern))
+                continue;
+            args.clear();
+            for (size_t i = 1; i < matches.size(); i++)
+                args.push_back(matches[i].str());
+            return index - 1;
+        }
+        if (uri != url && url.compare(0, uri.size() + 1, uri + "/") != 0)
+            continue;
+        return index - 1;
+    }
+    return -1;
+}
+
+template <typename Fn> static double nanosPerCall(Fn fn)
+{
+    using Clock          = std::chrono::steady_clock;
+    const int iterations = 2000;
+    fn(); // warm up
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+        fn();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+}
+
+void test_trie_against_regex_walk()
+{
+    struct Probe {
+        const char* path;
+        RouteMethod method;
+    };
+    static const Probe probes[] = {
+        { "/api/status", RouteMethod::GET },
+        { "/api/scale/current", RouteMethod::GET },
+        { "/api/logs/feeding", RouteMethod::GET },
+        { "/api/tanks/2D00C0FFEE000003", RouteMethod::PUT },
+        { "/api/tanks/2D00C0FFEE000003/history", RouteMethod::GET },
+        { "/api/feed/recipe/12", RouteMethod::POST },
+        { "/api/recipes/12", RouteMethod::DELETE },
+        { "/api/nothing", RouteMethod::GET },
+    };
+    double trieTotal = 0, walkTotal = 0;
+    for (const Probe& probe : probes) {
+        volatile int sink = 0;
+        size_t len        = strlen(probe.path);
+        double trie       = nanosPerCall([&]() {
+            RouteParams params;
+            sink = router.match(probe.path, len, probe.method, params);
+        });
+        double walk = nanosPerCall([&]() {
+            // The server handed each handler an Arduino String, copied into a std::string for the regex
+            std::string url(probe.path);
+            std::vector<std::string> args;
+            sink = legacyWalk(url, probe.method, args);
+        });
+        (void)sink;
+        trieTotal += trie;
+        walkTotal += walk;
+        char msg[128];
+        snprintf(msg, sizeof(msg), "%-40s trie %8.0f ns, regex walk %9.0f ns", probe.path, trie, walk);
+        TEST_MESSAGE(msg);
+    }
+    // Timings vary from host to host, only their order is checked
+    TEST_ASSERT_TRUE(trieTotal < walkTotal);
+}
+
+int main(int, char**)
+{
+    for (size_t i = 0; i < ROUTE_COUNT; i++)
+        router.add(ROUTES[i].pathTemplate, ROUTES[i].method);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_every_route_registers_in_order);
+    RUN_TEST(test_literal_paths);
+    RUN_TEST(test_typed_parameters);
+    RUN_TEST(test_malformed_parameters_do_not_match);
+    RUN_TEST(test_unknown_paths_and_methods);
+    RUN_TEST(test_tank_history_is_not_taken_by_the_tank_list);
+    RUN_TEST(test_literal_wins_and_backtracks_to_parameter);
+    RUN_TEST(test_malformed_templates_are_refused);
+    RUN_TEST(test_trie_against_regex_walk);
+    return UNITY_END();
+}
@@ -0,0 +1,259 @@
+#include "DispenserSim.hpp"
+#include <algorithm>
+#include <cmath>
+
+DispenserSim* DispenserSim::active = nullptr;
+
+HardwareSerial Serial2(2);
+static TwoWire simWire(0);
+
+DispenserSim::DispenserSim()
+    : scaleDead(false), thresholdGrams(0.5f), stallMs(3000), _trapdoorPwm(CLOSED_PWM), _servoPower(false), _lastActuationTick(0),
+      _hopperGrams(0), _bowlGrams(0), _samplePending(false), _sampleReady(false), _sampleDueTick(0), _sample(NAN), _mutex(nullptr),
+      _config(nullptr), _i2c(nullptr), _tanksManager(nullptr), _scale(nullptr), _processor(nullptr)
+{
+    for (int i = 0; i < NUMBER_OF_BUSES; i++) {
+        _present[i]    = false;
+        _augerSpeed[i] = 0.0f;
+    }
+    _phases.reserve(PHASE_LOG_RESERVE);
+    _state.isBowlScaleResponding = true;
+    hostTickCount()              = 0;
+    active                       = this;
+}
+
+DispenserSim::~DispenserSim()
+{
+    delete _processor;
+    delete _scale;
+    delete _tanksManager;
+    delete _i2c;
+    delete _config;
+    if (_mutex != nullptr)
+        vSemaphoreDelete(_mutex);
+    active = nullptr;
+}
+
+void DispenserSim::addTank(uint8_t bus, uint64_t uid, float stockGrams, float densityKgPerL)
+{
+    _tanks[bus]                 = { uid, stockGrams, densityKgPerL };
+    _present[bus]               = true;
+    _infos[bus]                 = TankInfo();
+    _infos[bus].uid             = uid;
+    _infos[bus].busIndex        = bus;
+    _infos[bus].isFullInfo      = true;
+    _infos[bus].kibbleDensity   = densityKgPerL;
+    _infos[bus].capacityLiters  = 2.0;
+}
+
+RecipeProcessor& DispenserSim::start()
+{
+    _mutex        = xSemaphoreCreateMutex();
+    _config       = new ConfigManager("sim");
+    _i2c          = new I2CManager(simWire);
+    _tanksManager = new TankManager(_state, _mutex, *_i2c);
+    _tanksManager->begin(CLOSED_PWM, OPEN_PWM);
+    _scale     = new HX711Scale(_state, _mutex, *_config);
+    _processor = new RecipeProcessor(_state, _mutex, *_config, *_tanksManager, *_scale);
+    _processor->begin();
+    return *_processor;
+}
+
+// ============================================================================
+// Feeding task
+// ============================================================================
+
+bool DispenserSim::pump(uint32_t maxMs)
+{
+    for (uint32_t elapsed = 0; _processor->isBusy() && elapsed < maxMs; elapsed += DISPENSING_TICK_MS)
+        step();
+    return !_processor->isBusy();
+}
+
+void DispenserSim::step()
+{
+    hostTickCount() += DISPENSING_TICK_MS;
+    TickType_t now = xTaskGetTickCount();
+    _advance(DISPENSING_TICK_MS);
+    _state.bowlWeight = _bowlGrams;
+
+    // The requested window completes
+    if (_samplePending && (int32_t)(now - _sampleDueTick) >= 0) {
+        _samplePending = false;
+        _sampleReady   = true;
+        _sample        = scaleDead ? NAN : _reading();
+    }
+
+    // As the feeding task does: hand the hopper sample over, then advance the processor
+    float grams;
+    if (_processor->getScale().takeRequestedSample(ScaleChannel::HOPPER, grams))
+        _processor->onWeightSample(ScaleChannel::HOPPER, grams);
+    _processor->tick(now);
+
+    DispensingPhase phase = _processor->getPhase();
+    if (_phases.empty() || _phases.back() != phase)
+        _phases.push_back(phase);
+}
+
+size_t DispenserSim::countPhase(DispensingPhase phase) const
+{
+    return std::count(_phases.begin(), _phases.end(), phase);
+}
+
+// ============================================================================
+// Hardware
+// ============================================================================
+
+void DispenserSim::_advance(uint32_t ms)
+{
+    float seconds = ms / 1000.0f;
+    for (int bus = 0; bus < NUMBER_OF_BUSES; bus++) {
+        if (!_present[bus] || _augerSpeed[bus] <= 0.0f || !_servoPower)
+            continue;
+        float moved = std::min(_tanks[bus].stockGrams, AUGER_GRAMS_PER_S * _augerSpeed[bus] * seconds);
+        _tanks[bus].stockGrams -= moved;
+        _hopperGrams += moved;
+    }
+    if (_trapdoorPwm < SEAL_PWM) {
+        float released = std::min(_hopperGrams, DRAIN_GRAMS_PER_S * seconds);
+        _hopperGrams -= released;
+        _bowlGrams += released;
+    }
+}
+
+float DispenserSim::_reading() const
+{
+    return EMPTY_HOPPER_GRAMS + _hopperGrams + (_trapdoorPwm >= CONTACT_PWM ? CONTACT_SPIKE_GRAMS : 0.0f);
+}
+
+bool DispenserSim::augerRunning() const
+{
+    for (int bus = 0; bus < NUMBER_OF_BUSES; bus++) {
+        if (_augerSpeed[bus] > 0.0f)
+            return true;
+    }
+    return false;
+}
+
+int8_t DispenserSim::busOf(uint64_t uid)
+{
+    for (int bus = 0; bus < NUMBER_OF_BUSES; bus++) {
+        if (_present[bus] && _tanks[bus].uid == uid)
+            return bus;
+    }
+    return -1;
+}
+
+TankInfo* DispenserSim::tankInfo(uint64_t uid)
+{
+    int8_t bus = busOf(uid);
+    return bus < 0 ? nullptr : &_infos[bus];
+}
+
+void DispenserSim::setServoPwm(uint8_t servoNum, uint16_t pwm)
+{
+    if (servoNum != HOPPER_SERVO_INDEX || !_servoPower)
+        return;
+    if (pwm != _trapdoorPwm)
+        _lastActuationTick = xTaskGetTickCount();
+    _trapdoorPwm = pwm;
+}
+
+void DispenserSim::setAugerSpeed(uint8_t bus, float speed)
+{
+    if (bus < NUMBER_OF_BUSES)
+        _augerSpeed[bus] = speed;
+}
+
+void DispenserSim::stopAllServos()
+{
+    for (int bus = 0; bus < NUMBER_OF_BUSES; bus++)
+        _augerSpeed[bus] = 0.0f;
+}
+
+void DispenserSim::requestSample()
+{
+    // A new request replaces the pending one, and is answered by a window started after it
+    _samplePending = true;
+    _sampleReady   = false;
+    _sampleDueTick = xTaskGetTickCount() + pdMS_TO_TICKS(SAMPLE_WINDOW_MS);
+}
+
+bool DispenserSim::takeSample(float& grams)
+{
+    if (!_sampleReady)
+        return false;
+    _sampleReady = false;
+    grams        = _sample;
+    return true;
+}
+
+bool DispenserSim::isSettled() const
+{
+    return xTaskGetTickCount() - _lastActuationTick >= pdMS_TO_TICKS(SETTLE_MS);
+}
+
+// ============================================================================
+// Link seams: the members of the collaborators RecipeProcessor uses, on the simulated hardware
+// ============================================================================
+
+const Recipe Recipe::EMPTY = { 0, "", {}, 0, 0, 0, 0, false };
+
+ConfigManager::ConfigManager(const char* nvs_namespace) : _namespace(nvs_namespace), _nvs_handle(0) {}
+std::vector<Recipe> ConfigManager::loadRecipes() { return DispenserSim::active->recipes(); }
+bool ConfigManager::saveRecipes(const std::vector<Recipe>& recipes)
+{
+    DispenserSim::active->recipes() = recipes;
+    return true;
+}
+
+float DeviceState::Settings_t::getDispensingWeightChangeThreshold() const { return DispenserSim::active->thresholdGrams; }
+uint32_t DeviceState::Settings_t::getDispensingNoWeightChangeTimeout_ms() const { return DispenserSim::active->stallMs; }
+
+I2CManager::I2CManager(TwoWire& wire) : _wire(wire) {}
+PCA9685::PCA9685(const uint8_t addr, I2CManager& bus) : _i2caddr(addr), _i2c(nullptr), _bus(&bus), _oscillator_freq(0) {}
+
+TaskHandle_t TankManager::_runningTask = nullptr;
+
+void TankManager::begin(uint16_t hopper_closed_pwm, uint16_t hopper_open_pwm, uint32_t)
+{
+    _hopperClosedPwm = hopper_closed_pwm;
+    _hopperOpenPwm   = hopper_open_pwm;
+}
+int8_t TankManager::getBusOfTank(const uint64_t tankUid) { return DispenserSim::active->busOf(tankUid); }
+TankInfo* TankManager::getKnownTankOfUis(uint64_t uid) { return DispenserSim::active->tankInfo(uid); }
+bool TankManager::setMeasuredDensity(uint64_t uid, uint16_t gramsPerLiter, uint16_t)
+{
+    TankInfo* tank = DispenserSim::active->tankInfo(uid);
+    if (tank == nullptr)
+        return false;
+    tank->kibbleDensity = gramsPerLiter / 1000.0;
+    return true;
+}
+bool TankManager::refineDensity(uint64_t, float) { return true; }
+void TankManager::setServoPower(bool on) { DispenserSim::active->setServoPower(on); }
+PCA9685::I2C_Result_e TankManager::setContinuousServo(uint8_t servoNum, float speed)
+{
+    DispenserSim::active->setAugerSpeed(servoNum, speed);
+    return PCA9685::I2C_Ok;
+}
+PCA9685::I2C_Result_e TankManager::stopAllServos()
+{
+    DispenserSim::active->stopAllServos();
+    return PCA9685::I2C_Ok;
+}
+PCA9685::I2C_Result_e TankManager::setServoPWM(uint8_t servoNum, uint16_t pwm)
+{
+    DispenserSim::active->setServoPwm(servoNum, pwm);
+    return PCA9685::I2C_Ok;
+}
+
+HX711::HX711() {}
+HX711::~HX711() {}
+HX711Scale::HX711Scale(DeviceState& deviceState, SemaphoreHandle_t& mutex, ConfigManager& configManager)
+    : _deviceState(deviceState), _mutex(mutex), _configManager(configManager), _trace(nullptr), _replayBuffer(nullptr)
+{}
+void HX711Scale::setFeedingActive(bool active) { _feedingHold = active; }
+bool HX711Scale::isSettledSinceActuation() const { return DispenserSim::active->isSettled(); }
+void HX711Scale::requestSample(ScaleChannel) { DispenserSim::active->requestSample(); }
+bool HX711Scale::takeRequestedSample(ScaleChannel, float& grams) { return DispenserSim::active->takeSample(grams); }
@@ -0,0 +1,120 @@
+#ifndef DISPENSERSIM_HPP
+#define DISPENSERSIM_HPP
+
+/**
+ * @file DispenserSim.hpp
+ * @brief Simulated hopper, trapdoor, augers and bowl for the RecipeProcessor host tests.
+ *
+ * DispenserSim.cpp also defines the TankManager, HX711Scale and ConfigManager members that
+ * RecipeProcessor calls, in place of the firmware ones: servo commands move the simulated
+ * hardware, and sample requests are answered from it after a conversion window. The feeding
+ * task is mirrored by pump(), so that the state machine is stepped on virtual time.
+ */
+
+#include <vector>
+#include "RecipeProcessor.hpp"
+
+class DispenserSim {
+  public:
+    // Hardware
+    static constexpr uint16_t OPEN_PWM          = 1000; // Trapdoor fully open
+    static constexpr uint16_t CLOSED_PWM        = 2000; // Default close command
+    static constexpr uint16_t CONTACT_PWM       = 1800; // The trapdoor presses on the frame from there
+    static constexpr uint16_t SEAL_PWM          = 1700; // The trapdoor holds the kibble from there
+    static constexpr float CONTACT_SPIKE_GRAMS  = 6.0f; // Reading added by the trapdoor pressing on the frame
+    static constexpr float EMPTY_HOPPER_GRAMS   = 250.0f; // Hopper channel reading, empty
+    static constexpr float DRAIN_GRAMS_PER_S    = 40.0f;  // Through the open trapdoor
+    static constexpr float AUGER_GRAMS_PER_S    = 8.0f;   // At full speed
+    static constexpr uint32_t SAMPLE_WINDOW_MS  = 100;    // Requested sample, from the request to the answer
+    static constexpr uint32_t SETTLE_MS         = 60;     // Load cell blanking after a servo command
+    static constexpr size_t PHASE_LOG_RESERVE   = 256;    // Phases logged without growing the log
+
+    struct Tank {
+        uint64_t uid;
+        float stockGrams;
+        float densityKgPerL;
+    };
+
+    DispenserSim();
+    ~DispenserSim();
+
+    /** @brief Connects a tank on @p bus, known to the fake TankManager. */
+    void addTank(uint8_t bus, uint64_t uid, float stockGrams, float densityKgPerL = 0.5f);
+    /** @brief Recipes returned by the fake ConfigManager::loadRecipes(). */
+    std::vector<Recipe>& recipes() { return _recipes; }
+
+    DeviceState& state() { return _state; }
+    RecipeProcessor& processor() { return *_processor; }
+    /** @brief Creates the processor over the fakes, and begins it (which loads the recipes). */
+    RecipeProcessor& start();
+
+    /**
+     * @brief Runs the feeding task loop on virtual time until the processor is idle
+     * @return false if it was still busy after @p maxMs
+     */
+    bool pump(uint32_t maxMs = 120000);
+    /** @brief One loop of the feeding task: advance the hardware, hand the sample over, tick. */
+    void step();
+
+    /** @brief Phases in the order they were entered, consecutive repeats merged. */
+    const std::vector<DispensingPhase>& phases() const { return _phases; }
+    size_t countPhase(DispensingPhase phase) const;
+    /** @brief Empties the phase log, keeping its storage: logging allocates nothing up to PHASE_LOG_RESERVE. */
+    void clearPhases() { _phases.clear(); }
+
+    float hopperGrams() const { return _hopperGrams; }
+    float bowlGrams() const { return _bowlGrams; }
+    uint16_t trapdoorPwm() const { return _trapdoorPwm; }
+    bool servoPower() const { return _servoPower; }
+    bool augerRunning() const;
+
+    // Fault injection
+    bool scaleDead;       ///< The HX711 stops answering: requested samples come back NAN
+    float thresholdGrams; ///< Settings: weight change that resets the stall timer
+    uint32_t stallMs;     ///< Settings: no-weight-change timeout
+
+    // --- Called by the fakes ---
+    static DispenserSim* active;
+    int8_t busOf(uint64_t uid);
+    TankInfo* tankInfo(uint64_t uid);
+    void setServoPwm(uint8_t servoNum, uint16_t pwm);
+    void setAugerSpeed(uint8_t bus, float speed);
+    void setServoPower(bool on) { _servoPower = on; }
+    void stopAllServos();
+    void requestSample();
+    bool takeSample(float& grams);
+    bool isSettled() const;
+
+  private:
+    void _advance(uint32_t ms);
+    float _reading() const;
+
+    Tank _tanks[NUMBER_OF_BUSES];
+    bool _present[NUMBER_OF_BUSES];
+    TankInfo _infos[NUMBER_OF_BUSES];
+    float _augerSpeed[NUMBER_OF_BUSES];
+    std::vector<Recipe> _recipes;
+
+    uint16_t _trapdoorPwm;
+    bool _servoPower;
+    TickType_t _lastActuationTick;
+    float _hopperGrams;
+    float _bowlGrams;
+
+    bool _samplePending;
+    bool _sampleReady;
+    TickType_t _sampleDueTick;
+    float _sample;
+
+    std::vector<DispensingPhase> _phases;
+
+    DeviceState _state;
+    SemaphoreHandle_t _mutex;
+    ConfigManager* _config;
+    I2CManager* _i2c;
+    TankManager* _tanksManager;
+    HX711Scale* _scale;
+    RecipeProcessor* _processor;
+};
+
+#endif // DISPENSERSIM_HPP
@@ -0,0 +1,411 @@
+/**
+ * @file test_main.cpp
+ * @brief The dispensing state machine on a simulated hopper: pio test -e native_sim -f test_dispensing
+ *
+ * The real RecipeProcessor runs against DispenserSim, stepped on virtual time as the feeding task
+ * steps it: every DISPENSING_TICK_MS, the requested hopper sample is handed over, then tick().
+ * malloc, calloc and realloc are wrapped at link time, and operator new goes through malloc, so that
+ * the soak can count the allocations of the feed path once the processor has booted.
+ */
+#include <unity.h>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include "DispenserSim.hpp"
+
+#define SOAK_FEEDS (3 * FEEDING_HISTORY_MAX) // Well past the history cap, so that old entries are dropped
+
+static const uint64_t TANK_A = 0xA1A1A1A1A1A1A1A1ULL;
+static const uint64_t TANK_B = 0xB2B2B2B2B2B2B2B2ULL;
+
+static DispenserSim* sim;
+
+// ============================================================================
+// Heap accounting
+// ============================================================================
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+}
+
+static bool countingAllocations;
+static size_t allocationCount;
+
+extern "C" void* __wrap_malloc(size_t size)
+{
+    if (countingAllocations)
+        allocationCount++;
+    return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size)
+{
+    if (countingAllocations)
+        allocationCount++;
+    return __real_calloc(count, size);
+}
+
+extern "C" void* __wrap_realloc(void* ptr, size_t size)
+{
+    if (countingAllocations)
+        allocationCount++;
+    return __real_realloc(ptr, size);
+}
+
+extern "C" void __wrap_free(void* ptr) { __real_free(ptr); }
+
+void* operator new(size_t size)
+{
+    void* ptr = malloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+
+void setUp()
+{
+    sim = new DispenserSim();
+    sim->addTank(0, TANK_A, 1000.0f);
+    sim->addTank(3, TANK_B, 1000.0f);
+}
+
+void tearDown()
+{
+    delete sim;
+    sim = nullptr;
+}
+
+// Runs the feeding task until the processor enters @p phase
+static bool pumpUntil(DispensingPhase phase, uint32_t maxMs = 60000)
+{
+    for (uint32_t elapsed = 0; elapsed < maxMs; elapsed += DISPENSING_TICK_MS) {
+        if (sim->processor().getPhase() == phase)
+            return true;
+        sim->step();
+    }
+    return false;
+}
+
+// A recipe of 12 g a serving: three batches at 500 g/L
+static RecipeProcessor& startWithRecipe()
+{
+    Recipe recipe = { 7, "Mix", { { TANK_A, 75.0f }, { TANK_B, 25.0f } }, 0, 0, 24.0, 2, true };
+    sim->recipes().push_back(recipe);
+    return sim->start();
+}
+
+// As the feeding task does with a posted command, then runs it
+static void serveCommand()
+{
+    FeedCommand& command = sim->state().feedCommand;
+    TEST_ASSERT_FALSE(command.processed);
+    TEST_ASSERT_EQUAL(FeedCommandType::RECIPE, command.type);
+    command.processed = true;
+    TEST_ASSERT_TRUE(sim->processor().startRecipeFeed(command.recipeUid, command.servings));
+    TEST_ASSERT_TRUE(sim->pump());
+}
+
+void test_immediate_feed_walks_the_cycle()
+{
+    RecipeProcessor& processor = sim->start();
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 4.0f));
+    TEST_ASSERT_TRUE(processor.isBusy());
+    TEST_ASSERT_TRUE(sim->servoPower());
+    TEST_ASSERT_TRUE(sim->pump());
+
+    // One batch: purge, close with the spike and back-off, zero, auger, settle, then the final purge
+    const DispensingPhase expected[] = {
+        DispensingPhase::PHASE_POWER_UP,
+        DispensingPhase::PHASE_PURGE_OPEN,
+        DispensingPhase::PHASE_PURGE_WIGGLE,
+        DispensingPhase::PHASE_PURGE_SETTLE,
+        DispensingPhase::PHASE_CLOSE_MOVING,
+        DispensingPhase::PHASE_CLOSE_DETECT_SPIKE,
+        DispensingPhase::PHASE_CLOSE_BACKOFF,
+        DispensingPhase::PHASE_CLOSE_SETTLE,
+        DispensingPhase::PHASE_ZERO,
+        DispensingPhase::PHASE_DISPENSE_AUGER,
+        DispensingPhase::PHASE_DISPENSE_SETTLE,
+        DispensingPhase::PHASE_PURGE_OPEN,
+        DispensingPhase::PHASE_PURGE_WIGGLE,
+        DispensingPhase::PHASE_PURGE_SETTLE,
+        DispensingPhase::PHASE_COMPLETE,
+    };
+    const size_t count = sizeof(expected) / sizeof(expected[0]);
+    TEST_ASSERT_EQUAL(count, sim->phases().size());
+    for (size_t i = 0; i < count; i++)
+        TEST_ASSERT_EQUAL(expected[i], sim->phases()[i]);
+
+    TEST_ASSERT_TRUE(processor.lastOperationSucceeded());
+    TEST_ASSERT_FALSE(sim->augerRunning());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, sim->hopperGrams());
+    // The slow approach overshoots by less than one sample of slow flow
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 4.0f, sim->bowlGrams());
+    TEST_ASSERT_EQUAL(1, sim->state().feedingHistory.size());
+    TEST_ASSERT_TRUE(sim->state().feedingHistory[0].success);
+}
+
+void test_batches_are_bounded_by_the_hopper_volume()
+{
+    // 500 g/L fills the 10 mL hopper with 5 g: 12 g take three batches
+    RecipeProcessor& processor = sim->start();
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 12.0f));
+    TEST_ASSERT_TRUE(sim->pump());
+
+    TEST_ASSERT_TRUE(processor.lastOperationSucceeded());
+    TEST_ASSERT_EQUAL(3, sim->countPhase(DispensingPhase::PHASE_ZERO));
+    TEST_ASSERT_EQUAL(2, sim->countPhase(DispensingPhase::PHASE_POST_BATCH));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 12.0f, sim->bowlGrams());
+}
+
+void test_recipe_runs_each_ingredient()
+{
+    Recipe recipe = { 7, "Mix", { { TANK_A, 75.0f }, { TANK_B, 25.0f } }, 0, 0, 16.0, 4, true };
+    sim->recipes().push_back(recipe);
+    RecipeProcessor& processor = sim->start();
+
+    // One serving of four: 4 g, 3 g from A then 1 g from B, in one batch
+    TEST_ASSERT_TRUE(processor.startRecipeFeed(7, 1));
+    TEST_ASSERT_TRUE(sim->pump());
+
+    TEST_ASSERT_TRUE(processor.lastOperationSucceeded());
+    TEST_ASSERT_EQUAL(1, sim->countPhase(DispensingPhase::PHASE_ZERO));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 4.0f, sim->bowlGrams());
+    TEST_ASSERT_EQUAL_STRING("recipe", sim->state().feedingHistory.back().type);
+    TEST_ASSERT_TRUE(sim->recipes()[0].lastUsed != 0);
+}
+
+void test_tick_never_blocks()
+{
+    RecipeProcessor& processor = sim->start();
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 12.0f));
+
+    // A tick that slept would have moved the kernel tick count past the ticks handed to it
+    uint32_t steps = 0;
+    while (processor.isBusy() && steps < 20000) {
+        sim->step();
+        steps++;
+        TEST_ASSERT_EQUAL_UINT32(steps * DISPENSING_TICK_MS, xTaskGetTickCount());
+    }
+    TEST_ASSERT_FALSE(processor.isBusy());
+}
+
+void test_runs_are_deterministic()
+{
+    RecipeProcessor& processor = sim->start();
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 12.0f));
+    TEST_ASSERT_TRUE(sim->pump());
+    std::vector<DispensingPhase> firstPhases = sim->phases();
+    TickType_t firstTicks                    = xTaskGetTickCount();
+    float firstBowl                          = sim->bowlGrams();
+
+    tearDown();
+    setUp();
+    RecipeProcessor& again = sim->start();
+    TEST_ASSERT_TRUE(again.startImmediateFeed(TANK_A, 12.0f));
+    TEST_ASSERT_TRUE(sim->pump());
+    TEST_ASSERT_TRUE(firstPhases == sim->phases());
+    TEST_ASSERT_EQUAL_UINT32(firstTicks, xTaskGetTickCount());
+    TEST_ASSERT_EQUAL_FLOAT(firstBowl, sim->bowlGrams());
+}
+
+void test_stop_takes_effect_on_the_next_tick()
+{
+    RecipeProcessor& processor = sim->start();
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 12.0f));
+    TEST_ASSERT_TRUE(pumpUntil(DispensingPhase::PHASE_DISPENSE_AUGER));
+    while (!sim->augerRunning())
+        sim->step();
+
+    processor.requestStop();
+    sim->step();
+    TEST_ASSERT_EQUAL(DispensingPhase::PHASE_STOPPING, processor.getPhase());
+    TEST_ASSERT_FALSE(sim->augerRunning());
+    TEST_ASSERT_EQUAL_UINT16(DispenserSim::CLOSED_PWM, sim->trapdoorPwm());
+
+    // The servos are released once the hopper had the time to close
+    TEST_ASSERT_TRUE(sim->pump(STOP_CLOSE_MS + DISPENSING_TICK_MS));
+    TEST_ASSERT_EQUAL(DispensingPhase::PHASE_ERROR, processor.getPhase());
+    TEST_ASSERT_FALSE(processor.lastOperationSucceeded());
+    TEST_ASSERT_EQUAL(DeviceEvent_e::DEVEVENT_USER_STOPPED, sim->state().lastEvent);
+    TEST_ASSERT_FALSE(sim->state().feedingHistory.back().success);
+}
+
+void test_unanswered_samples_fail_the_feed()
+{
+    RecipeProcessor& processor = sim->start();
+    sim->scaleDead = true;
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 4.0f));
+    TEST_ASSERT_TRUE(sim->pump());
+
+    TEST_ASSERT_EQUAL(DispensingPhase::PHASE_ERROR, processor.getPhase());
+    TEST_ASSERT_FALSE(sim->augerRunning());
+    TEST_ASSERT_EQUAL_UINT16(DispenserSim::CLOSED_PWM, sim->trapdoorPwm());
+}
+
+void test_empty_tank_ends_the_feed()
+{
+    sim->addTank(0, TANK_A, 3.0f);
+    RecipeProcessor& processor = sim->start();
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 12.0f));
+
+    // The first batch takes the last 3 g, the second stalls for the no-weight-change timeout
+    TEST_ASSERT_TRUE(sim->pump());
+    TEST_ASSERT_EQUAL(DispensingPhase::PHASE_ERROR, processor.getPhase());
+    TEST_ASSERT_EQUAL(DeviceEvent_e::DEVEVENT_TANK_EMPTY, sim->state().lastEvent);
+    TEST_ASSERT_EQUAL(2, sim->countPhase(DispensingPhase::PHASE_ZERO));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 3.0f, sim->bowlGrams());
+    TEST_ASSERT_FALSE(sim->state().feedingHistory.back().success);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 3.0f, sim->state().feedingHistory.back().amount);
+}
+
+void test_unknown_tank_is_rejected()
+{
+    RecipeProcessor& processor = sim->start();
+    TEST_ASSERT_FALSE(processor.startImmediateFeed(0x1234, 4.0f));
+    TEST_ASSERT_FALSE(processor.isBusy());
+    TEST_ASSERT_EQUAL(DeviceEvent_e::DEVEVENT_TANK_NOT_FOUND, sim->state().lastEvent);
+}
+
+void test_staged_meal_serves_the_first_kibble_sooner()
+{
+    RecipeProcessor& processor = startWithRecipe();
+
+    // The same serving, just in time
+    TEST_ASSERT_TRUE(processor.startRecipeFeed(7, 1));
+    TEST_ASSERT_TRUE(sim->pump());
+    StagingStatus status = processor.getStagingStatus();
+    TEST_ASSERT_FALSE(status.lastFeedWasStaged);
+    uint32_t justInTimeMs = status.lastFirstKibbleMs;
+    float bowlBefore      = sim->bowlGrams();
+
+    // Scheduled a minute ahead, with the default lead time: the first batch is staged at once
+    time_t now = time(nullptr);
+    TEST_ASSERT_TRUE(processor.scheduleMeal(7, 1, now + 60, STAGING_DEFAULT_LEAD_S));
+    processor.serviceStaging(now);
+    TEST_ASSERT_TRUE(processor.isBusy());
+    TEST_ASSERT_TRUE(sim->pump());
+    status = processor.getStagingStatus();
+    TEST_ASSERT_EQUAL(StagingState::STAGING_HELD, status.state);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 5.0f, status.stagedGrams);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 5.0f, sim->hopperGrams());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, bowlBefore, sim->bowlGrams());
+
+    // Nothing happens until the meal, which then goes through the regular command path
+    processor.serviceStaging(now + 30);
+    TEST_ASSERT_TRUE(sim->state().feedCommand.processed);
+    processor.serviceStaging(now + 60);
+    serveCommand();
+
+    status = processor.getStagingStatus();
+    TEST_ASSERT_TRUE(processor.lastOperationSucceeded());
+    TEST_ASSERT_TRUE(status.lastFeedWasStaged);
+    TEST_ASSERT_EQUAL(StagingState::STAGING_NONE, status.state);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 12.0f, sim->bowlGrams() - bowlBefore);
+    // The staged meal only waits for the servo power-up; the just-in-time one for a whole cycle
+    TEST_ASSERT_LESS_OR_EQUAL(SERVO_POWER_SETTLE_MS + DISPENSING_TICK_MS, status.lastFirstKibbleMs);
+    TEST_ASSERT_GREATER_THAN(10 * status.lastFirstKibbleMs, justInTimeMs);
+    char message[80];
+    snprintf(message, sizeof(message), "First kibble after %lu ms staged, %lu ms just in time", (unsigned long)status.lastFirstKibbleMs,
+      (unsigned long)justInTimeMs);
+    TEST_MESSAGE(message);
+}
+
+void test_cancelled_staging_is_credited_to_the_next_feed()
+{
+    RecipeProcessor& processor = startWithRecipe();
+    time_t now                 = time(nullptr);
+    TEST_ASSERT_TRUE(processor.scheduleMeal(7, 1, now + 60, STAGING_DEFAULT_LEAD_S));
+    processor.serviceStaging(now);
+    TEST_ASSERT_TRUE(sim->pump());
+    float staged = processor.getStagingStatus().stagedGrams;
+    TEST_ASSERT_TRUE(staged > 0.0f);
+
+    processor.cancelScheduledMeal();
+    processor.serviceStaging(now + 1);
+    TEST_ASSERT_FALSE(processor.isBusy());
+    TEST_ASSERT_EQUAL(StagingState::STAGING_RESIDUAL, processor.getStagingStatus().state);
+    // No meal is staged over a residual batch
+    TEST_ASSERT_TRUE(processor.scheduleMeal(7, 1, now + 120, STAGING_DEFAULT_LEAD_S));
+    processor.serviceStaging(now + 2);
+    TEST_ASSERT_FALSE(processor.isBusy());
+
+    // A feed of another size releases the batch first, and counts it
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_B, 8.0f));
+    TEST_ASSERT_TRUE(sim->pump());
+    TEST_ASSERT_TRUE(processor.lastOperationSucceeded());
+    TEST_ASSERT_FALSE(processor.getStagingStatus().lastFeedWasStaged);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 8.0f, sim->bowlGrams());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, sim->hopperGrams());
+}
+
+void test_feed_path_stops_allocating_after_boot()
+{
+    // Enough kibble for the whole soak
+    sim->addTank(0, TANK_A, 100000.0f);
+    sim->addTank(3, TANK_B, 100000.0f);
+    RecipeProcessor& processor = startWithRecipe();
+    // One feed of each kind first: the operation context takes its reserved sizes
+    TEST_ASSERT_TRUE(processor.startImmediateFeed(TANK_A, 4.0f));
+    TEST_ASSERT_TRUE(sim->pump());
+    TEST_ASSERT_TRUE(processor.startRecipeFeed(7, 1));
+    TEST_ASSERT_TRUE(sim->pump());
+
+    time_t now          = time(nullptr);
+    allocationCount     = 0;
+    countingAllocations = true;
+    for (int i = 0; i < SOAK_FEEDS; i++) {
+        sim->clearPhases();
+        switch (i % 3) {
+            case 0:
+                TEST_ASSERT_TRUE(processor.startImmediateFeed(i % 2 ? TANK_A : TANK_B, 4.0f));
+                break;
+            case 1:
+                TEST_ASSERT_TRUE(processor.startRecipeFeed(7, 1));
+                break;
+            default:
+                // A staged meal: the batch goes into the hopper ahead, the rest at the meal time
+                now += 3600;
+                TEST_ASSERT_TRUE(processor.scheduleMeal(7, 1, now + 60, STAGING_DEFAULT_LEAD_S));
+                processor.serviceStaging(now);
+                TEST_ASSERT_TRUE(sim->pump());
+                processor.serviceStaging(now + 60);
+                sim->state().feedCommand.processed = true;
+                TEST_ASSERT_TRUE(processor.startRecipeFeed(sim->state().feedCommand.recipeUid, sim->state().feedCommand.servings));
+                break;
+        }
+        TEST_ASSERT_TRUE(sim->pump());
+        TEST_ASSERT_TRUE(processor.lastOperationSucceeded());
+    }
+    countingAllocations = false;
+
+    TEST_ASSERT_EQUAL(FEEDING_HISTORY_MAX, sim->state().feedingHistory.size());
+    char message[80];
+    snprintf(message, sizeof(message), "%d feeds after boot, %u allocations", SOAK_FEEDS, (unsigned)allocationCount);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, allocationCount);
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_immediate_feed_walks_the_cycle);
+    RUN_TEST(test_batches_are_bounded_by_the_hopper_volume);
+    RUN_TEST(test_recipe_runs_each_ingredient);
+    RUN_TEST(test_tick_never_blocks);
+    RUN_TEST(test_runs_are_deterministic);
+    RUN_TEST(test_stop_takes_effect_on_the_next_tick);
+    RUN_TEST(test_unanswered_samples_fail_the_feed);
+    RUN_TEST(test_empty_tank_ends_the_feed);
+    RUN_TEST(test_unknown_tank_is_rejected);
+    RUN_TEST(test_staged_meal_serves_the_first_kibble_sooner);
+    RUN_TEST(test_cancelled_staging_is_credited_to_the_next_feed);
+    RUN_TEST(test_feed_path_stops_allocating_after_boot);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+/**
+ * @file test_main.cpp
+ * @brief GzipStream checked against zlib inflate: pio test -e native -f test_gzip
+ */
+#include <unity.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "GzipStream.hpp"
+
+/** @brief Feeding history as /api/feeding/history serializes it, @p count entries. */
+static std::string feedingHistoryJson(int count)
+{
+    std::string json = "[";
+    char entry[160];
+    for (int i = 0; i < count; i++) {
+        const char* type = (i % 5 == 0) ? "immediate" : "recipe";
+        int len          = snprintf(entry, sizeof(entry), "%s{\"timestamp\":%u,\"type\":\"%s\",", i ? "," : "", 1760000000u + i * 28800u, type);
+        json.append(entry, len);
+        if (i % 5 != 0) {
+            len = snprintf(entry, sizeof(entry), "\"recipeUid\":%u,", 1 + i % 3);
+            json.append(entry, len);
+        }
+        len = snprintf(entry, sizeof(entry), "\"success\":%s,\"amount\":%d.%d}", (i % 17) ? "true" : "false", 20 + i % 60, i % 10);
+        json.append(entry, len);
+    }
+    json += "]";
+    return json;
+}
+
+static std::vector<uint8_t> randomBytes(size_t len, uint32_t seed)
+{
+    std::vector<uint8_t> data(len);
+    for (size_t i = 0; i < len; i++) {
+        seed    = seed * 1664525u + 1013904223u;
+        data[i] = (uint8_t)(seed >> 24);
+    }
+    return data;
+}
+
+static std::vector<uint8_t> compress(const uint8_t* data, size_t len, size_t chunk, uint8_t maxChain = GZIP_MAX_CHAIN)
+{
+    GzipStream* gz = new GzipStream(data, len); // about 6 KB, kept off the stack as on the device
+    gz->setMaxChain(maxChain);
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> buffer(chunk);
+    size_t n;
+    while ((n = gz->read(buffer.data(), chunk)) > 0) {
+        TEST_ASSERT_TRUE(n <= chunk);
+        out.insert(out.end(), buffer.begin(), buffer.begin() + n);
+    }
+    TEST_ASSERT_TRUE(gz->isDone());
+    TEST_ASSERT_EQUAL_size_t(len, gz->getInputPosition());
+    delete gz;
+    return out;
+}
+
+static std::vector<uint8_t> inflateGzip(const std::vector<uint8_t>& gz)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    TEST_ASSERT_EQUAL_INT(Z_OK, inflateInit2(&zs, 16 + MAX_WBITS)); // gzip wrapper only
+    std::vector<uint8_t> out;
+    uint8_t buffer[4096];
+    zs.next_in  = const_cast<uint8_t*>(gz.data());
+    zs.avail_in = (uInt)gz.size();
+    int rc;
+    do {
+        zs.next_out  = buffer;
+        zs.avail_out = sizeof(buffer);
+        rc           = inflate(&zs, Z_NO_FLUSH);
+        TEST_ASSERT_TRUE_MESSAGE(rc == Z_OK || rc == Z_STREAM_END, zs.msg ? zs.msg : "inflate failed");
+        out.insert(out.end(), buffer, buffer + (sizeof(buffer) - zs.avail_out));
+    } while (rc != Z_STREAM_END);
+    // Nothing may follow the trailer, and the trailer checks the CRC-32 and length
+    TEST_ASSERT_EQUAL_UINT32(0, zs.avail_in);
+    inflateEnd(&zs);
+    return out;
+}
+
+static void assertRoundTrip(const uint8_t* data, size_t len, size_t chunk, uint8_t maxChain = GZIP_MAX_CHAIN)
+{
+    std::vector<uint8_t> gz    = compress(data, len, chunk, maxChain);
+    std::vector<uint8_t> plain = inflateGzip(gz);
+    TEST_ASSERT_EQUAL_size_t(len, plain.size());
+    if (len > 0)
+        TEST_ASSERT_EQUAL_MEMORY(data, plain.data(), len);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_crc32_matches_zlib()
+{
+    std::vector<uint8_t> data = randomBytes(10000, 7);
+    TEST_ASSERT_EQUAL_UINT32(::crc32(0, data.data(), (uInt)data.size()), GzipStream::crc32(0, data.data(), data.size()));
+    // Incremental, as the encoder computes it chunk by chunk
+    uint32_t crc = GzipStream::crc32(0, data.data(), 333);
+    crc          = GzipStream::crc32(crc, data.data() + 333, data.size() - 333);
+    TEST_ASSERT_EQUAL_UINT32(::crc32(0, data.data(), (uInt)data.size()), crc);
+}
+
+void test_empty_and_tiny_inputs()
+{
+    assertRoundTrip(nullptr, 0, 64);
+    const uint8_t one[] = { 'x' };
+    assertRoundTrip(one, 1, 1);
+    const uint8_t three[] = { 'a', 'b', 'c' };
+    assertRoundTrip(three, 3, 2);
+}
+
+void test_json_at_every_chunk_size_and_effort()
+{
+    std::string json = feedingHistoryJson(60);
+    const size_t chunks[] = { 1, 2, 3, 7, 64, 536, 1436, 4096 };
+    for (size_t chunk : chunks)
+        for (uint8_t chain = 0; chain <= GZIP_MAX_CHAIN; chain++)
+            assertRoundTrip((const uint8_t*)json.data(), json.size(), chunk, chain);
+}
+
+void test_effort_lowered_mid_stream()
+{
+    // WebServer lowers the effort between chunks when one exceeds its CPU budget
+    std::string json = feedingHistoryJson(200);
+    GzipStream* gz   = new GzipStream((const uint8_t*)json.data(), json.size());
+    std::vector<uint8_t> out;
+    uint8_t buffer[512];
+    size_t n;
+    while ((n = gz->read(buffer, sizeof(buffer))) > 0) {
+        out.insert(out.end(), buffer, buffer + n);
+        gz->setMaxChain(gz->getMaxChain() / 2);
+    }
+    delete gz;
+    std::vector<uint8_t> plain = inflateGzip(out);
+    TEST_ASSERT_EQUAL_size_t(json.size(), plain.size());
+    TEST_ASSERT_EQUAL_MEMORY(json.data(), plain.data(), json.size());
+}
+
+void test_random_data_and_long_runs()
+{
+    std::vector<uint8_t> noise = randomBytes(20000, 42);
+    assertRoundTrip(noise.data(), noise.size(), 1436);
+    assertRoundTrip(noise.data(), noise.size(), 5);
+
+    // Matches longer than 258 bytes and distances up to the end of the window
+    std::vector<uint8_t> run(50000, 'A');
+    assertRoundTrip(run.data(), run.size(), 1436);
+    std::vector<uint8_t> periodic(30000);
+    for (size_t i = 0; i < periodic.size(); i++)
+        periodic[i] = (uint8_t)((i % (GZIP_WINDOW_SIZE - 1)) * 31);
+    assertRoundTrip(periodic.data(), periodic.size(), 1436);
+}
+
+void test_feeding_history_ratio()
+{
+    // The full history, FEEDING_HISTORY_MAX entries
+    std::string json        = feedingHistoryJson(50);
+    std::vector<uint8_t> gz = compress((const uint8_t*)json.data(), json.size(), 1436);
+    float ratio             = (float)json.size() / (float)gz.size();
+    char msg[96];
+    snprintf(msg, sizeof(msg), "feeding history: %u -> %u bytes, %.1fx", (unsigned)json.size(), (unsigned)gz.size(), ratio);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(ratio >= 5.0f);
+    TEST_ASSERT_EQUAL_size_t(json.size(), inflateGzip(gz).size());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_matches_zlib);
+    RUN_TEST(test_empty_and_tiny_inputs);
+    RUN_TEST(test_json_at_every_chunk_size_and_effort);
+    RUN_TEST(test_effort_lowered_mid_stream);
+    RUN_TEST(test_random_data_and_long_runs);
+    RUN_TEST(test_feeding_history_ratio);
+    return UNITY_END();
+}
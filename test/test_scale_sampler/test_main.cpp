@@ -0,0 +1,133 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the HX711 channel interleaving: pio test -e native -f test_scale_sampler
+ *
+ * Conversions are injected the way the sampling task hands them over: each read is clocked out
+ * with the gain of the active channel, which selects the input of the *next* conversion.
+ */
+#include <unity.h>
+#include "ScaleSampler.hpp"
+
+static const long HOPPER_RAW = 100000;
+static const long BOWL_RAW   = 20000;
+
+// Feeds one conversion of the input the chip is converting, as a real HX711 would return it.
+static ScaleConversion convert(ScaleSampler& sampler, bool settled = true)
+{
+    long raw = sampler.getChipChannel() == ScaleChannel::HOPPER ? HOPPER_RAW : BOWL_RAW;
+    return sampler.onConversion(raw, settled);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_first_window_averages_hopper()
+{
+    ScaleSampler sampler;
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT_EQUAL(ScaleConversion::ACCEPTED, convert(sampler));
+    TEST_ASSERT_EQUAL(ScaleChannel::HOPPER, sampler.getActiveChannel());
+    TEST_ASSERT_EQUAL_UINT8(8, sampler.getSampleCount());
+    TEST_ASSERT_EQUAL_INT32(HOPPER_RAW, sampler.getAverage());
+}
+
+void test_switch_drops_stale_then_settling_conversions()
+{
+    ScaleSampler sampler;
+    convert(sampler);
+    sampler.nextWindow();
+    TEST_ASSERT_EQUAL(ScaleChannel::BOWL, sampler.getActiveChannel());
+
+    // Still channel A: the read only selects B for the next conversion
+    TEST_ASSERT_EQUAL(ScaleConversion::STALE_INPUT, convert(sampler));
+    TEST_ASSERT_EQUAL(ScaleChannel::BOWL, sampler.getChipChannel());
+    for (uint8_t i = 0; i < ScaleSampler::CHANNEL_SWITCH_DISCARD; i++)
+        TEST_ASSERT_EQUAL(ScaleConversion::DISCARDED, convert(sampler));
+    TEST_ASSERT_EQUAL(ScaleConversion::ACCEPTED, convert(sampler));
+    TEST_ASSERT_EQUAL_UINT8(1, sampler.getSampleCount());
+    TEST_ASSERT_EQUAL_INT32(BOWL_RAW, sampler.getAverage());
+}
+
+void test_interleaved_windows_never_mix_channels()
+{
+    ScaleSampler sampler;
+    for (int window = 0; window < 6; window++) {
+        for (int i = 0; i < 12; i++)
+            convert(sampler);
+        long expected = sampler.getActiveChannel() == ScaleChannel::HOPPER ? HOPPER_RAW : BOWL_RAW;
+        TEST_ASSERT_EQUAL_INT32(expected, sampler.getAverage());
+        // The first window needs no switch, every other one loses the stale read and the discards
+        uint8_t lost = window == 0 ? 0 : 1 + ScaleSampler::CHANNEL_SWITCH_DISCARD;
+        TEST_ASSERT_EQUAL_UINT8(12 - lost, sampler.getSampleCount());
+        sampler.nextWindow();
+    }
+}
+
+void test_failures_do_not_consume_the_discard()
+{
+    ScaleSampler sampler;
+    sampler.startWindow(ScaleChannel::BOWL);
+    convert(sampler); // stale
+    TEST_ASSERT_EQUAL(ScaleConversion::FAILED, sampler.onConversion(0, true));
+    for (uint8_t i = 0; i < ScaleSampler::CHANNEL_SWITCH_DISCARD; i++)
+        TEST_ASSERT_EQUAL(ScaleConversion::DISCARDED, convert(sampler));
+    TEST_ASSERT_EQUAL(ScaleConversion::ACCEPTED, convert(sampler));
+    TEST_ASSERT_EQUAL_UINT8(1, sampler.getFailureCount());
+}
+
+void test_blanked_conversions_stay_out_of_the_average()
+{
+    ScaleSampler sampler;
+    TEST_ASSERT_EQUAL(ScaleConversion::BLANKED, sampler.onConversion(HOPPER_RAW * 3, false));
+    TEST_ASSERT_EQUAL(ScaleConversion::ACCEPTED, convert(sampler));
+    TEST_ASSERT_EQUAL_UINT8(1, sampler.getBlankedCount());
+    TEST_ASSERT_EQUAL_INT32(HOPPER_RAW, sampler.getAverage());
+}
+
+void test_blocking_read_switch_skips_the_stale_conversion()
+{
+    // HX711Scale::_selectChannel() clocks the stale conversion out itself, then waits the settling out
+    ScaleSampler sampler;
+    sampler.setChipChannel(ScaleChannel::BOWL);
+    sampler.startWindow(ScaleChannel::BOWL);
+    TEST_ASSERT_EQUAL(ScaleConversion::ACCEPTED, convert(sampler));
+}
+
+void test_power_up_falls_back_to_channel_a()
+{
+    ScaleSampler sampler;
+    sampler.startWindow(ScaleChannel::BOWL);
+    convert(sampler);
+    convert(sampler);
+    TEST_ASSERT_EQUAL(ScaleChannel::BOWL, sampler.getChipChannel());
+    sampler.onPowerUp();
+    sampler.startWindow(ScaleChannel::BOWL);
+    TEST_ASSERT_EQUAL(ScaleConversion::STALE_INPUT, convert(sampler));
+}
+
+void test_restarted_window_clears_accumulators()
+{
+    ScaleSampler sampler;
+    convert(sampler);
+    sampler.onConversion(0, true);
+    sampler.onConversion(HOPPER_RAW, false);
+    sampler.startWindow(ScaleChannel::HOPPER);
+    TEST_ASSERT_EQUAL_UINT8(0, sampler.getSampleCount());
+    TEST_ASSERT_EQUAL_UINT8(0, sampler.getFailureCount());
+    TEST_ASSERT_EQUAL_UINT8(0, sampler.getBlankedCount());
+    TEST_ASSERT_EQUAL_INT32(0, sampler.getAverage());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_window_averages_hopper);
+    RUN_TEST(test_switch_drops_stale_then_settling_conversions);
+    RUN_TEST(test_interleaved_windows_never_mix_channels);
+    RUN_TEST(test_failures_do_not_consume_the_discard);
+    RUN_TEST(test_blanked_conversions_stay_out_of_the_average);
+    RUN_TEST(test_blocking_read_switch_skips_the_stale_conversion);
+    RUN_TEST(test_power_up_falls_back_to_channel_a);
+    RUN_TEST(test_restarted_window_clears_accumulators);
+    return UNITY_END();
+}
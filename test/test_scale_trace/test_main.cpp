@@ -0,0 +1,300 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the scale trace codec and replay player: pio test -e native -f test_scale_trace
+ */
+#include <unity.h>
+#include <vector>
+#include "ScaleTraceFormat.hpp"
+#include "ScaleSampler.hpp"
+
+/**
+ * Encodes a trace the way ScaleTrace does on the device, with the record times given instead of
+ * read from millis().
+ */
+class TraceBuilder {
+  public:
+    explicit TraceBuilder(uint32_t startMillis = 123456, uint32_t startUnix = 1700000000) : _lastMs(0)
+    {
+        _lastRaw[0] = _lastRaw[1] = 0;
+        uint8_t header[SCALE_TRACE_HEADER_SIZE] = { 0 };
+        memcpy(header, SCALE_TRACE_MAGIC, 4);
+        header[4] = SCALE_TRACE_VERSION;
+        ScaleTraceCodec::putLe32(header + 8, startMillis);
+        ScaleTraceCodec::putLe32(header + 12, startUnix);
+        _bytes.assign(header, header + sizeof(header));
+        mark(0, ScaleTraceMark::CAPTURE_START);
+    }
+
+    TraceBuilder& sample(uint32_t timeMs, uint8_t channel, int32_t raw)
+    {
+        uint8_t record[SCALE_TRACE_MAX_RECORD];
+        size_t len = _putTag(record, timeMs, (ScaleTraceRecordType)channel);
+        len += ScaleTraceCodec::putVarint(record + len, ScaleTraceCodec::zigzag(raw - _lastRaw[channel]));
+        _lastRaw[channel] = raw;
+        _bytes.insert(_bytes.end(), record, record + len);
+        return *this;
+    }
+
+    TraceBuilder& servo(uint32_t timeMs, uint8_t servoNum, uint16_t pwm)
+    {
+        uint8_t record[SCALE_TRACE_MAX_RECORD];
+        size_t len    = _putTag(record, timeMs, ScaleTraceRecordType::SERVO);
+        record[len++] = servoNum;
+        len += ScaleTraceCodec::putVarint(record + len, pwm);
+        _bytes.insert(_bytes.end(), record, record + len);
+        return *this;
+    }
+
+    TraceBuilder& mark(uint32_t timeMs, ScaleTraceMark id)
+    {
+        uint8_t record[SCALE_TRACE_MAX_RECORD];
+        size_t len    = _putTag(record, timeMs, ScaleTraceRecordType::MARK);
+        record[len++] = (uint8_t)id;
+        _bytes.insert(_bytes.end(), record, record + len);
+        return *this;
+    }
+
+    ScaleTraceReader reader() const { return ScaleTraceReader(_bytes.data(), _bytes.size()); }
+    std::vector<uint8_t>& bytes() { return _bytes; }
+
+  private:
+    std::vector<uint8_t> _bytes;
+    uint32_t _lastMs;
+    int32_t _lastRaw[2];
+
+    size_t _putTag(uint8_t* out, uint32_t timeMs, ScaleTraceRecordType type)
+    {
+        uint32_t dt = timeMs - _lastMs;
+        _lastMs     = timeMs;
+        return ScaleTraceCodec::putVarint(out, (dt << 2) | (uint8_t)type);
+    }
+};
+
+static const uint8_t HOPPER = (uint8_t)ScaleTraceRecordType::SAMPLE_HOPPER;
+static const uint8_t BOWL   = (uint8_t)ScaleTraceRecordType::SAMPLE_BOWL;
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// Codec
+// ============================================================================
+
+void test_varint_and_zigzag_round_trip()
+{
+    const int32_t values[] = { 0, 1, -1, 63, -64, 8388607, -8388608, 2147483647, (-2147483647 - 1) };
+    for (int32_t v : values) {
+        uint8_t buf[5];
+        size_t n = ScaleTraceCodec::putVarint(buf, ScaleTraceCodec::zigzag(v));
+        TEST_ASSERT_TRUE(n >= 1 && n <= 5);
+        uint32_t decoded = 0;
+        for (size_t i = 0; i < n; i++)
+            decoded |= (uint32_t)(buf[i] & 0x7F) << (7 * i);
+        TEST_ASSERT_EQUAL_INT32(v, ScaleTraceCodec::unzigzag(decoded));
+    }
+    uint8_t le[4];
+    ScaleTraceCodec::putLe32(le, 0xA1B2C3D4);
+    TEST_ASSERT_EQUAL_UINT32(0xA1B2C3D4, ScaleTraceCodec::getLe32(le));
+}
+
+void test_reader_decodes_what_the_encoder_wrote()
+{
+    TraceBuilder trace;
+    trace.sample(12, HOPPER, 8388607).sample(25, BOWL, -8388608).servo(25, 15, 2400).sample(37, HOPPER, 8388600);
+    trace.mark(5000, ScaleTraceMark::CAPTURE_END);
+
+    ScaleTraceReader reader = trace.reader();
+    TEST_ASSERT_TRUE(reader.isValid());
+    TEST_ASSERT_EQUAL_UINT32(123456, reader.getStartMillis());
+    TEST_ASSERT_EQUAL_UINT32(1700000000, reader.getStartUnixTime());
+
+    ScaleTraceRecord r;
+    TEST_ASSERT_TRUE(reader.next(r));
+    TEST_ASSERT_EQUAL(ScaleTraceRecordType::MARK, r.type);
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)ScaleTraceMark::CAPTURE_START, r.index);
+    TEST_ASSERT_TRUE(reader.next(r));
+    TEST_ASSERT_EQUAL(ScaleTraceRecordType::SAMPLE_HOPPER, r.type);
+    TEST_ASSERT_EQUAL_UINT32(12, r.timeMs);
+    TEST_ASSERT_EQUAL_INT32(8388607, r.value);
+    TEST_ASSERT_TRUE(reader.next(r));
+    TEST_ASSERT_EQUAL(ScaleTraceRecordType::SAMPLE_BOWL, r.type);
+    TEST_ASSERT_EQUAL_INT32(-8388608, r.value);
+    TEST_ASSERT_TRUE(reader.next(r));
+    TEST_ASSERT_EQUAL(ScaleTraceRecordType::SERVO, r.type);
+    TEST_ASSERT_EQUAL_UINT32(25, r.timeMs);
+    TEST_ASSERT_EQUAL_UINT8(15, r.index);
+    TEST_ASSERT_EQUAL_INT32(2400, r.value);
+    TEST_ASSERT_TRUE(reader.next(r));
+    TEST_ASSERT_EQUAL_INT32(8388600, r.value); // delta against the previous hopper reading, not the bowl one
+    TEST_ASSERT_TRUE(reader.next(r));
+    TEST_ASSERT_EQUAL(ScaleTraceRecordType::MARK, r.type);
+    TEST_ASSERT_EQUAL_UINT32(5000, r.timeMs);
+    TEST_ASSERT_FALSE(reader.next(r));
+
+    reader.rewind();
+    TEST_ASSERT_TRUE(reader.next(r));
+    TEST_ASSERT_EQUAL(ScaleTraceRecordType::MARK, r.type);
+}
+
+void test_reader_rejects_bad_header_and_stops_on_truncation()
+{
+    TraceBuilder trace;
+    trace.sample(10, HOPPER, 1000).servo(20, 3, 1500);
+    std::vector<uint8_t> bytes = trace.bytes();
+
+    // Cut in the middle of the servo record
+    ScaleTraceReader truncated(bytes.data(), bytes.size() - 1);
+    ScaleTraceRecord r;
+    TEST_ASSERT_TRUE(truncated.next(r)); // mark
+    TEST_ASSERT_TRUE(truncated.next(r)); // sample
+    TEST_ASSERT_FALSE(truncated.next(r));
+
+    bytes[4] = SCALE_TRACE_VERSION + 1;
+    ScaleTraceReader wrongVersion(bytes.data(), bytes.size());
+    TEST_ASSERT_FALSE(wrongVersion.isValid());
+    TEST_ASSERT_FALSE(wrongVersion.next(r));
+
+    ScaleTraceReader tooShort(bytes.data(), SCALE_TRACE_HEADER_SIZE - 1);
+    TEST_ASSERT_FALSE(tooShort.isValid());
+}
+
+// ============================================================================
+// Player
+// ============================================================================
+
+void test_player_serves_samples_at_their_recorded_time()
+{
+    TraceBuilder trace;
+    trace.sample(100, HOPPER, 11).sample(200, HOPPER, 12);
+    ScaleTracePlayer player(trace.reader());
+    TEST_ASSERT_TRUE(player.isValid());
+
+    int32_t raw;
+    uint32_t next;
+    TEST_ASSERT_FALSE(player.isSampleDue(HOPPER, 99));
+    TEST_ASSERT_FALSE(player.takeSample(HOPPER, 99, raw));
+    TEST_ASSERT_TRUE(player.nextSampleTime(HOPPER, next));
+    TEST_ASSERT_EQUAL_UINT32(100, next);
+    TEST_ASSERT_TRUE(player.takeSample(HOPPER, 100, raw));
+    TEST_ASSERT_EQUAL_INT32(11, raw);
+    TEST_ASSERT_FALSE(player.takeSample(HOPPER, 150, raw));
+    TEST_ASSERT_TRUE(player.takeSample(HOPPER, 200, raw));
+    TEST_ASSERT_EQUAL_INT32(12, raw);
+    TEST_ASSERT_FALSE(player.nextSampleTime(HOPPER, next));
+}
+
+void test_player_skips_to_the_latest_due_sample()
+{
+    TraceBuilder trace;
+    trace.sample(10, HOPPER, 1).sample(20, HOPPER, 2).sample(30, HOPPER, 3).sample(40, HOPPER, 4);
+    ScaleTracePlayer player(trace.reader());
+    int32_t raw;
+    TEST_ASSERT_TRUE(player.takeSample(HOPPER, 35, raw));
+    TEST_ASSERT_EQUAL_INT32(3, raw);
+    TEST_ASSERT_TRUE(player.takeSample(HOPPER, 40, raw));
+    TEST_ASSERT_EQUAL_INT32(4, raw);
+}
+
+void test_player_keeps_channels_apart()
+{
+    TraceBuilder trace;
+    trace.sample(10, HOPPER, 100).sample(20, BOWL, 200).sample(30, HOPPER, 101).sample(40, BOWL, 201);
+    ScaleTracePlayer player(trace.reader());
+    int32_t raw;
+    // Reading the bowl late never hands out a hopper conversion, and leaves the hopper cursor alone
+    TEST_ASSERT_TRUE(player.takeSample(BOWL, 45, raw));
+    TEST_ASSERT_EQUAL_INT32(201, raw);
+    TEST_ASSERT_FALSE(player.isSampleDue(BOWL, 1000));
+    TEST_ASSERT_TRUE(player.takeSample(HOPPER, 10, raw));
+    TEST_ASSERT_EQUAL_INT32(100, raw);
+    TEST_ASSERT_TRUE(player.takeSample(HOPPER, 30, raw));
+    TEST_ASSERT_EQUAL_INT32(101, raw);
+}
+
+void test_player_serves_servo_commands_in_order_with_their_travel()
+{
+    TraceBuilder trace;
+    trace.servo(5, 2, 1500).sample(10, HOPPER, 1).servo(50, 2, 1000).servo(50, 7, 2000).servo(90, 2, 1800);
+    ScaleTracePlayer player(trace.reader());
+    uint8_t servo;
+    uint16_t pwm, travel;
+
+    TEST_ASSERT_FALSE(player.takeServo(4, servo, pwm, travel));
+    TEST_ASSERT_TRUE(player.takeServo(60, servo, pwm, travel));
+    TEST_ASSERT_EQUAL_UINT8(2, servo);
+    TEST_ASSERT_EQUAL_UINT16(1500, pwm);
+    TEST_ASSERT_EQUAL_UINT16(1500, travel); // from unpowered
+    TEST_ASSERT_TRUE(player.takeServo(60, servo, pwm, travel));
+    TEST_ASSERT_EQUAL_UINT16(1000, pwm);
+    TEST_ASSERT_EQUAL_UINT16(500, travel);
+    TEST_ASSERT_TRUE(player.takeServo(60, servo, pwm, travel));
+    TEST_ASSERT_EQUAL_UINT8(7, servo);
+    TEST_ASSERT_FALSE(player.takeServo(60, servo, pwm, travel));
+    TEST_ASSERT_FALSE(player.isFinished(60));
+    TEST_ASSERT_TRUE(player.takeServo(90, servo, pwm, travel));
+    TEST_ASSERT_EQUAL_UINT16(800, travel);
+
+    // The servo cursor does not consume the samples
+    int32_t raw;
+    TEST_ASSERT_TRUE(player.takeSample(HOPPER, 90, raw));
+}
+
+void test_player_finishes_after_the_last_record()
+{
+    TraceBuilder trace;
+    trace.sample(10, HOPPER, 1).mark(300, ScaleTraceMark::CAPTURE_END);
+    ScaleTracePlayer player(trace.reader());
+    TEST_ASSERT_FALSE(player.isFinished(299));
+    TEST_ASSERT_TRUE(player.isFinished(300));
+
+    ScaleTracePlayer idle;
+    TEST_ASSERT_FALSE(idle.isValid());
+    TEST_ASSERT_TRUE(idle.isFinished(0));
+}
+
+void test_replay_through_the_sampler_keeps_channels_apart()
+{
+    // A capture of the device's own interleaving: 12 conversions of each channel per window at 80Hz
+    const int32_t hopperRaw = 500000, bowlRaw = -30000;
+    TraceBuilder trace;
+    uint32_t t      = 0;
+    uint8_t channel = HOPPER;
+    for (int window = 0; window < 4; window++, channel ^= 1)
+        for (int i = 0; i < 12; i++, t += 12)
+            trace.sample(t, channel, channel == HOPPER ? hopperRaw + i : bowlRaw - i);
+
+    // The replaying side switches windows at its own pace, every 8 conversions
+    ScaleTracePlayer player(trace.reader());
+    ScaleSampler sampler;
+    uint32_t now = 0;
+    for (int window = 0; window < 4; window++) {
+        for (int reads = 0; reads < 8; now++) {
+            int32_t raw;
+            if (!player.takeSample((uint8_t)sampler.getChipChannel(), now, raw))
+                continue;
+            sampler.onConversion(raw, true);
+            reads++;
+        }
+        TEST_ASSERT_TRUE(sampler.getSampleCount() > 0);
+        if (sampler.getActiveChannel() == ScaleChannel::HOPPER)
+            TEST_ASSERT_TRUE(sampler.getAverage() >= hopperRaw && sampler.getAverage() < hopperRaw + 12);
+        else
+            TEST_ASSERT_TRUE(sampler.getAverage() <= bowlRaw && sampler.getAverage() > bowlRaw - 12);
+        sampler.nextWindow();
+    }
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_varint_and_zigzag_round_trip);
+    RUN_TEST(test_reader_decodes_what_the_encoder_wrote);
+    RUN_TEST(test_reader_rejects_bad_header_and_stops_on_truncation);
+    RUN_TEST(test_player_serves_samples_at_their_recorded_time);
+    RUN_TEST(test_player_skips_to_the_latest_due_sample);
+    RUN_TEST(test_player_keeps_channels_apart);
+    RUN_TEST(test_player_serves_servo_commands_in_order_with_their_travel);
+    RUN_TEST(test_player_finishes_after_the_last_record);
+    RUN_TEST(test_replay_through_the_sampler_keeps_channels_apart);
+    return UNITY_END();
+}
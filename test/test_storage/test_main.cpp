@@ -0,0 +1,250 @@
+/**
+ * @file test_main.cpp
+ * @brief The SPIFFS to LittleFS migration of Storage, on an in-memory flash: pio test -e native_storage -f test_storage
+ *
+ * Each boot is a fresh Storage over the same data partition and OTA slot, as after a reset. A power
+ * loss is a HostPowerLoss thrown from a flash hook: what was written stays, the RAM state does not.
+ */
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "Storage.hpp"
+#include <LittleFS.h>
+#include <SPIFFS.h>
+
+fs::LittleFSFS LittleFS;
+fs::SPIFFSFS SPIFFS;
+
+struct HostPowerLoss {};
+
+static HostPartition* scratch;
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t*) { return scratch; }
+
+/** @brief Files as a SPIFFS device holds them: settings, recipes, a log and a scale trace. */
+static std::map<std::string, std::vector<uint8_t>> legacyFiles()
+{
+    std::map<std::string, std::vector<uint8_t>> files;
+    const char* settings = "{\"timezone\":\"CET-1CEST,M3.5.0,M10.5.0/3\",\"hopperOpenPwm\":1800}";
+    const char* recipes  = "[{\"uid\":1,\"name\":\"Morning\",\"ingredients\":[{\"tankUid\":\"A1\",\"percentage\":100}]}]";
+    files["/settings.json"].assign(settings, settings + strlen(settings));
+    files["/recipes.json"].assign(recipes, recipes + strlen(recipes));
+    uint32_t seed = 1;
+    for (int i = 0; i < 5000; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        files["/scale_trace.bin"].push_back((uint8_t)(seed >> 24));
+    }
+    for (int i = 0; i < 300; i++)
+        files["/kibblet5.log"].push_back((uint8_t)('a' + i % 26));
+    return files;
+}
+
+static void seedSpiffs()
+{
+    hostDataPartition().format       = "spiffs";
+    hostDataPartition().volume.files = legacyFiles();
+}
+
+static void reset()
+{
+    LittleFS.end();
+    SPIFFS.end();
+    fs::hostMounts().clear();
+}
+
+/** @brief Boots a fresh Storage; a power loss during begin() leaves it unmounted. */
+static bool boot(Storage& storage)
+{
+    reset();
+    try {
+        return storage.begin();
+    } catch (const HostPowerLoss&) {
+        return false;
+    }
+}
+
+static std::vector<uint8_t> readAll(fs::FS& fs, const char* path)
+{
+    std::vector<uint8_t> content;
+    File file = fs.open(path, FILE_READ);
+    uint8_t buffer[256];
+    for (size_t len; file && (len = file.read(buffer, sizeof(buffer))) > 0;)
+        content.insert(content.end(), buffer, buffer + len);
+    return content;
+}
+
+static void assertLegacyContent(Storage& storage)
+{
+    std::map<std::string, std::vector<uint8_t>> expected = legacyFiles();
+    TEST_ASSERT_EQUAL_size_t(expected.size(), hostDataPartition().volume.files.size());
+    for (const auto& file : expected)
+        TEST_ASSERT_TRUE_MESSAGE(readAll(storage, file.first.c_str()) == file.second, file.first.c_str());
+}
+
+static bool archiveCommitted()
+{
+    uint32_t magic;
+    esp_partition_read(scratch, 0, &magic, sizeof(magic));
+    return magic == STORAGE_ARCHIVE_MAGIC;
+}
+
+void setUp()
+{
+    reset();
+    hostDataPartition() = HostDataPartition();
+    scratch             = new HostPartition("app1", 64 * 1024);
+}
+
+void tearDown()
+{
+    reset();
+    delete scratch;
+    scratch = nullptr;
+}
+
+void test_spiffs_is_migrated()
+{
+    seedSpiffs();
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::MIGRATED, (int)storage.getMigration());
+    TEST_ASSERT_EQUAL_INT((int)StorageBackend::LITTLEFS, (int)storage.getBackend());
+    TEST_ASSERT_TRUE(hostDataPartition().format == "littlefs");
+    assertLegacyContent(storage);
+    TEST_ASSERT_FALSE(archiveCommitted());
+}
+
+void test_second_boot_needs_nothing()
+{
+    seedSpiffs();
+    Storage first;
+    TEST_ASSERT_TRUE(boot(first));
+    Storage second;
+    TEST_ASSERT_TRUE(boot(second));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::NOT_NEEDED, (int)second.getMigration());
+    assertLegacyContent(second);
+}
+
+void test_power_loss_after_format_is_resumed()
+{
+    seedSpiffs();
+    int writes                           = 0;
+    hostDataPartition().volume.onWrite   = [&writes](size_t) -> bool {
+        if (hostDataPartition().format == "littlefs" && ++writes == 3)
+            throw HostPowerLoss();
+        return true;
+    };
+    Storage interrupted;
+    TEST_ASSERT_FALSE(boot(interrupted));
+    TEST_ASSERT_TRUE(archiveCommitted());
+
+    hostDataPartition().volume.onWrite = nullptr;
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::RESUMED, (int)storage.getMigration());
+    TEST_ASSERT_EQUAL_INT((int)StorageBackend::LITTLEFS, (int)storage.getBackend());
+    assertLegacyContent(storage);
+    TEST_ASSERT_FALSE(archiveCommitted());
+}
+
+void test_power_loss_before_format_is_resumed()
+{
+    seedSpiffs();
+    hostDataPartition().onFormat = []() { throw HostPowerLoss(); };
+    Storage interrupted;
+    TEST_ASSERT_FALSE(boot(interrupted));
+    TEST_ASSERT_TRUE(hostDataPartition().format == "spiffs");
+
+    hostDataPartition().onFormat = nullptr;
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::RESUMED, (int)storage.getMigration());
+    assertLegacyContent(storage);
+}
+
+void test_damaged_archive_formats_nothing()
+{
+    seedSpiffs();
+    hostDataPartition().onFormat = []() { throw HostPowerLoss(); };
+    Storage interrupted;
+    TEST_ASSERT_FALSE(boot(interrupted));
+    TEST_ASSERT_TRUE(archiveCommitted());
+    // One bit lost in the records, the header still checks out
+    scratch->flash[STORAGE_SECTOR_SIZE + 40] ^= 0x01;
+
+    // The format hook is still armed: any format now would cut the power and fail the test
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::KEPT_SPIFFS, (int)storage.getMigration());
+    TEST_ASSERT_EQUAL_INT((int)StorageBackend::SPIFFS, (int)storage.getBackend());
+    assertLegacyContent(storage);
+    TEST_ASSERT_FALSE(archiveCommitted());
+
+    // The next boot packs a fresh archive and migrates
+    hostDataPartition().onFormat = nullptr;
+    Storage next;
+    TEST_ASSERT_TRUE(boot(next));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::MIGRATED, (int)next.getMigration());
+    assertLegacyContent(next);
+}
+
+void test_archive_write_failure_keeps_spiffs()
+{
+    seedSpiffs();
+    scratch->writesLeft = 2;
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::KEPT_SPIFFS, (int)storage.getMigration());
+    TEST_ASSERT_EQUAL_INT((int)StorageBackend::SPIFFS, (int)storage.getBackend());
+    assertLegacyContent(storage);
+    TEST_ASSERT_FALSE(archiveCommitted());
+}
+
+void test_littlefs_write_failure_rolls_back()
+{
+    seedSpiffs();
+    hostDataPartition().volume.onWrite = [](size_t) { return hostDataPartition().format != "littlefs"; };
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::ROLLED_BACK, (int)storage.getMigration());
+    TEST_ASSERT_EQUAL_INT((int)StorageBackend::SPIFFS, (int)storage.getBackend());
+    TEST_ASSERT_TRUE(hostDataPartition().format == "spiffs");
+    assertLegacyContent(storage);
+    TEST_ASSERT_FALSE(archiveCommitted());
+}
+
+void test_content_too_large_keeps_spiffs()
+{
+    seedSpiffs();
+    delete scratch;
+    scratch = new HostPartition("app1", 2 * STORAGE_SECTOR_SIZE);
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::KEPT_SPIFFS, (int)storage.getMigration());
+    TEST_ASSERT_EQUAL_INT((int)StorageBackend::SPIFFS, (int)storage.getBackend());
+    assertLegacyContent(storage);
+}
+
+void test_blank_partition_is_formatted()
+{
+    Storage storage;
+    TEST_ASSERT_TRUE(boot(storage));
+    TEST_ASSERT_EQUAL_INT((int)StorageMigration::NOT_NEEDED, (int)storage.getMigration());
+    TEST_ASSERT_EQUAL_INT((int)StorageBackend::LITTLEFS, (int)storage.getBackend());
+    TEST_ASSERT_EQUAL_size_t(0, hostDataPartition().volume.files.size());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_spiffs_is_migrated);
+    RUN_TEST(test_second_boot_needs_nothing);
+    RUN_TEST(test_power_loss_after_format_is_resumed);
+    RUN_TEST(test_power_loss_before_format_is_resumed);
+    RUN_TEST(test_damaged_archive_formats_nothing);
+    RUN_TEST(test_archive_write_failure_keeps_spiffs);
+    RUN_TEST(test_littlefs_write_failure_rolls_back);
+    RUN_TEST(test_content_too_large_keeps_spiffs);
+    RUN_TEST(test_blank_partition_is_formatted);
+    return UNITY_END();
+}
@@ -0,0 +1,245 @@
+#include "SwiMuxEmulator.hpp"
+#include <Arduino.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+constexpr size_t SwiMuxEmulator::EEPROM_SIZE;
+
+SwiMuxEmulator::SwiMuxEmulator(uint32_t maxCleanBauds, bool supportsBaudNegotiation)
+    : _maxCleanBauds(maxCleanBauds), _supportsBaudNegotiation(supportsBaudNegotiation), _masterFd(-1), _slaveFd(-1), _running(false),
+      _powerCyclePending(false), _bauds(SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS), _framesServed(0), _committing(false), _commitDeadline(0),
+      _codec(new SwiMuxComms_t())
+{
+    memset(_present, 0, sizeof(_present));
+    memset(_eeprom, 0xFF, sizeof(_eeprom));
+}
+
+SwiMuxEmulator::~SwiMuxEmulator()
+{
+    stop();
+    delete _codec;
+}
+
+bool SwiMuxEmulator::start()
+{
+    _masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (_masterFd < 0 || grantpt(_masterFd) != 0 || unlockpt(_masterFd) != 0)
+        return false;
+    _slaveFd = open(ptsname(_masterFd), O_RDWR | O_NOCTTY);
+    if (_slaveFd < 0)
+        return false;
+    struct termios tio;
+    tcgetattr(_slaveFd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(_slaveFd, TCSANOW, &tio);
+
+    _running = true;
+    _thread  = std::thread(&SwiMuxEmulator::_run, this);
+    return true;
+}
+
+void SwiMuxEmulator::stop()
+{
+    _running = false;
+    if (_thread.joinable())
+        _thread.join();
+    if (_slaveFd >= 0)
+        close(_slaveFd);
+    if (_masterFd >= 0)
+        close(_masterFd);
+    _slaveFd = _masterFd = -1;
+}
+
+void SwiMuxEmulator::insertTank(uint8_t bus)
+{
+    std::lock_guard<std::mutex> lock(_memLock);
+    _present[bus] = true;
+    for (size_t i = 0; i < EEPROM_SIZE; i++)
+        _eeprom[bus][i] = (uint8_t)(bus * 16 + i);
+}
+
+void SwiMuxEmulator::readEeprom(uint8_t bus, uint8_t* out)
+{
+    std::lock_guard<std::mutex> lock(_memLock);
+    memcpy(out, _eeprom[bus], EEPROM_SIZE);
+}
+
+bool SwiMuxEmulator::_hears() const
+{
+    // Both ends of a pty share the termios of the slave side, which the host's HardwareSerial sets
+    struct termios tio;
+    if (tcgetattr(_slaveFd, &tio) != 0)
+        return false;
+    return HardwareSerial::fromSpeed(cfgetospeed(&tio)) == _bauds && _bauds <= _maxCleanBauds;
+}
+
+void SwiMuxEmulator::_run()
+{
+    while (_running) {
+        if (_powerCyclePending.exchange(false)) {
+            delete _codec;
+            _codec      = new SwiMuxComms_t();
+            _bauds      = SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS;
+            _committing = false;
+        }
+        if (_committing && (long)(millis() - _commitDeadline) >= 0) {
+            // No valid frame at the new rate: back to the default one
+            _bauds      = SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS;
+            _committing = false;
+        }
+
+        struct pollfd pfd = { _masterFd, POLLIN, 0 };
+        if (poll(&pfd, 1, 1) <= 0 || !(pfd.revents & POLLIN))
+            continue;
+        uint8_t buffer[64];
+        ssize_t n = ::read(_masterFd, buffer, sizeof(buffer));
+        for (ssize_t i = 0; i < n; i++) {
+            if (!_hears())
+                continue; // line noise at this rate
+            uint8_t* payload = nullptr;
+            size_t len       = 0;
+            if (_codec->decode(buffer[i], payload, len) == SMERR_Done && payload != nullptr && len >= 2) {
+                _committing = false;
+                _onFrame(payload, len);
+            }
+        }
+    }
+}
+
+void SwiMuxEmulator::_send(const uint8_t* payload, size_t len)
+{
+    _codec->encode(payload, len, [this](uint8_t value) {
+        if (::write(_masterFd, &value, 1) != 1)
+            return;
+    });
+    _framesServed++;
+}
+
+void SwiMuxEmulator::_sendAck(uint8_t opcode)
+{
+    // ASSUMED framing: the request opcode and its complement. Requests are framed that way by
+    // SwiMuxSerial_t, but the ACK and NACK layouts were not checked against SwiMuxComms_t::waitForAckTo(),
+    // whose sources are not in this tree. Check them against the firmware before trusting a pass here.
+    uint8_t ack[2] = { opcode, (uint8_t)~opcode };
+    _send(ack, sizeof(ack));
+}
+
+void SwiMuxEmulator::_sendNack(SwiMuxError_e error)
+{
+    // ASSUMED framing, as for _sendAck(): Nack opcode, its complement, then the error code.
+    uint8_t nack[3] = { SMCMD_Nack, (uint8_t)~SMCMD_Nack, (uint8_t)error };
+    _send(nack, sizeof(nack));
+}
+
+void SwiMuxEmulator::_onFrame(const uint8_t* payload, size_t len)
+{
+    uint8_t opcode = payload[0];
+    if (payload[1] != (uint8_t)~opcode) {
+        _sendNack(SMERR_UnkownCommand);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_memLock);
+    switch (opcode) {
+        case SMCMD_Wakeup:
+        case SMCMD_Sleep:
+            _sendAck(opcode);
+            break;
+
+        case SMCMD_GetPresence: {
+            uint16_t map  = 0;
+            uint8_t count = 0;
+            for (uint8_t bus = 0; bus < NUMBER_OF_BUSES; bus++) {
+                if (_present[bus]) {
+                    map |= (uint16_t)(1 << bus);
+                    count++;
+                }
+            }
+            SwiMuxCmdPresence_t resp = { SMCMD_GetPresence, (uint8_t)~SMCMD_GetPresence, count, (uint8_t)map, (uint8_t)(map >> 8) };
+            _send((const uint8_t*)&resp, sizeof(resp));
+            break;
+        }
+
+        case SMCMD_RollCall: {
+            SwiMuxRollCallResult_t resp;
+            resp.Opcode    = SMCMD_RollCall;
+            resp.NegOpcode = (uint8_t)~SMCMD_RollCall;
+            for (uint8_t bus = 0; bus < NUMBER_OF_BUSES; bus++) {
+                uint64_t uid = _present[bus] ? uidOf(bus) : UINT64_MAX;
+                memcpy((uint8_t*)&resp + 2 + bus * 8, &uid, 8);
+            }
+            _send((const uint8_t*)&resp, sizeof(resp));
+            break;
+        }
+
+        case SMCMD_GetUID: {
+            uint8_t bus = len > 2 ? payload[2] : NUMBER_OF_BUSES;
+            if (bus >= NUMBER_OF_BUSES || !_present[bus]) {
+                _sendNack((SwiMuxError_e)SMREZ_OW_NO_DEVICE_PRESENT);
+                break;
+            }
+            uint8_t resp[10] = { SMCMD_HaveUID, (uint8_t)~SMCMD_HaveUID };
+            uint64_t uid     = uidOf(bus);
+            memcpy(resp + 2, &uid, 8);
+            _send(resp, sizeof(resp));
+            break;
+        }
+
+        case SMCMD_ReadBytes: {
+            SwiMuxCmdRead_t cmd;
+            if (len < sizeof(cmd)) {
+                _sendNack((SwiMuxError_e)SMREZ_ReadBytesParams);
+                break;
+            }
+            memcpy(&cmd, payload, sizeof(cmd));
+            if (cmd.busIndex >= NUMBER_OF_BUSES || !_present[cmd.busIndex] || cmd.offset + cmd.length > EEPROM_SIZE) {
+                _sendNack((SwiMuxError_e)SMREZ_ReadBytesParams);
+                break;
+            }
+            uint8_t resp[sizeof(SwiMuxCmdRead_t) + EEPROM_SIZE];
+            memcpy(resp, &cmd, sizeof(cmd));
+            memcpy(resp + sizeof(cmd), &_eeprom[cmd.busIndex][cmd.offset], cmd.length);
+            _send(resp, sizeof(cmd) + cmd.length);
+            break;
+        }
+
+        case SMCMD_WriteBytes: {
+            SwiMuxCmdWrite_t cmd;
+            if (len < sizeof(cmd)) {
+                _sendNack((SwiMuxError_e)SMREZ_WriteLengthOutOfRange);
+                break;
+            }
+            memcpy(&cmd, payload, sizeof(cmd));
+            if (cmd.busIndex >= NUMBER_OF_BUSES || !_present[cmd.busIndex] || cmd.offset + cmd.length > EEPROM_SIZE
+              || len < sizeof(cmd) + cmd.length) {
+                _sendNack((SwiMuxError_e)SMREZ_WriteLengthOutOfRange);
+                break;
+            }
+            memcpy(&_eeprom[cmd.busIndex][cmd.offset], payload + sizeof(cmd), cmd.length);
+            _sendAck(opcode);
+            break;
+        }
+
+        case SMCMD_SetBaudRate: {
+            if (!_supportsBaudNegotiation || len < sizeof(SwiMuxCmdSetBaud_t)) {
+                _sendNack(SMERR_UnkownCommand);
+                break;
+            }
+            const SwiMuxCmdSetBaud_t* cmd = (const SwiMuxCmdSetBaud_t*)payload;
+            uint32_t bauds = (uint32_t)cmd->bauds[0] | ((uint32_t)cmd->bauds[1] << 8) | ((uint32_t)cmd->bauds[2] << 16) | ((uint32_t)cmd->bauds[3] << 24);
+            _sendAck(opcode);
+            // The ACK leaves at the current rate, then the SwiMux follows the host
+            tcdrain(_masterFd);
+            _bauds          = bauds;
+            _committing     = true;
+            _commitDeadline = millis() + SWIMUX_BAUD_COMMIT_MS;
+            break;
+        }
+
+        default:
+            _sendNack(SMERR_UnkownCommand);
+            break;
+    }
+}
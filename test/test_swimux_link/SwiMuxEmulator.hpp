@@ -0,0 +1,78 @@
+#ifndef H_SWIMUX_EMULATOR_H
+#define H_SWIMUX_EMULATOR_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "SwiMuxSerial.h"
+
+/**
+ * @class SwiMuxEmulator
+ * @brief SwiMux firmware stand-in on the master side of a Linux pty, for host tests of SwiMuxSerial_t.
+ *
+ * It frames with the same SwiMuxComms_t codec as the firmware and serves 6 buses of 128-byte
+ * EEPROMs. A frame is only heard when the rate the host set on the pty matches the emulator's
+ * own rate, and that rate does not exceed the wiring limit given to the constructor: otherwise the
+ * bytes count as line noise, as a UART receiving at the wrong or a marginal rate would see them.
+ * SetBaudRate is acknowledged at the current rate, then followed by the switch, and reverted
+ * after SWIMUX_BAUD_COMMIT_MS without a valid frame at the new rate.
+ *
+ * The ACK/NACK payload layout (opcode, complement[, error]) is assumed, not taken from the firmware:
+ * a pass here proves SwiMuxSerial_t against that layout only.
+ */
+class SwiMuxEmulator {
+  public:
+    static constexpr size_t EEPROM_SIZE = 128;
+
+    /**
+     * @param maxCleanBauds Fastest rate the emulated wiring carries without errors.
+     * @param supportsBaudNegotiation false to emulate a firmware that predates SetBaudRate.
+     */
+    explicit SwiMuxEmulator(uint32_t maxCleanBauds = 921600, bool supportsBaudNegotiation = true);
+    ~SwiMuxEmulator();
+
+    /** @brief Opens the pty and starts serving it. */
+    bool start();
+    void stop();
+
+    /** @brief Descriptor of the pty side the host's HardwareSerial is attached to. */
+    int hostFd() const { return _slaveFd; }
+
+    /** @brief Places an EEPROM on @p bus, with a UID derived from the bus index. */
+    void insertTank(uint8_t bus);
+    uint64_t uidOf(uint8_t bus) const { return 0x2D00000000000000ULL | ((uint64_t)0xC0FFEE << 8) | bus; }
+    void readEeprom(uint8_t bus, uint8_t* out);
+
+    /** @brief Emulates a power cycle: the SwiMux is back at DEFAULT_SERIAL_BAUDS, its pending switch forgotten. */
+    void powerCycle() { _powerCyclePending = true; }
+
+    uint32_t getBaudRate() const { return _bauds; }
+    uint32_t getFramesServed() const { return _framesServed; }
+
+  private:
+    uint32_t _maxCleanBauds;
+    bool _supportsBaudNegotiation;
+    int _masterFd, _slaveFd;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::atomic<bool> _powerCyclePending;
+    std::atomic<uint32_t> _bauds;
+    std::atomic<uint32_t> _framesServed;
+    bool _committing;             // a switch awaits its first valid frame
+    unsigned long _commitDeadline;
+
+    std::mutex _memLock;
+    bool _present[NUMBER_OF_BUSES];
+    uint8_t _eeprom[NUMBER_OF_BUSES][EEPROM_SIZE];
+
+    SwiMuxComms_t* _codec;
+
+    void _run();
+    bool _hears() const;
+    void _onFrame(const uint8_t* payload, size_t len);
+    void _send(const uint8_t* payload, size_t len);
+    void _sendAck(uint8_t opcode);
+    void _sendNack(SwiMuxError_e error);
+};
+
+#endif // H_SWIMUX_EMULATOR_H
@@ -0,0 +1,125 @@
+/**
+ * @file test_main.cpp
+ * @brief Link speed negotiation of SwiMuxSerial_t against an emulated SwiMux on a pty: pio test -e native_swimux
+ *
+ * Linux only. Each test runs the real SwiMuxSerial_t and SwiMuxComms_t over a fresh pty, the
+ * emulator serving the other end.
+ */
+#include <unity.h>
+#include <Arduino.h>
+#include "SwiMuxSerial.h"
+#include "SwiMuxEmulator.hpp"
+
+static SwiMuxEmulator* emulator;
+static HardwareSerial* port;
+static SwiMuxSerial_t* swimux;
+
+static void connect(uint32_t maxCleanBauds, bool supportsBaudNegotiation = true)
+{
+    emulator = new SwiMuxEmulator(maxCleanBauds, supportsBaudNegotiation);
+    TEST_ASSERT_TRUE(emulator->start());
+    emulator->insertTank(0);
+    emulator->insertTank(3);
+    port = new HardwareSerial(2);
+    port->attach(emulator->hostFd());
+    swimux = new SwiMuxSerial_t(*port, 17, 16);
+    swimux->begin();
+}
+
+// The link must still carry a full tank discovery and an EEPROM image write, whatever the rate it settled on
+static void assertLinkWorks()
+{
+    RollCallArray_t uids;
+    TEST_ASSERT_EQUAL(SMREZ_OK, swimux->rollCall(uids));
+    TEST_ASSERT_TRUE(uids.bus[0] == emulator->uidOf(0));
+    TEST_ASSERT_TRUE(uids.bus[1] == UINT64_MAX);
+    TEST_ASSERT_TRUE(uids.bus[3] == emulator->uidOf(3));
+
+    uint8_t image[SwiMuxEmulator::EEPROM_SIZE];
+    for (size_t i = 0; i < sizeof(image); i++)
+        image[i] = (uint8_t)(0xA5 ^ i);
+    TEST_ASSERT_EQUAL(SMREZ_OK, swimux->write(3, image, 0, sizeof(image)));
+    uint8_t readBack[SwiMuxEmulator::EEPROM_SIZE] = { 0 };
+    TEST_ASSERT_EQUAL(SMREZ_OK, swimux->read(3, readBack, 0, sizeof(readBack)));
+    TEST_ASSERT_EQUAL_MEMORY(image, readBack, sizeof(image));
+    emulator->readEeprom(3, readBack);
+    TEST_ASSERT_EQUAL_MEMORY(image, readBack, sizeof(image));
+}
+
+void setUp() {}
+
+void tearDown()
+{
+    delete swimux;
+    delete port;
+    delete emulator;
+    swimux   = nullptr;
+    port     = nullptr;
+    emulator = nullptr;
+}
+
+void test_negotiates_the_fastest_rate()
+{
+    connect(921600);
+    TEST_ASSERT_EQUAL(SMREZ_OK, swimux->negotiateBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(921600, swimux->getBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(921600, emulator->getBaudRate());
+    assertLinkWorks();
+}
+
+void test_tries_the_preferred_rate_first()
+{
+    connect(921600);
+    TEST_ASSERT_EQUAL(SMREZ_OK, swimux->negotiateBaudRate(460800));
+    TEST_ASSERT_EQUAL_UINT32(460800, swimux->getBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(460800, emulator->getBaudRate());
+}
+
+void test_settles_on_the_fastest_rate_that_passes_the_link_test()
+{
+    // The SwiMux acknowledges 921600 and 460800, but the wiring garbles both
+    connect(230400);
+    TEST_ASSERT_EQUAL(SMREZ_OK, swimux->negotiateBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(230400, swimux->getBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(230400, emulator->getBaudRate());
+    assertLinkWorks();
+}
+
+void test_stays_at_default_when_no_rate_passes()
+{
+    connect(SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS);
+    TEST_ASSERT_EQUAL(SMREZ_TIMED_OUT, swimux->negotiateBaudRate(921600));
+    TEST_ASSERT_EQUAL_UINT32(SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS, swimux->getBaudRate());
+    assertLinkWorks();
+    TEST_ASSERT_EQUAL_UINT32(SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS, emulator->getBaudRate());
+}
+
+void test_legacy_firmware_stays_at_default()
+{
+    connect(921600, false);
+    TEST_ASSERT_EQUAL(SMREZ_UnkownCommand, swimux->negotiateBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS, swimux->getBaudRate());
+    assertLinkWorks();
+}
+
+void test_power_cycled_swimux_is_found_back_at_default()
+{
+    connect(921600);
+    TEST_ASSERT_EQUAL(SMREZ_OK, swimux->negotiateBaudRate());
+    emulator->powerCycle();
+    delay(10);
+    assertLinkWorks();
+    TEST_ASSERT_EQUAL_UINT32(SwiMuxSerial_t::DEFAULT_SERIAL_BAUDS, swimux->getBaudRate());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_negotiates_the_fastest_rate);
+    RUN_TEST(test_tries_the_preferred_rate_first);
+    RUN_TEST(test_settles_on_the_fastest_rate_that_passes_the_link_test);
+    RUN_TEST(test_stays_at_default_when_no_rate_passes);
+    RUN_TEST(test_legacy_firmware_stays_at_default);
+    RUN_TEST(test_power_cycled_swimux_is_found_back_at_default);
+    return UNITY_END();
+}